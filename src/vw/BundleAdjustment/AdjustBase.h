@@ -28,8 +28,12 @@
 #define __VW_BUNDLEADJUSTMENT_ADJUST_BASE_H__
 
 #include <vw/BundleAdjustment/ModelBase.h>
+#include <vw/Core/ThreadPool.h>
 #include <boost/foreach.hpp>
 
+#include <algorithm>
+#include <exception>
+
 namespace vw {
 namespace ba {
 
@@ -217,6 +221,23 @@ namespace ba {
     return ret;
   };
 
+  // MEASURE TERMS
+  //--------------------------------------------------------
+  // One image measurement's share of the normal equations, with
+  // fixed-size blocks so that a whole network's worth is stored
+  // contiguously.  The rows of the Jacobian are sqrt(weight)*A and
+  // sqrt(weight)*B, and the residual row is sqrt(weight)*error.
+  template <size_t CameraParamsN, size_t PointParamsN>
+  struct MeasureTerm {
+    size_t point_id, camera_id;
+    Matrix<double, 2, CameraParamsN> A;   // d pixel / d camera
+    Matrix<double, 2, PointParamsN>  B;   // d pixel / d point
+    Vector2   location;                   // Measured pixel
+    Vector2   error;                      // Measured minus projected, robustly weighted
+    Matrix2x2 inverse_cov;                // From the measure's sigma
+    double    weight;                     // Scale on this measure's normal equation terms
+  };
+
   // BUNDLE ADJUSTMENT BASE
   //--------------------------------------------------------
   // This is a base class for the item which actually performs the
@@ -240,6 +261,181 @@ namespace ba {
     bool m_use_camera_constraint;
     bool m_use_gcp_constraint;
 
+    // Fixed-size blocks of the normal equations
+    typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::camera_params_n> matrix_camera_camera;
+    typedef Matrix<double,BundleAdjustModelT::point_params_n,BundleAdjustModelT::point_params_n> matrix_point_point;
+    typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::point_params_n> matrix_camera_point;
+    typedef Vector<double,BundleAdjustModelT::camera_params_n> vector_camera;
+    typedef Vector<double,BundleAdjustModelT::point_params_n> vector_point;
+    typedef MeasureTerm<BundleAdjustModelT::camera_params_n,BundleAdjustModelT::point_params_n> measure_term;
+
+    // The image measurements in control network order, so the
+    // measures of point i are m_measures[m_point_measures[i]] up to
+    // m_measures[m_point_measures[i+1]].
+    std::vector<measure_term> m_measures;
+    std::vector<size_t> m_point_measures;
+    int m_num_threads;
+
+    // The index in m_measures of the first measure of a point in a
+    // camera at or after 'start'.  A point measured more than once in
+    // the same image has a measure for each, so the next one is found
+    // by starting after the previous match.
+    size_t find_measure( size_t point_id, size_t camera_id, size_t start = 0 ) const {
+      size_t end = m_point_measures[point_id+1];
+      for ( size_t k = std::max( start, m_point_measures[point_id] ); k < end; k++ )
+        if ( m_measures[k].camera_id == camera_id )
+          return k;
+      vw_throw( LogicErr() << "AdjustBase: point " << point_id << " has no further measure in camera " << camera_id << "." );
+      return end;
+    }
+
+    // The normal equation blocks filled in by assemble().  Any may be
+    // null when the caller does not need them.
+    struct NormalEquations {
+      std::vector<matrix_camera_camera>* U;         // Per camera
+      std::vector<vector_camera>*        epsilon_a; // Per camera
+      std::vector<matrix_point_point>*   V;         // Per point
+      std::vector<vector_point>*         epsilon_b; // Per point
+      std::vector<matrix_camera_point>*  W;         // Per measure
+      NormalEquations() : U(0), epsilon_a(0), V(0), epsilon_b(0), W(0) {}
+    };
+
+    // Evaluates and accumulates the measures of a range of control
+    // points.  Each task owns its points' blocks of V and epsilon_b
+    // and the W of their measures, and sums U and epsilon_a into its
+    // own copies that are reduced once all tasks are done.
+    class AssembleTask : public Task {
+      AdjustBase& m_adjust;
+      size_t m_begin, m_end;
+      double m_student_t_df;
+      NormalEquations m_normal;
+    public:
+      std::vector<matrix_camera_camera> U;
+      std::vector<vector_camera> epsilon_a;
+      double objective;
+      std::exception_ptr error;
+
+      AssembleTask( AdjustBase& adjust, size_t begin, size_t end,
+                    double student_t_df, NormalEquations const& normal ) :
+        m_adjust(adjust), m_begin(begin), m_end(end), m_student_t_df(student_t_df),
+        m_normal(normal), objective(0) {
+        if ( m_normal.U )         U.resize( m_normal.U->size() );
+        if ( m_normal.epsilon_a ) epsilon_a.resize( m_normal.epsilon_a->size() );
+      }
+
+      virtual void operator()() {
+        try {
+          RobustCostT robust_cost_func = m_adjust.m_robust_cost_func;
+          for ( size_t i = m_begin; i < m_end; i++ )
+            for ( size_t k = m_adjust.m_point_measures[i];
+                  k < m_adjust.m_point_measures[i+1]; k++ ) {
+              measure_term& term = m_adjust.m_measures[k];
+              objective += m_adjust.evaluate_measure( term, robust_cost_func, m_student_t_df );
+
+              Matrix<double,BundleAdjustModelT::camera_params_n,2> AT =
+                term.weight * transpose(term.A) * term.inverse_cov;
+              Matrix<double,BundleAdjustModelT::point_params_n,2> BT =
+                term.weight * transpose(term.B) * term.inverse_cov;
+              if ( m_normal.U )         U[term.camera_id] += AT * term.A;
+              if ( m_normal.epsilon_a ) epsilon_a[term.camera_id] += AT * term.error;
+              if ( m_normal.V )         (*m_normal.V)[i] += BT * term.B;
+              if ( m_normal.epsilon_b ) (*m_normal.epsilon_b)[i] += BT * term.error;
+              if ( m_normal.W )         (*m_normal.W)[k] = AT * term.B;
+            }
+        } catch ( ... ) {
+          error = std::current_exception();
+        }
+      }
+    };
+
+    // Fills in the Jacobian blocks and residual of one measure and
+    // returns its contribution to the objective.  With student_t_df
+    // zero the residual is weighted by the robust cost function, as
+    // in AdjustRef and AdjustSparse; otherwise the measure is weighted
+    // by a Student's t distribution with that many degrees of
+    // freedom, as in AdjustRobustRef and AdjustRobustSparse.
+    double evaluate_measure( measure_term& term, RobustCostT& robust_cost_func,
+                             double student_t_df ) {
+      size_t i = term.point_id, j = term.camera_id;
+      term.A = m_model.cam_jacobian( i, j, m_model.cam_params(j), m_model.point_params(i) );
+      term.B = m_model.point_jacobian( i, j, m_model.cam_params(j), m_model.point_params(i) );
+
+      term.error = Vector2();
+      try {
+        term.error = term.location -
+          m_model.cam_pixel( i, j, m_model.cam_params(j), m_model.point_params(i) );
+      } catch (const camera::PointToPixelErr& e) {}
+
+      if ( student_t_df > 0 ) {
+        double S_weight = transpose(term.error) * term.inverse_cov * term.error;
+        term.weight = (student_t_df + 2)/(student_t_df + S_weight);
+        return 0.5*(student_t_df + 2)*log(1 + S_weight/student_t_df);
+      }
+
+      term.weight = 1;
+      if ( term.error != Vector2() ) {
+        double mag = norm_2(term.error);
+        term.error *= sqrt(robust_cost_func(mag)) / mag;
+      }
+      return .5 * transpose(term.error) * term.inverse_cov * term.error;
+    }
+
+    // Evaluates every measure and sums them into the normal
+    // equations.  With more than one thread (see set_num_threads())
+    // blocks of control points are worked on in parallel.  Returns the
+    // pixel part of the objective.
+    double assemble( NormalEquations const& normal, double student_t_df = 0 ) {
+      if ( normal.U )
+        std::fill( normal.U->begin(), normal.U->end(), matrix_camera_camera() );
+      if ( normal.epsilon_a )
+        std::fill( normal.epsilon_a->begin(), normal.epsilon_a->end(), vector_camera() );
+      if ( normal.V )
+        std::fill( normal.V->begin(), normal.V->end(), matrix_point_point() );
+      if ( normal.epsilon_b )
+        std::fill( normal.epsilon_b->begin(), normal.epsilon_b->end(), vector_point() );
+      if ( normal.W )
+        normal.W->resize( m_measures.size() );
+
+      // Split the points into ranges with about the same number of
+      // measures, a few per thread to even out the load.
+      size_t num_points = m_point_measures.size() - 1;
+      size_t num_tasks = m_num_threads > 1 ? 4 * m_num_threads : 1;
+      std::vector<boost::shared_ptr<AssembleTask> > tasks;
+      size_t begin = 0;
+      for ( size_t t = 1; t <= num_tasks && begin < num_points; t++ ) {
+        size_t end = begin + 1;
+        size_t target = ( m_measures.size() * t ) / num_tasks;
+        while ( end < num_points && m_point_measures[end] < target )
+          end++;
+        if ( t == num_tasks )
+          end = num_points;
+        tasks.push_back( boost::shared_ptr<AssembleTask>( new AssembleTask( *this, begin, end, student_t_df, normal ) ) );
+        begin = end;
+      }
+
+      if ( tasks.size() > 1 ) {
+        FifoWorkQueue queue( m_num_threads );
+        BOOST_FOREACH( boost::shared_ptr<AssembleTask> task, tasks )
+          queue.add_task( task );
+        queue.join_all();
+      } else if ( !tasks.empty() ) {
+        (*tasks[0])();
+      }
+
+      // Reduce in task order, so the sums do not depend on timing.
+      double objective = 0;
+      BOOST_FOREACH( boost::shared_ptr<AssembleTask> task, tasks ) {
+        if ( task->error )
+          std::rethrow_exception( task->error );
+        objective += task->objective;
+        for ( size_t j = 0; j < task->U.size(); j++ )
+          (*normal.U)[j] += task->U[j];
+        for ( size_t j = 0; j < task->epsilon_a.size(); j++ )
+          (*normal.epsilon_a)[j] += task->epsilon_a[j];
+      }
+      return objective;
+    }
+
   public:
     // Constructor
     AdjustBase( BundleAdjustModelT &model,
@@ -252,6 +448,23 @@ namespace ba {
 
       m_iterations = 0;
       m_control_net = m_model.control_network();
+      m_num_threads = 1;
+
+      m_point_measures.reserve( m_control_net->size() + 1 );
+      m_point_measures.push_back( 0 );
+      for ( size_t i = 0; i < m_control_net->size(); ++i ) {
+        BOOST_FOREACH( ControlMeasure const& cmeasure, (*m_control_net)[i] ) {
+          measure_term term;
+          term.point_id = i;
+          term.camera_id = cmeasure.image_id();
+          term.location = cmeasure.dominant();
+          term.inverse_cov(0,0) = 1/(cmeasure.sigma()[0]*cmeasure.sigma()[0]);
+          term.inverse_cov(1,1) = 1/(cmeasure.sigma()[1]*cmeasure.sigma()[1]);
+          term.weight = 1;
+          m_measures.push_back( term );
+        }
+        m_point_measures.push_back( m_measures.size() );
+      }
 
       m_lambda = 1e-3;
       m_control = 0;
@@ -334,6 +547,12 @@ namespace ba {
     bool camera_constraint() const { return m_use_camera_constraint; }
     bool gcp_constraint() const { return m_use_gcp_constraint; }
 
+    // The number of threads that evaluate the measures each iteration,
+    // one by default.  More than one requires the model's cam_pixel()
+    // to be safe to call from several threads at once.
+    int num_threads() const { return m_num_threads; }
+    void set_num_threads(int num_threads) { m_num_threads = num_threads; }
+
     // Additional Information
     int iterations() const { return m_iterations; }
     RobustCostT costfunction() const { return m_robust_cost_func; }
@@ -55,6 +55,7 @@ namespace ba {
 
     // Need to save S for covariance calculations
     math::Matrix<double> m_S;
+    typedef typename AdjustBase<BundleAdjustModelT,RobustCostT>::measure_term measure_term;
 
   public:
 
@@ -142,45 +143,20 @@ namespace ba {
 
       // --- SETUP STEP ----
       // Add rows to J and error for the imaged pixel observations
+      this->assemble( typename AdjustBase<BundleAdjustModelT,RobustCostT>::NormalEquations() );
       int idx = 0;
-      for (unsigned i = 0; i < this->m_control_net->size(); ++i) {       // Iterate over control points
-        for (unsigned m = 0; m < (*(this->m_control_net))[i].size();
-             ++m) {  // Iterate over control measures
-          int camera_idx = (*(this->m_control_net))[i][m].image_id();
-
-          Matrix<double> J_a = this->m_model.cam_jacobian(i,camera_idx,
-                                                        this->m_model.cam_params(camera_idx),
-                                                        this->m_model.point_params(i));
-          Matrix<double> J_b = this->m_model.point_jacobian(i,camera_idx,
-                                                        this->m_model.cam_params(camera_idx),
-                                                        this->m_model.point_params(i));
-
-          // Populate the Jacobian Matrix
-          submatrix(J, 2*idx, num_cam_params*camera_idx, 2, num_cam_params) = J_a;
-          submatrix(J, 2*idx, num_cam_params*num_cameras + i*num_pt_params, 2, num_pt_params) = J_b;
+      BOOST_FOREACH( measure_term const& term, this->m_measures ) {
+        // Populate the Jacobian Matrix
+        submatrix(J, 2*idx, num_cam_params*term.camera_id, 2, num_cam_params) = term.A;
+        submatrix(J, 2*idx, num_cam_params*num_cameras + term.point_id*num_pt_params, 2, num_pt_params) = term.B;
 
-          // Apply robust cost function weighting and populate the error vector
-          Vector2 unweighted_error;
-          try {
-            unweighted_error = (*(this->m_control_net))[i][m].dominant() -
-              this->m_model.cam_pixel(i, camera_idx,
-                            this->m_model.cam_params(camera_idx),
-                            this->m_model.point_params(i));
-          } catch (const camera::PointToPixelErr& e) {}
-          double mag = norm_2(unweighted_error);
-          double weight = sqrt(this->m_robust_cost_func(mag)) / mag;
-          subvector(error,2*idx,2) = unweighted_error * weight;
-
-          // Fill in the entries of the sigma matrix with the uncertainty of the observations.
-          Matrix2x2 inverse_cov;
-          Vector2 pixel_sigma = (*(this->m_control_net))[i][m].sigma();
+        // The error is already weighted by the robust cost function
+        subvector(error,2*idx,2) = term.error;
 
-          inverse_cov(0,0) = 1/(pixel_sigma(0)*pixel_sigma(0));
-          inverse_cov(1,1) = 1/(pixel_sigma(1)*pixel_sigma(1));
-          submatrix(sigma, 2*idx, 2*idx, 2, 2) = inverse_cov;
+        // Fill in the entries of the sigma matrix with the uncertainty of the observations.
+        submatrix(sigma, 2*idx, 2*idx, 2, 2) = term.inverse_cov;
 
-          ++idx;
-        }
+        ++idx;
       }
 
       double max = 0.0;
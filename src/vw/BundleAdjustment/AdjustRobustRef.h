@@ -56,6 +56,7 @@ namespace ba {
 
     // Need to save S for covariance calculations
     math::Matrix<double> m_S;
+    typedef typename AdjustBase<BundleAdjustModelT,RobustCostT>::measure_term measure_term;
 
   public:
 
@@ -157,52 +158,22 @@ namespace ba {
       // --- SETUP STEP ----
       // Add rows to J and error for the imaged pixel observations
 
+      robust_objective = this->assemble( typename AdjustBase<BundleAdjustModelT,RobustCostT>::NormalEquations(), t_df );
       int idx = 0;
-      // Iterate over control points
-      for (unsigned i = 0; i < this->m_control_net->size(); ++i) {
-        // Iterate over control measures
-        for (unsigned m = 0; m < (*(this->m_control_net))[i].size(); ++m) {
-          int camera_idx = (*(this->m_control_net))[i][m].image_id();
-
-          Matrix<double> J_a = this->m_model.cam_jacobian(i,camera_idx,
-                                                        this->m_model.cam_params(camera_idx),
-                                                        this-> m_model.point_params(i));
-          Matrix<double> J_b = this->m_model.point_jacobian(i,camera_idx,
-                                                        this->m_model.cam_params(camera_idx),
-                                                        this->m_model.point_params(i));
-
-          // Apply robust cost function weighting and populate the error vector
-          Vector2 unweighted_error;
-          try {
-            unweighted_error = (*(this->m_control_net))[i][m].dominant() -
-              this->m_model.cam_pixel(i, camera_idx,
-                            this->m_model.cam_params(camera_idx),
-                            this->m_model.point_params(i));
-          } catch (const camera::PointToPixelErr& e) {}
-          // Fill in the entries of the sigma matrix with the uncertainty of the observations.
-          Matrix2x2 inverse_cov;
-          Vector2 pixel_sigma = (*(this->m_control_net))[i][m].sigma();
-          inverse_cov(0,0) = 1/(pixel_sigma(0)*pixel_sigma(0));
-          inverse_cov(1,1) = 1/(pixel_sigma(1)*pixel_sigma(1));
-          submatrix(sigma, 2*idx, 2*idx, 2, 2) = inverse_cov;
-
-          // Populate the S_weights, mu_weights vectors
-          double S_weight = transpose(unweighted_error) * inverse_cov * unweighted_error;
-          double mu_weight = (t_df + t_dim_pixel)/(t_df + S_weight);
-
-          robust_objective += 0.5*(t_df + t_dim_pixel)*log(1 + S_weight/t_df);
-
+      BOOST_FOREACH( measure_term const& term, this->m_measures ) {
+        double sqrt_mu = sqrt(term.weight);
 
-          // Populate the robust error vector
-          subvector(error,2*idx,2) = unweighted_error * sqrt(mu_weight);
+        // Fill in the entries of the sigma matrix with the uncertainty of the observations.
+        submatrix(sigma, 2*idx, 2*idx, 2, 2) = term.inverse_cov;
 
-          // Populate the robust Jacobian Matrix
-          submatrix(J, 2*idx, num_cam_params*camera_idx, 2, num_cam_params) = sqrt(mu_weight)*J_a;
-          submatrix(J, 2*idx, num_cam_params*num_cameras + i*num_pt_params, 2, num_pt_params) = sqrt(mu_weight)*J_b;
+        // Populate the robust error vector
+        subvector(error,2*idx,2) = term.error * sqrt_mu;
 
+        // Populate the robust Jacobian Matrix
+        submatrix(J, 2*idx, num_cam_params*term.camera_id, 2, num_cam_params) = sqrt_mu*term.A;
+        submatrix(J, 2*idx, num_cam_params*num_cameras + term.point_id*num_pt_params, 2, num_pt_params) = sqrt_mu*term.B;
 
-          ++idx;
-        }
+        ++idx;
       }
 
       // initialize m_lambda on first iteration, ignore if user has
@@ -25,24 +25,7 @@
 
 // Vision Workbench
 #include <vw/BundleAdjustment/AdjustBase.h>
-#include <vw/Math/MatrixSparseSkyline.h>
-
-// Boost
-#include <boost/numeric/ublas/matrix_sparse.hpp>
-#include <boost/numeric/ublas/vector_sparse.hpp>
-#include <boost/numeric/ublas/io.hpp>
-#include <boost/version.hpp>
-#if BOOST_VERSION<=103200
-// Mapped matrix doesn't exist in 1.32, but Sparse Matrix does
-//
-// Unfortunately some other tests say this doesn't work
-#define boost_sparse_matrix boost::numeric::ublas::sparse_matrix
-#define boost_sparse_vector boost::numeric::ublas::sparse_vector
-#else
-// Sparse Matrix was renamed Mapped Matrix in later editions
-#define boost_sparse_matrix boost::numeric::ublas::mapped_matrix
-#define boost_sparse_vector boost::numeric::ublas::mapped_vector
-#endif
+#include <vw/BundleAdjustment/ReducedCameraSystem.h>
 
 namespace vw {
 namespace ba {
@@ -51,18 +34,13 @@ namespace ba {
   class AdjustRobustSparse : public AdjustBase<BundleAdjustModelT, RobustCostT> {
 
     // Common Types
-    typedef Matrix<double, 2, BundleAdjustModelT::camera_params_n> matrix_2_camera;
-    typedef Matrix<double, 2, BundleAdjustModelT::point_params_n> matrix_2_point;
     typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::camera_params_n> matrix_camera_camera;
     typedef Matrix<double,BundleAdjustModelT::point_params_n,BundleAdjustModelT::point_params_n> matrix_point_point;
     typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::point_params_n> matrix_camera_point;
     typedef Vector<double,BundleAdjustModelT::camera_params_n> vector_camera;
     typedef Vector<double,BundleAdjustModelT::point_params_n> vector_point;
 
-    math::MatrixSparseSkyline<double> m_S;
-    std::vector<size_t> m_ideal_ordering;
-    Vector<size_t> m_ideal_skyline;
-    bool m_found_ideal_ordering;
+    ReducedCameraSystem m_S;
     CameraRelationNetwork<JFeature> m_crn;
     typedef CameraNode<JFeature>::iterator crn_iter;
 
@@ -71,6 +49,7 @@ namespace ba {
     std::vector< matrix_point_point > V, V_inverse;
     std::vector< vector_camera > epsilon_a;
     std::vector< vector_point > epsilon_b;
+    std::vector< matrix_camera_point > W, Y; // Per measure, see JFeature::m_index
 
   public:
 
@@ -86,10 +65,30 @@ namespace ba {
       epsilon_a( this->m_model.num_cameras() ), epsilon_b( this->m_model.num_points() ) {
       vw_out(DebugMessage,"ba") << "Constructed Robust Sparse Bundle Adjuster.\n";
       m_crn.read_controlnetwork( *(this->m_control_net).get() );
-      m_found_ideal_ordering = false;
+
+      // Find the measure behind each feature, so that the W and Y
+      // blocks are kept in the order AdjustBase evaluates measures.
+      // A camera's features of one point are adjacent and in measure
+      // order, so repeated measures of a point each get their own.
+      for ( size_t j = 0; j < m_crn.size(); j++ ) {
+        boost::shared_ptr<JFeature> previous;
+        BOOST_FOREACH( boost::shared_ptr<JFeature> feature, m_crn[j] ) {
+          size_t start = 0;
+          if ( previous && previous->m_point_id == feature->m_point_id )
+            start = previous->m_index + 1;
+          feature->m_index = this->find_measure( feature->m_point_id, j, start );
+          previous = feature;
+        }
+      }
+      Y.resize( this->m_measures.size() );
     }
 
-    math::MatrixSparseSkyline<double> S() const { return m_S; }
+    // A copy of the reduced camera system from the last update.
+    math::MatrixSparseSkyline<double> S() const { return m_S.skyline<double>(); }
+
+    // Solve the reduced camera system by preconditioned conjugate
+    // gradient instead of sparse Cholesky.
+    void set_use_pcg( bool use_pcg ) { m_S.set_use_pcg( use_pcg ); }
 
     // Covariance Calculator
     // __________________________________________________
@@ -97,28 +96,20 @@ namespace ba {
     // covariance matrices for each camera
     void covCalc() {
       // camera params
-      size_t num_cam_params = BundleAdjustModelT::camera_params_n;
       size_t num_cameras = this->m_model.num_cameras();
 
-      size_t inverse_size = num_cam_params * num_cameras;
-
       typedef Matrix<double, BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n> matrix_camera_camera;
 
       // final vector of camera covariance matrices
       vw::Vector< matrix_camera_camera > sparse_cov(num_cameras);
 
-      // Get the S matrix from the model
-      math::MatrixSparseSkyline<double> S = this->S();
-      Matrix<double> Id(inverse_size, inverse_size);
-      Id.set_identity();
-      Matrix<double> Cov = multi_sparse_solve(S, Id);
-
-      //pick out covariances of indvidual cameras
+      std::vector<Matrix<double> > blocks;
+      if ( m_S.num_cameras() != num_cameras || !m_S.inverse_diagonal( blocks ) ) {
+        vw_out(WarningMessage,"ba") << "Cannot compute covariances: S has not been built or is not positive definite.\n";
+        return;
+      }
       for ( size_t i = 0; i < num_cameras; i++ )
-        sparse_cov(i) = submatrix(Cov, i*num_cam_params,
-                                  i*num_cam_params,
-                                  num_cam_params,
-                                  num_cam_params);
+        sparse_cov(i) = blocks[i];
     }
 
     // UPDATE IMPLEMENTATION
@@ -131,16 +122,6 @@ namespace ba {
 
       VW_DEBUG_ASSERT(this->m_control_net->size() == this->m_model.num_points(), LogicErr() << "BundleAdjustment::update() : Number of bundles does not match the number of points in the bundle adjustment model.");
 
-      // Reseting the values for U, V, and epsilon.
-      for ( size_t j = 0; j < this->m_model.num_cameras(); j++ ) {
-        U[j] = matrix_camera_camera();
-        epsilon_a[j] = vector_camera();
-      }
-      for ( size_t i = 0; i < this->m_model.num_points(); i++ ) {
-        V[i] = matrix_point_point();
-        epsilon_b[i] = vector_point();
-      }
-
       size_t num_cam_params = BundleAdjustModelT::camera_params_n;
       size_t num_pt_params = BundleAdjustModelT::point_params_n;
 
@@ -155,46 +136,15 @@ namespace ba {
 
       // Populate the Jacobian, which is broken into two sparse
       // matrices A & B, as well as the error matrix and the W
-      // matrix.
+      // matrix.  Each measure is weighted by the t distribution.
       time.reset(new Timer("Solve for Image Error, Jacobian, U, V, and W:", DebugMessage, "ba"));
-      double robust_objective = 0.0;
-      for ( size_t j = 0; j < m_crn.size(); j++ ) {
-        for ( crn_iter fiter = m_crn[j].begin();
-              fiter != m_crn[j].end(); fiter++ ) {
-          size_t i = (**fiter).m_point_id;
-
-          matrix_2_camera A = this->m_model.cam_jacobian(i,j,this->m_model.cam_params(j),
-                                                       this->m_model.point_params(i));
-          matrix_2_point B = this->m_model.point_jacobian(i,j,this->m_model.cam_params(j),
-                                                      this->m_model.point_params(i));
-
-          // Apply robust cost function weighting
-          Vector2 unweighted_error;
-          try {
-            unweighted_error = (**fiter).m_location -
-              this->m_model.cam_pixel(i,j,this->m_model.cam_params(j),
-                            this->m_model.point_params(i));
-          } catch (const camera::PointToPixelErr& e) {}
-
-          Vector2 pixel_sigma = (**fiter).m_scale;
-          Matrix2x2 inverse_cov;
-          inverse_cov(0,0) = 1/(pixel_sigma(0)*pixel_sigma(0));
-          inverse_cov(1,1) = 1/(pixel_sigma(1)*pixel_sigma(1));
-
-          double S_weight = transpose(unweighted_error) * inverse_cov * unweighted_error;
-          double mu_weight = (t_df + t_dim_pixel)/(t_df + S_weight);
-
-          // do NOT want epsilon_inst scaled
-          robust_objective += 0.5*(t_df + t_dim_pixel)*log(1 + S_weight/t_df);
-
-          // Storing intermediate values
-          U[j] += mu_weight * transpose(A) * inverse_cov * A;
-          V[i] += mu_weight * transpose(B) * inverse_cov * B;
-          (**fiter).m_w = mu_weight * transpose(A) * inverse_cov * B;
-          epsilon_a[j] += mu_weight * transpose(A) * inverse_cov * unweighted_error;
-          epsilon_b[i] += mu_weight * transpose(B) * inverse_cov * unweighted_error;
-        }
-      }
+      typename AdjustBase<BundleAdjustModelT,RobustCostT>::NormalEquations normal;
+      normal.U = &U;
+      normal.epsilon_a = &epsilon_a;
+      normal.V = &V;
+      normal.epsilon_b = &epsilon_b;
+      normal.W = &W;
+      double robust_objective = this->assemble( normal, t_df );
       time.reset();
 
       // Add in the camera position and pose constraint terms and covariances.
@@ -291,9 +241,10 @@ namespace ba {
               fiter != m_crn[j].end(); fiter++ ) {
           size_t i = (**fiter).m_point_id;
           // Compute the blocks of Y
-          (**fiter).m_y = (**fiter).m_w * V_inverse[i];
+          size_t k = (**fiter).m_index;
+          Y[k] = W[k] * V_inverse[i];
           // Flatten the block structure to compute 'e'
-          subvector(e, j*num_cam_params, num_cam_params) -= (**fiter).m_y
+          subvector(e, j*num_cam_params, num_cam_params) -= Y[k]
             * epsilon_b[i];
         }
       }
@@ -302,87 +253,77 @@ namespace ba {
       // --- BUILD SPARSE, SOLVE A'S UPDATE STEP -------------------------
       time.reset(new Timer("Build Sparse", DebugMessage, "ba"));
 
+      typedef boost::weak_ptr<JFeature> w_ptr;
+      typedef boost::shared_ptr<JFeature> f_ptr;
+      typedef std::multimap< size_t, f_ptr >::iterator mm_iterator;
+
       // The S matrix is a m x m block matrix with blocks that are
-      // camera_params_n x camera_params_n in size.  It has a sparse
-      // skyline structure, which makes it more efficient to solve
-      // through L*D*L^T decomposition and forward/back substitution
-      // below.
-      math::MatrixSparseSkyline<double> S(this->m_model.num_cameras()*num_cam_params,
-                                          this->m_model.num_cameras()*num_cam_params);
+      // camera_params_n x camera_params_n in size.  Only the blocks of
+      // cameras that share features are stored.  That pattern does not
+      // change, so it is only found on the first iteration.
+      if ( m_S.num_cameras() != m_crn.size() ) {
+        std::vector<std::vector<size_t> > pattern( m_crn.size() );
+        for ( size_t j = 0; j < m_crn.size(); j++ )
+          for ( mm_iterator k_iter = m_crn[j].map.upper_bound( j );
+                k_iter != m_crn[j].map.end();
+                k_iter = m_crn[j].map.upper_bound( k_iter->first ) )
+            pattern[ k_iter->first ].push_back( j );
+        m_S.set_pattern( num_cam_params, pattern );
+      }
+
       for ( size_t j = 0; j < m_crn.size(); j++ ) {
         { // Filling in diagonal
           matrix_camera_camera S_jj;
 
-          // Iterate across all features seen by the camera
+          // Iterate across all features seen by the camera, pairing
+          // repeated measures of a point in this camera as well.
           for ( crn_iter fiter = m_crn[j].begin();
                 fiter != m_crn[j].end(); fiter++ ) {
-            S_jj -= (**fiter).m_y*transpose((**fiter).m_w);
+            S_jj -= Y[(**fiter).m_index]*transpose(W[(**fiter).m_index]);
+            BOOST_FOREACH( w_ptr connection, (**fiter).m_connections ) {
+              f_ptr repeat = connection.lock();
+              if ( repeat->m_camera_id == j )
+                S_jj -= Y[(**fiter).m_index]*transpose(W[repeat->m_index]);
+            }
           }
 
           // Augmenting Diagonal
           S_jj += U[j];
 
-          // Loading into sparse matrix
-          size_t offset = j * num_cam_params;
-          for ( size_t aa = 0; aa < num_cam_params; aa++ ) {
-            for ( size_t bb = aa; bb < num_cam_params; bb++ ) {
-              S( offset+bb, offset+aa ) = S_jj(aa,bb);  // Transposing
-            }
-          }
+          m_S.set_block( j, j, S_jj );
         }
 
-        // Filling in off diagonal
-        for ( size_t k = j+1; k < m_crn.size(); k++ ) {
-          typedef boost::weak_ptr<JFeature> w_ptr;
-          typedef boost::shared_ptr<JFeature> f_ptr;
-          typedef std::multimap< size_t, f_ptr >::iterator mm_iterator;
+        // Filling in off diagonal, for each camera k > j that shares
+        // features with camera j.
+        for ( mm_iterator k_iter = m_crn[j].map.upper_bound( j );
+              k_iter != m_crn[j].map.end();
+              k_iter = m_crn[j].map.upper_bound( k_iter->first ) ) {
+          size_t k = k_iter->first;
           std::pair< mm_iterator, mm_iterator > feature_range;
           feature_range = m_crn[j].map.equal_range( k );
 
           // Iterating through all features in camera j that have
-          // connections to camera k.
+          // connections to camera k, and every feature of the same
+          // point in camera k (there may be more than one).
           matrix_camera_camera S_jk;
-          bool found = false;
           for ( mm_iterator f_j_iter = feature_range.first;
                 f_j_iter != feature_range.second; f_j_iter++ ) {
-            w_ptr f_k = (*f_j_iter).second->m_map[k];
-            found = true;
-            S_jk -= (*f_j_iter).second->m_y *
-              transpose( f_k.lock()->m_w );
+            BOOST_FOREACH( w_ptr connection, (*f_j_iter).second->m_connections ) {
+              f_ptr f_k = connection.lock();
+              if ( f_k->m_camera_id == k )
+                S_jk -= Y[(*f_j_iter).second->m_index] *
+                  transpose( W[f_k->m_index] );
+            }
           }
 
-          // Loading into sparse matrix
-          // - if it seems we are loading in oddly, it's because the sparse
-          //   matrix is row major.
-          if ( found ) {
-            submatrix( S, k*num_cam_params, j*num_cam_params,
-                       num_cam_params, num_cam_params ) = transpose(S_jk);
-          }
+          // S only stores its lower triangle.
+          m_S.set_block( k, j, transpose(S_jk) );
         }
       }
-
-      m_S = S; // S is modified in sparse solve. Keeping a copy;
       time.reset();
 
-      // Computing ideal ordering of sparse matrix
-      if ( !m_found_ideal_ordering ) {
-        time.reset(new Timer("Solving Cuthill-Mckee", DebugMessage, "ba"));
-        m_ideal_ordering = cuthill_mckee_ordering(S,num_cam_params);
-        math::MatrixReorganize<math::MatrixSparseSkyline<double> > mod_S( S, m_ideal_ordering );
-        m_ideal_skyline = solve_for_skyline( mod_S );
-
-        m_found_ideal_ordering = true;
-        time.reset();
-      }
-
       time.reset(new Timer("Solve Delta A", DebugMessage, "ba"));
-
-      // Compute the LDL^T decomposition and solve using sparse methods.
-      math::MatrixReorganize<math::MatrixSparseSkyline<double> > modified_S( S, m_ideal_ordering );
-      Vector<double> delta_a = sparse_solve( modified_S,
-                                             reorganize(e, m_ideal_ordering),
-                                             m_ideal_skyline );
-      delta_a = reorganize( delta_a, modified_S.inverse() );
+      Vector<double> delta_a = m_S.solve( e );
       BOOST_FOREACH( double& e, delta_a )
         if ( std::isnan( e ) ) e = 0;
       time.reset();
@@ -401,7 +342,7 @@ namespace ba {
         for ( size_t j = 0; j < m_crn.size(); j++ ) {
           for ( crn_iter fiter = m_crn[j].begin();
                 fiter != m_crn[j].end(); fiter++ ) {
-            right_delta_b[ (**fiter).m_point_id ] += transpose( (**fiter).m_w ) *
+            right_delta_b[ (**fiter).m_point_id ] += transpose( W[(**fiter).m_index] ) *
               subvector( delta_a, j*num_cam_params, num_cam_params );
           }
         }
@@ -24,28 +24,11 @@
 #define __VW_BUNDLEADJUSTMENT_ADJUST_SPARSE_H__
 
 // Vision Workbench
-#include <vw/Math/MatrixSparseSkyline.h>
 #include <vw/Core/Debugging.h>
 #include <vw/BundleAdjustment/AdjustBase.h>
+#include <vw/BundleAdjustment/ReducedCameraSystem.h>
 #include <vw/BundleAdjustment/CameraRelation.h>
 
-// Boost
-#include <boost/numeric/ublas/matrix_sparse.hpp>
-#include <boost/numeric/ublas/vector_sparse.hpp>
-#include <boost/numeric/ublas/io.hpp>
-#include <boost/version.hpp>
-#if BOOST_VERSION<=103200
-// Mapped matrix doesn't exist in 1.32, but Sparse Matrix does
-//
-// Unfortunately some other tests say this doesn't work
-#define boost_sparse_matrix boost::numeric::ublas::sparse_matrix
-#define boost_sparse_vector boost::numeric::ublas::sparse_vector
-#else
-// Sparse Matrix was renamed Mapped Matrix in later editions
-#define boost_sparse_matrix boost::numeric::ublas::mapped_matrix
-#define boost_sparse_vector boost::numeric::ublas::mapped_vector
-#endif
-
 namespace vw {
 namespace ba {
 
@@ -53,18 +36,13 @@ namespace ba {
   class AdjustSparse : public AdjustBase<BundleAdjustModelT, RobustCostT> {
 
     // Common Types
-    typedef Matrix<double, 2, BundleAdjustModelT::camera_params_n> matrix_2_camera;
-    typedef Matrix<double, 2, BundleAdjustModelT::point_params_n> matrix_2_point;
     typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::camera_params_n> matrix_camera_camera;
     typedef Matrix<double,BundleAdjustModelT::point_params_n,BundleAdjustModelT::point_params_n> matrix_point_point;
     typedef Matrix<double,BundleAdjustModelT::camera_params_n,BundleAdjustModelT::point_params_n> matrix_camera_point;
     typedef Vector<double,BundleAdjustModelT::camera_params_n> vector_camera;
     typedef Vector<double,BundleAdjustModelT::point_params_n> vector_point;
 
-    math::MatrixSparseSkyline<double> m_S;
-    std::vector<size_t> m_ideal_ordering;
-    Vector<size_t> m_ideal_skyline;
-    bool m_found_ideal_ordering;
+    ReducedCameraSystem m_S;
     CameraRelationNetwork<JFeature> m_crn;
     typedef CameraNode<JFeature>::iterator crn_iter;
 
@@ -73,6 +51,7 @@ namespace ba {
     std::vector< matrix_point_point > V, V_inverse;
     std::vector< vector_camera > epsilon_a;
     std::vector< vector_point > epsilon_b;
+    std::vector< matrix_camera_point > W, Y; // Per measure, see JFeature::m_index
 
   public:
 
@@ -88,10 +67,30 @@ namespace ba {
       epsilon_a( this->m_model.num_cameras() ), epsilon_b( this->m_model.num_points() ) {
       vw_out(DebugMessage,"ba") << "Constructed Sparse Bundle Adjuster.\n";
       m_crn.read_controlnetwork( *(this->m_control_net).get() );
-      m_found_ideal_ordering = false;
+
+      // Find the measure behind each feature, so that the W and Y
+      // blocks are kept in the order AdjustBase evaluates measures.
+      // A camera's features of one point are adjacent and in measure
+      // order, so repeated measures of a point each get their own.
+      for ( size_t j = 0; j < m_crn.size(); j++ ) {
+        boost::shared_ptr<JFeature> previous;
+        BOOST_FOREACH( boost::shared_ptr<JFeature> feature, m_crn[j] ) {
+          size_t start = 0;
+          if ( previous && previous->m_point_id == feature->m_point_id )
+            start = previous->m_index + 1;
+          feature->m_index = this->find_measure( feature->m_point_id, j, start );
+          previous = feature;
+        }
+      }
+      Y.resize( this->m_measures.size() );
     }
 
-    math::MatrixSparseSkyline<double> S() const { return m_S; }
+    // A copy of the reduced camera system from the last update.
+    math::MatrixSparseSkyline<double> S() const { return m_S.skyline<double>(); }
+
+    // Solve the reduced camera system by preconditioned conjugate
+    // gradient instead of sparse Cholesky.
+    void set_use_pcg( bool use_pcg ) { m_S.set_use_pcg( use_pcg ); }
 
     // Covariance Calculator
     // ___________________________________________________________
@@ -99,25 +98,20 @@ namespace ba {
     // covariance matrices for each camera
     void covCalc(){
       // camera params
-      size_t num_cam_params = BundleAdjustModelT::camera_params_n;
       size_t num_cameras = this->m_model.num_cameras();
 
-      size_t inverse_size = num_cam_params * num_cameras;
-
       typedef Matrix<double, BundleAdjustModelT::camera_params_n, BundleAdjustModelT::camera_params_n> matrix_camera_camera;
 
       // final vector of camera covariance matrices
       vw::Vector< matrix_camera_camera > sparse_cov(num_cameras);
 
-      // Get the S matrix from the model
-      math::MatrixSparseSkyline<double> S = this->S();  // Make copy as solve is destructive
-      Matrix<double> Id(inverse_size, inverse_size);
-      Id.set_identity();
-      Matrix<double> Cov = multi_sparse_solve(S, Id);
-
-      //pick out covariances of individual cameras
+      std::vector<Matrix<double> > blocks;
+      if ( m_S.num_cameras() != num_cameras || !m_S.inverse_diagonal( blocks ) ) {
+        vw_out(WarningMessage,"ba") << "Cannot compute covariances: S has not been built or is not positive definite.\n";
+        return;
+      }
       for ( size_t i = 0; i < num_cameras; i++ )
-        sparse_cov(i) = submatrix(Cov, i*num_cam_params, i*num_cam_params, num_cam_params, num_cam_params);
+        sparse_cov(i) = blocks[i];
 
       std::cout << "Covariance matrices for cameras are:"
                 << sparse_cov << "\n\n";
@@ -133,16 +127,6 @@ namespace ba {
 
       VW_DEBUG_ASSERT(this->m_control_net->size() == this->m_model.num_points(), LogicErr() << "BundleAdjustment::update() : Number of bundles does not match the number of points in the bundle adjustment model.");
 
-      // Reseting the values for U, V, epsilon
-      BOOST_FOREACH( matrix_camera_camera& element, U )
-        element = matrix_camera_camera();
-      BOOST_FOREACH( vector_camera& element, epsilon_a )
-        element = vector_camera();
-      BOOST_FOREACH( matrix_point_point& element, V )
-        element = matrix_point_point();
-      BOOST_FOREACH( vector_point& element, epsilon_b )
-        element = vector_point();
-
       size_t num_cam_params = BundleAdjustModelT::camera_params_n;
       size_t num_pt_params = BundleAdjustModelT::point_params_n;
 
@@ -150,49 +134,13 @@ namespace ba {
       // matrices A & B, as well as the error matrix and the W
       // matrix.
       time.reset(new Timer("Solve for Image Error, Jacobian, U, V, and W:", DebugMessage, "ba"));
-      double error_total = 0; // assume this is r^T\Sigma^{-1}r
-      for ( size_t j = 0; j < m_crn.size(); j++ ) {
-        BOOST_FOREACH( boost::shared_ptr<JFeature> measure, m_crn[j] ) {
-          size_t i = measure->m_point_id;
-
-          matrix_2_camera A =
-            this->m_model.cam_jacobian( i, j,
-                                      this->m_model.cam_params(j),
-                                      this->m_model.point_params(i) );
-          matrix_2_point B =
-            this->m_model.point_jacobian( i, j,
-                                      this->m_model.cam_params(j),
-                                      this->m_model.point_params(i) );
-
-          // Apply robust cost function weighting
-          Vector2 error;
-          try {
-            error = measure->m_location -
-              this->m_model.cam_pixel(i,j,this->m_model.cam_params(j),
-                            this->m_model.point_params(i) );
-          } catch (const camera::PointToPixelErr& e) {}
-
-          if ( error != Vector2() ) {
-            double mag = norm_2(error);
-            double weight = sqrt(this->m_robust_cost_func(mag)) / mag;
-            error *= weight;
-          }
-
-          Matrix2x2 inverse_cov;
-          Vector2 pixel_sigma = measure->m_scale;
-          inverse_cov(0,0) = 1/(pixel_sigma(0)*pixel_sigma(0));
-          inverse_cov(1,1) = 1/(pixel_sigma(1)*pixel_sigma(1));
-          error_total += .5 * transpose(error) *
-            inverse_cov * error;
-
-          // Storing intermediate values
-          U[j] += transpose(A) * inverse_cov * A;
-          V[i] += transpose(B) * inverse_cov * B;
-          epsilon_a[j] += transpose(A) * inverse_cov * error;
-          epsilon_b[i] += transpose(B) * inverse_cov * error;
-          measure->m_w = transpose(A) * inverse_cov * B;
-        }
-      }
+      typename AdjustBase<BundleAdjustModelT,RobustCostT>::NormalEquations normal;
+      normal.U = &U;
+      normal.epsilon_a = &epsilon_a;
+      normal.V = &V;
+      normal.epsilon_b = &epsilon_b;
+      normal.W = &W;
+      double error_total = this->assemble( normal ); // assume this is r^T\Sigma^{-1}r
       time.reset();
 
       // Add in the camera position and pose constraint terms and covariances.
@@ -284,9 +232,10 @@ namespace ba {
         for ( crn_iter fiter = m_crn[j].begin();
               fiter != m_crn[j].end(); fiter++ ) {
           // Compute the blocks of Y
-          (**fiter).m_y = (**fiter).m_w * V_inverse[(**fiter).m_point_id];
+          size_t k = (**fiter).m_index;
+          Y[k] = W[k] * V_inverse[(**fiter).m_point_id];
           // Flatten the block structure to compute 'e'
-          subvector(e, j*num_cam_params, num_cam_params) -= (**fiter).m_y
+          subvector(e, j*num_cam_params, num_cam_params) -= Y[k]
             * epsilon_b[ (**fiter).m_point_id ];
         }
       }
@@ -296,87 +245,77 @@ namespace ba {
       // --- BUILD SPARSE, SOLVE A'S UPDATE STEP -------------------------
       time.reset(new Timer("Build Sparse", DebugMessage, "ba"));
 
+      typedef boost::weak_ptr<JFeature> w_ptr;
+      typedef boost::shared_ptr<JFeature> f_ptr;
+      typedef std::multimap< size_t, f_ptr >::iterator mm_iterator;
+
       // The S matrix is a m x m block matrix with blocks that are
-      // camera_params_n x camera_params_n in size.  It has a sparse
-      // skyline structure, which makes it more efficient to solve
-      // through L*D*L^T decomposition and forward/back substitution
-      // below.
-      math::MatrixSparseSkyline<double> S(this->m_model.num_cameras()*num_cam_params,
-                                          this->m_model.num_cameras()*num_cam_params);
+      // camera_params_n x camera_params_n in size.  Only the blocks of
+      // cameras that share features are stored.  That pattern does not
+      // change, so it is only found on the first iteration.
+      if ( m_S.num_cameras() != m_crn.size() ) {
+        std::vector<std::vector<size_t> > pattern( m_crn.size() );
+        for ( size_t j = 0; j < m_crn.size(); j++ )
+          for ( mm_iterator k_iter = m_crn[j].map.upper_bound( j );
+                k_iter != m_crn[j].map.end();
+                k_iter = m_crn[j].map.upper_bound( k_iter->first ) )
+            pattern[ k_iter->first ].push_back( j );
+        m_S.set_pattern( num_cam_params, pattern );
+      }
+
       for ( size_t j = 0; j < m_crn.size(); j++ ) {
         { // Filling in diagonal
           matrix_camera_camera S_jj;
 
-          // Iterate across all features seen by the camera
+          // Iterate across all features seen by the camera, pairing
+          // repeated measures of a point in this camera as well.
           for ( crn_iter fiter = m_crn[j].begin();
                 fiter != m_crn[j].end(); fiter++ ) {
-            S_jj -= (**fiter).m_y*transpose((**fiter).m_w);
+            S_jj -= Y[(**fiter).m_index]*transpose(W[(**fiter).m_index]);
+            BOOST_FOREACH( w_ptr connection, (**fiter).m_connections ) {
+              f_ptr repeat = connection.lock();
+              if ( repeat->m_camera_id == j )
+                S_jj -= Y[(**fiter).m_index]*transpose(W[repeat->m_index]);
+            }
           }
 
           // Augmenting Diagonal
           S_jj += U[j];
 
-          // Loading into sparse matrix
-          size_t offset = j * num_cam_params;
-          for ( size_t aa = 0; aa < num_cam_params; aa++ ) {
-            for ( size_t bb = aa; bb < num_cam_params; bb++ ) {
-              S( offset+bb, offset+aa ) = S_jj(aa,bb);  // Transposing
-            }
-          }
+          m_S.set_block( j, j, S_jj );
         }
 
-        // Filling in off diagonal
-        for ( size_t k = j+1; k < m_crn.size(); k++ ) {
-          typedef boost::weak_ptr<JFeature> w_ptr;
-          typedef boost::shared_ptr<JFeature> f_ptr;
-          typedef std::multimap< size_t, f_ptr >::iterator mm_iterator;
+        // Filling in off diagonal, for each camera k > j that shares
+        // features with camera j.
+        for ( mm_iterator k_iter = m_crn[j].map.upper_bound( j );
+              k_iter != m_crn[j].map.end();
+              k_iter = m_crn[j].map.upper_bound( k_iter->first ) ) {
+          size_t k = k_iter->first;
           std::pair< mm_iterator, mm_iterator > feature_range;
           feature_range = m_crn[j].map.equal_range( k );
 
           // Iterating through all features in camera j that have
-          // connections to camera k.
+          // connections to camera k, and every feature of the same
+          // point in camera k (there may be more than one).
           matrix_camera_camera S_jk;
-          bool found = false;
           for ( mm_iterator f_j_iter = feature_range.first;
                 f_j_iter != feature_range.second; f_j_iter++ ) {
-            w_ptr f_k = (*f_j_iter).second->m_map[k];
-            found = true;
-            S_jk -= (*f_j_iter).second->m_y *
-              transpose( f_k.lock()->m_w );
+            BOOST_FOREACH( w_ptr connection, (*f_j_iter).second->m_connections ) {
+              f_ptr f_k = connection.lock();
+              if ( f_k->m_camera_id == k )
+                S_jk -= Y[(*f_j_iter).second->m_index] *
+                  transpose( W[f_k->m_index] );
+            }
           }
 
-          // Loading into sparse matrix
-          // - if it seems we are loading in oddly, it's because the sparse
-          //   matrix is row major.
-          if ( found ) {
-            submatrix( S, k*num_cam_params, j*num_cam_params,
-                       num_cam_params, num_cam_params ) = transpose(S_jk);
-          }
+          // S only stores its lower triangle.
+          m_S.set_block( k, j, transpose(S_jk) );
         }
       }
-
-      m_S = S; // S is modified in sparse solve. Keeping a copy.
       time.reset();
 
-      // Computing ideal ordering
-      if (!m_found_ideal_ordering) {
-        time.reset(new Timer("Solving Cuthill-Mckee", DebugMessage, "ba"));
-        m_ideal_ordering = cuthill_mckee_ordering(S,num_cam_params);
-        math::MatrixReorganize<math::MatrixSparseSkyline<double> > mod_S( S, m_ideal_ordering );
-        m_ideal_skyline = solve_for_skyline(mod_S);
-
-        m_found_ideal_ordering = true;
-        time.reset();
-      }
-
       time.reset(new Timer("Solve Delta A", DebugMessage, "ba"));
-
-      // Compute the LDL^T decomposition and solve using sparse methods.
-      math::MatrixReorganize<math::MatrixSparseSkyline<double> > modified_S( S, m_ideal_ordering );
-      Vector<double> delta_a = sparse_solve( modified_S,
-                                             reorganize(e, m_ideal_ordering),
-                                             m_ideal_skyline );
-      delta_a = reorganize(delta_a, modified_S.inverse());
+      Vector<double> delta_a = m_S.solve( e );
       BOOST_FOREACH( double& e, delta_a )
         if ( std::isnan( e ) ) e = 0;
       time.reset();
@@ -394,7 +333,7 @@ namespace ba {
         for ( size_t j = 0; j < m_crn.size(); j++ ) {
           for ( crn_iter fiter = m_crn[j].begin();
                 fiter != m_crn[j].end(); fiter++ ) {
-            right_delta_b[ (**fiter).m_point_id ] += transpose( (**fiter).m_w ) *
+            right_delta_b[ (**fiter).m_point_id ] += transpose( W[(**fiter).m_index] ) *
               subvector( delta_a, j*num_cam_params, num_cam_params );
           }
         }
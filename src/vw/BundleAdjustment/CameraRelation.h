@@ -145,19 +145,18 @@ namespace ba {
   // Jacobian Feature
   // - Intended for internal use in BA
   struct JFeature : public FeatureBase<JFeature> {
-    Matrix<double> m_w, m_y; // W = product of Jacobians, Y = product of W
-
+    size_t   m_index; // Where the adjuster keeps this measure's W and Y blocks
     size_t   m_point_id;
     Vector2f m_location;
     Vector2f m_scale;
 
     // Standard Constructor
     JFeature ( size_t const& point_id, size_t const& camera_id ) :
-        FeatureBase<JFeature>(camera_id), m_point_id(point_id) {}
+        FeatureBase<JFeature>(camera_id), m_index(0), m_point_id(point_id) {}
 
     // For building from control networks
     JFeature ( ControlMeasure const& cmeas, size_t const& point_id ) :
-        FeatureBase<JFeature>( cmeas.image_id() ), m_point_id(point_id) {
+        FeatureBase<JFeature>( cmeas.image_id() ), m_index(0), m_point_id(point_id) {
       m_location = cmeas.position();
       m_scale    = cmeas.sigma();
     }
@@ -0,0 +1,484 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file CompactControlNetwork.cc
+///
+
+#include <vw/config.h>
+#include <vw/Core/Exception.h>
+#include <vw/Core/Log.h>
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if VW_HAVE_PKG_BOOST_IOSTREAMS
+#include <boost/iostreams/device/mapped_file.hpp>
+#endif
+
+namespace {
+
+  // The file starts with this header.  The columns follow in the
+  // order of Layout, each padded to a multiple of 8 bytes, in the
+  // byte order of the machine that wrote them.
+  struct Header {
+    char       magic[4];
+    vw::uint32 version, byte_order, type;
+    vw::uint64 num_points, num_measures, num_images, names_size;
+  };
+
+  const char   compact_magic[4] = { 'V', 'W', 'C', 'N' };
+  const vw::uint32 byte_order_mark = 0x01020304;
+
+  // Byte offsets of the columns from the start of the header.
+  struct Layout {
+    vw::uint64 point_position, point_sigma, point_start, point_info,
+      measure_position, measure_sigma, measure_image, measure_point, measure_info,
+      image_start, image_measures, name_start, names, total;
+
+    explicit Layout( Header const& h ) {
+      vw::uint64 at = sizeof(Header);
+      point_position   = place( at, 3 * h.num_points * sizeof(double) );
+      point_sigma      = place( at, 3 * h.num_points * sizeof(double) );
+      point_start      = place( at, ( h.num_points + 1 ) * sizeof(vw::uint64) );
+      point_info       = place( at, h.num_points );
+      measure_position = place( at, 2 * h.num_measures * sizeof(double) );
+      measure_sigma    = place( at, 2 * h.num_measures * sizeof(double) );
+      measure_image    = place( at, h.num_measures * sizeof(vw::uint32) );
+      measure_point    = place( at, h.num_measures * sizeof(vw::uint32) );
+      measure_info     = place( at, h.num_measures );
+      image_start      = place( at, ( h.num_images + 1 ) * sizeof(vw::uint64) );
+      image_measures   = place( at, h.num_measures * sizeof(vw::uint64) );
+      name_start       = place( at, ( h.num_images + 1 ) * sizeof(vw::uint64) );
+      names            = place( at, h.names_size );
+      total            = at;
+    }
+
+    static vw::uint64 place( vw::uint64& at, vw::uint64 bytes ) {
+      vw::uint64 start = at;
+      at += ( bytes + 7 ) & ~vw::uint64(7);
+      return start;
+    }
+  };
+
+  template <class T>
+  T* column( vw::uint8* data, vw::uint64 offset ) { return reinterpret_cast<T*>( data + offset ); }
+
+  template <class T>
+  const T* column( const vw::uint8* data, vw::uint64 offset ) { return reinterpret_cast<const T*>( data + offset ); }
+
+  // Whether offsets[0..count] starts at zero, never decreases, and
+  // ends at last.
+  bool valid_offsets( const vw::uint64* offsets, vw::uint64 count, vw::uint64 last ) {
+    if ( offsets[0] != 0 || offsets[count] != last )
+      return false;
+    for ( vw::uint64 i = 0; i < count; i++ )
+      if ( offsets[i] > offsets[i+1] )
+        return false;
+    return true;
+  }
+
+} // namespace
+
+namespace vw {
+namespace ba {
+
+  ////////////////////////////
+  // Compact Control Network
+  ////////////////////////////
+
+  const uint32 CompactControlNetwork::format_version;
+
+  void CompactControlNetwork::Columns::add_point( ControlPoint const& point ) {
+    for ( size_t d = 0; d < 3; d++ ) {
+      point_position.push_back( point.position()[d] );
+      point_sigma.push_back( point.sigma()[d] );
+    }
+    point_info.push_back( uint8( point.type() ) | ( point.ignore() ? 0x80 : 0 ) );
+    BOOST_FOREACH( ControlMeasure const& cm, point ) {
+      VW_ASSERT( cm.image_id() <= 0xffffffffu,
+                 ArgumentErr() << "CompactControlNetwork: image id " << cm.image_id() << " is too large." );
+      measure_position.push_back( cm.position()[0] );
+      measure_position.push_back( cm.position()[1] );
+      measure_sigma.push_back( cm.sigma()[0] );
+      measure_sigma.push_back( cm.sigma()[1] );
+      measure_image.push_back( uint32( cm.image_id() ) );
+      measure_info.push_back( uint8( cm.type() ) | ( cm.ignore() ? 0x80 : 0 ) );
+    }
+    point_start.push_back( measure_image.size() );
+  }
+
+  CompactControlNetwork::CompactControlNetwork() {
+    *this = CompactControlNetwork( Columns() );
+  }
+
+  CompactControlNetwork::CompactControlNetwork( Columns const& columns ) {
+    uint64 num_points = columns.point_info.size(), num_measures = columns.measure_image.size();
+    VW_ASSERT( columns.point_start.size() == num_points + 1 && columns.point_start.back() == num_measures &&
+               columns.point_position.size() == 3 * num_points && columns.point_sigma.size() == 3 * num_points &&
+               columns.measure_position.size() == 2 * num_measures && columns.measure_sigma.size() == 2 * num_measures &&
+               columns.measure_info.size() == num_measures,
+               ArgumentErr() << "CompactControlNetwork: inconsistent column sizes." );
+    VW_ASSERT( num_points <= 0xffffffffu,
+               ArgumentErr() << "CompactControlNetwork: too many control points." );
+
+    // Measures may name images that have no name.
+    uint64 num_images = columns.image_names.size();
+    BOOST_FOREACH( uint32 image, columns.measure_image )
+      num_images = std::max( num_images, uint64(image) + 1 );
+
+    Header header;
+    std::memcpy( header.magic, compact_magic, 4 );
+    header.version      = format_version;
+    header.byte_order   = byte_order_mark;
+    header.type         = columns.type;
+    header.num_points   = num_points;
+    header.num_measures = num_measures;
+    header.num_images   = num_images;
+    header.names_size   = 0;
+    BOOST_FOREACH( std::string const& name, columns.image_names )
+      header.names_size += name.size();
+    Layout layout( header );
+
+    // Kept as words so the columns are aligned.
+    boost::shared_ptr<std::vector<uint64> > buffer( new std::vector<uint64>( layout.total / 8 ) );
+    uint8* data = reinterpret_cast<uint8*>( &(*buffer)[0] );
+    std::memcpy( data, &header, sizeof(header) );
+
+    std::copy( columns.point_position.begin(), columns.point_position.end(), column<double>( data, layout.point_position ) );
+    std::copy( columns.point_sigma.begin(), columns.point_sigma.end(), column<double>( data, layout.point_sigma ) );
+    std::copy( columns.point_start.begin(), columns.point_start.end(), column<uint64>( data, layout.point_start ) );
+    std::copy( columns.point_info.begin(), columns.point_info.end(), column<uint8>( data, layout.point_info ) );
+    std::copy( columns.measure_position.begin(), columns.measure_position.end(), column<double>( data, layout.measure_position ) );
+    std::copy( columns.measure_sigma.begin(), columns.measure_sigma.end(), column<double>( data, layout.measure_sigma ) );
+    std::copy( columns.measure_image.begin(), columns.measure_image.end(), column<uint32>( data, layout.measure_image ) );
+    std::copy( columns.measure_info.begin(), columns.measure_info.end(), column<uint8>( data, layout.measure_info ) );
+
+    uint32* measure_point = column<uint32>( data, layout.measure_point );
+    for ( uint64 i = 0; i < num_points; i++ )
+      for ( uint64 k = columns.point_start[i]; k < columns.point_start[i+1]; k++ )
+        measure_point[k] = uint32( i );
+
+    // The image index is a counting sort of the measures by image.
+    uint64* image_start = column<uint64>( data, layout.image_start );
+    uint64* image_measures = column<uint64>( data, layout.image_measures );
+    BOOST_FOREACH( uint32 image, columns.measure_image )
+      image_start[image+1]++;
+    for ( uint64 j = 0; j < num_images; j++ )
+      image_start[j+1] += image_start[j];
+    std::vector<uint64> next( image_start, image_start + num_images );
+    for ( uint64 k = 0; k < num_measures; k++ )
+      image_measures[ next[ columns.measure_image[k] ]++ ] = k;
+
+    uint64* name_start = column<uint64>( data, layout.name_start );
+    char* names = column<char>( data, layout.names );
+    for ( uint64 j = 0; j < num_images; j++ ) {
+      name_start[j+1] = name_start[j];
+      if ( j < columns.image_names.size() ) {
+        std::string const& name = columns.image_names[j];
+        std::copy( name.begin(), name.end(), names + name_start[j] );
+        name_start[j+1] += name.size();
+      }
+    }
+
+    attach( buffer, data, layout.total, "memory" );
+  }
+
+  CompactControlNetwork::CompactControlNetwork( ControlNetwork const& cnet ) {
+    Columns columns;
+    columns.type = cnet.type();
+    columns.image_names = cnet.get_image_list();
+    BOOST_FOREACH( ControlPoint const& cp, cnet )
+      columns.add_point( cp );
+    *this = CompactControlNetwork( columns );
+  }
+
+  CompactControlNetwork::CompactControlNetwork( std::string const& filename ) {
+#if VW_HAVE_PKG_BOOST_IOSTREAMS
+    boost::shared_ptr<boost::iostreams::mapped_file_source> file;
+    try {
+      file.reset( new boost::iostreams::mapped_file_source( filename ) );
+    } catch ( std::exception const& e ) {
+      vw_throw( IOErr() << "Failed to map \"" << filename << "\": " << e.what() );
+    }
+    attach( file, reinterpret_cast<const uint8*>( file->data() ), file->size(), filename );
+#else
+    std::ifstream f( filename.c_str(), std::ios::binary );
+    if ( !f.is_open() )
+      vw_throw( IOErr() << "Failed to open \"" << filename << "\" as a compact control network." );
+    f.seekg( 0, std::ios::end );
+    size_t size = f.tellg();
+    f.seekg( 0, std::ios::beg );
+    boost::shared_ptr<std::vector<uint64> > buffer( new std::vector<uint64>( ( size + 7 ) / 8 ) );
+    if ( size )
+      f.read( reinterpret_cast<char*>( &(*buffer)[0] ), size );
+    if ( !f )
+      vw_throw( IOErr() << "Failed to read \"" << filename << "\"." );
+    attach( buffer, size ? reinterpret_cast<const uint8*>( &(*buffer)[0] ) : 0, size, filename );
+#endif
+  }
+
+  void CompactControlNetwork::attach( boost::shared_ptr<const void> storage, const uint8* data, size_t size,
+                                      std::string const& source ) {
+    Header header;
+    if ( size < sizeof(header) )
+      vw_throw( IOErr() << "\"" << source << "\" is not a compact control network." );
+    std::memcpy( &header, data, sizeof(header) );
+    if ( std::memcmp( header.magic, compact_magic, 4 ) != 0 )
+      vw_throw( IOErr() << "\"" << source << "\" is not a compact control network." );
+    if ( header.byte_order != byte_order_mark )
+      vw_throw( IOErr() << "\"" << source << "\" was written on a machine with a different byte order." );
+    if ( header.version != format_version )
+      vw_throw( IOErr() << "\"" << source << "\" has compact control network version "
+                << header.version << ", expected " << format_version << "." );
+    // Bounding the counts by the size keeps the layout from overflowing.
+    if ( header.num_points > size || header.num_measures > size ||
+         header.num_images > size || header.names_size > size )
+      vw_throw( IOErr() << "\"" << source << "\" is truncated." );
+    Layout layout( header );
+    if ( layout.total != size )
+      vw_throw( IOErr() << "\"" << source << "\" is truncated." );
+
+    m_storage      = storage;
+    m_data         = data;
+    m_size         = size;
+    m_type         = header.type;
+    m_num_points   = header.num_points;
+    m_num_measures = header.num_measures;
+    m_num_images   = header.num_images;
+    m_point_position   = column<double>( data, layout.point_position );
+    m_point_sigma      = column<double>( data, layout.point_sigma );
+    m_point_start      = column<uint64>( data, layout.point_start );
+    m_point_info       = column<uint8> ( data, layout.point_info );
+    m_measure_position = column<double>( data, layout.measure_position );
+    m_measure_sigma    = column<double>( data, layout.measure_sigma );
+    m_measure_image    = column<uint32>( data, layout.measure_image );
+    m_measure_point    = column<uint32>( data, layout.measure_point );
+    m_measure_info     = column<uint8> ( data, layout.measure_info );
+    m_image_start      = column<uint64>( data, layout.image_start );
+    m_image_measures   = column<uint64>( data, layout.image_measures );
+    m_name_start       = column<uint64>( data, layout.name_start );
+    m_names            = column<char>  ( data, layout.names );
+
+    // Check every index, so that a damaged file cannot send the
+    // accessors out of bounds.
+    bool valid = valid_offsets( m_point_start, m_num_points, m_num_measures ) &&
+      valid_offsets( m_image_start, m_num_images, m_num_measures ) &&
+      valid_offsets( m_name_start, m_num_images, header.names_size );
+    for ( uint64 k = 0; valid && k < m_num_measures; k++ )
+      valid = m_measure_image[k] < m_num_images && m_measure_point[k] < m_num_points &&
+        m_image_measures[k] < m_num_measures;
+    if ( !valid )
+      vw_throw( IOErr() << "\"" << source << "\" has a corrupt index." );
+  }
+
+  ControlMeasure CompactControlNetwork::control_measure( size_t k ) const {
+    ControlMeasure cm( m_measure_position[2*k], m_measure_position[2*k+1],
+                       m_measure_sigma[2*k], m_measure_sigma[2*k+1],
+                       m_measure_image[k], measure_type(k) );
+    cm.set_ignore( measure_ignore(k) );
+    return cm;
+  }
+
+  ControlPoint CompactControlNetwork::control_point( size_t i ) const {
+    ControlPoint cp( point_type(i) );
+    cp.set_position( point_position(i) );
+    cp.set_sigma( point_sigma(i) );
+    cp.set_ignore( point_ignore(i) );
+    cp.reserve( point_size(i) );
+    for ( size_t k = point_begin(i); k < point_end(i); k++ )
+      cp.add_measure( control_measure(k) );
+    return cp;
+  }
+
+  void CompactControlNetwork::to_control_network( ControlNetwork& cnet ) const {
+    cnet.clear();
+    cnet.set_type( type() );
+    std::vector<std::string>& names = cnet.get_image_list();
+    names.clear();
+    for ( size_t j = 0; j < m_num_images; j++ )
+      names.push_back( image_name(j) );
+    cnet.reserve( m_num_points );
+    for ( size_t i = 0; i < m_num_points; i++ )
+      cnet.add_control_point( control_point(i) );
+  }
+
+  void CompactControlNetwork::write( std::string const& filename ) const {
+    std::ofstream f( filename.c_str(), std::ios::binary );
+    if ( !f.is_open() )
+      vw_throw( IOErr() << "Failed to open \"" << filename << "\" for writing." );
+    f.write( reinterpret_cast<const char*>( m_data ), m_size );
+    if ( !f )
+      vw_throw( IOErr() << "Failed to write \"" << filename << "\"." );
+  }
+
+  std::ostream& operator<<( std::ostream& os, CompactControlNetwork const& cnet ) {
+    os << "CompactControlNetwork: " << cnet.num_points() << " points, "
+       << cnet.num_measures() << " measures, " << cnet.num_images() << " images";
+    return os;
+  }
+
+  ////////////////////////////
+  // Builder
+  ////////////////////////////
+
+  size_t CompactControlNetworkBuilder::FeatureHash::operator()( Feature const& f ) const {
+    uint32 x, y;
+    std::memcpy( &x, &f.x, sizeof(x) );
+    std::memcpy( &y, &f.y, sizeof(y) );
+    uint64 h = f.image;
+    h = h * 0x9e3779b97f4a7c15ULL + x;
+    h = h * 0x9e3779b97f4a7c15ULL + y;
+    return size_t( h ^ ( h >> 29 ) );
+  }
+
+  uint64 CompactControlNetworkBuilder::feature( uint32 image, ip::InterestPoint const& ip ) {
+    Feature f;
+    f.x = ip.x == 0 ? 0.0f : ip.x;  // One hash for +0 and -0
+    f.y = ip.y == 0 ? 0.0f : ip.y;
+    f.sigma = ip.scale > 0 ? ip.scale : 10;  // Keep the measure usable by BA
+    f.image = image;
+    std::pair<lookup_type::iterator, bool> result = m_lookup.insert( std::make_pair( f, uint64( m_features.size() ) ) );
+    if ( result.second ) {
+      m_features.push_back( f );
+      m_parent.push_back( result.first->second );
+    }
+    return result.first->second;
+  }
+
+  uint64 CompactControlNetworkBuilder::find_root( uint64 f ) {
+    while ( m_parent[f] != f ) {
+      m_parent[f] = m_parent[ m_parent[f] ];
+      f = m_parent[f];
+    }
+    return f;
+  }
+
+  size_t CompactControlNetworkBuilder::add_image( std::string const& name ) {
+    m_extra.image_names.push_back( name );
+    return m_extra.image_names.size() - 1;
+  }
+
+  void CompactControlNetworkBuilder::add_matches( size_t image1, size_t image2,
+                                                  std::vector<ip::InterestPoint> const& ip1,
+                                                  std::vector<ip::InterestPoint> const& ip2 ) {
+    VW_ASSERT( ip1.size() == ip2.size(),
+               ArgumentErr() << "CompactControlNetworkBuilder: match lists differ in size." );
+    VW_ASSERT( image1 < num_images() && image2 < num_images(),
+               ArgumentErr() << "CompactControlNetworkBuilder: unknown image." );
+    for ( size_t k = 0; k < ip1.size(); k++ ) {
+      uint64 a = find_root( feature( image1, ip1[k] ) );
+      uint64 b = find_root( feature( image2, ip2[k] ) );
+      // The root is the first feature of a track, so tracks keep the
+      // order they were started in.
+      if ( a < b )
+        m_parent[b] = a;
+      else if ( b < a )
+        m_parent[a] = b;
+    }
+    m_num_matches += ip1.size();
+  }
+
+  size_t CompactControlNetworkBuilder::add_match_file( std::string const& match_file,
+                                                       size_t image1, size_t image2,
+                                                       size_t min_matches ) {
+    std::vector<ip::InterestPoint> ip1, ip2;
+    ip::read_binary_match_file( match_file, ip1, ip2 );
+    if ( ip1.size() >= min_matches )
+      add_matches( image1, image2, ip1, ip2 );
+    return ip1.size();
+  }
+
+  void CompactControlNetworkBuilder::add_control_point( ControlPoint const& point ) {
+    m_extra.add_point( point );
+  }
+
+  CompactControlNetwork CompactControlNetworkBuilder::build( ControlNetwork::ControlNetworkType type ) {
+    // Number the tracks in the order they were started, and group the
+    // features of each track, keeping the order they were added in.
+    uint64 num_features = m_features.size();
+    std::vector<uint64> track( num_features ), track_start( 1, 0 );
+    for ( uint64 f = 0; f < num_features; f++ ) {
+      uint64 root = find_root( f );
+      if ( root == f ) {
+        track[f] = track_start.size() - 1;
+        track_start.push_back( 0 );
+      } else {
+        track[f] = track[root];
+      }
+      track_start[ track[f] + 1 ]++;
+    }
+    uint64 num_tracks = track_start.size() - 1;
+    for ( uint64 t = 0; t < num_tracks; t++ )
+      track_start[t+1] += track_start[t];
+    std::vector<uint64> members( num_features ), next( track_start.begin(), track_start.end() - 1 );
+    for ( uint64 f = 0; f < num_features; f++ )
+      members[ next[ track[f] ]++ ] = f;
+
+    CompactControlNetwork::Columns columns;
+    columns.type = type;
+    columns.image_names = m_extra.image_names;
+    m_num_rejected = 0;
+    std::vector<uint32> images;
+    for ( uint64 t = 0; t < num_tracks; t++ ) {
+      // A track that reaches the same image twice holds a mismatch.
+      images.clear();
+      for ( uint64 n = track_start[t]; n < track_start[t+1]; n++ )
+        images.push_back( m_features[ members[n] ].image );
+      std::sort( images.begin(), images.end() );
+      if ( std::adjacent_find( images.begin(), images.end() ) != images.end() ) {
+        m_num_rejected++;
+        continue;
+      }
+
+      for ( size_t d = 0; d < 3; d++ ) {
+        columns.point_position.push_back( 0 );
+        columns.point_sigma.push_back( 0 );
+      }
+      columns.point_info.push_back( uint8( ControlPoint::TiePoint ) );
+      for ( uint64 n = track_start[t]; n < track_start[t+1]; n++ ) {
+        Feature const& f = m_features[ members[n] ];
+        columns.measure_position.push_back( f.x );
+        columns.measure_position.push_back( f.y );
+        columns.measure_sigma.push_back( f.sigma );
+        columns.measure_sigma.push_back( f.sigma );
+        columns.measure_image.push_back( f.image );
+        columns.measure_info.push_back( uint8( ControlMeasure::Automatic ) );
+      }
+      columns.point_start.push_back( columns.measure_image.size() );
+    }
+
+    // Append the points that were added whole.
+    uint64 offset = columns.measure_image.size();
+    columns.point_position.insert( columns.point_position.end(), m_extra.point_position.begin(), m_extra.point_position.end() );
+    columns.point_sigma.insert( columns.point_sigma.end(), m_extra.point_sigma.begin(), m_extra.point_sigma.end() );
+    columns.point_info.insert( columns.point_info.end(), m_extra.point_info.begin(), m_extra.point_info.end() );
+    for ( size_t i = 1; i < m_extra.point_start.size(); i++ )
+      columns.point_start.push_back( offset + m_extra.point_start[i] );
+    columns.measure_position.insert( columns.measure_position.end(), m_extra.measure_position.begin(), m_extra.measure_position.end() );
+    columns.measure_sigma.insert( columns.measure_sigma.end(), m_extra.measure_sigma.begin(), m_extra.measure_sigma.end() );
+    columns.measure_image.insert( columns.measure_image.end(), m_extra.measure_image.begin(), m_extra.measure_image.end() );
+    columns.measure_info.insert( columns.measure_info.end(), m_extra.measure_info.begin(), m_extra.measure_info.end() );
+
+    return CompactControlNetwork( columns );
+  }
+
+}} // namespace vw::ba
@@ -0,0 +1,223 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file CompactControlNetwork.h
+///
+/// A read-only control network stored column by column, for networks
+/// with millions of measures.  Each field of the points and measures
+/// is a flat array, the measures of a point are contiguous, and an
+/// index lists the measures of every image.  The same layout is used
+/// in memory and on disk, so a saved network is loaded by mapping the
+/// file rather than parsing it.
+///
+/// Only what bundle adjustment needs is kept: the strings, focal
+/// plane coordinates and times of ControlMeasure are not.
+///
+/// CompactControlNetworkBuilder assembles one from pairwise interest
+/// point matches as they are read, joining matches that share an
+/// interest point into tracks.
+
+#ifndef __VW_BUNDLEADJUSTMENT_COMPACT_CONTROL_NETWORK_H__
+#define __VW_BUNDLEADJUSTMENT_COMPACT_CONTROL_NETWORK_H__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Math/Vector.h>
+#include <vw/BundleAdjustment/ControlNetwork.h>
+#include <vw/InterestPoint/InterestData.h>
+
+#include <boost/shared_ptr.hpp>
+
+namespace vw {
+namespace ba {
+
+  /// A read-only control network with flat arrays for each field of
+  /// its points and measures, and an index of the measures in each
+  /// image.
+  class CompactControlNetwork {
+  public:
+    /// The version of the file layout written by write().
+    static const uint32 format_version = 2;
+
+    /// The columns of a network under construction.
+    struct Columns {
+      ControlNetwork::ControlNetworkType type;
+      std::vector<double> point_position, point_sigma;  // 3 per point
+      std::vector<uint8>  point_info;                   // Type and ignore flag
+      std::vector<uint64> point_start;                  // First measure of each point, then the total
+      std::vector<double> measure_position, measure_sigma; // 2 per measure
+      std::vector<uint32> measure_image;
+      std::vector<uint8>  measure_info;                 // Type and ignore flag
+      std::vector<std::string> image_names;
+
+      Columns() : type(ControlNetwork::ImageToImage), point_start(1, 0) {}
+      void add_point( ControlPoint const& point );
+    };
+
+  private:
+    boost::shared_ptr<const void> m_storage; // A buffer or a mapped file
+    const uint8*  m_data;
+    size_t        m_size;
+    uint32 m_type;
+    uint64 m_num_points, m_num_measures, m_num_images;
+    const double* m_point_position;
+    const double* m_point_sigma;
+    const uint64* m_point_start;
+    const uint8*  m_point_info;
+    const double* m_measure_position;
+    const double* m_measure_sigma;
+    const uint32* m_measure_image;
+    const uint32* m_measure_point;
+    const uint8*  m_measure_info;
+    const uint64* m_image_start;
+    const uint64* m_image_measures;
+    const uint64* m_name_start;
+    const char*   m_names;
+
+    void attach( boost::shared_ptr<const void> storage, const uint8* data, size_t size,
+                 std::string const& source );
+
+  public:
+    /// An empty network.
+    CompactControlNetwork();
+
+    /// Packs the given columns.
+    explicit CompactControlNetwork( Columns const& columns );
+
+    /// Copies the points, measures and image names of a ControlNetwork.
+    explicit CompactControlNetwork( ControlNetwork const& cnet );
+
+    /// Maps a file written by write().  Throws IOErr if the file is
+    /// not a compact control network of this version.
+    explicit CompactControlNetwork( std::string const& filename );
+
+    ControlNetwork::ControlNetworkType type() const { return ControlNetwork::ControlNetworkType(m_type); }
+    size_t num_points  () const { return m_num_points;   }
+    size_t num_measures() const { return m_num_measures; }
+    size_t num_images  () const { return m_num_images;   }
+
+    /// Points
+    Vector3 point_position( size_t i ) const { return Vector3( m_point_position[3*i], m_point_position[3*i+1], m_point_position[3*i+2] ); }
+    Vector3 point_sigma   ( size_t i ) const { return Vector3( m_point_sigma[3*i], m_point_sigma[3*i+1], m_point_sigma[3*i+2] ); }
+    ControlPoint::ControlPointType point_type( size_t i ) const { return ControlPoint::ControlPointType( m_point_info[i] & 0x7f ); }
+    bool   point_ignore( size_t i ) const { return m_point_info[i] & 0x80; }
+
+    /// The measures of point i are those from point_begin(i) up to point_end(i).
+    size_t point_begin ( size_t i ) const { return m_point_start[i];   }
+    size_t point_end   ( size_t i ) const { return m_point_start[i+1]; }
+    size_t point_size  ( size_t i ) const { return m_point_start[i+1] - m_point_start[i]; }
+
+    /// Measures
+    Vector2 measure_position( size_t k ) const { return Vector2( m_measure_position[2*k], m_measure_position[2*k+1] ); }
+    Vector2 measure_sigma   ( size_t k ) const { return Vector2( m_measure_sigma[2*k], m_measure_sigma[2*k+1] ); }
+    size_t  measure_image   ( size_t k ) const { return m_measure_image[k]; }
+    size_t  measure_point   ( size_t k ) const { return m_measure_point[k]; }
+    ControlMeasure::ControlMeasureType measure_type( size_t k ) const { return ControlMeasure::ControlMeasureType( m_measure_info[k] & 0x7f ); }
+    bool    measure_ignore  ( size_t k ) const { return m_measure_info[k] & 0x80; }
+
+    /// Images.  The measures seen in image j are image_measure(n) for
+    /// n from image_begin(j) up to image_end(j), in measure order.
+    std::string image_name( size_t j ) const { return std::string( m_names + m_name_start[j], m_names + m_name_start[j+1] ); }
+    size_t image_begin  ( size_t j ) const { return m_image_start[j];   }
+    size_t image_end    ( size_t j ) const { return m_image_start[j+1]; }
+    size_t image_size   ( size_t j ) const { return m_image_start[j+1] - m_image_start[j]; }
+    size_t image_measure( size_t n ) const { return m_image_measures[n]; }
+
+    /// Conversion back to the full classes.
+    ControlMeasure control_measure( size_t k ) const;
+    ControlPoint   control_point  ( size_t i ) const;
+
+    /// Replaces the points and image list of cnet with this network's.
+    void to_control_network( ControlNetwork& cnet ) const;
+
+    /// Writes the network in the layout it has in memory.
+    void write( std::string const& filename ) const;
+  };
+
+  std::ostream& operator<<( std::ostream& os, CompactControlNetwork const& cnet );
+
+  /// Builds a CompactControlNetwork from pairwise interest point
+  /// matches.  Each interest point is looked up by image and location
+  /// in a hash table, so adding a match takes constant time however
+  /// large the network grows, and the matches of each file can be
+  /// dropped once they are added.  Matches that share an interest
+  /// point are joined into one control point.
+  class CompactControlNetworkBuilder {
+    struct Feature {
+      float  x, y, sigma;
+      uint32 image;
+    };
+    struct FeatureHash {
+      size_t operator()( Feature const& f ) const;
+    };
+    struct FeatureEqual {
+      bool operator()( Feature const& a, Feature const& b ) const {
+        return a.image == b.image && a.x == b.x && a.y == b.y;
+      }
+    };
+    typedef std::unordered_map<Feature, uint64, FeatureHash, FeatureEqual> lookup_type;
+
+    std::vector<Feature> m_features;
+    std::vector<uint64>  m_parent;  // Union-find forest over m_features
+    lookup_type          m_lookup;
+    CompactControlNetwork::Columns m_extra; // Points added whole, such as GCPs
+    size_t m_num_matches, m_num_rejected;
+
+    uint64 feature( uint32 image, ip::InterestPoint const& ip );
+    uint64 find_root( uint64 f );
+
+  public:
+    CompactControlNetworkBuilder() : m_num_matches(0), m_num_rejected(0) {}
+
+    /// Adds an image and returns its index.
+    size_t add_image( std::string const& name );
+    size_t num_images() const { return m_extra.image_names.size(); }
+
+    /// Adds matches between the interest points ip1 in image1 and ip2
+    /// in image2.
+    void add_matches( size_t image1, size_t image2,
+                      std::vector<ip::InterestPoint> const& ip1,
+                      std::vector<ip::InterestPoint> const& ip2 );
+
+    /// Reads a match file written by ip::write_binary_match_file and
+    /// adds its matches, unless there are fewer than min_matches.
+    /// Returns the number of matches in the file.
+    size_t add_match_file( std::string const& match_file, size_t image1, size_t image2,
+                           size_t min_matches = 0 );
+
+    /// Adds a complete control point, such as a ground control point.
+    void add_control_point( ControlPoint const& point );
+
+    /// The number of matches added so far.
+    size_t num_matches() const { return m_num_matches; }
+
+    /// The number of control points dropped by the last build()
+    /// because they saw one image twice.
+    size_t num_rejected_points() const { return m_num_rejected; }
+
+    /// Joins the matches into control points, with the points added
+    /// by add_control_point() after them.
+    CompactControlNetwork build( ControlNetwork::ControlNetworkType type = ControlNetwork::ImageToImage );
+  };
+
+}} // namespace vw::ba
+
+#endif // __VW_BUNDLEADJUSTMENT_COMPACT_CONTROL_NETWORK_H__
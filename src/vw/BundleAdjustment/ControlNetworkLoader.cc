@@ -17,8 +17,8 @@
 
 
 #include <vw/BundleAdjustment/ControlNetworkLoader.h>
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
 #include <vw/Stereo/StereoModel.h>
-#include <vw/InterestPoint/Matcher.h>
 
 using namespace vw;
 using namespace vw::ba;
@@ -27,23 +27,6 @@ using namespace vw::ba;
 
 namespace fs = boost::filesystem;
 
-struct ContainsEqualIP {
-  ip::InterestPoint& m_compare;
-  ContainsEqualIP( ip::InterestPoint& comp ) : m_compare(comp) {}
-
-  bool operator()( boost::shared_ptr<IPFeature> in ) {
-    if (  m_compare.x == in->m_ip.x &&
-          m_compare.y == in->m_ip.y )
-      return true;
-    return false;
-  }
-};
-
-// Utility for checking that the point is BA safe
-void safe_measurement( ip::InterestPoint& ip ) {
-  if ( ip.scale <= 0 ) ip.scale = 10;
-}
-
 double vw::ba::triangulate_control_point( ControlPoint& cp,
                                           std::vector<boost::shared_ptr<camera::CameraModel> >
                                           const& camera_models,
@@ -137,13 +120,11 @@ bool vw::ba::build_control_network( bool triangulate_control_points,
   // std::map to give ourselves a sorted list and access to a binary search.
   std::map<std::string,size_t> image_prefix_map;
   size_t count = 0;
-  ba::CameraRelationNetwork<ba::IPFeature> crn;
+  ba::CompactControlNetworkBuilder builder;
   BOOST_FOREACH( std::string const& file, image_files ) {
     fs::path file_path(file);
     image_prefix_map[file_path.replace_extension().string()] = count;
-    crn.add_node( ba::CameraNode<ba::IPFeature>( count,
-                                                 file_path.stem().string() ) );
-    cnet.add_image_name(file);
+    builder.add_image(file);
     count++;
   }
 
@@ -186,66 +167,23 @@ bool vw::ba::build_control_network( bool triangulate_control_points,
     }
   }
 
-  // Loop through the match files...
+  // Loop through the match files, joining matches into tracks as
+  // they are read.
   size_t num_load_rejected = 0, num_loaded = 0;
   for (size_t file_iter = 0; file_iter < match_files_vec.size(); file_iter++){
     std::string match_file = match_files_vec[file_iter];
-    size_t index1 = index1_vec[file_iter];
-    size_t index2 = index2_vec[file_iter];
-
-    // Actually read in the file as it seems we've found something correct
-    std::vector<ip::InterestPoint> ip1, ip2;
     vw_out(DebugMessage,"ba") << "Loading: " << match_file << std::endl;
-    ip::read_binary_match_file( match_file, ip1, ip2 );
-    if ( ip1.size() < min_matches ) {
+    size_t num_matches = builder.add_match_file( match_file, index1_vec[file_iter],
+                                                 index2_vec[file_iter], min_matches );
+    if ( num_matches < min_matches ) {
       vw_out(DebugMessage,"ba") << "\t" << match_file << "    "
-                                << ip1.size() << " matches. [rejected]\n";
-      num_load_rejected += ip1.size();
+                                << num_matches << " matches. [rejected]\n";
+      num_load_rejected += num_matches;
       continue;
     }
     vw_out(DebugMessage,"ba") << "\t" << match_file << "    "
-                              << ip1.size() << " matches.\n";
-    num_loaded += ip1.size();
-
-    // Remove descriptors from interest points and correct scale
-    std::for_each( ip1.begin(), ip1.end(), ip::remove_descriptor );
-    std::for_each( ip2.begin(), ip2.end(), ip::remove_descriptor );
-    std::for_each( ip1.begin(), ip1.end(), safe_measurement );
-    std::for_each( ip2.begin(), ip2.end(), safe_measurement );
-
-    typedef boost::shared_ptr< ba::IPFeature > f_ptr;
-    typedef std::list< f_ptr >::iterator f_itr;
-
-    // Checking to see if features already exist, adding if they
-    // don't, then linking them.
-    vw_out() << "Building the control network for " << match_file <<".\n";
-    TerminalProgressCallback progress("ba", "Building: ");
-    progress.report_progress(0);
-    double inc_prog = 1.0/double(ip1.size());
-    for ( size_t k = 0; k < ip1.size(); k++ ) { // Loop through all existing IP
-      // Check if either IP is already in the lists
-      f_itr ipfeature1 = std::find_if( crn[index1].begin(),
-                                       crn[index1].end(),
-                                       ContainsEqualIP( ip1[k] ) );
-      f_itr ipfeature2 = std::find_if( crn[index2].begin(),
-                                       crn[index2].end(),
-                                       ContainsEqualIP( ip2[k] ) );
-      // If the IP are new, add them to the list
-      if ( ipfeature1 == crn[index1].end() ) {
-        crn[index1].relations.push_front( f_ptr( new ba::IPFeature( ip1[k], index1 ) ) );
-        ipfeature1 = crn[index1].begin();
-      }
-      if ( ipfeature2 == crn[index2].end() ) {
-        crn[index2].relations.push_front( f_ptr( new ba::IPFeature( ip2[k], index2 ) ) );
-        ipfeature2 = crn[index2].begin();
-      }
-
-      // Doubly linking
-      (*ipfeature1)->connection( *ipfeature2, false );
-      (*ipfeature2)->connection( *ipfeature1, false );
-      progress.report_incremental_progress(inc_prog );
-    } // End loop through ip1
-    progress.report_finished();
+                              << num_matches << " matches.\n";
+    num_loaded += num_matches;
   } // End loop through match files
 
   if ( num_load_rejected != 0 ) {
@@ -257,7 +195,15 @@ bool vw::ba::build_control_network( bool triangulate_control_points,
   }
 
   // Building control network
-  bool success = crn.write_controlnetwork( cnet );
+  ba::CompactControlNetwork compact = builder.build();
+  if ( builder.num_rejected_points() != 0 )
+    vw_out(WarningMessage,"ba") << "\t" << builder.num_rejected_points()
+                                << " control points removed due to spiral errors.\n";
+  compact.to_control_network( cnet );
+  bool success = cnet.size() != 0;
+  if ( !success )
+    vw_out(WarningMessage,"ba")
+      << "Failed to load any points, control network is empty.";
 
   // Triangulating Positions
   if (triangulate_control_points){
@@ -0,0 +1,63 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file ReducedCameraSystem.cc
+///
+
+#include <vw/BundleAdjustment/ReducedCameraSystem.h>
+#include <vw/Core/Log.h>
+
+namespace vw {
+namespace ba {
+
+  void ReducedCameraSystem::set_pattern( size_t camera_params, std::vector<std::vector<size_t> > const& pattern ) {
+    m_S = math::BlockSparseMatrix( camera_params, pattern );
+  }
+
+  Vector<double> ReducedCameraSystem::solve( Vector<double> const& e ) {
+    if ( !m_use_pcg ) {
+      if ( m_cholesky.factor( m_S ) )
+        return m_cholesky.solve( e );
+      vw_out(DebugMessage,"ba") << "S is not positive definite, using conjugate gradient.\n";
+    }
+    Vector<double> delta_a( e.size() );
+    size_t iterations = math::block_jacobi_pcg( m_S, e, delta_a );
+    vw_out(DebugMessage,"ba") << "Conjugate gradient took " << iterations << " iterations.\n";
+    return delta_a;
+  }
+
+  bool ReducedCameraSystem::inverse_diagonal( std::vector<Matrix<double> >& blocks ) {
+    if ( m_S.num_blocks() == 0 || !m_cholesky.factor( m_S ) )
+      return false;
+
+    // Solve for the columns of the inverse that hold each diagonal block.
+    size_t n = m_S.block_size();
+    blocks.assign( m_S.num_blocks(), Matrix<double>( n, n ) );
+    Vector<double> unit( m_S.rows() );
+    for ( size_t i = 0; i < m_S.num_blocks(); i++ )
+      for ( size_t c = 0; c < n; c++ ) {
+        unit[i*n+c] = 1;
+        Vector<double> column = m_cholesky.solve( unit );
+        unit[i*n+c] = 0;
+        for ( size_t r = 0; r < n; r++ )
+          blocks[i](r,c) = column[i*n+r];
+      }
+    return true;
+  }
+
+}} // namespace vw::ba
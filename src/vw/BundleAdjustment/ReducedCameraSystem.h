@@ -0,0 +1,103 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file ReducedCameraSystem.h
+///
+/// The reduced camera system S * delta_a = e that the sparse bundle
+/// adjusters solve on every iteration, once the points have been
+/// eliminated.
+
+#ifndef __VW_BUNDLEADJUSTMENT_REDUCED_CAMERA_SYSTEM_H__
+#define __VW_BUNDLEADJUSTMENT_REDUCED_CAMERA_SYSTEM_H__
+
+#include <vw/Math/BlockSparseCholesky.h>
+#include <vw/Math/MatrixSparseSkyline.h>
+#include <vw/Math/Matrix.h>
+#include <vw/Math/Vector.h>
+
+#include <vector>
+
+namespace vw {
+namespace ba {
+
+  /// S is a symmetric matrix of square camera blocks, with a block for
+  /// each pair of cameras that share features.  It is solved by sparse
+  /// Cholesky, which keeps its ordering and symbolic analysis from the
+  /// previous iterations, with conjugate gradient as the fallback if S
+  /// is not positive definite.
+  class ReducedCameraSystem {
+    math::BlockSparseMatrix   m_S;
+    math::BlockSparseCholesky m_cholesky;
+    bool                      m_use_pcg;
+
+  public:
+    ReducedCameraSystem() : m_use_pcg(false) {}
+
+    /// Solve by preconditioned conjugate gradient instead of sparse
+    /// Cholesky.  This needs no memory beyond S itself, which suits
+    /// very large camera networks.
+    void set_use_pcg( bool use_pcg ) { m_use_pcg = use_pcg; }
+
+    /// The number of cameras, or zero before the pattern is set.
+    size_t num_cameras() const { return m_S.num_blocks(); }
+
+    /// Set the pattern of S.  pattern[i] lists the cameras j < i that
+    /// share features with camera i.
+    void set_pattern( size_t camera_params, std::vector<std::vector<size_t> > const& pattern );
+
+    /// Copy a block into the lower triangle of S, j <= i.
+    template <class MatrixT>
+    void set_block( size_t i, size_t j, MatrixBase<MatrixT> const& block ) {
+      double* dest = m_S.block( i, j );
+      VW_ASSERT( dest, LogicErr() << "ReducedCameraSystem: block (" << i << "," << j << ") is not in the pattern." );
+      for ( size_t aa = 0; aa < m_S.block_size(); aa++ )
+        for ( size_t bb = 0; bb < m_S.block_size(); bb++ )
+          *dest++ = block.impl()(aa,bb);
+    }
+
+    /// Solve S * delta_a = e.
+    Vector<double> solve( Vector<double> const& e );
+
+    /// The diagonal blocks of the inverse of S, which are the camera
+    /// covariances.  Returns false if S has not been built or is not
+    /// positive definite.
+    bool inverse_diagonal( std::vector<Matrix<double> >& blocks );
+
+    math::BlockSparseMatrix const& matrix() const { return m_S; }
+
+    /// The lower triangle of S as a skyline matrix, as the sparse
+    /// adjusters used to store it.
+    template <class ElemT>
+    math::MatrixSparseSkyline<ElemT> skyline() const {
+      size_t n = m_S.block_size();
+      math::MatrixSparseSkyline<ElemT> S( m_S.rows() );
+      for ( size_t i = 0; i < m_S.num_blocks(); i++ )
+        for ( size_t k = m_S.row_begin( i ); k < m_S.row_end( i ); k++ ) {
+          size_t j = m_S.col_index( k );
+          double const* src = m_S.block_data( k );
+          for ( size_t aa = 0; aa < n; aa++ )
+            for ( size_t bb = 0; bb < n; bb++ )
+              S( i*n+aa, j*n+bb ) = *src++;
+        }
+      return S;
+    }
+  };
+
+}} // namespace vw::ba
+
+#endif // __VW_BUNDLEADJUSTMENT_REDUCED_CAMERA_SYSTEM_H__
@@ -0,0 +1,165 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+
+#include <fstream>
+#include <vw/BundleAdjustment/CompactControlNetwork.h>
+
+#include <test/Helpers.h>
+
+using namespace vw;
+using namespace vw::ba;
+using namespace vw::test;
+
+namespace {
+  ip::InterestPoint make_ip( float x, float y ) {
+    ip::InterestPoint ip( x, y, 2 );
+    return ip;
+  }
+}
+
+TEST( CompactControlNetwork, RoundTrip ) {
+  ControlNetwork cnet( "TestCNET", ControlNetwork::ImageToGround );
+  cnet.add_image_name( "a.tif" );
+  cnet.add_image_name( "b.tif" );
+  cnet.add_image_name( "c.tif" );
+  for ( uint32 i = 0; i < 4; i++ ) {
+    ControlPoint cpoint( i == 3 ? ControlPoint::GroundControlPoint : ControlPoint::TiePoint );
+    cpoint.set_position( Vector3( i, 2*i, 3*i ) );
+    cpoint.set_sigma( Vector3( 1, 1, 2 ) );
+    // Positions and sigmas that a float cannot hold, which must come
+    // back exactly.
+    for ( uint32 j = 0; j < i+1 && j < 3; j++ )
+      cpoint.add_measure( ControlMeasure( 10*i + j + 0.1, 20*i + 1.0/3, 0.3, 0.5, 2-j ) );
+    cnet.add_control_point( cpoint );
+  }
+  cnet[1][1].set_ignore( true );
+
+  CompactControlNetwork compact( cnet );
+  ASSERT_EQ( 4u, compact.num_points() );
+  ASSERT_EQ( 9u, compact.num_measures() );
+  ASSERT_EQ( 3u, compact.num_images() );
+  EXPECT_EQ( 3u, compact.point_size(2) );
+  EXPECT_EQ( ControlPoint::GroundControlPoint, compact.point_type(3) );
+  EXPECT_TRUE( compact.measure_ignore( compact.point_begin(1) + 1 ) );
+  EXPECT_EQ( "b.tif", compact.image_name(1) );
+
+  // Image 0 is the third image of points 2 and 3.
+  ASSERT_EQ( 2u, compact.image_size(0) );
+  size_t k = compact.image_measure( compact.image_begin(0) );
+  EXPECT_EQ( 2u, compact.measure_point(k) );
+  EXPECT_VECTOR_DOUBLE_EQ( Vector2(22.1, 40 + 1.0/3), compact.measure_position(k) );
+
+  UnlinkName file( "test.ccnet" );
+  compact.write( file );
+  CompactControlNetwork loaded( file );
+  ASSERT_EQ( 9u, loaded.num_measures() );
+  EXPECT_EQ( ControlNetwork::ImageToGround, loaded.type() );
+
+  ControlNetwork result( "result" );
+  loaded.to_control_network( result );
+  ASSERT_EQ( cnet.size(), result.size() );
+  EXPECT_EQ( cnet.get_image_list(), result.get_image_list() );
+  EXPECT_EQ( 1u, result.num_ground_control_points() );
+  for ( size_t i = 0; i < cnet.size(); i++ ) {
+    EXPECT_VECTOR_DOUBLE_EQ( cnet[i].position(), result[i].position() );
+    EXPECT_VECTOR_DOUBLE_EQ( cnet[i].sigma(), result[i].sigma() );
+    ASSERT_EQ( cnet[i].size(), result[i].size() );
+    for ( size_t m = 0; m < cnet[i].size(); m++ ) {
+      EXPECT_TRUE( cnet[i][m] == result[i][m] );
+      EXPECT_EQ( cnet[i][m].ignore(), result[i][m].ignore() );
+    }
+  }
+}
+
+TEST( CompactControlNetwork, BadFile ) {
+  UnlinkName file( "test.notccnet" );
+  {
+    std::ofstream out( file.c_str() );
+    out << "this is not a control network";
+  }
+  EXPECT_THROW( CompactControlNetwork net( file ), IOErr );
+
+  // A truncated network
+  ControlNetwork cnet( "TestCNET" );
+  ControlPoint cpoint;
+  cpoint.add_measure( ControlMeasure( 1, 2, 1, 1, 0 ) );
+  cnet.add_control_point( cpoint );
+  CompactControlNetwork( cnet ).write( file );
+  std::vector<char> bytes;
+  {
+    std::ifstream in( file.c_str(), std::ios::binary );
+    bytes.assign( std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() );
+  }
+  {
+    std::ofstream out( file.c_str(), std::ios::binary );
+    out.write( &bytes[0], bytes.size() - 8 );
+  }
+  EXPECT_THROW( CompactControlNetwork net( file ), IOErr );
+}
+
+TEST( CompactControlNetwork, Builder ) {
+  CompactControlNetworkBuilder builder;
+  for ( size_t j = 0; j < 4; j++ )
+    builder.add_image( "image" );
+
+  // A track through images 0, 1 and 2, added out of order, and a pair
+  // between images 2 and 3.
+  std::vector<ip::InterestPoint> ip1, ip2;
+  ip1.push_back( make_ip( 1, 1 ) );  ip2.push_back( make_ip( 2, 2 ) );
+  ip1.push_back( make_ip( 5, 5 ) );  ip2.push_back( make_ip( 6, 6 ) );
+  builder.add_matches( 1, 2, ip1, ip2 );
+
+  UnlinkName match_file( "test.match" );
+  ip1.clear(); ip2.clear();
+  ip1.push_back( make_ip( 0, 0 ) );  ip2.push_back( make_ip( 1, 1 ) );
+  ip1.push_back( make_ip( 9, 9 ) );  ip2.push_back( make_ip( 7, 7 ) );
+  ip::write_binary_match_file( match_file, ip1, ip2 );
+  EXPECT_EQ( 2u, builder.add_match_file( match_file, 0, 1 ) );
+  EXPECT_EQ( 2u, builder.add_match_file( match_file, 0, 1, 3 ) );  // Too few, not added
+
+  // A mismatch that brings image 3 into the same track twice.
+  ip1.clear(); ip2.clear();
+  ip1.push_back( make_ip( 6, 6 ) );  ip2.push_back( make_ip( 3, 3 ) );
+  ip1.push_back( make_ip( 6, 6 ) );  ip2.push_back( make_ip( 4, 4 ) );
+  builder.add_matches( 2, 3, ip1, ip2 );
+  EXPECT_EQ( 6u, builder.num_matches() );
+
+  ControlPoint gcp( ControlPoint::GroundControlPoint );
+  gcp.add_measure( ControlMeasure( 3, 4, 1, 1, 3 ) );
+  builder.add_control_point( gcp );
+
+  CompactControlNetwork cnet = builder.build();
+  EXPECT_EQ( 1u, builder.num_rejected_points() );
+  ASSERT_EQ( 3u, cnet.num_points() );
+
+  // The first track, in the order its interest points were seen
+  ASSERT_EQ( 3u, cnet.point_size(0) );
+  EXPECT_EQ( 1u, cnet.measure_image(0) );
+  EXPECT_EQ( 2u, cnet.measure_image(1) );
+  EXPECT_EQ( 0u, cnet.measure_image(2) );
+  EXPECT_VECTOR_DOUBLE_EQ( Vector2(2,2), cnet.measure_sigma(0) );
+
+  ASSERT_EQ( 2u, cnet.point_size(1) );
+  EXPECT_VECTOR_DOUBLE_EQ( Vector2(9,9), cnet.measure_position( cnet.point_begin(1) ) );
+
+  EXPECT_EQ( ControlPoint::GroundControlPoint, cnet.point_type(2) );
+  ASSERT_EQ( 1u, cnet.image_size(3) );
+  EXPECT_EQ( 2u, cnet.measure_point( cnet.image_measure( cnet.image_begin(3) ) ) );
+}
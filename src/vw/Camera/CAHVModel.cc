@@ -150,6 +150,48 @@ namespace camera {
     return C;
   };
 
+  void CAHVModel::points_to_pixels(std::vector<Vector3> const& points,
+                                   std::vector<Vector2>      & pixels) const {
+    const double ax = A[0], ay = A[1], az = A[2],
+                 hx = H[0], hy = H[1], hz = H[2],
+                 vx = V[0], vy = V[1], vz = V[2];
+    const size_t num_points = points.size();
+    pixels.resize(num_points);
+    for (size_t i = 0; i < num_points; i++) {
+      const double dx = points[i][0] - C[0],
+                   dy = points[i][1] - C[1],
+                   dz = points[i][2] - C[2];
+      const double dDot = ax*dx + ay*dy + az*dz;
+      pixels[i] = Vector2( (hx*dx + hy*dy + hz*dz) / dDot,
+                           (vx*dx + vy*dy + vz*dz) / dDot );
+    }
+  }
+
+  void CAHVModel::pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                    std::vector<Vector3>      & vectors) const {
+    // The handedness check in pixel_to_vector() does not depend on the pixel.
+    const double sign = (dot_prod(cross_prod(V, H), A) < 0.0) ? -1.0 : 1.0;
+    const double ax = A[0], ay = A[1], az = A[2],
+                 hx = H[0], hy = H[1], hz = H[2],
+                 vx = V[0], vy = V[1], vz = V[2];
+    const size_t num_pixels = pixels.size();
+    vectors.resize(num_pixels);
+    for (size_t i = 0; i < num_pixels; i++) {
+      const double c = pixels[i][0], r = pixels[i][1];
+      // cross_prod(V - r*A, H - c*A)
+      const double px = vx - r*ax, py = vy - r*ay, pz = vz - r*az;
+      const double qx = hx - c*ax, qy = hy - c*ay, qz = hz - c*az;
+      const double ox = py*qz - pz*qy, oy = pz*qx - px*qz, oz = px*qy - py*qx;
+      const double scale = sign / std::sqrt(ox*ox + oy*oy + oz*oz);
+      vectors[i] = Vector3(ox*scale, oy*scale, oz*scale);
+    }
+  }
+
+  void CAHVModel::camera_centers(std::vector<Vector2> const& pixels,
+                                 std::vector<Vector3>      & centers) const {
+    centers.assign(pixels.size(), C);
+  }
+
   // --------------------------------------------------
   //                 Private Methods
   // --------------------------------------------------
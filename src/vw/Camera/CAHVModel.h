@@ -122,6 +122,13 @@ namespace camera {
     virtual Vector3 pixel_to_vector(Vector2 const& pix  ) const;
     virtual Vector3 camera_center  (Vector2 const& /*pix*/ = Vector2() ) const;
 
+    virtual void points_to_pixels (std::vector<Vector3> const& points,
+                                   std::vector<Vector2>      & pixels ) const;
+    virtual void pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                   std::vector<Vector3>      & vectors) const;
+    virtual void camera_centers   (std::vector<Vector2> const& pixels,
+                                   std::vector<Vector3>      & centers) const;
+
     /// Write CAHV model to file
     void write(std::string const& filename);
 
@@ -349,6 +349,74 @@ Vector3 CAHVORModel::pixel_to_vector(Vector2 const& pix) const {
 
 Vector3 CAHVORModel::camera_center( Vector2 const& pix ) const { return C; }
 
+// Batch pixel_to_vector. Same math as above, with the loop invariant
+// quantities computed once. Iteration problems are reported once per
+// batch instead of once per pixel.
+void CAHVORModel::pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                    std::vector<Vector3>      & vectors) const {
+  const double sign = (dot_prod(cross_prod(V,H), A) < 0) ? -1.0 : 1.0;
+  const double ax = A[0], ay = A[1], az = A[2],
+               hx = H[0], hy = H[1], hz = H[2],
+               vx = V[0], vy = V[1], vz = V[2],
+               ox = O[0], oy = O[1], oz = O[2];
+  const double k1 = 1 + R(0);
+  int32 num_too_many_iter = 0, num_too_negative = 0;
+
+  const size_t num_pixels = pixels.size();
+  vectors.resize(num_pixels);
+  for (size_t p = 0; p < num_pixels; p++) {
+    const double c = pixels[p][0], r = pixels[p][1];
+
+    // rr = normalize(cross_prod(V - r*A, H - c*A)), with the handedness fix
+    const double px = vx - r*ax, py = vy - r*ay, pz = vz - r*az;
+    const double qx = hx - c*ax, qy = hy - c*ay, qz = hz - c*az;
+    double rx = py*qz - pz*qy, ry = pz*qx - px*qz, rz = px*qy - py*qx;
+    double scale = sign / std::sqrt(rx*rx + ry*ry + rz*rz);
+    rx *= scale; ry *= scale; rz *= scale;
+
+    const double omega = rx*ox + ry*oy + rz*oz;
+    const double lx = rx - omega*ox, ly = ry - omega*oy, lz = rz - omega*oz;
+    const double tau = (lx*lx + ly*ly + lz*lz) / (omega*omega);
+    const double k3  = R(1) * tau;
+    const double k5  = R(2) * tau*tau;
+
+    double u = 1.0 - (R(0) + k3 + k5);
+    for (int32 i=0;; i++) {
+      if (i >= VW_CAHVOR_MAXITER) {
+        num_too_many_iter++;
+        break;
+      }
+      double u_2   = u*u;
+      double poly  =  ((k5*u_2  +  k3)*u_2 + k1)*u - 1;
+      double deriv = (5*k5*u_2 + 3*k3)*u_2 + k1;
+      if (deriv <= 0) {
+        num_too_negative++;
+        break;
+      }
+      double du = poly/deriv;
+      u -= du;
+      if (fabs(du) < VW_CAHVOR_CONV)
+        break;
+    }
+
+    rx -= (1 - u)*lx; ry -= (1 - u)*ly; rz -= (1 - u)*lz;
+    scale = 1.0 / std::sqrt(rx*rx + ry*ry + rz*rz);
+    vectors[p] = Vector3(rx*scale, ry*scale, rz*scale);
+  }
+
+  if (num_too_many_iter > 0)
+    vw_out(InfoMessage, "camera") << "CAHVORModel.pixels_to_vectors(): Too many iterations for "
+                                  << num_too_many_iter << " pixels\n";
+  if (num_too_negative > 0)
+    vw_out(InfoMessage, "camera") << "CAHVORModel.pixels_to_vectors(): Distortion is too negative for "
+                                  << num_too_negative << " pixels\n";
+}
+
+void CAHVORModel::camera_centers(std::vector<Vector2> const& pixels,
+                                 std::vector<Vector3>      & centers) const {
+  centers.assign(pixels.size(), C);
+}
+
 // vector_to_pixel with partial_derivatives
 Vector2 CAHVORModel::point_to_pixel(Vector3 const& point,
                                     Matrix<double> &partial_derivatives) const {
@@ -447,6 +515,32 @@ Vector2 CAHVORModel::point_to_pixel(Vector3 const& point) const {
                   dot_prod(pp_c,V) / alpha );
 }
 
+// Batch point_to_pixel.
+void CAHVORModel::points_to_pixels(std::vector<Vector3> const& points,
+                                   std::vector<Vector2>      & pixels) const {
+  const double ax = A[0], ay = A[1], az = A[2],
+               hx = H[0], hy = H[1], hz = H[2],
+               vx = V[0], vy = V[1], vz = V[2],
+               ox = O[0], oy = O[1], oz = O[2];
+  const double r0 = R(0), r1 = R(1), r2 = R(2);
+
+  const size_t num_points = points.size();
+  pixels.resize(num_points);
+  for (size_t i = 0; i < num_points; i++) {
+    const double dx = points[i][0] - C[0],
+                 dy = points[i][1] - C[1],
+                 dz = points[i][2] - C[2];
+    const double omega = dx*ox + dy*oy + dz*oz;
+    const double lx = dx - omega*ox, ly = dy - omega*oy, lz = dz - omega*oz;
+    const double tau = (lx*lx + ly*ly + lz*lz) / (omega*omega);
+    const double mu  = r0 + (r1 * tau) + (r2 * tau * tau);
+    const double px = dx + mu*lx, py = dy + mu*ly, pz = dz + mu*lz;
+    const double alpha = px*ax + py*ay + pz*az;
+    pixels[i] = Vector2( (px*hx + py*hy + pz*hz) / alpha,
+                         (px*vx + py*vy + pz*vz) / alpha );
+  }
+}
+
 // linearize_camera
 //
 // Takes CAHVOR camera --> CAHV camera
@@ -45,6 +45,42 @@ CameraModel::camera_pose(Vector2 const& pix) const {
   return Quaternion<double>();
 }
 
+void CameraModel::points_to_pixels(std::vector<Vector3> const& points,
+                                   std::vector<Vector2>      & pixels) const {
+  pixels.resize(points.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    try {
+      pixels[i] = this->point_to_pixel(points[i]);
+    } catch(...) {
+      pixels[i] = invalid_pixel();
+    }
+  }
+}
+
+void CameraModel::pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                    std::vector<Vector3>      & vectors) const {
+  vectors.resize(pixels.size());
+  for (size_t i = 0; i < pixels.size(); i++) {
+    try {
+      vectors[i] = this->pixel_to_vector(pixels[i]);
+    } catch(...) {
+      vectors[i] = Vector3();
+    }
+  }
+}
+
+void CameraModel::camera_centers(std::vector<Vector2> const& pixels,
+                                 std::vector<Vector3>      & centers) const {
+  centers.resize(pixels.size());
+  for (size_t i = 0; i < pixels.size(); i++) {
+    try {
+      centers[i] = this->camera_center(pixels[i]);
+    } catch(...) {
+      centers[i] = Vector3();
+    }
+  }
+}
+
 AdjustedCameraModel::AdjustedCameraModel(boost::shared_ptr<CameraModel> camera_model,
                                          Vector3 const& translation, Quat const& rotation,
                                          Vector2 const& pixel_offset, double scale) :
@@ -124,6 +160,56 @@ Quat AdjustedCameraModel::camera_pose(Vector2 const& pix) const {
   return m_rotation*m_camera->camera_pose(m_scale*pix + m_pixel_offset);
 }
 
+// The batch versions move the whole batch into the frame of the
+// unadjusted camera, make a single batch call on it, and then undo the
+// adjustment, so that the wrapped model's own batch code gets used.
+void AdjustedCameraModel::points_to_pixels(std::vector<Vector3> const& points,
+                                           std::vector<Vector2>      & pixels) const {
+  // Apply the inverse rotation as a matrix, it is cheaper than
+  // rotating each point with the quaternion.
+  Matrix3x3 R   = normalize(m_rotation_inverse).rotation_matrix();
+  Vector3   ctr = m_rotation_center + m_translation;
+  std::vector<Vector3> new_pts(points.size());
+  for (size_t i = 0; i < points.size(); i++)
+    new_pts[i] = R*(points[i] - ctr) + m_rotation_center;
+
+  m_camera->points_to_pixels(new_pts, pixels);
+
+  const Vector2 invalid = invalid_pixel();
+  for (size_t i = 0; i < pixels.size(); i++) {
+    if (pixels[i] != invalid)
+      pixels[i] = (pixels[i] - m_pixel_offset)/m_scale;
+  }
+}
+
+void AdjustedCameraModel::pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                            std::vector<Vector3>      & vectors) const {
+  std::vector<Vector2> raw_pixels(pixels.size());
+  for (size_t i = 0; i < pixels.size(); i++)
+    raw_pixels[i] = m_scale*pixels[i] + m_pixel_offset;
+
+  m_camera->pixels_to_vectors(raw_pixels, vectors);
+
+  // A zero vector flags a failure and stays zero under the rotation.
+  Matrix3x3 R = normalize(m_rotation).rotation_matrix();
+  for (size_t i = 0; i < vectors.size(); i++)
+    vectors[i] = R*vectors[i];
+}
+
+void AdjustedCameraModel::camera_centers(std::vector<Vector2> const& pixels,
+                                         std::vector<Vector3>      & centers) const {
+  std::vector<Vector2> raw_pixels(pixels.size());
+  for (size_t i = 0; i < pixels.size(); i++)
+    raw_pixels[i] = m_scale*pixels[i] + m_pixel_offset;
+
+  m_camera->camera_centers(raw_pixels, centers);
+
+  Matrix3x3 R   = normalize(m_rotation).rotation_matrix();
+  Vector3   ctr = m_rotation_center + m_translation;
+  for (size_t i = 0; i < centers.size(); i++)
+    centers[i] = R*(centers[i] - m_rotation_center) + ctr;
+}
+
 // Modify the adjustments by applying on top of them a scale*rotation + translation
 // transform with the origin at the center of the planet (such as output
 // by pc_align's forward or inverse computed alignment transform). 
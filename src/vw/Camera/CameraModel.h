@@ -25,6 +25,7 @@
 #define __VW_CAMERA_CAMERAMODEL_H__
 
 #include <fstream>
+#include <vector>
 #include <vw/Core/Exception.h>
 #include <vw/Math/Matrix.h>
 #include <vw/Math/Vector.h>
@@ -96,6 +97,31 @@ namespace camera {
     /// - Generally the input pixel is only used for linescane cameras.
     virtual Quaternion<double> camera_pose(Vector2 const& /*pix*/) const;
 
+    //------------------------------------------------------------------
+    // Batch Interface
+    //------------------------------------------------------------------
+
+    /// Batch version of point_to_pixel().  The output is resized to
+    /// match the input.  Instead of throwing, points which fail to
+    /// project are returned as invalid_pixel() so that a single bad
+    /// point does not abort the whole batch.
+    /// - The default implementation loops over point_to_pixel().  Camera
+    ///   models which can hoist per-point setup out of the loop should
+    ///   override it.
+    virtual void points_to_pixels(std::vector<Vector3> const& points,
+                                  std::vector<Vector2>      & pixels) const;
+
+    /// Batch version of pixel_to_vector().  Pixels for which no ray can
+    /// be computed are returned as a zero vector.
+    virtual void pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                   std::vector<Vector3>      & vectors) const;
+
+    /// Batch version of camera_center().  Pixels for which no center can
+    /// be computed are returned as a zero vector.  As that is also a
+    /// legal center, use pixels_to_vectors() to find the failed pixels.
+    virtual void camera_centers(std::vector<Vector2> const& pixels,
+                                std::vector<Vector3>      & centers) const;
+
     // This should be a value which can never occur in normal
     // circumstances, but it most not be made up of NaN values, as those
     // are hard to compare.
@@ -185,6 +211,13 @@ namespace camera {
     virtual Vector3 camera_center  (Vector2 const&) const;
     virtual Quat    camera_pose    (Vector2 const&) const;
 
+    virtual void points_to_pixels (std::vector<Vector3> const& points,
+                                   std::vector<Vector2>      & pixels ) const;
+    virtual void pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                   std::vector<Vector3>      & vectors) const;
+    virtual void camera_centers   (std::vector<Vector2> const& pixels,
+                                   std::vector<Vector3>      & centers) const;
+
     Vector3 adjusted_point(Vector3 const& point) const;
     
     boost::shared_ptr<CameraModel> unadjusted_model(){
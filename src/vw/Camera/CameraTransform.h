@@ -25,11 +25,30 @@
 #define __VW_CAMERA_TRANSFORM_H__
 
 #include <vw/Camera/CameraModel.h>
+#include <vw/Camera/PinholeModel.h>
+#include <vw/Camera/LensDistortion.h>
 #include <vw/Image/Transform.h>
 
 namespace vw {
 namespace camera{
 
+  namespace detail {
+    /// Cameras other than PinholeModel need no preparation.
+    template <class CameraT>
+    inline void add_lens_distortion_table( CameraT& /*camera*/, Vector2i const& /*image_size*/ ) {}
+
+    /// Give a pinhole camera whose lens distortion needs a solver in one
+    /// direction a lookup table over an image of the given size, unless
+    /// it already has one.
+    inline void add_lens_distortion_table( PinholeModel& camera, Vector2i const& image_size ) {
+      LensDistortion const* distortion = camera.lens_distortion();
+      if ( distortion->inverse_table() ||
+           !( distortion->has_fast_distort() || distortion->has_fast_undistort() ) )
+        return;
+      camera.build_lens_distortion_table( image_size );
+    }
+  }
+
   /// This transform functor can be used along with the machinery in
   /// vw/Transform.h to warp an image from one camera's perspective
   /// into anothers.  In particular, this can be used to remove lens
@@ -47,6 +66,19 @@ namespace camera{
       m_src_camera(src_camera), m_dst_camera(dst_camera) {
     }
 
+    /// As above, but pinhole cameras get a lens distortion lookup table
+    /// (see PinholeModel::build_lens_distortion_table()) covering the
+    /// source or destination image, so that the warp does not run the
+    /// distortion solver at every pixel. Only this object's copies of
+    /// the cameras are changed.
+    CameraTransform(SrcCameraT const& src_camera,
+                    DstCameraT const& dst_camera,
+                    Vector2i const& src_size, Vector2i const& dst_size) :
+      m_src_camera(src_camera), m_dst_camera(dst_camera) {
+      detail::add_lens_distortion_table( m_src_camera, src_size );
+      detail::add_lens_distortion_table( m_dst_camera, dst_size );
+    }
+
     /// This defines the transformation from coordinates in our target
     /// image back to coordinates in the original image.
     inline Vector2 reverse(const Vector2 &p) const {
@@ -126,7 +158,8 @@ namespace camera{
   TransformView<InterpolationView<EdgeExtensionView<ImageT, EdgeT>, InterpT>, CameraTransform<SrcCameraT, DstCameraT> >
   inline camera_transform( ImageViewBase<ImageT> const& image, SrcCameraT const& src_camera, DstCameraT const& dst_camera, Vector2i size, EdgeT const& edge_func, InterpT const& interp_func )
   {
-    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera );
+    Vector2i image_size( image.impl().cols(), image.impl().rows() );
+    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera, image_size, size );
     return transform( image, ctx, size[0], size[1], edge_func, interp_func );
   }
 
@@ -136,7 +169,8 @@ namespace camera{
   TransformView<InterpolationView<EdgeExtensionView<ImageT, EdgeT>, InterpT>, CameraTransform<SrcCameraT, DstCameraT> >
   inline camera_transform( ImageViewBase<ImageT> const& image, SrcCameraT const& src_camera, DstCameraT const& dst_camera, EdgeT const& edge_func, InterpT const& interp_func )
   {
-    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera );
+    Vector2i image_size( image.impl().cols(), image.impl().rows() );
+    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera, image_size, image_size );
     return transform( image, ctx, edge_func, interp_func );
   }
 
@@ -146,7 +180,8 @@ namespace camera{
   TransformView<InterpolationView<EdgeExtensionView<ImageT, EdgeT>, BilinearInterpolation>, CameraTransform<SrcCameraT, DstCameraT> >
   inline camera_transform( ImageViewBase<ImageT> const& image, SrcCameraT const& src_camera, DstCameraT const& dst_camera, EdgeT const& edge_func )
   {
-    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera );
+    Vector2i image_size( image.impl().cols(), image.impl().rows() );
+    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera, image_size, image_size );
     return transform( image, ctx, edge_func, BilinearInterpolation() );
   }
 
@@ -156,7 +191,8 @@ namespace camera{
   TransformView<InterpolationView<EdgeExtensionView<ImageT, ZeroEdgeExtension>, BilinearInterpolation>, CameraTransform<SrcCameraT, DstCameraT> >
   inline camera_transform( ImageViewBase<ImageT> const& image, SrcCameraT const& src_camera, DstCameraT const& dst_camera )
   {
-    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera );
+    Vector2i image_size( image.impl().cols(), image.impl().rows() );
+    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera, image_size, image_size );
     return transform( image, ctx, ZeroEdgeExtension(), BilinearInterpolation() );
   }
 
@@ -167,7 +203,8 @@ namespace camera{
   inline camera_transform( ImageViewBase<ImageT> const& image, SrcCameraT const& src_camera, DstCameraT const& dst_camera,
                            Vector2i size)
   {
-    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera );
+    Vector2i image_size( image.impl().cols(), image.impl().rows() );
+    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera, image_size, size );
     return transform( image, ctx, size[0], size[1], ZeroEdgeExtension(), BilinearInterpolation() );
   }
 
@@ -178,7 +215,9 @@ namespace camera{
   inline camera_transform( ImageViewBase<ImageT> const& image, SrcCameraT const& src_camera, DstCameraT const& dst_camera,
                            BBox2 const &bbox)
   {
-    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera );
+    Vector2i image_size( image.impl().cols(), image.impl().rows() );
+    Vector2i dst_size( int32(ceil(bbox.max().x())), int32(ceil(bbox.max().y())) );
+    CameraTransform<SrcCameraT, DstCameraT> ctx( src_camera, dst_camera, image_size, dst_size );
     return transform( image, ctx, bbox, ZeroEdgeExtension(), BilinearInterpolation() );
   }
 
@@ -192,7 +231,9 @@ namespace camera{
     typename SrcCameraT::linearized_type dst_camera =
       linearize_camera( src_camera, Vector2i(image.impl().cols(), image.impl().rows()),
                         Vector2i(image.impl().cols(), image.impl().rows()) );
-    CameraTransform<SrcCameraT, typename SrcCameraT::linearized_type> ctx( src_camera, dst_camera );
+    CameraTransform<SrcCameraT, typename SrcCameraT::linearized_type>
+      ctx( src_camera, dst_camera, Vector2i(image.impl().cols(), image.impl().rows()),
+           Vector2i(image.impl().cols(), image.impl().rows()) );
     return transform( image, ctx, edge_func, interp_func );
   }
 
@@ -206,7 +247,9 @@ namespace camera{
     typename SrcCameraT::linearized_type dst_camera =
       linearize_camera( src_camera, Vector2i(image.impl().cols(), image.impl().rows()),
                         Vector2i(image.impl().cols(), image.impl().rows()) );
-    CameraTransform<SrcCameraT, typename SrcCameraT::linearized_type> ctx( src_camera, dst_camera );
+    CameraTransform<SrcCameraT, typename SrcCameraT::linearized_type>
+      ctx( src_camera, dst_camera, Vector2i(image.impl().cols(), image.impl().rows()),
+           Vector2i(image.impl().cols(), image.impl().rows()) );
     return transform( image, ctx, edge_func, BilinearInterpolation() );
   }
 
@@ -220,7 +263,9 @@ namespace camera{
     typename SrcCameraT::linearized_type dst_camera =
       linearize_camera( src_camera, Vector2i(image.impl().cols(), image.impl().rows()),
                         Vector2i(image.impl().cols(), image.impl().rows()) );
-    CameraTransform<SrcCameraT, typename SrcCameraT::linearized_type> ctx( src_camera, dst_camera );
+    CameraTransform<SrcCameraT, typename SrcCameraT::linearized_type>
+      ctx( src_camera, dst_camera, Vector2i(image.impl().cols(), image.impl().rows()),
+           Vector2i(image.impl().cols(), image.impl().rows()) );
     return transform( image, ctx, ZeroEdgeExtension(), BilinearInterpolation() );
   }
 
@@ -16,8 +16,10 @@
 // __END_LICENSE__
 
 
+#include <vw/Core/Log.h>
 #include <vw/Camera/LensDistortion.h>
 #include <vw/Camera/PinholeModel.h>
+#include <vw/Math/Functions.h>
 #include <vw/Math/LevenbergMarquardt.h>
 
 using namespace vw;
@@ -57,7 +59,128 @@ struct DistortOptimizeFunctor :  public math::LeastSquaresModelBaseFixed<Distort
 
 // Isolate these local utilities to this file.
 namespace {
-  
+
+// Evaluate whichever direction of the distortion model is fast.
+struct FastDistortionFunc {
+  const camera::PinholeModel   &m_cam;
+  const camera::LensDistortion &m_distort;
+  bool m_distort_is_fast;
+  FastDistortionFunc(const camera::PinholeModel& cam, const camera::LensDistortion& d,
+                     bool distort_is_fast):
+    m_cam(cam), m_distort(d), m_distort_is_fast(distort_is_fast) {}
+
+  inline Vector2 operator()(Vector2 const& x) const {
+    if (m_distort_is_fast)
+      return m_distort.distorted_coordinates(m_cam, x);
+    return m_distort.undistorted_coordinates(m_cam, x);
+  }
+
+  /// The slow direction, which may use a solver and throw.
+  inline Vector2 inverse(Vector2 const& x) const {
+    if (m_distort_is_fast)
+      return m_distort.undistorted_coordinates(m_cam, x);
+    return m_distort.distorted_coordinates(m_cam, x);
+  }
+};
+
+// Solve func(x) = target with Newton's method starting from the value in x,
+// using a forward difference Jacobian. Returns true if the result meets the
+// same tolerance as the solver based implementations below.
+template <class FuncT>
+bool newton_invert(FuncT const& func, Vector2 const& target, Vector2 & x, int max_iterations = 20) {
+
+  const double tol = 1e-10*std::max(norm_2(target), 0.1);
+  Vector2 fx = func(x);
+  for (int i = 0; i < max_iterations; i++) {
+    Vector2 residual = fx - target;
+    if (norm_2(residual) <= tol)
+      return true;
+
+    double h = 1e-7*std::max(norm_inf(x), 1e-3);
+    Vector2 dx = (func(x + Vector2(h, 0)) - fx)/h;
+    Vector2 dy = (func(x + Vector2(0, h)) - fx)/h;
+    double det = dx[0]*dy[1] - dy[0]*dx[1];
+    if (det == 0 || !std::isfinite(det))
+      return false;
+
+    // Solve the 2x2 system J*step = residual by Cramer's rule
+    x[0] -= ( dy[1]*residual[0] - dy[0]*residual[1])/det;
+    x[1] -= (-dx[1]*residual[0] + dx[0]*residual[1])/det;
+    if (!std::isfinite(x[0]) || !std::isfinite(x[1]))
+      return false;
+    fx = func(x);
+  }
+  return norm_2(fx - target) <= tol;
+}
+
+// Compute the exact inverse at a lookup table node, starting from the
+// given guess. Returns false if the solver did not converge.
+bool solve_table_node(FastDistortionFunc const& func, Vector2 const& target,
+                      Vector2 const& guess, Vector2 & result) {
+  result = guess;
+  if (newton_invert(func, target, result, 50))
+    return true;
+  result = target; // Try again from the identity
+  if (newton_invert(func, target, result, 50))
+    return true;
+
+  // Some models are not smooth everywhere (TSAI along the principal point
+  // lines), so as a last resort use the model's own solver.
+  try {
+    result = func.inverse(target);
+  } catch (const Exception&) {
+    return false;
+  }
+  return true;
+}
+
+// Bilinearly interpolate an n by n table at grid coordinates (px, py),
+// clamping to the border cells. Same as ApproximateTransform.
+Vector2 interpolate_table(std::vector<Vector2> const& table, int n, double px, double py) {
+  int32 ix = math::impl::_floor(px);
+  if (ix < 0  ) ix = 0;
+  if (ix > n-2) ix = n-2;
+  int32 iy = math::impl::_floor(py);
+  if (iy < 0  ) iy = 0;
+  if (iy > n-2) iy = n-2;
+  double normx = px-ix, normy = py-iy;
+
+  Vector2 const& m00 = table[ iy   *n + ix  ];
+  Vector2 const& m10 = table[ iy   *n + ix+1];
+  Vector2 const& m01 = table[(iy+1)*n + ix  ];
+  Vector2 const& m11 = table[(iy+1)*n + ix+1];
+
+  return Vector2( (m00.x()*(1-normy)+m01.x()*normy)*(1-normx) +
+                  (m10.x()*(1-normy)+m11.x()*normy)*normx,
+                  (m00.y()*(1-normy)+m01.y()*normy)*(1-normx) +
+                  (m10.y()*(1-normy)+m11.y()*normy)*normx );
+}
+
+// Measure the interpolation error of an n by n table at a 3x3 set of
+// points inside each cell, where it is largest. Returns false if the
+// exact value could not be found at one of them.
+bool max_cell_error(FastDistortionFunc const& func, std::vector<Vector2> const& table, int n,
+                    Vector2 const& origin, Vector2 const& diag, double & max_err) {
+  max_err = 0;
+  for (int cy = 0; cy < n-1; ++cy) {
+    for (int cx = 0; cx < n-1; ++cx) {
+      for (int j = 1; j < 4; ++j) {
+        for (int i = 1; i < 4; ++i) {
+          double  px = cx + i/4.0, py = cy + j/4.0;
+          Vector2 interp = interpolate_table(table, n, px, py);
+          Vector2 target = origin + elem_prod(Vector2(px, py)/(n-1), diag);
+          Vector2 exact;
+          if (!solve_table_node(func, target, interp, exact))
+            return false;
+          max_err = std::max(max_err, norm_2(exact - interp));
+        }
+      }
+    }
+  }
+  return true;
+}
+
+
 // Pull all lines from the stream. Search for "name = val". Store the
 // values in the order given in "names". Complain if some fields were
 // not populated. This has the advantage that the order of lines in
@@ -173,6 +296,16 @@ void LensDistortion::set_distortion_parameters(Vector<double> const& params) {}
 
 Vector2
 LensDistortion::undistorted_coordinates(const camera::PinholeModel& cam, Vector2 const& v) const {
+
+  // Start from the lookup table if there is one covering this point
+  if (m_inverse_table && m_inverse_table->undistort() && m_inverse_table->applies(cam, v)) {
+    Vector2 guess = m_inverse_table->lookup(v);
+    if (!m_inverse_table->polish())
+      return guess;
+    if (newton_invert(FastDistortionFunc(cam, *this, true), v, guess))
+      return guess;
+  }
+
   UndistortOptimizeFunctor model(cam, *this);
   int status;
 
@@ -196,6 +329,16 @@ LensDistortion::undistorted_coordinates(const camera::PinholeModel& cam, Vector2
 
 vw::Vector2
 LensDistortion::distorted_coordinates(const camera::PinholeModel& cam, Vector2 const& v) const {
+
+  // Start from the lookup table if there is one covering this point
+  if (m_inverse_table && !m_inverse_table->undistort() && m_inverse_table->applies(cam, v)) {
+    Vector2 guess = m_inverse_table->lookup(v);
+    if (!m_inverse_table->polish())
+      return guess;
+    if (newton_invert(FastDistortionFunc(cam, *this, false), v, guess))
+      return guess;
+  }
+
   DistortOptimizeFunctor model(cam, *this);
   int status;
   // Must push the solver really hard, to make sure bundle adjust gets accurate values
@@ -216,6 +359,113 @@ LensDistortion::distorted_coordinates(const camera::PinholeModel& cam, Vector2 c
 }
 
 
+void LensDistortion::build_inverse_table(PinholeModel const& cam, BBox2 const& region,
+                                         double tolerance, bool polish) {
+  // Drop any old table first so it is not used while building the new one.
+  m_inverse_table.reset();
+
+  bool fast_distort = this->has_fast_distort(), fast_undistort = this->has_fast_undistort();
+  if (fast_distort && fast_undistort)
+    return;
+  if (!fast_distort && !fast_undistort)
+    vw_throw( ArgumentErr() << "LensDistortion: Cannot build an inverse table for "
+                            << name() << ", it has no fast direction.\n" );
+
+  boost::shared_ptr<LensDistortionInverseTable>
+    table(new LensDistortionInverseTable(cam, *this, fast_distort, region, tolerance, polish));
+  if (table->is_valid())
+    m_inverse_table = table;
+  else
+    VW_OUT(DebugMessage, "camera") << "LensDistortion: Could not approximate the inverse of "
+                                   << name() << " within tolerance " << tolerance << ".\n";
+}
+
+// ======== LensDistortionInverseTable ========
+
+LensDistortionInverseTable::LensDistortionInverseTable(PinholeModel const& cam,
+                                                       LensDistortion const& distortion,
+                                                       bool undistort, BBox2 const& region,
+                                                       double tolerance, bool polish,
+                                                       int max_grid_size):
+  m_undistort(undistort), m_polish(polish), m_region(region),
+  m_focal(cam.focal_length()), m_offset(cam.point_offset()), m_size(0), m_max_error(0) {
+
+  if (region.empty() || region.width() <= 0 || region.height() <= 0)
+    vw_throw( ArgumentErr() << "LensDistortionInverseTable: Empty region.\n" );
+
+  // The table inverts the fast direction of the model.
+  FastDistortionFunc func(cam, distortion, undistort);
+  Vector2 origin = region.min(), diag = region.size();
+
+  // Initialize with a simple 2x2 lookup table
+  int n = 2;
+  std::vector<Vector2> table(4);
+  for (int y = 0; y < 2; y++) {
+    for (int x = 0; x < 2; x++) {
+      Vector2 target = origin + elem_prod(Vector2(x, y), diag);
+      if (!solve_table_node(func, target, target, table[y*2 + x]))
+        return;
+    }
+  }
+
+  // Double the grid density until the worst approximation error at the
+  // new nodes is less than the allowed tolerance.
+  double max_err = 0;
+  do {
+    int prev_n = n;
+    n = 2*n-1;
+    if (n > max_grid_size)
+      return; // Leave the table invalid
+
+    std::vector<Vector2> prev;
+    prev.swap(table);
+    table.resize(n*n);
+    max_err = 0;
+    for (int y = 0; y < n; ++y) {
+      for (int x = 0; x < n; ++x) {
+        Vector2 const& p00 = prev[(y/2)*prev_n + x/2];
+        if ((y%2) == 0 && (x%2) == 0) {
+          table[y*n + x] = p00;
+          continue;
+        }
+        Vector2 interp;
+        if ((y%2) == 0)
+          interp = (p00 + prev[(y/2)*prev_n + x/2+1]) / 2.0;
+        else if ((x%2) == 0)
+          interp = (p00 + prev[(y/2+1)*prev_n + x/2]) / 2.0;
+        else
+          interp = (p00 + prev[(y/2)*prev_n + x/2+1] + prev[(y/2+1)*prev_n + x/2] +
+                    prev[(y/2+1)*prev_n + x/2+1]) / 4.0;
+
+        Vector2 target = origin + elem_prod(Vector2(x, y)/(n-1), diag);
+        if (!solve_table_node(func, target, interp, table[y*n + x]))
+          return;
+        max_err = std::max(max_err, norm_2(table[y*n + x] - interp));
+      }
+    }
+
+    // The new nodes are exact, so before accepting the finer grid check
+    // its own error between the nodes.
+    if (max_err <= tolerance && !max_cell_error(func, table, n, origin, diag, max_err))
+      return;
+  } while (max_err > tolerance);
+
+  m_size      = n;
+  m_max_error = max_err;
+  m_table.swap(table);
+}
+
+bool LensDistortionInverseTable::applies(PinholeModel const& cam, Vector2 const& p) const {
+  return m_region.contains(p) && cam.focal_length() == m_focal && cam.point_offset() == m_offset;
+}
+
+Vector2 LensDistortionInverseTable::lookup(Vector2 const& p) const {
+  int    n  = m_size - 1;
+  double px = n * (p.x() - m_region.min().x()) / m_region.width ();
+  double py = n * (p.y() - m_region.min().y()) / m_region.height();
+  return interpolate_table(m_table, m_size, px, py);
+}
+
 std::ostream& camera::operator<<(std::ostream & os,
                                  const camera::LensDistortion& ld) {
   ld.write(os);
@@ -267,6 +517,7 @@ void TsaiLensDistortion::init_distortion_param_names(){
 }
 
 void TsaiLensDistortion::set_distortion_parameters(Vector<double> const& params) {
+  clear_inverse_table();
   TsaiLensDistortion::init_distortion_param_names();
   m_distortion = params;
   if (m_distortion.size() != m_distortion_param_names.size())
@@ -322,11 +573,13 @@ void TsaiLensDistortion::write(std::ostream & os) const {
 }
 
 void TsaiLensDistortion::read(std::istream & is) {
+  clear_inverse_table();
   m_distortion.set_size(m_distortion_param_names.size());
   read_fields_in_vec(m_distortion_param_names, m_distortion, is);
 }
 
 void TsaiLensDistortion::scale( double scale ) {
+  clear_inverse_table();
   m_distortion *= scale;
 }
 
@@ -378,6 +631,7 @@ Vector<double> BrownConradyDistortion::distortion_parameters() const {
 }
 
 void BrownConradyDistortion::set_distortion_parameters(Vector<double> const& params) {
+  clear_inverse_table();
   m_principal_point      = subvector(params,0,2);
   m_radial_distortion    = subvector(params,2,3);
   m_centering_distortion = subvector(params,5,2);
@@ -411,6 +665,7 @@ void BrownConradyDistortion::write(std::ostream& os) const {
 }
 
 void BrownConradyDistortion::read(std::istream & is) {
+  clear_inverse_table();
   Vector<double, num_distortion_params> distortion;
   read_fields_in_vec(m_distortion_param_names, distortion, is);
   int p = 0;
@@ -441,6 +696,7 @@ AdjustableTsaiLensDistortion::distortion_parameters() const {
 }
 
 void AdjustableTsaiLensDistortion::set_distortion_parameters(Vector<double> const& params) {
+  clear_inverse_table();
   m_distortion = params;
 }
 
@@ -491,6 +747,7 @@ void AdjustableTsaiLensDistortion::write(std::ostream & os) const {
 }
 
 void AdjustableTsaiLensDistortion::read(std::istream & is) {
+  clear_inverse_table();
   Vector<double,0> radial_vec, tangential_vec;
   double alpha;
   
@@ -552,6 +809,7 @@ PhotometrixLensDistortion::distortion_parameters() const {
 }
 
 void PhotometrixLensDistortion::set_distortion_parameters(Vector<double> const& params) {
+  clear_inverse_table();
   m_distortion = params;
   if (m_distortion.size() != m_distortion_param_names.size())
     vw_throw( IOErr() << "PhotometrixLensDistortion: Incorrect number of parameters was passed in.");
@@ -607,11 +865,13 @@ void PhotometrixLensDistortion::write(std::ostream & os) const {
 }
 
 void PhotometrixLensDistortion::read(std::istream & is) {
+  clear_inverse_table();
   m_distortion.set_size(m_distortion_param_names.size());
   read_fields_in_vec(m_distortion_param_names, m_distortion, is);
 }
 
 void PhotometrixLensDistortion::scale( double scale ) {
+  clear_inverse_table();
   m_distortion *= scale;
 }
 
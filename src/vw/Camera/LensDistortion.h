@@ -24,9 +24,11 @@
 #define __VW_CAMERA_LENSDISTORTION_H__
 
 #include <vw/Math/Vector.h>
+#include <vw/Math/BBox.h>
 
 #include <iosfwd>
 #include <string>
+#include <vector>
 #include <boost/smart_ptr/shared_ptr.hpp>
 
 namespace vw {
@@ -34,6 +36,55 @@ namespace camera {
 
   // Forward declaration
   class PinholeModel;
+  class LensDistortion;
+
+  /// A lookup table approximating whichever of distorted_coordinates()
+  /// and undistorted_coordinates() does not have a fast implementation,
+  /// over a rectangular region of its input (in the same units as the
+  /// focal length). The nodes are computed from the fast direction with
+  /// Newton's method and the grid density is doubled, as in
+  /// ApproximateTransform, until the bilinear interpolation error is below
+  /// the requested tolerance, both at the newly added nodes and at a 3x3
+  /// set of points inside each cell of the final grid.
+  ///
+  /// The table is tied to the focal length and point offset of the
+  /// camera it was built for and is ignored for any other camera.
+  class LensDistortionInverseTable {
+  public:
+    /// Build the table. If undistort is true the table approximates
+    /// undistorted_coordinates(), otherwise distorted_coordinates().
+    /// If polish is true, lookups are refined to full precision with
+    /// a few Newton iterations started from the interpolated value.
+    /// If the tolerance cannot be met with a grid of max_grid_size
+    /// nodes per side, the table is left invalid.
+    LensDistortionInverseTable(PinholeModel const& cam, LensDistortion const& distortion,
+                               bool undistort, BBox2 const& region, double tolerance,
+                               bool polish = true, int max_grid_size = 1025);
+
+    bool   is_valid  () const { return !m_table.empty(); }
+    bool   undistort () const { return m_undistort;      }
+    bool   polish    () const { return m_polish;         }
+    BBox2  region    () const { return m_region;         }
+    int    grid_size () const { return m_size;           }
+
+    /// The largest interpolation error measured inside the cells of the table.
+    double max_error () const { return m_max_error;      }
+
+    /// Return true if the table was built for a camera with the same
+    /// intrinsics as cam and p is inside the table region.
+    bool applies(PinholeModel const& cam, Vector2 const& p) const;
+
+    /// Bilinearly interpolate the table at p, which must be inside the region.
+    Vector2 lookup(Vector2 const& p) const;
+
+  private:
+    bool    m_undistort, m_polish;
+    BBox2   m_region;
+    Vector2 m_focal, m_offset;
+    int     m_size;
+    double  m_max_error;
+    std::vector<Vector2> m_table;
+  };
 
   /// Base class which all distortion models inherit from.
   /// Trivia: Back in 2009 this was implemented using CRTP. See commit
@@ -41,6 +92,9 @@ namespace camera {
   class LensDistortion {
   protected:
     std::vector<std::string> m_distortion_param_names;
+
+    /// Optional lookup table used by the solver based default implementations.
+    boost::shared_ptr<const LensDistortionInverseTable> m_inverse_table;
   public:
     LensDistortion() {}
 
@@ -91,6 +145,23 @@ namespace camera {
     
     /// Used to scale distortion with image size
     std::vector<std::string> distortion_param_names() const { return m_distortion_param_names; }
+
+    /// Precompute a lookup table for the direction which does not have a fast
+    /// implementation, so the default solver implementation above becomes a
+    /// bilinear lookup (optionally followed by Newton polishing) for inputs
+    /// inside the given region. Does nothing if both directions are fast.
+    /// - The region and tolerance are in the same units as the focal length.
+    /// - The table must be rebuilt if the distortion parameters change; it is
+    ///   discarded by set_distortion_parameters(), read() and scale().
+    /// - Not thread safe with concurrent calls on this object.
+    void build_inverse_table(PinholeModel const& cam, BBox2 const& region,
+                             double tolerance, bool polish = true);
+
+    /// Discard any table created by build_inverse_table().
+    void clear_inverse_table() { m_inverse_table.reset(); }
+
+    /// Return the table created by build_inverse_table(), if any.
+    boost::shared_ptr<const LensDistortionInverseTable> inverse_table() const { return m_inverse_table; }
   }; // End class LensDistortion
 
   /// Write any derived lens distortion class to the stream.
@@ -21,6 +21,98 @@
 namespace vw {
 namespace camera {
 
+namespace {
+
+  // Sine of the along-track angle between a point and the line of sight of
+  // a pixel, in the local camera frame at the time of the pixel's line. As
+  // a function of the line this is zero where the point is in the scan plane.
+  struct AlongTrackError {
+    LinescanModel const& m_cam;
+    Vector3 m_point;
+    double  m_col;
+    AlongTrackError(LinescanModel const& cam, Vector3 const& point, double col):
+      m_cam(cam), m_point(point), m_col(col) {}
+
+    double operator()(double line) const {
+      double  time = m_cam.get_time_at_line(line);
+      Vector3 dir  = inverse(m_cam.get_camera_pose_at_time(time))
+                       .rotate(m_point - m_cam.get_camera_center_at_time(time));
+      Vector3 pix_dir = m_cam.get_local_pixel_vector(Vector2(m_col, line));
+      return dir.y()/norm_2(dir) - pix_dir.y()/norm_2(pix_dir);
+    }
+  };
+
+  // Secant search for a root of func starting from x. Returns false if it
+  // did not converge.
+  template <class FuncT>
+  bool secant_root(FuncT const& func, double & x, double tol, int max_iterations) {
+    double x0 = x, x1 = x + 1.0;
+    double f0 = func(x0), f1 = func(x1);
+    for (int i = 0; i < max_iterations; i++) {
+      if (f1 == f0)
+        return false;
+      double x2 = x1 - f1*(x1 - x0)/(f1 - f0);
+      if (!std::isfinite(x2))
+        return false;
+      if (std::abs(x2 - x1) < tol) {
+        x = x2;
+        return true;
+      }
+      x0 = x1; f0 = f1;
+      x1 = x2; f1 = func(x1);
+    }
+    return false;
+  }
+
+  // Sample func over [lo, hi] and refine the first sign change with the
+  // Illinois variant of false position. Returns false if there is none.
+  template <class FuncT>
+  bool bracket_root(FuncT const& func, double lo, double hi, int num_samples,
+                    double & x, double tol, int max_iterations) {
+    double step = (hi - lo)/num_samples;
+    double a = lo, fa = func(a);
+    double b = a,  fb = fa;
+    bool found = false;
+    for (int i = 1; i <= num_samples; i++) {
+      b  = lo + i*step;
+      fb = func(b);
+      if (fa*fb <= 0) {
+        found = true;
+        break;
+      }
+      a = b; fa = fb;
+    }
+    if (!found)
+      return false;
+
+    int side = 0;
+    for (int i = 0; i < max_iterations; i++) {
+      if (fa == fb) {
+        x = (a + b)/2;
+        return true;
+      }
+      double c  = (a*fb - b*fa)/(fb - fa);
+      double fc = func(c);
+      if (std::abs(b - a) < tol || fc == 0) {
+        x = c;
+        return true;
+      }
+      if (fc*fb > 0) {
+        b = c; fb = fc;
+        if (side == -1) fa /= 2;
+        side = -1;
+      } else {
+        a = c; fa = fc;
+        if (side == 1) fb /= 2;
+        side = 1;
+      }
+    }
+    x = (a + b)/2;
+    return true;
+  }
+
+} // end anonymous namespace
+
 Vector2 LinescanModel::point_to_pixel(Vector3 const& point) const {
   return point_to_pixel(point, -1); // Redirect to the function with no guess
 }
@@ -28,14 +120,26 @@ Vector2 LinescanModel::point_to_pixel(Vector3 const& point) const {
 
 Vector2 LinescanModel::point_to_pixel(Vector3 const& point, double starty) const {
 
-  // Use the generic solver to find the pixel 
-  // - This method will be slower but works for more complicated geometries
-  CameraGenericLMA model( this, point );
-  int status;
   Vector2 start = m_image_size / 2.0; // Use the center as the initial guess
   if (starty >= 0) // If the user provided a line number guess..
     start[1] = starty;
 
+  // Find the line with a one-dimensional search first. This is exact unless
+  // velocity aberration or atmospheric refraction are applied, so only fall
+  // through to the generic solver if the result does not check out.
+  CameraGenericLMA model( this, point );
+  Vector2 guess = start;
+  if (line_search_point_to_pixel(point, guess)) {
+    const double RESIDUAL_TOL = 1e-12; // Difference of unit vectors
+    if (norm_2(model(guess)) < RESIDUAL_TOL)
+      return guess;
+    start = guess;
+  }
+
+  // Use the generic solver to find the pixel 
+  // - This method will be slower but works for more complicated geometries
+  int status;
+
   // Solver constants
   const double ABS_TOL = 1e-16;
   const double REL_TOL = 1e-16;
@@ -50,6 +154,82 @@ Vector2 LinescanModel::point_to_pixel(Vector3 const& point, double starty) const
   return solution;
 }
 
+void LinescanModel::point_to_pixel(std::vector<Vector3> const& points,
+                                   std::vector<Vector2>      & pixels,
+                                   std::vector<bool>         & valid) const {
+  pixels.resize(points.size());
+  valid.resize(points.size());
+
+  double starty = -1; // No guess for the first point
+  for (size_t i = 0; i < points.size(); i++) {
+    try {
+      pixels[i] = point_to_pixel(points[i], starty);
+      valid [i] = true;
+      starty    = pixels[i].y();
+    } catch (const vw::camera::PointToPixelErr&) {
+      pixels[i] = Vector2(-1, -1);
+      valid [i] = false;
+    }
+  }
+}
+
+void LinescanModel::points_to_pixels(std::vector<Vector3> const& points,
+                                     std::vector<Vector2>      & pixels) const {
+  std::vector<bool> valid;
+  point_to_pixel(points, pixels, valid);
+  for (size_t i = 0; i < pixels.size(); i++) {
+    if (!valid[i])
+      pixels[i] = invalid_pixel();
+  }
+}
+
+bool LinescanModel::line_search_point_to_pixel(Vector3 const& point, Vector2 & pixel) const {
+
+  const double LINE_TOL       = 1e-8; // In pixels
+  const int    MAX_PASSES     = 10;
+  const int    MAX_ITERATIONS = 50;
+  const int    NUM_SAMPLES    = 64;
+  const double num_lines      = m_image_size[1];
+
+  try {
+    double x = pixel.x(), y = pixel.y();
+    for (int pass = 0; pass < MAX_PASSES; pass++) {
+
+      // Find the line for the current column
+      double prev_y = y;
+      AlongTrackError func(*this, point, x);
+      if (!secant_root(func, y, LINE_TOL, MAX_ITERATIONS) || std::abs(y - prev_y) > 2*num_lines) {
+        // Search the image and a margin around it
+        y = prev_y;
+        if (!bracket_root(func, -0.5*num_lines, 1.5*num_lines, NUM_SAMPLES,
+                          y, LINE_TOL, MAX_ITERATIONS))
+          return false;
+      }
+
+      // Find the column on that line. Within the scan plane the pixel vector
+      // is a + s*b, which is parallel to the point direction d when
+      // (a + s*b) x d has no along-track component.
+      double  time = get_time_at_line(y);
+      Vector3 dir  = inverse(get_camera_pose_at_time(time)).rotate(point - get_camera_center_at_time(time));
+      Vector3 a = get_local_pixel_vector(Vector2(x, y));
+      Vector3 b = get_local_pixel_vector(Vector2(x + 1.0, y)) - a;
+      double denom = cross_prod(b, dir).y();
+      if (denom == 0)
+        return false;
+      double dx = -cross_prod(a, dir).y()/denom;
+      if (!std::isfinite(dx))
+        return false;
+      x += dx;
+
+      if (std::abs(dx) < LINE_TOL && std::abs(y - prev_y) < LINE_TOL)
+        break;
+    }
+    pixel = Vector2(x, y);
+  } catch (const vw::Exception&) {
+    return false;
+  }
+  return true;
+}
 
 Vector3 LinescanModel::pixel_to_vector(Vector2 const& pixel) const {
   try {
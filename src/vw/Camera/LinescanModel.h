@@ -28,6 +28,8 @@
 #include <vw/Math/LevenbergMarquardt.h>
 #include <vw/Camera/CameraModel.h>
 
+#include <vector>
+
 namespace vw {
 namespace camera {
 
@@ -127,6 +129,19 @@ namespace camera {
     //   linescan cameras may be able to use more specific implementation.
     virtual Vector2 point_to_pixel(vw::Vector3 const& point, double starty) const;
 
+    /// Project many points at once. The line found for each point is used
+    /// as the starting guess for the next one, so passing points in spatial
+    /// order (for example the rows of a DEM tile) makes most solves take
+    /// only a couple of iterations. Points which fail to project are
+    /// flagged in the output mask and their pixel is left at (-1, -1).
+    void point_to_pixel(std::vector<Vector3> const& points,
+                        std::vector<Vector2>      & pixels,
+                        std::vector<bool>         & valid) const;
+
+    /// The CameraModel batch interface, implemented with the overload above.
+    virtual void points_to_pixels(std::vector<Vector3> const& points,
+                                  std::vector<Vector2>      & pixels) const;
+
   protected:
 
     /// Image size in pixels: [num lines, num samples]
@@ -147,6 +162,17 @@ namespace camera {
     /// Returns the radius of the Earth under the current camera position.
     double get_earth_radius() const;
 
+    /// Find the pixel observing a point without the generic solver. The line
+    /// is found with a secant search on the along-track angle between the
+    /// point and the scan plane, falling back to bracketing over the image
+    /// if that does not converge. Given the line, the column is solved in
+    /// closed form assuming the local pixel vector is linear along the
+    /// line, with a few passes for detectors where it is not.
+    /// - The result ignores velocity aberration and atmospheric refraction,
+    ///   so it may need refining by the generic solver.
+    /// - The input pixel is the initial guess. Returns false on failure.
+    bool line_search_point_to_pixel(Vector3 const& point, Vector2 & pixel) const;
+
   }; // End class LinescanModel
   
 /*
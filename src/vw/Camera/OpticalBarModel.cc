@@ -95,10 +95,14 @@ Quat OpticalBarModel::camera_pose(Vector2 const& pix) const {
 }
 
 Vector3 OpticalBarModel::pixel_to_vector_uncorrected(Vector2 const& pixel) const {
+  return pixel_to_vector_uncorrected(pixel, camera_pose(pixel), camera_center(pixel));
+}
+
+Vector3 OpticalBarModel::pixel_to_vector_uncorrected(Vector2 const& pixel,
+                                                     Quat    const& cam_pose,
+                                                     Vector3 const& cam_center) const {
  
   Vector2 sensor_plane_pos = pixel_to_sensor_plane(pixel);
-  Vector3 cam_center       = camera_center(pixel);
-  Quat    cam_pose         = camera_pose  (pixel);
 
   // This is the horizontal angle away from the center point (from straight out of the camera)
   double alpha = sensor_to_alpha(sensor_plane_pos);
@@ -128,20 +132,26 @@ Vector3 OpticalBarModel::pixel_to_vector_uncorrected(Vector2 const& pixel) const
   return result;
 }
 
+Vector3 OpticalBarModel::apply_corrections(Vector3 const& cam_ctr,
+                                           Vector3 const& velocity,
+                                           Vector3 const& uncorrected_vector) const {
+  Vector3 output_vector = uncorrected_vector;
+  if (!m_correct_atmospheric_refraction) 
+    output_vector = apply_atmospheric_refraction_correction(cam_ctr, m_mean_earth_radius,
+                                                            m_mean_surface_elevation, output_vector);
+
+  if (!m_correct_velocity_aberration) 
+    return output_vector;
+  else
+    return apply_velocity_aberration_correction(cam_ctr, velocity,
+                                                m_mean_earth_radius, output_vector);
+}
+
 Vector3 OpticalBarModel::pixel_to_vector(Vector2 const& pixel) const {
   try {
     Vector3 output_vector = pixel_to_vector_uncorrected(pixel);
-
-    Vector3 cam_ctr = camera_center(pixel);
-    if (!m_correct_atmospheric_refraction) 
-      output_vector = apply_atmospheric_refraction_correction(cam_ctr, m_mean_earth_radius,
-                                                              m_mean_surface_elevation, output_vector);
-
-    if (!m_correct_velocity_aberration) 
-      return output_vector;
-    else
-      return apply_velocity_aberration_correction(cam_ctr, get_velocity(pixel),
-                                                  m_mean_earth_radius, output_vector);
+    Vector3 cam_ctr       = camera_center(pixel);
+    return apply_corrections(cam_ctr, get_velocity(pixel), output_vector);
 
   } catch(const vw::Exception &e) {
     // Repackage any of our exceptions thrown below this point as a 
@@ -150,13 +160,13 @@ Vector3 OpticalBarModel::pixel_to_vector(Vector2 const& pixel) const {
   }
 }
 
-Vector2 OpticalBarModel::point_to_pixel(Vector3 const& point) const {
+bool OpticalBarModel::solve_point_to_pixel(Vector3 const& point, Vector2 const& start,
+                                           Vector2 & pixel) const {
 
   // Use the generic solver to find the pixel 
   // - This method will be slower but works for more complicated geometries
   CameraGenericLMA model( this, point );
   int status;
-  Vector2 start = m_image_size / 2.0; // Use the center as the initial guess
 
   // Solver constants
   const double ABS_TOL = 1e-16;
@@ -164,14 +174,75 @@ Vector2 OpticalBarModel::point_to_pixel(Vector3 const& point) const {
   const int    MAX_ITERATIONS = 1e+5;
 
   Vector3 objective(0, 0, 0);
-  Vector2 solution = math::levenberg_marquardtFixed<CameraGenericLMA, 2,3>(model, start, objective, status,
-                                               ABS_TOL, REL_TOL, MAX_ITERATIONS);
-  VW_ASSERT( status > 0,
+  pixel = math::levenberg_marquardtFixed<CameraGenericLMA, 2,3>(model, start, objective, status,
+                                                                ABS_TOL, REL_TOL, MAX_ITERATIONS);
+  return status > 0;
+}
+
+Vector2 OpticalBarModel::point_to_pixel(Vector3 const& point) const {
+
+  Vector2 solution;
+  Vector2 start = m_image_size / 2.0; // Use the center as the initial guess
+  bool success = solve_point_to_pixel(point, start, solution);
+  VW_ASSERT( success,
              camera::PointToPixelErr() << "Unable to project point into Linescan model" );
 
   return solution;
 }
 
+void OpticalBarModel::points_to_pixels(std::vector<Vector3> const& points,
+                                       std::vector<Vector2>      & pixels) const {
+
+  // Batches usually come from neighboring ground points, so the last
+  // solution is a much better guess than the image center. Fall back to
+  // the center if that does not converge.
+  const Vector2 center = m_image_size / 2.0;
+  Vector2 guess = center;
+  pixels.resize(points.size());
+  for (size_t i = 0; i < points.size(); i++) {
+    // As in the base class, one failed point must not fail the batch.
+    Vector2 solution;
+    bool success = false;
+    try {
+      success = solve_point_to_pixel(points[i], guess, solution);
+      if (!success && guess != center)
+        success = solve_point_to_pixel(points[i], center, solution);
+    } catch(...) {
+      success = false;
+    }
+    if (!success) {
+      pixels[i] = invalid_pixel();
+      continue;
+    }
+    pixels[i] = solution;
+    guess     = solution;
+  }
+}
+
+void OpticalBarModel::pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                        std::vector<Vector3>      & vectors) const {
+  const Quat    pose     = camera_pose(Vector2());
+  const Vector3 velocity = get_velocity(Vector2());
+  vectors.resize(pixels.size());
+  for (size_t i = 0; i < pixels.size(); i++) {
+    try {
+      Vector3 cam_ctr = m_initial_position + pixel_to_time_delta(pixels[i])*velocity;
+      vectors[i] = apply_corrections(cam_ctr, velocity,
+                                     pixel_to_vector_uncorrected(pixels[i], pose, cam_ctr));
+    } catch(...) {
+      vectors[i] = Vector3();
+    }
+  }
+}
+
+void OpticalBarModel::camera_centers(std::vector<Vector2> const& pixels,
+                                     std::vector<Vector3>      & centers) const {
+  const Vector3 velocity = get_velocity(Vector2());
+  centers.resize(pixels.size());
+  for (size_t i = 0; i < pixels.size(); i++)
+    centers[i] = m_initial_position + pixel_to_time_delta(pixels[i])*velocity;
+}
+
 void OpticalBarModel::apply_transform(vw::Matrix3x3 const & rotation,
                                       vw::Vector3   const & translation,
                                       double                scale) {
@@ -135,6 +135,16 @@ namespace camera {
     /// Gives a pose vector which represents the rotation from camera to world units
     virtual vw::Quat camera_pose(vw::Vector2 const& pix) const;
 
+    /// Batch versions of the functions above.  The pose and velocity are
+    /// constant over a scan, so they are only computed once per call, and
+    /// point_to_pixel warm-starts each solve from the previous solution.
+    virtual void points_to_pixels (std::vector<vw::Vector3> const& points,
+                                   std::vector<vw::Vector2>      & pixels ) const;
+    virtual void pixels_to_vectors(std::vector<vw::Vector2> const& pixels,
+                                   std::vector<vw::Vector3>      & vectors) const;
+    virtual void camera_centers   (std::vector<vw::Vector2> const& pixels,
+                                   std::vector<vw::Vector3>      & centers) const;
+
     // -- These are new functions --
 
     // These return the initial center/pose at time=0.
@@ -198,6 +208,20 @@ namespace camera {
     /// Does not incluce velocity aberration and atmospheric correction.
     vw::Vector3 pixel_to_vector_uncorrected(vw::Vector2 const& pixel) const;
 
+    /// As above, with the pose and camera center for the pixel already known.
+    vw::Vector3 pixel_to_vector_uncorrected(vw::Vector2 const& pixel,
+                                            vw::Quat    const& cam_pose,
+                                            vw::Vector3 const& cam_center) const;
+
+    /// Apply the optional corrections to a vector from pixel_to_vector_uncorrected.
+    vw::Vector3 apply_corrections(vw::Vector3 const& cam_center,
+                                  vw::Vector3 const& velocity,
+                                  vw::Vector3 const& uncorrected_vector) const;
+
+    /// Solve for the pixel observing a point, starting from the given guess.
+    bool solve_point_to_pixel(vw::Vector3 const& point, vw::Vector2 const& start,
+                              vw::Vector2 & pixel) const;
+
     /// Returns the velocity in the GCC frame, not the sensor frame.
     vw::Vector3 get_velocity(vw::Vector2 const& pixel) const;
 
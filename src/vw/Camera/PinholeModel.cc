@@ -442,6 +442,104 @@ Vector3 PinholeModel::camera_center(Vector2 const& /*pix*/ ) const {
   return m_camera_center;
 };
 
+void PinholeModel::points_to_pixels(std::vector<Vector3> const& points,
+                                    std::vector<Vector2>      & pixels) const {
+
+  // Unpack the camera matrix so the inner loop works on plain doubles.
+  const double p00 = m_camera_matrix(0,0), p01 = m_camera_matrix(0,1),
+               p02 = m_camera_matrix(0,2), p03 = m_camera_matrix(0,3),
+               p10 = m_camera_matrix(1,0), p11 = m_camera_matrix(1,1),
+               p12 = m_camera_matrix(1,2), p13 = m_camera_matrix(1,3),
+               p20 = m_camera_matrix(2,0), p21 = m_camera_matrix(2,1),
+               p22 = m_camera_matrix(2,2), p23 = m_camera_matrix(2,3);
+  const double q00 = m_inv_camera_transform(0,0), q01 = m_inv_camera_transform(0,1),
+               q02 = m_inv_camera_transform(0,2), q10 = m_inv_camera_transform(1,0),
+               q11 = m_inv_camera_transform(1,1), q12 = m_inv_camera_transform(1,2),
+               q20 = m_inv_camera_transform(2,0), q21 = m_inv_camera_transform(2,1),
+               q22 = m_inv_camera_transform(2,2);
+  const double cx = m_camera_center[0], cy = m_camera_center[1], cz = m_camera_center[2];
+  const bool   no_distortion = (dynamic_cast<NullLensDistortion const*>(m_distortion.get()) != 0);
+
+  // Same threshold as in point_to_pixel().
+  const double ERROR_THRESHOLD = 0.01;
+
+  const size_t num_points = points.size();
+  pixels.resize(num_points);
+  for (size_t i = 0; i < num_points; i++) {
+    const double x = points[i][0], y = points[i][1], z = points[i][2];
+    const double denominator = p20*x + p21*y + p22*z + p23;
+    const double u = (p00*x + p01*y + p02*z + p03) / denominator;
+    const double v = (p10*x + p11*y + p12*z + p13) / denominator;
+
+    Vector2 final_pixel, undist_pixel(u, v);
+    try {
+      if (no_distortion) {
+        final_pixel = undist_pixel/m_pixel_pitch;
+      } else {
+        final_pixel  = m_distortion->distorted_coordinates(*this, undist_pixel)/m_pixel_pitch;
+        if (m_do_point_to_pixel_check)
+          undist_pixel = m_distortion->undistorted_coordinates(*this, final_pixel*m_pixel_pitch);
+      }
+    } catch(...) {
+      pixels[i] = invalid_pixel();
+      continue;
+    }
+
+    if (m_do_point_to_pixel_check) {
+      // Inlined version of the check in point_to_pixel().
+      const double ux = undist_pixel[0], uy = undist_pixel[1];
+      double rx = q00*ux + q01*uy + q02, ry = q10*ux + q11*uy + q12, rz = q20*ux + q21*uy + q22;
+      double dx = x - cx, dy = y - cy, dz = z - cz;
+      const double rn = std::sqrt(rx*rx + ry*ry + rz*rz);
+      const double dn = std::sqrt(dx*dx + dy*dy + dz*dz);
+      rx = rx/rn - dx/dn;
+      ry = ry/rn - dy/dn;
+      rz = rz/rn - dz/dn;
+      const double diff = std::sqrt(rx*rx + ry*ry + rz*rz);
+      if (diff >= ERROR_THRESHOLD || diff != diff) {
+        pixels[i] = invalid_pixel();
+        continue;
+      }
+    }
+    pixels[i] = final_pixel;
+  }
+}
+
+void PinholeModel::pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                     std::vector<Vector3>      & vectors) const {
+
+  const double q00 = m_inv_camera_transform(0,0), q01 = m_inv_camera_transform(0,1),
+               q02 = m_inv_camera_transform(0,2), q10 = m_inv_camera_transform(1,0),
+               q11 = m_inv_camera_transform(1,1), q12 = m_inv_camera_transform(1,2),
+               q20 = m_inv_camera_transform(2,0), q21 = m_inv_camera_transform(2,1),
+               q22 = m_inv_camera_transform(2,2);
+  const bool   no_distortion = (dynamic_cast<NullLensDistortion const*>(m_distortion.get()) != 0);
+
+  const size_t num_pixels = pixels.size();
+  vectors.resize(num_pixels);
+  for (size_t i = 0; i < num_pixels; i++) {
+    Vector2 pix = pixels[i]*m_pixel_pitch;
+    if (!no_distortion) {
+      try {
+        pix = m_distortion->undistorted_coordinates(*this, pix);
+      } catch(...) {
+        vectors[i] = Vector3();
+        continue;
+      }
+    }
+    const double rx = q00*pix[0] + q01*pix[1] + q02,
+                 ry = q10*pix[0] + q11*pix[1] + q12,
+                 rz = q20*pix[0] + q21*pix[1] + q22;
+    const double rn = std::sqrt(rx*rx + ry*ry + rz*rz);
+    vectors[i] = Vector3(rx/rn, ry/rn, rz/rn);
+  }
+}
+
+void PinholeModel::camera_centers(std::vector<Vector2> const& pixels,
+                                  std::vector<Vector3>      & centers) const {
+  centers.assign(pixels.size(), m_camera_center);
+}
+
 void PinholeModel::set_camera_center(Vector3 const& position) {
   m_camera_center = position; 
   rebuild_camera_matrix();
@@ -485,6 +583,39 @@ void PinholeModel::set_lens_distortion(LensDistortion const* distortion) {
   m_distortion = distortion->copy();
 }
 
+void PinholeModel::build_lens_distortion_table(Vector2i const& image_size,
+                                               double tolerance, bool polish) {
+  bool fast_distort = m_distortion->has_fast_distort();
+  if (fast_distort && m_distortion->has_fast_undistort())
+    return; // Nothing to do
+
+  // The table must cover the input of the slow direction. For undistortion
+  // that is the image itself. For distortion it is the undistorted footprint
+  // of the image, found by undistorting points along the image border.
+  const double margin = 2.0; // In pixels
+  BBox2 image_box(-margin, -margin, image_size[0] + 2*margin, image_size[1] + 2*margin);
+  BBox2 region;
+  if (fast_distort) {
+    region = image_box;
+  } else {
+    const int num_samples = 100;
+    Vector2 diag = image_box.size();
+    for (int i = 0; i <= num_samples; i++) {
+      double t = double(i)/num_samples;
+      Vector2 border_pts[] = {image_box.min() + Vector2(t*diag[0], 0      ),
+                              image_box.min() + Vector2(t*diag[0], diag[1]),
+                              image_box.min() + Vector2(0,       t*diag[1]),
+                              image_box.min() + Vector2(diag[0], t*diag[1])};
+      for (int j = 0; j < 4; j++)
+        region.grow(m_distortion->undistorted_coordinates(*this, border_pts[j]*m_pixel_pitch)
+                    / m_pixel_pitch);
+    }
+    region.expand(margin);
+  }
+
+  m_distortion->build_inverse_table(*this, region*m_pixel_pitch, tolerance*m_pixel_pitch, polish);
+}
+
 void PinholeModel::intrinsic_parameters(double& f_u, double& f_v,
                                         double& c_u, double& c_v) const {
   f_u = m_fu;  f_v = m_fv;  c_u = m_cu;  c_v = m_cv;
@@ -232,6 +232,16 @@ namespace camera {
     virtual Vector3 camera_center(Vector2 const& /*pix*/ = Vector2() ) const;
     void set_camera_center(Vector3 const& position);
 
+    /// Batch versions of the methods above.  The camera matrix is
+    /// unpacked once per call and the lens distortion model is skipped
+    /// entirely when it is the null model.
+    virtual void points_to_pixels (std::vector<Vector3> const& points,
+                                   std::vector<Vector2>      & pixels ) const;
+    virtual void pixels_to_vectors(std::vector<Vector2> const& pixels,
+                                   std::vector<Vector3>      & vectors) const;
+    virtual void camera_centers   (std::vector<Vector2> const& pixels,
+                                   std::vector<Vector3>      & centers) const;
+
     // Pose is a rotation which moves a vector in camera coordinates
     // into world coordinates.
     // - The pinhole camera position does not vary by pixel so the input pixel is ignored.
@@ -261,6 +271,14 @@ namespace camera {
     LensDistortion const* lens_distortion() const;
     void set_lens_distortion(LensDistortion const* distortion); // Makes a copy
 
+    /// Precompute a lookup table for the lens distortion direction which
+    /// otherwise needs an iterative solver, covering an image of the given
+    /// size plus a small margin. The tolerance is in pixels.
+    /// - The table is ignored if the focal length or point offset change.
+    /// - See LensDistortion::build_inverse_table().
+    void build_lens_distortion_table(Vector2i const& image_size,
+                                     double tolerance = 1e-3, bool polish = true);
+
     //  f_u and f_v :  focal length in horiz and vert. pixel units
     //  c_u and c_v :  principal point in pixel units
     void intrinsic_parameters(double& f_u, double& f_v,
@@ -98,3 +98,42 @@ TEST( AdjustedCameraModel, AdjustedConstruct ) {
     acos(dot_prod(Vector3(0,0,1),inverse(center_pose).rotate(adjcam2.pixel_to_vector(center_pixel))));
   EXPECT_LT( angle_from_z, 0.5 );
 }
+
+TEST( AdjustedCameraModel, BatchProjection ) {
+
+  Matrix<double,3,3> pose = math::euler_to_rotation_matrix(1.3,2.0,-.7,"xyz");
+  boost::shared_ptr<CameraModel> pinhole(
+      new PinholeModel( Vector3(10,-4,2), // camera center
+                        pose,             // camera pose
+                        500,500,          // fx, fy
+                        500,500) );       // cx, cy
+
+  AdjustedCameraModel adjcam( pinhole, Vector3(1,-2,0.5),
+                              Quat(math::euler_to_rotation_matrix(0.01,-0.02,0.03,"xyz")),
+                              Vector2(20,-30), 2.0 );
+
+  std::vector<Vector2> pixels;
+  std::vector<Vector3> points;
+  for ( int i = 0; i < 500; i += 50 ) {
+    for ( int j = 0; j < 500; j += 50 ) {
+      Vector2 pixel(i,j);
+      pixels.push_back( pixel );
+      points.push_back( adjcam.camera_center(pixel) + 100*adjcam.pixel_to_vector(pixel) );
+    }
+  }
+  // Behind the camera
+  points.push_back( adjcam.camera_center(pixels[0]) - 100*adjcam.pixel_to_vector(pixels[0]) );
+
+  std::vector<Vector2> batch_pixels;
+  std::vector<Vector3> batch_vectors, batch_centers;
+  adjcam.points_to_pixels ( points, batch_pixels  );
+  adjcam.pixels_to_vectors( pixels, batch_vectors );
+  adjcam.camera_centers   ( pixels, batch_centers );
+  ASSERT_EQ( points.size(), batch_pixels.size() );
+  for ( size_t i = 0; i < pixels.size(); i++ ) {
+    EXPECT_VECTOR_NEAR( pixels[i], batch_pixels[i], 1e-8 );
+    EXPECT_VECTOR_NEAR( adjcam.pixel_to_vector(pixels[i]), batch_vectors[i], 1e-12 );
+    EXPECT_VECTOR_NEAR( adjcam.camera_center  (pixels[i]), batch_centers[i], 1e-10 );
+  }
+  EXPECT_VECTOR_DOUBLE_EQ( CameraModel::invalid_pixel(), batch_pixels.back() );
+}
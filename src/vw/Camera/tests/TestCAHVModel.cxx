@@ -189,3 +189,29 @@ TEST( CAHVModel, ForwardReverse ) {
     }
   }
 }
+
+TEST( CAHVModel, BatchProjection ) {
+  CAHVModel cahv(Vector3(0.606583,-0.036214,-0.234717),
+                 Vector3(0.708256,-0.0113108,0.705866),
+                 Vector3(365.881,275.126,361.931),
+                 Vector3(173.589,-3.95587,550.402));
+
+  std::vector<Vector2> pixels;
+  std::vector<Vector3> points;
+  for ( uint32 i = 100; i < 901; i += 100 ) {
+    for ( uint32 j = 100; j < 901; j+= 100 ) {
+      pixels.push_back( Vector2(i,j) );
+      points.push_back( cahv.C + 30*cahv.pixel_to_vector( Vector2(i,j) ) );
+    }
+  }
+
+  std::vector<Vector2> batch_pixels;
+  std::vector<Vector3> batch_vectors;
+  cahv.points_to_pixels ( points, batch_pixels  );
+  cahv.pixels_to_vectors( pixels, batch_vectors );
+  ASSERT_EQ( pixels.size(), batch_pixels.size() );
+  for ( size_t i = 0; i < pixels.size(); i++ ) {
+    EXPECT_VECTOR_NEAR( pixels[i], batch_pixels[i], 1e-8 );
+    EXPECT_VECTOR_NEAR( cahv.pixel_to_vector( pixels[i] ), batch_vectors[i], 1e-12 );
+  }
+}
@@ -177,3 +177,33 @@ TEST( CAHVORModel, ForwardReverse) {
     }
   }
 }
+
+TEST( CAHVORModel, BatchProjection ) {
+  CAHVORModel cahvor(Vector3(0.491222,-0.0717236,-1.24143),
+                     Vector3(0.921657,-0.230518,0.312107),
+                     Vector3(757.076,1071.6,160.227),
+                     Vector3(91.7479,-27.7504,1319.48),
+                     Vector3(0.920759,-0.206185,0.331197),
+                     Vector3(0.00096,-0.002183,0.018547));
+
+  std::vector<Vector2> pixels;
+  std::vector<Vector3> points;
+  for ( uint32 i = 100; i < 901; i += 100 ) {
+    for ( uint32 j = 100; j < 901; j+= 100 ) {
+      pixels.push_back( Vector2(i,j) );
+      points.push_back( cahvor.C + 30*cahvor.pixel_to_vector( Vector2(i,j) ) );
+    }
+  }
+
+  std::vector<Vector2> batch_pixels;
+  std::vector<Vector3> batch_vectors, batch_centers;
+  cahvor.points_to_pixels ( points, batch_pixels  );
+  cahvor.pixels_to_vectors( pixels, batch_vectors );
+  cahvor.camera_centers   ( pixels, batch_centers );
+  ASSERT_EQ( pixels.size(), batch_pixels.size() );
+  for ( size_t i = 0; i < pixels.size(); i++ ) {
+    EXPECT_VECTOR_NEAR( cahvor.point_to_pixel( points[i] ), batch_pixels[i], 1e-8 );
+    EXPECT_VECTOR_NEAR( cahvor.pixel_to_vector( pixels[i] ), batch_vectors[i], 1e-12 );
+    EXPECT_VECTOR_DOUBLE_EQ( cahvor.C, batch_centers[i] );
+  }
+}
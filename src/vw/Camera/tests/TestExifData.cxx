@@ -18,12 +18,15 @@
 
 // TestExifData
 #include <gtest/gtest_VW.h>
+#include <test/Helpers.h>
 
 #include <cstdio>
+#include <fstream>
 #include <vw/Camera/Exif.h>
 
 using namespace vw;
 using namespace vw::camera;
+using namespace vw::test;
 
 TEST( Exif, ReadData ) {
 
@@ -57,3 +60,32 @@ TEST( Exif, ReadData ) {
 
   }
 }
+
+// A little-endian TIFF header whose first IFD links to an Exif IFD
+// holding the exposure time and f-number.  read_tiff_ifd() maps the
+// file into memory rather than reading it.
+TEST( Exif, ReadTiff ) {
+  const unsigned char tiff[] = {
+    'I','I', 42,0,  8,0,0,0,
+    // IFD0: ExifOffset (LONG) -> 26
+    1,0,  0x69,0x87, 4,0, 1,0,0,0, 26,0,0,0,  0,0,0,0,
+    // Exif IFD: ExposureTime and FNumber (RATIONAL) -> 56, 64
+    2,0,  0x9A,0x82, 5,0, 1,0,0,0, 56,0,0,0,
+          0x9D,0x82, 5,0, 1,0,0,0, 64,0,0,0,  0,0,0,0,
+    1,0,0,0, 80,0,0,0,
+    29,0,0,0, 5,0,0,0 };
+
+  UnlinkName file( "exif.tif" );
+  {
+    std::ofstream out( file.c_str(), std::ios::binary );
+    out.write( (const char*)tiff, sizeof(tiff) );
+  }
+
+  ExifData exif_data;
+  EXPECT_TRUE( exif_data.import_data( file ) );
+  double exposure, fstop;
+  ASSERT_TRUE( exif_data.get_tag_value(EXIF_ExposureTime, exposure) );
+  EXPECT_NEAR( exposure, 0.0125, 1e-8 );
+  ASSERT_TRUE( exif_data.get_tag_value(EXIF_FNumber, fstop) );
+  EXPECT_NEAR( fstop, 5.8, 1e-8 );
+}
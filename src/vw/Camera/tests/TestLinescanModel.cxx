@@ -19,6 +19,7 @@
 #include <gtest/gtest_VW.h>
 
 #include <vw/Math/Vector.h>
+#include <vw/Math/Matrix.h>
 #include <vw/Camera/LinescanModel.h>
 #include <vw/Camera/Extrinsics.h>
 #include <test/Helpers.h>
@@ -113,3 +114,79 @@ TEST( LinearPushbroom, PixelToVector ) {
   */
 }
 
+
+// A minimal orbiting pushbroom camera looking straight down at the Earth
+class SimpleLinescanModel : public LinescanModel {
+  LinearPositionInterpolation m_position_func;
+  ConstantPoseInterpolation   m_pose_func;
+  LinearTimeInterpolation     m_time_func;
+  Vector3 m_velocity;
+  double  m_focal_length;
+public:
+  SimpleLinescanModel(Vector3 const& position, Vector3 const& velocity, Quat const& pose,
+                      Vector2i const& image_size, double focal_length,
+                      bool correct_velocity, bool correct_atmosphere):
+    LinescanModel(image_size, correct_velocity, correct_atmosphere),
+    m_position_func(position, velocity), m_pose_func(pose),
+    m_time_func(0, 1e-4), m_velocity(velocity), m_focal_length(focal_length) {}
+
+  virtual Vector3 get_camera_center_at_time  (double time) const { return m_position_func(time); }
+  virtual Vector3 get_camera_velocity_at_time(double /*time*/) const { return m_velocity; }
+  virtual Quat    get_camera_pose_at_time    (double time) const { return m_pose_func(time); }
+  virtual double  get_time_at_line           (double line) const { return m_time_func(line); }
+  virtual Vector3 get_local_pixel_vector(Vector2 const& pix) const {
+    return normalize(Vector3(pix.x() - m_image_size[0]/2.0, 0, m_focal_length));
+  }
+};
+
+// Build a camera 500 km above the equator, flying north, with +Z pointing down
+SimpleLinescanModel make_simple_linescan(bool correct_velocity, bool correct_atmosphere) {
+  Matrix3x3 rot;
+  select_col(rot, 0) = Vector3(0, 0, 1);
+  select_col(rot, 1) = Vector3(0, 1, 0);
+  select_col(rot, 2) = Vector3(-1, 0, 0);
+  return SimpleLinescanModel(Vector3(6371000.0 + 500000.0, 0, 0), Vector3(0, 7000, 0),
+                             Quat(rot), Vector2i(2000, 5000), 50000.0,
+                             correct_velocity, correct_atmosphere);
+}
+
+TEST( LinescanModel, PointToPixel ) {
+  for (int i = 0; i < 3; i++) {
+    SimpleLinescanModel cam = make_simple_linescan(i == 1, i == 2);
+    for (double row = 0; row < 5000; row += 701.3) {
+      for (double col = 0; col < 2000; col += 313.7) {
+        Vector2 pix(col, row);
+        Vector3 point = cam.camera_center(pix) + 480000.0*cam.pixel_to_vector(pix);
+        EXPECT_VECTOR_NEAR( cam.point_to_pixel(point), pix, 1e-5 );
+        // A far off guess must converge as well
+        EXPECT_VECTOR_NEAR( cam.point_to_pixel(point, 4999.0), pix, 1e-5 );
+      }
+    }
+  }
+}
+
+TEST( LinescanModel, PointToPixelBatch ) {
+  SimpleLinescanModel cam = make_simple_linescan(true, false);
+  std::vector<Vector3> points;
+  std::vector<Vector2> expected;
+  for (double row = 100; row < 4900; row += 97.5) {
+    for (double col = 10; col < 2000; col += 401.1) {
+      Vector2 pix(col, row);
+      expected.push_back(pix);
+      points.push_back(cam.camera_center(pix) + 480000.0*cam.pixel_to_vector(pix));
+    }
+  }
+  // This point is behind the camera and cannot be projected
+  points.push_back(Vector3(6371000.0 + 600000.0, 0, 0));
+
+  std::vector<Vector2> pixels;
+  std::vector<bool> valid;
+  cam.point_to_pixel(points, pixels, valid);
+  ASSERT_EQ( points.size(), pixels.size() );
+  ASSERT_EQ( points.size(), valid.size() );
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_TRUE( valid[i] );
+    EXPECT_VECTOR_NEAR( pixels[i], expected[i], 1e-5 );
+  }
+  EXPECT_FALSE( valid.back() );
+}
@@ -113,6 +113,25 @@ TEST(OpticalBarModel, CreateCamera) {
     }
   }
 
+  // The batch functions must agree with the single pixel versions
+  std::vector<Vector2> pixels, batch_pixels;
+  std::vector<Vector3> points, batch_vectors, batch_centers;
+  for ( size_t i = 0; i < 3000; i += 200 ) {
+    for ( size_t j = 0; j < 2400; j += 200 ) {
+      Vector2 pixel(i,j);
+      pixels.push_back(pixel);
+      points.push_back(cam1->camera_center(pixel) + 2e4*cam1->pixel_to_vector(pixel));
+    }
+  }
+  cam1->points_to_pixels (points, batch_pixels );
+  cam1->pixels_to_vectors(pixels, batch_vectors);
+  cam1->camera_centers   (pixels, batch_centers);
+  for ( size_t i = 0; i < pixels.size(); i++ ) {
+    EXPECT_VECTOR_NEAR( pixels[i], batch_pixels[i], 1e-2 /*pixels*/);
+    EXPECT_VECTOR_NEAR( cam1->pixel_to_vector(pixels[i]), batch_vectors[i], 1e-12 );
+    EXPECT_VECTOR_NEAR( cam1->camera_center  (pixels[i]), batch_centers[i], 1e-6  );
+  }
+
   
   /*
   Vector3   gcc2(-2470746.042265798, 5537165.6573024355, 2515786.8430585163);
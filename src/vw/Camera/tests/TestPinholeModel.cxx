@@ -112,6 +112,80 @@ TEST( PinholeModel, TsaiDistortion ) {
 #endif
 }
 
+TEST( PinholeModel, DistortionInverseTable ) {
+  double distortion_arr[] = {-0.2805362343788147, 0.1062035113573074,
+                             -0.0001422458299202845, 0.00116333004552871};
+  Vector<double> distortion_vec(sizeof(distortion_arr)/sizeof(double), distortion_arr);
+  TsaiLensDistortion lens(distortion_vec);
+  PinholeModel pinhole( Vector3(0,0,0), math::identity_matrix<3>(),
+                        500,500, 500,500, &lens);
+  PinholeModel exact_pinhole(pinhole);
+
+  // Approximate table, no polishing. This lens is strongly distorted near
+  // the image border, so use a modest tolerance to keep the grid small.
+  const double tol = 1e-2;
+  pinhole.build_lens_distortion_table(Vector2i(1000,1000), tol, false);
+  boost::shared_ptr<const LensDistortionInverseTable> table
+    = pinhole.lens_distortion()->inverse_table();
+  ASSERT_TRUE( table.get() != 0 );
+  EXPECT_TRUE( table->undistort() );
+  EXPECT_LE( table->max_error(), tol );
+
+#if defined(VW_HAVE_PKG_LAPACK)
+  for (int x = 0; x < 1000; x += 97) {
+    for (int y = 0; y < 1000; y += 89) {
+      Vector2 pix(x + 0.3, y + 0.7);
+      Vector2 exact = exact_pinhole.lens_distortion()->undistorted_coordinates(exact_pinhole, pix);
+      EXPECT_VECTOR_NEAR( pinhole.lens_distortion()->undistorted_coordinates(pinhole, pix),
+                          exact, tol );
+    }
+  }
+
+  // Polished results agree with the solver
+  pinhole.build_lens_distortion_table(Vector2i(1000,1000), tol, true);
+  Vector2 pix(123.4, 876.5);
+  EXPECT_VECTOR_NEAR( pinhole.lens_distortion()->undistorted_coordinates(pinhole, pix),
+                      exact_pinhole.lens_distortion()->undistorted_coordinates(exact_pinhole, pix),
+                      1e-8 );
+#endif
+
+  // The table is tied to the intrinsics it was built with
+  EXPECT_TRUE ( table->applies(pinhole, Vector2(10,10)) );
+  pinhole.set_focal_length(Vector2(501,501));
+  EXPECT_FALSE( table->applies(pinhole, Vector2(10,10)) );
+
+  // Changing the parameters discards the table
+  TsaiLensDistortion lens2(lens);
+  lens2.build_inverse_table(exact_pinhole, BBox2(0,0,1000,1000), tol);
+  EXPECT_TRUE ( lens2.inverse_table().get() != 0 );
+  lens2.set_distortion_parameters(distortion_vec);
+  EXPECT_FALSE( lens2.inverse_table().get() != 0 );
+}
+
+TEST( PinholeModel, CameraTransformTable ) {
+  // Brown-Conrady has no fast distortion, which the reverse warp needs
+  BrownConradyDistortion lens(Vector2(-0.6,-0.2), Vector3(.1336185e-8, 0, 0),
+                              Vector2(.5495819e-9, 0), 0.201);
+  PinholeModel distorted( Vector3(0,0,0), math::identity_matrix<3>(),
+                          500,500, 500,500, &lens);
+  PinholeModel linear( Vector3(0,0,0), math::identity_matrix<3>(),
+                       500,500, 500,500);
+
+  CameraTransform<PinholeModel, PinholeModel> exact( distorted, linear );
+  CameraTransform<PinholeModel, PinholeModel> tabled( distorted, linear,
+                                                      Vector2i(1000,1000), Vector2i(1000,1000) );
+  // Only the transform's own copy gets the table
+  EXPECT_TRUE( distorted.lens_distortion()->inverse_table().get() == 0 );
+
+#if defined(VW_HAVE_PKG_LAPACK)
+  for (int x = 0; x < 1000; x += 111)
+    for (int y = 0; y < 1000; y += 93) {
+      Vector2 pix(x + 0.25, y + 0.5);
+      EXPECT_VECTOR_NEAR( exact.reverse(pix), tabled.reverse(pix), 1e-6 );
+    }
+#endif
+}
+
 TEST( PinholeModel, ScalePinhole ) {
   Matrix<double,3,3> rot = vw::math::euler_to_quaternion(1.15, 0.0, -1.57, "xyz").rotation_matrix();
   double distortion_arr[] = {-0.2796604335308075, 0.1031486615538597,
@@ -231,6 +305,38 @@ protected:
     }
   }
 
+  /// Make sure the batch projection functions agree with the single point ones.
+  void batch_test(double tolerance=1e-8) {
+    Vector2 image_size = pinhole.point_offset();
+    image_size *= 2;
+    std::vector<Vector2> pixels;
+    std::vector<Vector3> points;
+    for ( unsigned x = 10; x < image_size.x(); x+=80 ) {
+      for ( unsigned y = 10; y < image_size.y(); y+=80 ) {
+        pixels.push_back(Vector2(x,y));
+        points.push_back(pinhole.camera_center() + 10*pinhole.pixel_to_vector(Vector2(x,y)));
+      }
+    }
+    // A point behind the camera must be flagged rather than throw.
+    points.push_back(pinhole.camera_center() - 10*pinhole.pixel_to_vector(pixels[0]));
+
+    std::vector<Vector2> batch_pixels;
+    std::vector<Vector3> batch_vectors, batch_centers;
+    pinhole.points_to_pixels (points, batch_pixels);
+    pinhole.pixels_to_vectors(pixels, batch_vectors);
+    pinhole.camera_centers   (pixels, batch_centers);
+    ASSERT_EQ( points.size(), batch_pixels.size()  );
+    ASSERT_EQ( pixels.size(), batch_vectors.size() );
+    ASSERT_EQ( pixels.size(), batch_centers.size() );
+    for ( size_t i = 0; i < pixels.size(); i++ ) {
+      EXPECT_VECTOR_NEAR( pinhole.point_to_pixel(points[i]), batch_pixels[i], tolerance );
+      EXPECT_VECTOR_NEAR( pinhole.pixel_to_vector(pixels[i]), batch_vectors[i], tolerance );
+      EXPECT_VECTOR_DOUBLE_EQ( pinhole.camera_center(), batch_centers[i] );
+    }
+    EXPECT_THROW( pinhole.point_to_pixel(points.back()), PointToPixelErr );
+    EXPECT_VECTOR_DOUBLE_EQ( PinholeModel::invalid_pixel(), batch_pixels.back() );
+  }
+
   /// Write a .tsai file, then read it back in and make sure nothing has changed.
   void readback_test(std::string const& file) {
     pinhole.write( file );
@@ -285,6 +391,19 @@ TEST_F( PinholeTest, TsaiLensDistortion ) {
   readback_test( file );
 }
 
+TEST_F( PinholeTest, BatchProjection ) {
+  batch_test();
+
+  double distortion_arr[] = {-0.2796604335308075, 0.1031486615538597,
+                             -0.0007824968779459596, 0.0009675505571067333};
+  Vector<double> distortion_vec(sizeof(distortion_arr)/sizeof(double), distortion_arr);
+  TsaiLensDistortion lens(distortion_vec);
+  pinhole.set_lens_distortion(&lens);
+#if defined(VW_HAVE_PKG_LAPACK) && VW_HAVE_PKG_LAPACK==1
+  batch_test();
+#endif
+}
+
 TEST_F( PinholeTest, BrownConradyDistortion ) {
   BrownConradyDistortion lens(Vector2(-0.6,-0.2),
                               Vector3(.1336185e-8,
@@ -301,6 +420,23 @@ TEST_F( PinholeTest, BrownConradyDistortion ) {
   readback_test( file );
 }
 
+TEST_F( PinholeTest, BrownConradyDistortionTable ) {
+  // Without K2, so the distortion is invertible over the whole image
+  BrownConradyDistortion lens(Vector2(-0.6,-0.2),
+                              Vector3(.1336185e-8, 0, 0),
+                              Vector2(.5495819e-9,
+                                      0),
+                              0.201);
+  pinhole.set_lens_distortion(&lens);
+  Vector2 image_size = pinhole.point_offset()*2;
+  pinhole.build_lens_distortion_table(Vector2i(image_size[0], image_size[1]));
+  ASSERT_TRUE( pinhole.lens_distortion()->inverse_table().get() != 0 );
+  EXPECT_FALSE( pinhole.lens_distortion()->inverse_table()->undistort() );
+#if defined(VW_HAVE_PKG_LAPACK)
+  projection_test(1e-4);
+#endif
+}
+
 TEST_F( PinholeTest, AdjustableTsaiDistortion ) {
   Vector<double> distort_coeff(6);
   distort_coeff[0] = 0.007646500298509824;   // k1
@@ -59,7 +59,7 @@ namespace cartography {
   // function is difference between datum height and DEM height at
   // current point on the ray.
   template <class DEMImageT>
-  class RayDEMIntersectionLMA : public math::LeastSquaresModelBase< RayDEMIntersectionLMA< DEMImageT > > {
+  class RayDEMIntersectionLMA : public math::LeastSquaresModelBaseFixed< RayDEMIntersectionLMA< DEMImageT >, 1, 1 > {
 
     // TODO: Why does this use EdgeExtension if Helper() restricts access to the bounds?
     InterpolationView<EdgeExtensionView<DEMImageT, ConstantEdgeExtension>,
@@ -100,7 +100,7 @@ namespace cartography {
   public:
     typedef Vector<double, 1> result_type;
     typedef Vector<double, 1> domain_type;
-    typedef Matrix<double>    jacobian_type; ///< Jacobian form. Auto.
+    typedef Matrix<double, 1, 1> jacobian_type; ///< Jacobian form. Auto.
 
     /// Return a very large error to penalize locations that fall off the edge of the DEM.
     inline double big_val() const {
@@ -216,10 +216,10 @@ namespace cartography {
       //   value to minimize the height difference from the DEM.
       int status = 0;
       Vector<double, 1> observation; observation[0] = 0;
-      len = math::levenberg_marquardt(model, len, observation, status,
-                                      max_abs_tol, max_rel_tol,
-                                      num_max_iter
-                                      );
+      len = math::levenberg_marquardtFixed(model, len, observation, status,
+                                           max_abs_tol, max_rel_tol,
+                                           num_max_iter
+                                           );
 
       Vector<double, 1> dem_height = model(len);
 
@@ -578,10 +578,12 @@ namespace cartography {
       std::vector<Vector2> dem_pixels;
       detail::sample_points_on_dem(dem, dem_step, dem_pixels);
         
-      // Project the sampled points into the camera
+      // Find the ground point for each sample
+      std::vector<Vector3> xyz_vec;
+      std::vector<Vector2> point_vec;
       for (size_t it = 0; it < dem_pixels.size(); it++) {
 
-        Vector2 lonlat, point, dem_pix, cam_pix;
+        Vector2 lonlat, point, dem_pix;
         double  height;
         Vector3 llh, xyz;
 
@@ -602,50 +604,6 @@ namespace cartography {
           xyz = dem_georef.datum().geodetic_to_cartesian(llh);
           if (xyz == Vector3() || xyz != xyz) // watch for invalid values
             continue;
-          
-          cam_pix = camera_model->point_to_pixel(xyz);
-          if (cam_pix != cam_pix)
-            continue; // watch for nan
-
-          // Check if the point projects into the camera
-          if (!(cam_pix[0] >= 0 && cam_pix[0] <= cols-1 &&
-                cam_pix[1] >= 0 && cam_pix[1] <= rows-1))
-            continue;
-
-          // This point looks good. Do more sanity checks
-
-          // Geometric check. If this dot product is non-negative,
-          // the point xyz is on the same side of the planet as the
-          // camera center. Otherwise throw out this xyz. This is a
-          // bugfix.
-          vw::Vector3 cam_ctr = camera_model->camera_center(cam_pix);
-          vw::Vector3 ray_vec = xyz - cam_ctr;
-          double dot = dot_prod(ray_vec, -xyz);
-          if (dot < 0.0) 
-            continue;
-
-          // Normalize the ray vector
-          double len = norm_2(ray_vec);
-          ray_vec /= len;
-
-          // If the ray from the pixel to the point on the ground
-          // does not agree with the camera direction, this point is
-          // spurious. The tolerance we use here is too lenient, it
-          // is meant to catch only large deviations. At the same
-          // time for some camera models the agreement between
-          // point_to_pixel and pixel_to_vector may not be too great
-          // perhaps if a numerical solver is used, hence the
-          // tolerance is not made too tight.
-          vw::Vector3 camera_dir = camera_model->pixel_to_vector(cam_pix);
-          double DIRECTION_TOLERANCE = 1e-3; 
-          if (norm_2(camera_dir - ray_vec) > DIRECTION_TOLERANCE) 
-            continue;
-          
-          // Finally a good point we can accept
-          cam_bbox.grow(point);
-          
-          // Add to cam_pixels from this different way of sampling
-          cam_pixels.push_back(cam_pix);
         }
         
         catch(...) {
@@ -656,8 +614,70 @@ namespace cartography {
           // these since they probably don't intersect the image
           // anyways.
           continue;
-        }  
+        }
+
+        xyz_vec.push_back(xyz);
+        point_vec.push_back(point);
       } // End loop through points on the DEM
+
+      // Project the sampled points into the camera, all at once
+      std::vector<Vector2> proj_pix;
+      camera_model->points_to_pixels(xyz_vec, proj_pix);
+
+      // Keep the ones which project into the camera
+      std::vector<size_t>  in_index;
+      std::vector<Vector2> in_pix;
+      for (size_t it = 0; it < proj_pix.size(); it++) {
+        Vector2 const& cam_pix = proj_pix[it];
+        if (cam_pix != cam_pix)
+          continue; // watch for nan
+        if (!(cam_pix[0] >= 0 && cam_pix[0] <= cols-1 &&
+              cam_pix[1] >= 0 && cam_pix[1] <= rows-1))
+          continue; // also rejects the invalid pixel
+        in_index.push_back(it);
+        in_pix.push_back(cam_pix);
+      }
+
+      // This point looks good. Do more sanity checks. A failed center or
+      // ray comes back as a zero vector, which fails the checks below.
+      std::vector<Vector3> cam_ctrs, cam_dirs;
+      camera_model->camera_centers   (in_pix, cam_ctrs);
+      camera_model->pixels_to_vectors(in_pix, cam_dirs);
+      for (size_t it = 0; it < in_pix.size(); it++) {
+
+        Vector3 const& xyz = xyz_vec[in_index[it]];
+
+        // Geometric check. If this dot product is non-negative,
+        // the point xyz is on the same side of the planet as the
+        // camera center. Otherwise throw out this xyz. This is a
+        // bugfix.
+        vw::Vector3 ray_vec = xyz - cam_ctrs[it];
+        double dot = dot_prod(ray_vec, -xyz);
+        if (dot < 0.0) 
+          continue;
+
+        // Normalize the ray vector
+        double len = norm_2(ray_vec);
+        ray_vec /= len;
+
+        // If the ray from the pixel to the point on the ground
+        // does not agree with the camera direction, this point is
+        // spurious. The tolerance we use here is too lenient, it
+        // is meant to catch only large deviations. At the same
+        // time for some camera models the agreement between
+        // point_to_pixel and pixel_to_vector may not be too great
+        // perhaps if a numerical solver is used, hence the
+        // tolerance is not made too tight.
+        double DIRECTION_TOLERANCE = 1e-3; 
+        if (norm_2(cam_dirs[it] - ray_vec) > DIRECTION_TOLERANCE) 
+          continue;
+        
+        // Finally a good point we can accept
+        cam_bbox.grow(point_vec[in_index[it]]);
+        
+        // Add to cam_pixels from this different way of sampling
+        cam_pixels.push_back(in_pix[it]);
+      }
       
       //vw_out() << "Expanded bbox with DEM to image: " << cam_bbox << std::endl;
     } // End if (!quick)
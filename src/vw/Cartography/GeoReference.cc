@@ -34,6 +34,9 @@
 // Boost
 #include <boost/algorithm/string.hpp>
 #include <boost/foreach.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <map>
 
 // Proj.4
 #define ACCEPT_USE_OF_DEPRECATED_PROJ_API_H // TODO(oalexan1): Remove deprecations
@@ -924,10 +927,124 @@ double GeoReference::test_pixel_reprojection_error(Vector2 const& pixel) {
     return Vector3( ll[0], ll[1], point[2] );
   }
   
+  void GeoReference::point_to_lonlat(std::vector<Vector2> const& points,
+                                     std::vector<Vector2> & lonlats) const {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    lonlats.resize(points.size());
+    if ( !m_is_projected ) {
+      for (size_t i = 0; i < points.size(); i++)
+        lonlats[i] = Vector2(math::normalize_longitude(points[i][0], m_center_lon_zero),
+                             points[i][1]);
+      return;
+    }
+
+    void *ctx, *proj; // Look up this thread's context and projection once
+    m_proj_context.thread_ptrs(ctx, proj);
+    for (size_t i = 0; i < points.size(); i++) {
+      projXY projected;
+      projected.u = points[i][0];
+      projected.v = points[i][1];
+      projLP unprojected = pj_inv(projected, proj);
+      if (pj_ctx_get_errno(ctx) || unprojected.u == HUGE_VAL) {
+        lonlats[i] = Vector2(nan, nan);
+        continue;
+      }
+      lonlats[i] = Vector2(math::normalize_longitude(unprojected.u * RAD_TO_DEG, m_center_lon_zero),
+                           unprojected.v * RAD_TO_DEG);
+    }
+  }
+
+  void GeoReference::lonlat_to_point(std::vector<Vector2> const& lonlats,
+                                     std::vector<Vector2> & points) const {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    points.resize(lonlats.size());
+    if ( !m_is_projected ) {
+      for (size_t i = 0; i < lonlats.size(); i++)
+        points[i] = Vector2(math::normalize_longitude(lonlats[i][0], m_center_lon_zero),
+                            lonlats[i][1]);
+      return;
+    }
+
+    // Same latitude clamp as in the single point version
+    static const double BOUND = 1.5707963267948966 - (1e-10) - std::numeric_limits<double>::epsilon();
+
+    void *ctx, *proj;
+    m_proj_context.thread_ptrs(ctx, proj);
+    for (size_t i = 0; i < lonlats.size(); i++) {
+      projLP unprojected;
+      unprojected.u = math::normalize_longitude(lonlats[i][0], m_center_lon_zero) * DEG_TO_RAD;
+      unprojected.v = std::max(-BOUND, std::min(BOUND, lonlats[i][1] * DEG_TO_RAD));
+      projXY projected = pj_fwd(unprojected, proj);
+      if (pj_ctx_get_errno(ctx) || projected.u == HUGE_VAL)
+        points[i] = Vector2(nan, nan);
+      else
+        points[i] = Vector2(projected.u, projected.v);
+    }
+  }
+
+  void GeoReference::pixel_to_lonlat(std::vector<Vector2> const& pixels,
+                                     std::vector<Vector2> & lonlats) const {
+    std::vector<Vector2> points(pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++)
+      points[i] = pixel_to_point(pixels[i]);
+    point_to_lonlat(points, lonlats);
+  }
+
+  void GeoReference::lonlat_to_pixel(std::vector<Vector2> const& lonlats,
+                                     std::vector<Vector2> & pixels) const {
+    lonlat_to_point(lonlats, pixels);
+    for (size_t i = 0; i < pixels.size(); i++)
+      pixels[i] = point_to_pixel(pixels[i]); // NaN stays NaN
+  }
+
   //*****************************************************************
   //************** Functions for class ProjContext ******************
 
-  char** ProjContext::split_proj4_string(std::string const& proj4_str, int &num_strings) {
+  namespace detail {
+    /// The contexts and projections made for threads other than the one
+    /// which created a ProjContext. Each thread keeps its own entry,
+    /// which is freed when the thread exits, so no lock is needed.
+    class ProjThreadTable {
+      struct Entry {
+        uint64                  table; ///< The table this entry was made for
+        boost::shared_ptr<void> ctx, proj;
+      };
+      uint64                            m_id;
+      boost::thread_specific_ptr<Entry> m_entry;
+
+      // A table may be allocated at the address of a destroyed one
+      // whose entries outlived it, so entries are matched by an id
+      // which is never reused.
+      static uint64 next_id() {
+        static Mutex  mutex;
+        static uint64 count = 0;
+        Mutex::Lock lock(mutex);
+        return ++count;
+      }
+    public:
+      ProjThreadTable() : m_id(next_id()) {}
+
+      /// Look up the entry of the calling thread. Returns false if there is none yet.
+      bool find(void* & ctx, void* & proj) const {
+        Entry* e = m_entry.get();
+        if (!e || e->table != m_id)
+          return false;
+        ctx  = e->ctx.get();
+        proj = e->proj.get();
+        return true;
+      }
+      void insert(boost::shared_ptr<void> const& ctx,
+                  boost::shared_ptr<void> const& proj) {
+        Entry* e = new Entry;
+        e->table = m_id;
+        e->ctx   = ctx;
+        e->proj  = proj;
+        m_entry.reset(e);
+      }
+    };
+  } // namespace detail
+
+  char** ProjContext::split_proj4_string(std::string const& proj4_str, int &num_strings) const {
     std::vector<std::string> arg_strings;
     std::string trimmed_proj4_str = boost::trim_copy(proj4_str);
     boost::split( arg_strings, trimmed_proj4_str, boost::is_any_of(" ") );
@@ -941,48 +1058,77 @@ double GeoReference::test_pixel_reprojection_error(Vector2 const& pixel) {
     return strings;
   }
 
-
-  ProjContext::ProjContext(std::string const& proj4_str ) : m_proj4_str(proj4_str) {
-    m_proj_ctx_ptr.reset(pj_ctx_alloc(),pj_ctx_free);
+  void ProjContext::init(boost::shared_ptr<void> & ctx, boost::shared_ptr<void> & proj) const {
+    ctx.reset(pj_ctx_alloc(),pj_ctx_free);
     int num;
     char** proj_strings = split_proj4_string(m_proj4_str, num);
-    m_proj_ptr.reset(pj_init_ctx( m_proj_ctx_ptr.get(),
-                                  num, proj_strings ),
-                     pj_free);
-
-    VW_ASSERT( !pj_ctx_get_errno(m_proj_ctx_ptr.get()),
-               InputErr() << "Proj.4 failed to initialize on string: " << m_proj4_str << "\n\tError was: " 
-                          << pj_strerrno(pj_ctx_get_errno(m_proj_ctx_ptr.get())) );
+    proj.reset(pj_init_ctx( ctx.get(), num, proj_strings ),
+               pj_free);
 
     for ( int i = 0; i < num; i++ )
       delete [] proj_strings[i];
     delete [] proj_strings;
+
+    VW_ASSERT( !pj_ctx_get_errno(ctx.get()),
+               InputErr() << "Proj.4 failed to initialize on string: " << m_proj4_str << "\n\tError was: " 
+                          << pj_strerrno(pj_ctx_get_errno(ctx.get())) );
   }
 
-  ProjContext::ProjContext( ProjContext const& other ) : m_proj4_str(other.m_proj4_str) {
-    m_proj_ctx_ptr.reset(pj_ctx_alloc(),pj_ctx_free);
-    if ( m_proj4_str.empty() )
+  ProjContext::ProjContext(std::string const& proj4_str ) 
+    : m_proj4_str(proj4_str), m_owner_thread(Thread::id()),
+      m_thread_table(new detail::ProjThreadTable()) {
+    init(m_proj_ctx_ptr, m_proj_ptr);
+  }
+
+  ProjContext::ProjContext( ProjContext const& other ) 
+    : m_proj4_str(other.m_proj4_str), m_owner_thread(Thread::id()),
+      m_thread_table(new detail::ProjThreadTable()) {
+    if ( m_proj4_str.empty() ) {
+      m_proj_ctx_ptr.reset(pj_ctx_alloc(),pj_ctx_free);
       return; // They've made a copy of an uninitialized
               // projcontext. Not an error .. since they can
               // initialize later.
+    }
 
-    int num;
-    char** proj_strings = split_proj4_string(m_proj4_str, num);
-    m_proj_ptr.reset(pj_init_ctx( m_proj_ctx_ptr.get(),
-                                  num, proj_strings ),
-                     pj_free);
+    init(m_proj_ctx_ptr, m_proj_ptr);
+  }
 
-    VW_ASSERT( !pj_ctx_get_errno(m_proj_ctx_ptr.get()),
-               InputErr() << "Proj.4 failed to initialize on string: " << m_proj4_str << "\n\tError was: " 
-                          << pj_strerrno(pj_ctx_get_errno(m_proj_ctx_ptr.get())) );
+  void ProjContext::thread_ptrs(void*& ctx, void*& proj) const {
+    VW_ASSERT( !m_proj4_str.empty(),
+               ArgumentErr() << "ProjContext: Projection not initialized." );
+    uint64 id = Thread::id();
+    if (id == m_owner_thread) {
+      ctx  = m_proj_ctx_ptr.get();
+      proj = m_proj_ptr.get();
+      return;
+    }
 
-    for ( int i = 0; i < num; i++ )
-      delete [] proj_strings[i];
-    delete [] proj_strings;
+    if (m_thread_table->find(ctx, proj))
+      return;
+
+    // First use from this thread
+    boost::shared_ptr<void> new_ctx, new_proj;
+    init(new_ctx, new_proj);
+    m_thread_table->insert(new_ctx, new_proj);
+    ctx  = new_ctx.get();
+    proj = new_proj.get();
+  }
+
+  void* ProjContext::proj_ptr() const {
+    void *ctx, *proj;
+    thread_ptrs(ctx, proj);
+    return proj;
+  }
+
+  void* ProjContext::thread_ctx_ptr() const {
+    void *ctx, *proj;
+    if (m_thread_table && Thread::id() != m_owner_thread && m_thread_table->find(ctx, proj))
+      return ctx;
+    return m_proj_ctx_ptr.get();
   }
 
   int ProjContext::error_no() const {
-    return pj_ctx_get_errno(m_proj_ctx_ptr.get());
+    return pj_ctx_get_errno(thread_ctx_ptr());
   }
 
 //************** End functions for class ProjContext ******************
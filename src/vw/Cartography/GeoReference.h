@@ -24,6 +24,7 @@
 #include <vw/Cartography/Datum.h>
 #include <vw/FileIO/DiskImageResource.h>
 #include <vw/Core/Exception.h>
+#include <vw/Core/Thread.h>
 
 // Boost
 #include <boost/algorithm/string.hpp>
@@ -41,31 +42,48 @@ namespace cartography {
   VW_DEFINE_EXCEPTION(ProjectionErr, ArgumentErr);
 
 
+  namespace detail {
+    class ProjThreadTable; // Projections owned by other threads
+  }
+
   // Here is some machinery to keep track of an initialized proj.4
   // projection context using a smart pointer.
+  // - A proj.4 context must not be used by two threads at once, so
+  //   every thread other than the one which created this object is
+  //   transparently given its own context, freed when that thread exits.
   class ProjContext {
     boost::shared_ptr<void> m_proj_ctx_ptr;
     boost::shared_ptr<void> m_proj_ptr;
     std::string             m_proj4_str;
+    uint64                  m_owner_thread; ///< The thread m_proj_ptr belongs to
+    boost::shared_ptr<detail::ProjThreadTable> m_thread_table;
 
     /// 
-    char** split_proj4_string(std::string const& proj4_str, int &num_strings);
+    char** split_proj4_string(std::string const& proj4_str, int &num_strings) const;
+
+    /// Create a context and a projection from m_proj4_str.
+    void init(boost::shared_ptr<void> & ctx, boost::shared_ptr<void> & proj) const;
+
+    /// Return the context used by the calling thread.
+    void* thread_ctx_ptr() const;
 
   public:
 
-    ProjContext() : m_proj4_str("") {};
+    ProjContext() : m_proj4_str(""), m_owner_thread(0) {};
     ProjContext(std::string const& proj4_str);
     ProjContext(ProjContext const& other );
 
-    inline void* proj_ptr() const {
-      VW_ASSERT( !m_proj4_str.empty(),
-                 ArgumentErr() << "ProjContext: Projection not initialized." );
-      return m_proj_ptr.get();
-    }
+    /// Return the projection to be used by the calling thread.
+    void* proj_ptr() const;
+
+    /// Return the context and projection of the calling thread with a
+    /// single lookup, for loops that check errors after every point.
+    void thread_ptrs(void*& ctx, void*& proj) const;
     
     /// Return true if the proj4 string has been loaded.
     bool is_initialized() const {return(!m_proj4_str.empty());}
 
+    /// The last error in the calling thread's context.
     int error_no() const;
   };
 
@@ -335,6 +353,16 @@ namespace cartography {
       return point_to_pixel(lonlat_to_point(lat_lon));
     }
 
+    // Batch versions of the conversions above. These find the projection
+    // for the calling thread only once, so they should be preferred when
+    // converting many points, such as a row of an image. Points that fail
+    // to convert are set to NaN instead of throwing.
+
+    void point_to_lonlat(std::vector<Vector2> const& points,  std::vector<Vector2> & lonlats) const;
+    void lonlat_to_point(std::vector<Vector2> const& lonlats, std::vector<Vector2> & points ) const;
+    void pixel_to_lonlat(std::vector<Vector2> const& pixels,  std::vector<Vector2> & lonlats) const;
+    void lonlat_to_pixel(std::vector<Vector2> const& lonlats, std::vector<Vector2> & pixels ) const;
+
     /// For a given pixel bbox, return the corresponding bbox in projected space
     BBox2  pixel_to_point_bbox(BBox2i const& pixel_bbox) const;
 
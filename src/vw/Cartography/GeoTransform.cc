@@ -38,7 +38,7 @@ namespace cartography {
   GeoTransform::GeoTransform(GeoReference const& src_georef, GeoReference const& dst_georef,
                              BBox2 const& src_bbox, BBox2 const& dst_bbox) :
     m_src_georef(src_georef), m_dst_georef(dst_georef),
-    m_src_bbox(src_bbox), m_dst_bbox(dst_bbox) {
+    m_src_bbox(src_bbox), m_dst_bbox(dst_bbox), m_affine_only(false) {
     
     const std::string src_datum = m_src_georef.datum().proj4_str();
     const std::string dst_datum = m_dst_georef.datum().proj4_str();
@@ -73,6 +73,29 @@ namespace cartography {
       ss_dst << "+proj=longlat " << dst_datum;
       m_dst_datum_proj = ProjContext( ss_dst.str() );
     }
+
+    // If the projections match and neither georeference has a perspective
+    // component, pixel to pixel conversion is affine. Find the map in each
+    // direction from the images of the origin and the unit vectors.
+    Matrix3x3 const& src_t = m_src_georef.transform();
+    Matrix3x3 const& dst_t = m_dst_georef.transform();
+    if (m_skip_map_projection &&
+        src_t(2,0) == 0 && src_t(2,1) == 0 && src_t(2,2) == 1 &&
+        dst_t(2,0) == 0 && dst_t(2,1) == 0 && dst_t(2,2) == 1) {
+      m_affine_only = true;
+      for (int k = 0; k < 2; k++) {
+        Matrix3x3 & A = (k == 0) ? m_forward_affine : m_reverse_affine;
+        GeoReference const& from = (k == 0) ? m_src_georef : m_dst_georef;
+        GeoReference const& to   = (k == 0) ? m_dst_georef : m_src_georef;
+        Vector2 o  = to.point_to_pixel(from.pixel_to_point(Vector2(0,0)));
+        Vector2 ex = to.point_to_pixel(from.pixel_to_point(Vector2(1,0))) - o;
+        Vector2 ey = to.point_to_pixel(from.pixel_to_point(Vector2(0,1))) - o;
+        A.set_identity();
+        A(0,0) = ex[0]; A(0,1) = ey[0]; A(0,2) = o[0];
+        A(1,0) = ex[1]; A(1,1) = ey[1]; A(1,2) = o[1];
+      }
+    }
+
     // Because GeoTransform is typically very slow, we default to a tolerance
     // of 0.1 pixels to allow ourselves to be approximated.
     set_tolerance( 0.1 );
@@ -85,15 +108,23 @@ namespace cartography {
   GeoTransform& GeoTransform::operator=(GeoTransform const& other) {
     m_src_georef            = other.m_src_georef;
     m_dst_georef            = other.m_dst_georef;
+    m_src_bbox              = other.m_src_bbox;
+    m_dst_bbox              = other.m_dst_bbox;
     m_src_datum_proj        = other.m_src_datum_proj;
     m_dst_datum_proj        = other.m_dst_datum_proj;
     m_skip_map_projection   = other.m_skip_map_projection;
     m_skip_datum_conversion = other.m_skip_datum_conversion;
+    m_affine_only           = other.m_affine_only;
+    m_forward_affine        = other.m_forward_affine;
+    m_reverse_affine        = other.m_reverse_affine;
+    set_tolerance( other.tolerance() );
     return *this;
   }
 
 
   Vector2 GeoTransform::reverse(Vector2 const& v) const {
+    if (m_affine_only)
+      return apply_affine(m_reverse_affine, v);
     if (m_skip_map_projection)
       return m_src_georef.point_to_pixel(m_dst_georef.pixel_to_point(v));
     Vector2 dst_lonlat = m_dst_georef.pixel_to_lonlat(v);
@@ -105,6 +136,8 @@ namespace cartography {
 
 
   Vector2 GeoTransform::pixel_to_pixel(Vector2 const& v) const {
+    if (m_affine_only)
+      return apply_affine(m_forward_affine, v);
     if (m_skip_map_projection)
       return m_dst_georef.point_to_pixel(m_src_georef.pixel_to_point(v));
     Vector2 src_lonlat = m_src_georef.pixel_to_lonlat(v);
@@ -119,14 +152,14 @@ namespace cartography {
 
     if (bbox.empty()) return BBox2();
 
-    std::vector<vw::Vector2> points;
+    std::vector<vw::Vector2> points, out;
     gen_bd_and_diag_pts(bbox, points);
+    pixel_to_pixel(points, out);
     
     BBox2 r;
-    for (size_t ptiter = 0; ptiter < points.size(); ptiter++) {
-      try {
-        r.grow( this->forward( points[ptiter] ) );
-      }catch ( const std::exception & e ) {}
+    for (size_t ptiter = 0; ptiter < out.size(); ptiter++) {
+      if (out[ptiter] == out[ptiter]) // Skip NaN
+        r.grow( out[ptiter] );
     }
 
     return grow_bbox_to_int(r);
@@ -135,14 +168,14 @@ namespace cartography {
   BBox2i GeoTransform::reverse_bbox( BBox2i const& bbox ) const {
     if (bbox.empty()) return BBox2();
 
-    std::vector<vw::Vector2> points;
+    std::vector<vw::Vector2> points, out;
     gen_bd_and_diag_pts(bbox, points);
+    reverse(points, out);
 
     BBox2 r;
-    for (size_t ptiter = 0; ptiter < points.size(); ptiter++) {
-      try {
-        r.grow( this->reverse( points[ptiter] ) );
-      }catch ( const std::exception & e ) {}
+    for (size_t ptiter = 0; ptiter < out.size(); ptiter++) {
+      if (out[ptiter] == out[ptiter]) // Skip NaN
+        r.grow( out[ptiter] );
     }
 
     return grow_bbox_to_int(r);
@@ -190,8 +223,6 @@ namespace cartography {
     double lat = lonlat[1] * DEG_TO_RAD;
     double alt = 0;
 
-    Mutex::WriteLock write_lock(m_mutex);
-
     if(forward) // src to dst
       pj_transform(m_src_datum_proj.proj_ptr(), m_dst_datum_proj.proj_ptr(), 1, 0, &lon, &lat, &alt);
     else // dst to src
@@ -210,8 +241,6 @@ namespace cartography {
     double lat = lonlatalt[1] * DEG_TO_RAD;
     double alt = lonlatalt[2];
 
-    Mutex::WriteLock write_lock(m_mutex);
-
     if(forward) // src to dst
       pj_transform(m_src_datum_proj.proj_ptr(), m_dst_datum_proj.proj_ptr(), 1, 0, &lon, &lat, &alt);
     else // dst to src
@@ -222,6 +251,109 @@ namespace cartography {
     return Vector3(lon*RAD_TO_DEG, lat*RAD_TO_DEG, alt);
   }
 
+  void GeoTransform::pixel_to_pixel(std::vector<Vector2> const& pixels,
+                                    std::vector<Vector2> & out) const {
+    if (m_affine_only) {
+      out.resize(pixels.size());
+      for (size_t i = 0; i < pixels.size(); i++)
+        out[i] = apply_affine(m_forward_affine, pixels[i]);
+      return;
+    }
+    if (m_skip_map_projection) {
+      out.resize(pixels.size());
+      for (size_t i = 0; i < pixels.size(); i++)
+        out[i] = m_dst_georef.point_to_pixel(m_src_georef.pixel_to_point(pixels[i]));
+      return;
+    }
+    std::vector<Vector2> lonlats;
+    m_src_georef.pixel_to_lonlat(pixels, lonlats);
+    if (!m_skip_datum_conversion)
+      lonlat_to_lonlat(lonlats, lonlats, true);
+    m_dst_georef.lonlat_to_pixel(lonlats, out);
+  }
+
+  void GeoTransform::reverse(std::vector<Vector2> const& pixels,
+                             std::vector<Vector2> & out) const {
+    if (m_affine_only) {
+      out.resize(pixels.size());
+      for (size_t i = 0; i < pixels.size(); i++)
+        out[i] = apply_affine(m_reverse_affine, pixels[i]);
+      return;
+    }
+    if (m_skip_map_projection) {
+      out.resize(pixels.size());
+      for (size_t i = 0; i < pixels.size(); i++)
+        out[i] = m_src_georef.point_to_pixel(m_dst_georef.pixel_to_point(pixels[i]));
+      return;
+    }
+    std::vector<Vector2> lonlats;
+    m_dst_georef.pixel_to_lonlat(pixels, lonlats);
+    if (!m_skip_datum_conversion)
+      lonlat_to_lonlat(lonlats, lonlats, false);
+    m_src_georef.lonlat_to_pixel(lonlats, out);
+  }
+
+  void GeoTransform::reverse_row(int32 row, int32 col, int32 count,
+                                 double* xs, double* ys) const {
+    std::vector<Vector2> pixels(count), out;
+    for (int32 i = 0; i < count; i++)
+      pixels[i] = Vector2(col + i, row);
+    reverse(pixels, out);
+    for (int32 i = 0; i < count; i++) {
+      // The batch version gives NaN where the single point one throws,
+      // redo those points so the results are the same as reverse().
+      if (out[i] != out[i])
+        out[i] = reverse(pixels[i]);
+      xs[i] = out[i].x();
+      ys[i] = out[i].y();
+    }
+  }
+
+  void GeoTransform::lonlat_to_lonlat(std::vector<Vector2> const& lonlats,
+                                      std::vector<Vector2> & out, bool forward) const {
+    if (&out != &lonlats)
+      out = lonlats;
+    if (m_skip_datum_conversion)
+      return;
+
+    // Convert the whole array with one call to proj4
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t n = out.size();
+    std::vector<double> lon(n), lat(n), alt(n, 0.0);
+    for (size_t i = 0; i < n; i++) {
+      lon[i] = out[i][0] * DEG_TO_RAD; // proj4 requires radians
+      lat[i] = out[i][1] * DEG_TO_RAD;
+    }
+
+    void* src_proj = forward ? m_src_datum_proj.proj_ptr() : m_dst_datum_proj.proj_ptr();
+    void* dst_proj = forward ? m_dst_datum_proj.proj_ptr() : m_src_datum_proj.proj_ptr();
+    int err = 0;
+    if (n > 0)
+      err = pj_transform(src_proj, dst_proj, long(n), 0, &lon[0], &lat[0], &alt[0]);
+
+    // Some errors abort the whole call, leaving the output partially
+    // converted. In that case convert the points one at a time, so that
+    // only the ones which fail are lost.
+    if (err != 0) {
+      for (size_t i = 0; i < n; i++) {
+        lon[i] = out[i][0] * DEG_TO_RAD;
+        lat[i] = out[i][1] * DEG_TO_RAD;
+        alt[i] = 0;
+        if (pj_transform(src_proj, dst_proj, 1, 0, &lon[i], &lat[i], &alt[i]) != 0)
+          lon[i] = lat[i] = HUGE_VAL;
+      }
+    }
+
+    // Single points which fail are flagged with HUGE_VAL, and NaN input
+    // stays NaN.
+    for (size_t i = 0; i < n; i++) {
+      if (lon[i] == HUGE_VAL || lat[i] == HUGE_VAL)
+        out[i] = Vector2(nan, nan);
+      else
+        out[i] = Vector2(lon[i]*RAD_TO_DEG, lat[i]*RAD_TO_DEG);
+    }
+  }
+
 
   bool GeoTransform::check_bbox_wraparound() const {
 
@@ -405,18 +537,27 @@ namespace cartography {
 
     GeoTransform gtx(src_georef, dst_georef);
 
-    // Iterate over the image, transforming the first two coordinates
-    // in the Vector one at a time.  The third coordinate is taken to
+    // Iterate over the image a row at a time, transforming the first
+    // two coordinates in the Vector.  The third coordinate is taken to
     // be the altitude value, and this value is not touched.
+    std::vector<Vector2> in, out;
+    std::vector<int32>   cols;
     for (int32 j=0; j < point_image.rows(); ++j) {
+      in.clear();
+      cols.clear();
       for (int32 i=0; i < point_image.cols(); ++i) {
         if (point_image(i,j) != Vector3()) {
-          Vector2 in(point_image(i,j)[0], point_image(i,j)[1]);
-          Vector2 out = gtx.forward(in);
-          point_image(i,j).x() = out[0];
-          point_image(i,j).y() = out[1];
+          in.push_back(Vector2(point_image(i,j)[0], point_image(i,j)[1]));
+          cols.push_back(i);
         }
       }
+      gtx.pixel_to_pixel(in, out);
+      for (size_t k = 0; k < cols.size(); ++k) {
+        if (out[k] != out[k])
+          vw_throw(ProjectionErr() << "Bad projection in reproject_point_image at " << in[k] << ".");
+        point_image(cols[k],j).x() = out[k][0];
+        point_image(cols[k],j).y() = out[k][1];
+      }
     }
   }
 }} // namespace vw::cartography
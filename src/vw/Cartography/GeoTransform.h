@@ -21,8 +21,8 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 
-#include <vw/Core/Thread.h>
 #include <vw/Math/Vector.h>
 #include <vw/Image/Transform.h>
 #include <vw/Cartography/GeoReference.h>
@@ -50,12 +50,24 @@ namespace cartography {
                   m_dst_datum_proj;
     bool          m_skip_map_projection;
     bool          m_skip_datum_conversion;
-    mutable Mutex m_mutex; // Used to control access to the ProjContext objects
+
+    /// If both georeferences use the same projection and purely affine
+    /// transforms, pixel to pixel conversion is a single affine map and
+    /// proj.4 is never called.
+    bool          m_affine_only;
+    Matrix3x3     m_forward_affine, m_reverse_affine;
+
+    /// Apply one of the affine maps above.
+    static Vector2 apply_affine(Matrix3x3 const& A, Vector2 const& v) {
+      return Vector2(A(0,0)*v[0] + A(0,1)*v[1] + A(0,2),
+                     A(1,0)*v[0] + A(1,1)*v[1] + A(1,2));
+    }
 
   public:
   
     /// Default constructor, does not generate a usable object.
-    GeoTransform() {}
+    GeoTransform() : m_skip_map_projection(false), m_skip_datum_conversion(false),
+                     m_affine_only(false) {}
 
     GeoTransform(GeoTransform const& other);
 
@@ -112,6 +124,26 @@ namespace cartography {
     /// - The parameter 'forward' specifies whether we convert forward (true) or reverse (false).
     Vector3 lonlatalt_to_lonlatalt(Vector3 const& lonlatalt, bool forward=true) const;
 
+    // Batch versions of the conversions above, for converting many points
+    // such as a row of an image. Unlike the single point versions these
+    // do not throw, points that fail to convert are set to NaN instead.
+    // - These are safe to call from several threads at once.
+
+    /// Batch version of pixel_to_pixel(), same as forward().
+    void pixel_to_pixel(std::vector<Vector2> const& pixels, std::vector<Vector2> & out) const;
+
+    /// Batch version of reverse().
+    void reverse(std::vector<Vector2> const& pixels, std::vector<Vector2> & out) const;
+
+    /// Compute reverse() for count pixels of a destination row starting
+    /// at (col,row) with the batch version above. This is used by
+    /// TransformView, see HasReverseRow.
+    void reverse_row(int32 row, int32 col, int32 count, double* xs, double* ys) const;
+
+    /// Batch version of lonlat_to_lonlat().
+    void lonlat_to_lonlat(std::vector<Vector2> const& lonlats, std::vector<Vector2> & out,
+                          bool forward=true) const;
+
     /// Returns true if bounding box conversions wrap around the output
     ///  georeference, creating a very large bounding box.
     bool check_bbox_wraparound() const;
@@ -251,6 +283,11 @@ namespace cartography {
                              GeoReference const& src_georef,
                              GeoReference const& dst_georef);
 
-}} // namespace vw::cartography
+} // namespace cartography
+
+  template <>
+  struct HasReverseRow<cartography::GeoTransform> : public true_type {};
+
+} // namespace vw
 
 #endif // __GEO_TRANSFORM_H__
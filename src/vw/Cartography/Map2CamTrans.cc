@@ -16,21 +16,158 @@
 // __END_LICENSE__
 
 
+#include <vw/Core/System.h>
+#include <vw/Core/Thread.h>
 #include <vw/Cartography/PointImageManipulation.h>
 #include <vw/Cartography/GeoTransform.h>
 #include <vw/Cartography/Map2CamTrans.h>
 #include <vw/Image/MaskViews.h>
 #include <vw/Camera/CameraModel.h>
 
+#include <boost/thread/tss.hpp>
+
 namespace vw { namespace cartography {
 
+  namespace detail {
+
+    /// Reads one block of the DEM into memory. The block is padded on
+    /// each side so that any point in it can be interpolated without
+    /// touching a neighboring block.
+    class DemBlockGenerator {
+      DiskImageView<float> m_dem;
+      BBox2i               m_bbox;
+    public:
+      typedef ImageView<float> value_type;
+
+      DemBlockGenerator( DiskImageView<float> const& dem, BBox2i const& bbox )
+        : m_dem(dem), m_bbox(bbox) {}
+
+      size_t size() const {
+        return m_bbox.width() * m_bbox.height() * sizeof(float);
+      }
+
+      boost::shared_ptr<value_type> generate() const {
+        boost::shared_ptr<value_type> ptr( new value_type( m_bbox.width(), m_bbox.height() ) );
+        m_dem.rasterize( *ptr, m_bbox );
+        return ptr;
+      }
+    }; // End class DemBlockGenerator
+
+    /// The DEM block one call is interpolating into. The block is read
+    /// through its cache handle, which stays locked until the sampler
+    /// moves to another block or goes out of scope, so no DEM data is
+    /// kept outside the cache between calls.
+    struct DemSampler {
+      Cache::Handle<DemBlockGenerator> const* handle;
+      Vector2i                        block;
+      BBox2i                          block_box;
+      ImageViewRef<PixelMask<float> > interp_dem;
+
+      DemSampler() : handle(0), block(-1, -1) {}
+      ~DemSampler() { release(); }
+
+      void release() {
+        interp_dem = ImageViewRef<PixelMask<float> >();
+        if ( handle )
+          handle->release();
+        handle = 0;
+        block  = Vector2i(-1, -1);
+      }
+    };
+
+    /// The last tile a thread passed to reverse_bbox() and its camera
+    /// pixels.
+    struct Map2CamTransScratch {
+      uint64                            owner; // The Map2CamTransCache it belongs to
+      BBox2i                            input_box, output_box, img_cache_box;
+      bool                              has_output;
+      ImageView<Vector2>                cache;
+      ImageViewRef<PixelMask<Vector2> > cache_interp_mask;
+
+      Map2CamTransScratch( uint64 owner ) : owner(owner), has_output(false) {}
+    };
+
+    /// A number for each Map2CamTransCache, never reused.
+    uint64 next_cache_id() {
+      static Mutex  mutex;
+      static uint64 next_id = 0;
+      Mutex::Lock lock( mutex );
+      return next_id++;
+    }
+
+    /// The state shared by all copies of a Map2CamTrans: a table of
+    /// cached DEM blocks, and one scratch object per thread.
+    class Map2CamTransCache {
+      typedef Cache::Handle<DemBlockGenerator> handle_type;
+
+      int                      m_block_size, m_table_width, m_table_height;
+      std::vector<handle_type> m_blocks;
+      std::vector<BBox2i>      m_bboxes;
+
+      // Each thread's scratch is deleted when the thread exits.
+      uint64 m_id;
+      boost::thread_specific_ptr<Map2CamTransScratch> m_scratch;
+
+    public:
+      Map2CamTransCache( Cache & cache, DiskImageView<float> const& dem,
+                         int pixel_buffer, int block_size = 256 )
+        : m_block_size(block_size), m_id(next_cache_id()) {
+
+        m_table_width  = (dem.cols()-1) / m_block_size + 1;
+        m_table_height = (dem.rows()-1) / m_block_size + 1;
+        m_blocks.reserve( m_table_width * m_table_height );
+        m_bboxes.reserve( m_table_width * m_table_height );
+        for ( int iy = 0; iy < m_table_height; iy++ ) {
+          for ( int ix = 0; ix < m_table_width; ix++ ) {
+            BBox2i bbox( ix*m_block_size, iy*m_block_size, m_block_size, m_block_size );
+            bbox.expand( pixel_buffer + 1 );
+            bbox.crop( bounding_box(dem) );
+            m_blocks.push_back( cache.insert( DemBlockGenerator( dem, bbox ) ) );
+            m_bboxes.push_back( bbox );
+          }
+        }
+      }
+
+      /// The block containing the given DEM pixel, clamped to the table.
+      Vector2i block_index( Vector2 const& dem_pix ) const {
+        int ix = int(floor(dem_pix[0])) / m_block_size;
+        int iy = int(floor(dem_pix[1])) / m_block_size;
+        return Vector2i( std::max(0, std::min(ix, m_table_width -1)),
+                         std::max(0, std::min(iy, m_table_height-1)) );
+      }
+
+      handle_type const& block( Vector2i const& index ) const {
+        return m_blocks[ index[1]*m_table_width + index[0] ];
+      }
+
+      /// The region of the DEM held by a block, including the padding.
+      BBox2i const& block_bbox( Vector2i const& index ) const {
+        return m_bboxes[ index[1]*m_table_width + index[0] ];
+      }
+
+      /// Return the scratch data belonging to the calling thread. A
+      /// thread may still hold the scratch of an earlier cache that
+      /// lived at the same address, which is replaced.
+      Map2CamTransScratch& scratch() {
+        Map2CamTransScratch* ptr = m_scratch.get();
+        if ( !ptr || ptr->owner != m_id ) {
+          ptr = new Map2CamTransScratch( m_id );
+          m_scratch.reset( ptr );
+        }
+        return *ptr;
+      }
+    }; // End class Map2CamTransCache
+
+  } // namespace detail
+
   Map2CamTrans::Map2CamTrans( vw::camera::CameraModel const* cam,
                               GeoReference const& image_georef,
                               GeoReference const& dem_georef,
                               std::string const& dem_file,
                               vw::Vector2i const& image_size,
                               bool call_from_mapproject,
-                              bool nearest_neighbor):
+                              bool nearest_neighbor,
+                              Cache * dem_cache):
     m_cam(cam), m_image_georef(image_georef), m_dem_georef(dem_georef),
     m_dem(dem_file), m_image_size(image_size),
     m_call_from_mapproject(call_from_mapproject), 
@@ -44,21 +181,46 @@ namespace vw { namespace cartography {
     if (m_has_nodata) m_nodata = dem_rsrc->nodata_read();
 
     m_invalid_pix = vw::camera::CameraModel::invalid_pixel();
+
+    int b = BicubicInterpolation::pixel_buffer;
+    if (m_nearest_neighbor)
+      b = NearestPixelInterpolation::pixel_buffer;
+    if (!dem_cache)
+      dem_cache = &vw_system_cache();
+    m_cache.reset( new detail::Map2CamTransCache(*dem_cache, m_dem, b) );
   }
 
   vw::Vector2
   Map2CamTrans::reverse(const vw::Vector2 &p) const {
 
+    detail::Map2CamTransScratch & scratch = m_cache->scratch();
+
     // If we have data for the location already cached
-    if (m_img_cache_box.contains(p)){
+    if (scratch.img_cache_box.contains(p)){
       // Interpolate the output value using the cached data
-      PixelMask<Vector2> v = m_cache_interp_mask(p.x() - m_img_cache_box.min().x(),
-                                                 p.y() - m_img_cache_box.min().y());
+      PixelMask<Vector2> v
+        = scratch.cache_interp_mask(p.x() - scratch.img_cache_box.min().x(),
+                                    p.y() - scratch.img_cache_box.min().y());
       // We can just return the value if it is valid!
       if (is_valid(v)) return v.child();
       else             return m_invalid_pix;
     }
 
+    detail::DemSampler sampler;
+    Vector3 xyz;
+    if (!dem_point(sampler, p, xyz))
+      return m_invalid_pix;
+
+    try{
+      return checked_camera_pixel(m_cam->point_to_pixel(xyz));
+    }catch(...){ // If a point failed to project
+      return m_invalid_pix;
+    }
+  }
+
+  bool Map2CamTrans::dem_point(detail::DemSampler & sampler,
+                               const vw::Vector2 &p, vw::Vector3 & xyz) const {
+
     int b = BicubicInterpolation::pixel_buffer;
     if (m_nearest_neighbor)
       b = NearestPixelInterpolation::pixel_buffer;
@@ -68,42 +230,57 @@ namespace vw { namespace cartography {
         (dem_pix[1] < b - 1) || (dem_pix[1] >= m_dem.rows() - b)
         ){
       // No DEM data
-      return m_invalid_pix;
+      return false;
     }
 
-    Vector2 sdem_pix = dem_pix - m_dem_cache_box.min(); // since we cropped the DEM
-    if (m_dem_cache_box.empty() ||
-        (sdem_pix[0] < b - 1) || (sdem_pix[0] >= m_cropped_dem.cols() - b) ||
-        (sdem_pix[1] < b - 1) || (sdem_pix[1] >= m_cropped_dem.rows() - b)
-        ){
-      // Cache miss. Will not happen often.
-      BBox2i box;
-      box.min() = floor(p) - Vector2(1, 1);
-      box.max() = ceil(p)  + Vector2(1, 1);
-      cache_dem(box);
-      return reverse(p);
+    // Switch to the DEM block holding this pixel. Neighboring pixels
+    // are usually in the same block, so this does not happen often.
+    Vector2i block = m_cache->block_index(dem_pix);
+    if (block != sampler.block){
+      sampler.release();
+      sampler.handle    = &m_cache->block(block);
+      sampler.block     = block;
+      sampler.block_box = m_cache->block_bbox(block);
+      ImageView<float> const& dem_tile = **sampler.handle; // Locked until released
+
+      ImageViewRef<PixelMask<float> > masked_dem;
+      if (m_has_nodata){
+        masked_dem = create_mask(dem_tile, m_nodata);
+      }else{ // Don't need to handle nodata
+        masked_dem = pixel_cast< PixelMask<float> >(dem_tile);
+      }
+      // Set up interpolation interface to the data we loaded into memory
+      if (m_nearest_neighbor)
+        sampler.interp_dem = interpolate(masked_dem, NearestPixelInterpolation(), ZeroEdgeExtension());
+      else
+        sampler.interp_dem = interpolate(masked_dem, BicubicInterpolation(), ZeroEdgeExtension());
     }
 
-    PixelMask<float> h = m_interp_dem(sdem_pix[0], sdem_pix[1]);
+    Vector2 sdem_pix = dem_pix - sampler.block_box.min();
+    PixelMask<float> h = sampler.interp_dem(sdem_pix[0], sdem_pix[1]);
     if (!is_valid(h))
-      return m_invalid_pix;
+      return false;
 
-    Vector3 xyz = m_dem_georef.datum().geodetic_to_cartesian
+    xyz = m_dem_georef.datum().geodetic_to_cartesian
       (Vector3(lonlat[0], lonlat[1], h.child()));
-    Vector2 pt;
-    try{
-      pt = m_cam->point_to_pixel(xyz);
-      if ( m_call_from_mapproject &&
-           (pt[0] < b - 1 || pt[0] >= m_image_size[0] - b ||
-            pt[1] < b - 1 || pt[1] >= m_image_size[1] - b)
-           ){
-        // Won't be able to interpolate into image in transform(...)
-        return m_invalid_pix;
-      }
-    }catch(...){ // If a point failed to project
+    return true;
+  }
+
+  vw::Vector2 Map2CamTrans::checked_camera_pixel(vw::Vector2 const& pt) const {
+
+    if (pt == m_invalid_pix)
       return m_invalid_pix;
-    }
 
+    int b = BicubicInterpolation::pixel_buffer;
+    if (m_nearest_neighbor)
+      b = NearestPixelInterpolation::pixel_buffer;
+    if ( m_call_from_mapproject &&
+         (pt[0] < b - 1 || pt[0] >= m_image_size[0] - b ||
+          pt[1] < b - 1 || pt[1] >= m_image_size[1] - b)
+         ){
+      // Won't be able to interpolate into image in transform(...)
+      return m_invalid_pix;
+    }
     return pt;
   }
 
@@ -120,55 +297,74 @@ namespace vw { namespace cartography {
     // A lot of care is needed here when going from real box to int
     // box, and if in doubt, better expand more rather than less.
     dbox.expand(1);
-    m_dem_cache_box = grow_bbox_to_int(dbox);
-    if (m_nearest_neighbor)
-      m_dem_cache_box.expand(NearestPixelInterpolation::pixel_buffer); // for interp
-    else
-      m_dem_cache_box.expand(BicubicInterpolation::pixel_buffer); // for interp
-    m_dem_cache_box.crop(bounding_box(m_dem));
-
-    // Read the dem in memory for speed in the region of the expanded bounding box.
-    m_cropped_dem = crop(m_dem, m_dem_cache_box);
-
-    if (m_has_nodata){
-      m_masked_dem = create_mask(m_cropped_dem, m_nodata);
-    }else{ // Don't need to handle nodata
-      m_masked_dem = pixel_cast< PixelMask<float> >(m_cropped_dem);
+    BBox2i dem_box = grow_bbox_to_int(dbox);
+    dem_box.crop(bounding_box(m_dem));
+    if (dem_box.empty())
+      return;
+
+    // Touch each block so that it is read into the cache now.
+    Vector2i first = m_cache->block_index(dem_box.min());
+    Vector2i last  = m_cache->block_index(dem_box.max() - Vector2i(1, 1));
+    for (int iy = first[1]; iy <= last[1]; iy++){
+      for (int ix = first[0]; ix <= last[0]; ix++){
+        Cache::Handle<detail::DemBlockGenerator> const& handle
+          = m_cache->block(Vector2i(ix, iy));
+        *handle;
+        handle.release();
+      }
     }
-    // Set up interpolation interface to the data we loaded into memory
-    if (m_nearest_neighbor)
-      m_interp_dem = interpolate(m_masked_dem, NearestPixelInterpolation(), ZeroEdgeExtension());
-    else
-      m_interp_dem = interpolate(m_masked_dem, BicubicInterpolation(), ZeroEdgeExtension());
-
   } // End function cache_dem
 
   // This function will be called whenever we start to apply the
-  // transform in a tile. It computes and caches the point cloud at
+  // transform in a tile. It computes and caches the camera pixel at
   // each pixel in the tile, to be used later when we iterate over pixels.
   vw::BBox2i
   Map2CamTrans::reverse_bbox( vw::BBox2i const& bbox ) const {
 
-    // Custom reverse_bbox() function which can handle invalid pixels.
-    if (!m_cached_rv_box.empty()) return m_cached_rv_box;
+    detail::Map2CamTransScratch & scratch = m_cache->scratch();
 
-    cache_dem(bbox);
+    // Custom reverse_bbox() function which can handle invalid pixels.
+    if (scratch.has_output && scratch.input_box == bbox)
+      return scratch.output_box;
 
     // Cache the reverse transform
 
-    m_img_cache_box = BBox2i();
+    scratch.img_cache_box = BBox2i();
     BBox2i local_cache_box = bbox;
     if (m_nearest_neighbor)
       local_cache_box.expand(NearestPixelInterpolation::pixel_buffer); // for interpolation
     else
       local_cache_box.expand(BicubicInterpolation::pixel_buffer); // for interpolation
-    
-    m_cache.set_size(local_cache_box.width(), local_cache_box.height());
+
+    // Allocate fresh memory, since an earlier prerasterized view may
+    // still be reading from the previous tile's cache.
+    scratch.cache = ImageView<Vector2>(local_cache_box.width(), local_cache_box.height());
     vw::BBox2 out_box;
+
+    // Find the DEM points for a whole row, then project them into the
+    // camera with one batch call.
+    detail::DemSampler   sampler;
+    std::vector<Vector3> xyz_row;
+    std::vector<int32>   col_row;
+    std::vector<Vector2> pix_row;
     for( int32 y=local_cache_box.min().y(); y<local_cache_box.max().y(); ++y ){
+      xyz_row.clear();
+      col_row.clear();
       for( int32 x=local_cache_box.min().x(); x<local_cache_box.max().x(); ++x ){
-        Vector2 p = reverse( Vector2(x,y) );
-        m_cache(x - local_cache_box.min().x(), y - local_cache_box.min().y()) = p;
+        scratch.cache(x - local_cache_box.min().x(), y - local_cache_box.min().y()) = m_invalid_pix;
+        Vector3 xyz;
+        if (!dem_point(sampler, Vector2(x,y), xyz))
+          continue;
+        xyz_row.push_back(xyz);
+        col_row.push_back(x);
+      }
+
+      m_cam->points_to_pixels(xyz_row, pix_row);
+
+      for (size_t i = 0; i < pix_row.size(); i++) {
+        int32   x = col_row[i];
+        Vector2 p = checked_camera_pixel(pix_row[i]);
+        scratch.cache(x - local_cache_box.min().x(), y - local_cache_box.min().y()) = p;
         if (p == m_invalid_pix) continue;
         if (bbox.contains(Vector2i(x, y))) out_box.grow( p );
       }
@@ -176,22 +372,24 @@ namespace vw { namespace cartography {
     out_box = grow_bbox_to_int( out_box );
 
     // Must happen after all calls to reverse finished.
-    m_img_cache_box = local_cache_box;
+    scratch.img_cache_box = local_cache_box;
 
     if (m_nearest_neighbor)
-      m_cache_interp_mask = interpolate(create_mask(m_cache, m_invalid_pix),
-                                        NearestPixelInterpolation(), ZeroEdgeExtension());
+      scratch.cache_interp_mask = interpolate(create_mask(scratch.cache, m_invalid_pix),
+                                              NearestPixelInterpolation(), ZeroEdgeExtension());
     else
-      m_cache_interp_mask = interpolate(create_mask(m_cache, m_invalid_pix),
-                                        BicubicInterpolation(), ZeroEdgeExtension());
+      scratch.cache_interp_mask = interpolate(create_mask(scratch.cache, m_invalid_pix),
+                                              BicubicInterpolation(), ZeroEdgeExtension());
 
     // Need the check below as to not try to create images with
     // negative dimensions.
     if (out_box.empty())
       out_box = vw::BBox2i(0, 0, 0, 0);
 
-    m_cached_rv_box = out_box;
-    return m_cached_rv_box;
+    scratch.input_box  = bbox;
+    scratch.output_box = out_box;
+    scratch.has_output = true;
+    return out_box;
   }
 /*
   std::ostream& operator<<( std::ostream& os, Map2CamTrans const& trans ) {
@@ -248,14 +446,34 @@ namespace vw { namespace cartography {
 
   BBox2i Datum2CamTrans::reverse_bbox( BBox2i const& bbox ) const {
 
+    int b = BicubicInterpolation::pixel_buffer;
+    if (m_nearest_neighbor)
+      b = NearestPixelInterpolation::pixel_buffer;
+
+    // Same as calling reverse() on each pixel, but projecting a row
+    // at a time into the camera.
     BBox2 out_box;      
+    std::vector<Vector3> xyz_row;
+    std::vector<Vector2> pix_row;
     for( int32 y=bbox.min().y(); y<bbox.max().y(); ++y ){
+      xyz_row.clear();
       for( int32 x=bbox.min().x(); x<bbox.max().x(); ++x ){
-      
-        Vector2 p = reverse( Vector2(x,y) );
-        if (p == m_invalid_pix) 
+        Vector2 lonlat = m_image_georef.pixel_to_lonlat(Vector2(x,y));
+        xyz_row.push_back(m_dem_georef.datum().geodetic_to_cartesian
+                          (Vector3(lonlat[0], lonlat[1], m_dem_height)));
+      }
+
+      m_cam->points_to_pixels(xyz_row, pix_row);
+
+      for (size_t i = 0; i < pix_row.size(); i++) {
+        Vector2 const& pt = pix_row[i];
+        if (pt == m_invalid_pix) 
+          continue;
+        if ( m_call_from_mapproject &&
+            (pt[0] < b - 1 || pt[0] >= m_image_size[0] - b ||
+             pt[1] < b - 1 || pt[1] >= m_image_size[1] - b) )
           continue;
-        out_box.grow( p );
+        out_box.grow( pt );
       }
     }
     out_box = grow_bbox_to_int( out_box );
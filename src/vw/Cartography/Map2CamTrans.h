@@ -19,6 +19,7 @@
 #ifndef __VW_CARTOGRAPHY_MAP_TRANSFORM_H__
 #define __VW_CARTOGRAPHY_MAP_TRANSFORM_H__
 
+#include <vw/Core/Cache.h>
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/Transform.h>
 #include <vw/FileIO/DiskImageView.h>
@@ -30,11 +31,18 @@
 /// convert to the DEM pixel, then to the DEM lonlat, then to the DEM
 /// xyz, then project into the camera, and find the camera pixel.
 
-/// This class is not thread-safe. For performance reasons it better not
-/// be invoked for individual pixels. The best approach is to first
-/// create a new instance of this class for each tile, do one wholesale
-/// caching computation on the entire tile, then invoke it repeatedly
-/// individual pixels in the tile.
+/// This class is thread-safe, and a single instance (or copies of it,
+/// which share all their caches) can be used by all the threads
+/// rasterizing a map-projected image.
+/// - The DEM is read in blocks through a vw::Cache, so overlapping
+///   output tiles do not read or interpolate the same DEM data twice.
+/// - Each thread keeps its own scratch data for the output tile it is
+///   working on, which is freed when the thread exits. reverse_bbox()
+///   projects the whole tile into the camera at once, and later calls
+///   to reverse() from the same thread interpolate into that result.
+///   This matches how TransformView uses a transform.
+/// - DEM blocks are only held, locked in the cache, for the duration
+///   of a call.
 
 /// The class can handle DEMs with holes.
 
@@ -44,6 +52,12 @@ namespace vw { namespace camera{
 
 namespace vw { namespace cartography {
 
+  namespace detail {
+    class  Map2CamTransCache;   // Shared DEM blocks and per-thread data
+    struct Map2CamTransScratch; // Working data for one thread
+    struct DemSampler;          // The DEM block one call is reading
+  }
+
   class Map2CamTrans : public TransformBase<Map2CamTrans> {
     camera::CameraModel const* m_cam;
     GeoReference         m_image_georef, m_dem_georef;
@@ -54,31 +68,40 @@ namespace vw { namespace cartography {
     double               m_nodata;
     Vector2              m_invalid_pix;
 
+    /// Shared by all copies of this object.
+    boost::shared_ptr<detail::Map2CamTransCache> m_cache;
+
+    /// Find the DEM point under a map-projected pixel. Returns false if
+    /// there is no valid DEM point there.
+    bool dem_point(detail::DemSampler & sampler,
+                   Vector2 const& p, Vector3 & xyz) const;
 
-    // We will always be modifying these
-    mutable BBox2i                             m_dem_cache_box;
-    mutable ImageView<float>                   m_cropped_dem;
-    mutable ImageViewRef< PixelMask<float> >   m_masked_dem;
-    mutable ImageViewRef< PixelMask<float> >   m_interp_dem;
-    mutable ImageView<Vector2>                 m_cache;
-    mutable ImageViewRef< PixelMask<Vector2> > m_cache_interp_mask;
-    mutable BBox2i                             m_img_cache_box;
-    mutable BBox2i                             m_cached_rv_box;
+    /// Return the camera pixel, or the invalid pixel if it cannot be
+    /// interpolated into the image.
+    Vector2 checked_camera_pixel(Vector2 const& pt) const;
 
   public:
+
+    /// The DEM blocks are stored in the given cache, or in the system
+    /// cache if none is provided.
     Map2CamTrans( camera::CameraModel const* cam,
                   GeoReference const& image_georef,
                   GeoReference const& dem_georef,
                   std::string  const& dem_file,
                   Vector2i     const& image_size,
                   bool                call_from_mapproject,
-                  bool                nearest_neighbor = false); // Default is bicubic
+                  bool                nearest_neighbor = false, // Default is bicubic
+                  Cache             * dem_cache = NULL);
 
     /// Convert Map Projected Coordinate to camera coordinate
     Vector2 reverse(const Vector2 &p) const;
 
-    // Not thread safe ... you must copy this object
-    void       cache_dem   ( BBox2i const& bbox ) const;
+    /// Load the DEM blocks needed for this region of the map-projected image.
+    void   cache_dem   ( BBox2i const& bbox ) const;
+
+    /// Project the given tile into the camera and return the bounding box
+    /// of the result, skipping invalid pixels. The projected tile is kept
+    /// for this thread's subsequent calls to reverse().
     BBox2i reverse_bbox( BBox2i const& bbox ) const;
   }; // End class Map2CamTrans
 
@@ -203,8 +203,69 @@ TEST(GeoTransform, skipProjectionTest) {
   EXPECT_VECTOR_NEAR(point2, point2b, EPS);
 }
 
+TEST(GeoTransform, BatchTransform) {
+
+  // The batch functions must agree with the single point ones, both for
+  // the affine only case and when projections and datums differ.
+  Matrix3x3 affine;
+  affine(0,0) =  0.01;
+  affine(1,1) = -0.01;
+  affine(2,2) = 1;
+  affine(0,2) = 100.0;
+  affine(1,2) = 30.0;
+  GeoReference georef1(Datum("WGS84"), affine);
+  affine(0,0) =  0.02;
+  affine(1,1) = -0.02;
+  GeoReference georef2(Datum("WGS84"), affine);
+
+  Matrix3x3 utm_affine;
+  utm_affine(0,0) =  30;
+  utm_affine(1,1) = -30;
+  utm_affine(2,2) = 1;
+  utm_affine(0,2) = 400000;
+  utm_affine(1,2) = 3300000;
+  GeoReference georef3(Datum("WGS72"), utm_affine);
+  georef3.set_UTM(47);
+
+  std::vector<Vector2> pixels;
+  for (int i = 0; i < 10; i++)
+    pixels.push_back(Vector2(3.5*i, 20 - 1.5*i));
+
+  GeoTransform affine_trans(georef1, georef2);
+  GeoTransform proj_trans  (georef3, georef1);
+  GeoTransform* transforms[2] = {&affine_trans, &proj_trans};
+  for (int t = 0; t < 2; t++) {
+    std::vector<Vector2> fwd, rev;
+    transforms[t]->pixel_to_pixel(pixels, fwd);
+    transforms[t]->reverse       (pixels, rev);
+    ASSERT_EQ(pixels.size(), fwd.size());
+    ASSERT_EQ(pixels.size(), rev.size());
+    for (size_t i = 0; i < pixels.size(); i++) {
+      EXPECT_VECTOR_NEAR(transforms[t]->forward(pixels[i]), fwd[i], 1e-6);
+      EXPECT_VECTOR_NEAR(transforms[t]->reverse(pixels[i]), rev[i], 1e-6);
+    }
+  }
+  EXPECT_VECTOR_NEAR(affine_trans.forward(Vector2(10,20)), Vector2(5,10), 1e-8);
+
+  // TransformView converts whole rows with the batch functions.
+  std::vector<double> xs(pixels.size()), ys(pixels.size());
+  proj_trans.reverse_row(7, -3, int32(pixels.size()), &xs[0], &ys[0]);
+  for (size_t i = 0; i < pixels.size(); i++)
+    EXPECT_VECTOR_NEAR(proj_trans.reverse(Vector2(-3.0 + i, 7)), Vector2(xs[i], ys[i]), 1e-6);
+
+  // A point which proj.4 rejects must not take the rest of the batch with it.
+  std::vector<Vector2> lonlats, out;
+  lonlats.push_back(Vector2(98.5, 29.0));
+  lonlats.push_back(Vector2(98.5, 120.0));
+  lonlats.push_back(Vector2(99.0, 29.5));
+  proj_trans.lonlat_to_lonlat(lonlats, out, true);
+  ASSERT_EQ(lonlats.size(), out.size());
+  EXPECT_VECTOR_NEAR(proj_trans.lonlat_to_lonlat(lonlats[0], true), out[0], 1e-8);
+  EXPECT_VECTOR_NEAR(proj_trans.lonlat_to_lonlat(lonlats[2], true), out[2], 1e-8);
+}
+
 TEST(GeoTransform, RefToRef) {
-  
+
   // Set up a pair of GeoReference objects which overlap but
   //  do not use the same longitude convention.
   
@@ -29,43 +29,123 @@
 ///
 /// This class also has supports non-copying resize() semantics.
 ///
-/// At some point we may want to extend this to deal with allocation
-/// pools and so forth, if we want to start exposing that functionality
-/// in matrices and images.
+/// Arrays of up to VW_SMALL_ARRAY_BYTES bytes are stored inside the
+/// object itself rather than on the heap, so the small dynamically
+/// sized vectors and matrices that are created and thrown away in
+/// inner loops do not allocate.  The buffer is part of every Vector
+/// and Matrix, including large ones that never use it, so the default
+/// only fits a 3x3 matrix of doubles.  Set VW_SMALL_ARRAY_BYTES to 0
+/// to put every array on the heap.
 ///
 #ifndef __VW_CORE_VARARRAY_H__
 #define __VW_CORE_VARARRAY_H__
 
+#include <vw/config.h>
+
+#include <cstddef>
 #include <algorithm>
+#include <memory>
+#include <new>
 #include <boost/smart_ptr.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+
+#ifndef VW_SMALL_ARRAY_BYTES
+#define VW_SMALL_ARRAY_BYTES 72
+#endif
 
 namespace vw {
 
   template <class T>
   class VarArray {
-    boost::shared_array<T> m_data;
+  public:
+    /// The largest number of elements stored without allocating.
+    static const size_t inline_size = VW_SMALL_ARRAY_BYTES / sizeof(T);
+
+  private:
+    typename boost::aligned_storage<sizeof(T) * (inline_size ? inline_size : 1),
+                                    boost::alignment_of<T>::value>::type m_buffer;
+    T* m_data;
     size_t m_size;
+
+    T* buffer() { return reinterpret_cast<T*>( &m_buffer ); }
+    bool is_inline() const { return m_data == reinterpret_cast<const T*>( &m_buffer ); }
+
+    // Returns uninitialized space for size elements.
+    T* allocate( size_t size ) {
+      if( size <= inline_size ) return buffer();
+      return static_cast<T*>( ::operator new( size * sizeof(T) ) );
+    }
+
+    void deallocate( T* data ) {
+      if( data != buffer() ) ::operator delete( data );
+    }
+
+    static void destroy( T* b, T* e ) {
+      for( ; b != e; ++b ) b->~T();
+    }
+
+    // Fills freshly allocated storage, releasing it if a copy throws.
+    template <class IterT>
+    void construct( IterT b, size_t size ) {
+      m_data = allocate( size );
+      try {
+        std::uninitialized_copy( b, b+size, m_data );
+      } catch( ... ) {
+        deallocate( m_data );
+        m_data = buffer();
+        throw;
+      }
+      m_size = size;
+    }
+
+    void release() {
+      destroy( m_data, m_data+m_size );
+      deallocate( m_data );
+      m_data = buffer();
+      m_size = 0;
+    }
+
   public:
-    VarArray() : m_data(), m_size(0) {}
+    VarArray() : m_data(buffer()), m_size(0) {}
 
-    VarArray( VarArray const& other ) : m_data(new T[other.size()]), m_size(other.size()) {
-      std::copy( other.begin(), other.end(), begin() );
+    VarArray( VarArray const& other ) : m_data(buffer()), m_size(0) {
+      construct( other.begin(), other.size() );
     }
 
-    VarArray( size_t size ) : m_data(new T[size]), m_size(size) {
-      std::uninitialized_fill(begin(),end(),T());
+    VarArray( size_t size ) : m_data(buffer()), m_size(0) {
+      m_data = allocate( size );
+      try {
+        std::uninitialized_fill( m_data, m_data+size, T() );
+      } catch( ... ) {
+        deallocate( m_data );
+        m_data = buffer();
+        throw;
+      }
+      m_size = size;
     }
 
     template <class IterT>
-    VarArray( IterT b, IterT e ) : m_data(new T[e-b]), m_size(e-b) {
-      std::copy(b,e,begin());
+    VarArray( IterT b, IterT e ) : m_data(buffer()), m_size(0) {
+      construct( b, e-b );
+    }
+
+    ~VarArray() {
+      destroy( m_data, m_data+m_size );
+      deallocate( m_data );
     }
 
+    /// Assignment reuses the storage when the sizes match.  Otherwise
+    /// it offers only the basic guarantee: if an element copy throws
+    /// the array is left empty.
     VarArray& operator=( VarArray const& other ) {
-      boost::shared_array<T> new_data( new T[other.size()] );
-      std::copy( other.begin(), other.end(), new_data.get() );
-      m_data = new_data;
-      m_size = other.size();
+      if( &other == this ) return *this;
+      if( other.size() == m_size ) {
+        std::copy( other.begin(), other.end(), begin() );
+        return *this;
+      }
+      release();
+      construct( other.begin(), other.size() );
       return *this;
     }
 
@@ -80,36 +160,73 @@ namespace vw {
     typedef T* iterator;
     typedef const T* const_iterator;
 
-    iterator begin() { return m_data.get(); }
-    iterator end() { return m_data.get() + m_size; }
+    iterator begin() { return m_data; }
+    iterator end() { return m_data + m_size; }
 
-    const_iterator begin() const { return m_data.get(); }
-    const_iterator end() const { return m_data.get() + m_size; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
 
     size_t size() const { return m_size; }
 
     void resize( size_t new_size, bool preserve = true ) {
       if( new_size == m_size ) return;
-      if( new_size == 0 ) {
-        m_data.reset();
-        m_size = 0;
+      size_t keep = preserve ? (std::min)( new_size, m_size ) : 0;
+
+      // Small arrays change size in place.
+      if( is_inline() && new_size <= inline_size ) {
+        std::fill( m_data+keep, m_data+(std::min)( new_size, m_size ), T() );
+        if( new_size < m_size )
+          destroy( m_data+new_size, m_data+m_size );
+        else
+          std::uninitialized_fill( m_data+m_size, m_data+new_size, T() );
+        m_size = new_size;
         return;
       }
-      boost::shared_array<T> new_data( new T[new_size] );
-      if( preserve ) {
-        if( new_size > m_size ) {
-          std::copy( m_data.get(), m_data.get()+m_size, new_data.get() );
-          std::uninitialized_fill( new_data.get()+m_size, new_data.get()+new_size, T() );
+
+      T* new_data = allocate( new_size );
+      try {
+        std::uninitialized_copy( m_data, m_data+keep, new_data );
+        try {
+          std::uninitialized_fill( new_data+keep, new_data+new_size, T() );
+        } catch( ... ) {
+          destroy( new_data, new_data+keep );
+          throw;
         }
-        else std::copy( m_data.get(), m_data.get()+new_size, new_data.get() );
+      } catch( ... ) {
+        deallocate( new_data );
+        throw;
       }
-      else std::uninitialized_fill( new_data.get(), new_data.get()+new_size, T() );
+      destroy( m_data, m_data+m_size );
+      deallocate( m_data );
       m_data = new_data;
       m_size = new_size;
     }
 
+    /// Heap arrays trade pointers.  Inline elements are copied into the
+    /// other object's buffer, so a heap array is never copied.
     void swap( VarArray& other ) {
-      std::swap( m_data, other.m_data );
+      if( &other == this ) return;
+      if( !is_inline() && !other.is_inline() ) {
+        std::swap( m_data, other.m_data );
+        std::swap( m_size, other.m_size );
+        return;
+      }
+      if( is_inline() && other.is_inline() ) {
+        VarArray& longer  = ( m_size >= other.m_size ) ? *this : other;
+        VarArray& shorter = ( m_size >= other.m_size ) ? other : *this;
+        std::uninitialized_copy( longer.m_data+shorter.m_size, longer.m_data+longer.m_size,
+                                 shorter.m_data+shorter.m_size );
+        destroy( longer.m_data+shorter.m_size, longer.m_data+longer.m_size );
+        std::swap_ranges( shorter.m_data, shorter.m_data+shorter.m_size, longer.m_data );
+        std::swap( m_size, other.m_size );
+        return;
+      }
+      VarArray& small = is_inline() ? *this : other;
+      VarArray& large = is_inline() ? other : *this;
+      std::uninitialized_copy( small.m_data, small.m_data+small.m_size, large.buffer() );
+      destroy( small.m_data, small.m_data+small.m_size );
+      small.m_data = large.m_data;
+      large.m_data = large.buffer();
       std::swap( m_size, other.m_size );
     }
   };
@@ -0,0 +1,137 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+
+#include <vw/Core/VarArray.h>
+#include <string>
+
+using namespace vw;
+
+namespace {
+  // Counts live objects, to check that every element is destroyed.
+  struct Counted {
+    static int live;
+    int value;
+    Counted() : value(0) { live++; }
+    Counted( Counted const& other ) : value(other.value) { live++; }
+    ~Counted() { live--; }
+  };
+  int Counted::live = 0;
+}
+
+TEST(VarArray, Small) {
+  VarArray<double> a( 3 );
+  ASSERT_EQ( 3u, a.size() );
+  EXPECT_EQ( 0, a[2] );
+  // Small arrays live inside the object.
+  EXPECT_TRUE( (const char*)a.begin() >= (const char*)&a &&
+               (const char*)a.end() <= (const char*)&a + sizeof(a) );
+
+  a[0] = 1; a[1] = 2; a[2] = 3;
+  a.resize( 5 );
+  ASSERT_EQ( 5u, a.size() );
+  EXPECT_EQ( 3, a[2] );
+  EXPECT_EQ( 0, a[4] );
+  a.resize( 2, false );
+  EXPECT_EQ( 0, a[0] );
+}
+
+TEST(VarArray, Transitions) {
+  size_t big = VarArray<double>::inline_size + 10;
+  VarArray<double> a( 4 );
+  for ( size_t i = 0; i < 4; i++ )
+    a[i] = double(i);
+  a.resize( big );
+  ASSERT_EQ( big, a.size() );
+  EXPECT_EQ( 3, a[3] );
+  EXPECT_EQ( 0, a[big-1] );
+
+  VarArray<double> b( a ), c( 2 );
+  EXPECT_EQ( 3, b[3] );
+  c.swap( b );
+  EXPECT_EQ( big, c.size() );
+  EXPECT_EQ( 2u, b.size() );
+  EXPECT_EQ( 3, c[3] );
+
+  c.resize( 3 );
+  ASSERT_EQ( 3u, c.size() );
+  EXPECT_EQ( 2, c[2] );
+  c = a;
+  EXPECT_EQ( big, c.size() );
+  c = VarArray<double>();
+  EXPECT_EQ( 0u, c.size() );
+}
+
+TEST(VarArray, Swap) {
+  size_t big = VarArray<double>::inline_size + 10;
+  VarArray<double> heap( big ), small( 2 ), tiny( 1 );
+  heap[big-1] = 5;
+  small[1] = 7;
+  tiny[0] = 9;
+
+  // The heap array changes hands without being copied.
+  const double* heap_data = heap.begin();
+  small.swap( heap );
+  EXPECT_EQ( heap_data, small.begin() );
+  ASSERT_EQ( big, small.size() );
+  EXPECT_EQ( 5, small[big-1] );
+  ASSERT_EQ( 2u, heap.size() );
+  EXPECT_EQ( 7, heap[1] );
+
+  heap.swap( tiny );
+  ASSERT_EQ( 1u, heap.size() );
+  EXPECT_EQ( 9, heap[0] );
+  ASSERT_EQ( 2u, tiny.size() );
+  EXPECT_EQ( 7, tiny[1] );
+  EXPECT_TRUE( (const char*)tiny.begin() >= (const char*)&tiny &&
+               (const char*)tiny.end() <= (const char*)&tiny + sizeof(tiny) );
+}
+
+TEST(VarArray, Objects) {
+  {
+    VarArray<Counted> a( 3 );
+    EXPECT_EQ( 3, Counted::live );
+    a.resize( 200 );
+    EXPECT_EQ( 200, Counted::live );
+    a.resize( 1 );
+    EXPECT_EQ( 1, Counted::live );
+    VarArray<Counted> b( a );
+    b = VarArray<Counted>( 7 );
+    EXPECT_EQ( 8, Counted::live );
+  }
+  EXPECT_EQ( 0, Counted::live );
+
+  {
+    VarArray<Counted> a( 1 ), b( 40 ), c( 2 );
+    a.swap( b );
+    c.swap( a );
+    b.swap( c );
+    EXPECT_EQ( 43, Counted::live );
+  }
+  EXPECT_EQ( 0, Counted::live );
+
+  VarArray<std::string> s( 2 ), t( 1 );
+  s[1] = "small";
+  s.resize( 100 );
+  EXPECT_EQ( "small", s[1] );
+  t[0] = "inline";
+  t.swap( s );
+  EXPECT_EQ( "small", t[1] );
+  EXPECT_EQ( "inline", s[0] );
+}
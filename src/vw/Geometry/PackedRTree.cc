@@ -0,0 +1,269 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <vw/Geometry/PackedRTree.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <boost/shared_ptr.hpp>
+
+namespace vw {
+namespace geometry {
+
+namespace {
+
+  // Orders boxes by the center of one axis, then by index so that the
+  // packing does not depend on the sort.
+  struct CenterLess {
+    const double* m_centers;
+    size_t m_dim, m_axis;
+    CenterLess( const double* centers, size_t dim, size_t axis ) :
+      m_centers(centers), m_dim(dim), m_axis(axis) {}
+    bool operator()( uint32 a, uint32 b ) const {
+      double ca = m_centers[a*m_dim+m_axis], cb = m_centers[b*m_dim+m_axis];
+      return ca < cb || ( ca == cb && a < b );
+    }
+  };
+
+  // The number of boxes in each slab when order[begin,end) is cut
+  // along axis, so that the remaining axes can cut each slab into as
+  // many slabs again.
+  size_t slab_size( size_t count, size_t node_size, size_t dim, size_t axis ) {
+    size_t leaves = ( count + node_size - 1 ) / node_size;
+    size_t slabs  = size_t( std::ceil( std::pow( double(leaves), 1.0 / double(dim - axis) ) - 1e-9 ) );
+    slabs = std::max( slabs, size_t(1) );
+    return node_size * ( ( leaves + slabs - 1 ) / slabs );
+  }
+
+  // Sorts order[begin,end) into Sort-Tile-Recursive order, starting
+  // with the given axis.
+  void str_sort( std::vector<uint32>& order, size_t begin, size_t end,
+                 std::vector<double> const& centers, size_t dim, size_t axis, size_t node_size ) {
+    if ( end - begin <= node_size ) return;
+    std::sort( order.begin() + begin, order.begin() + end, CenterLess( &centers[0], dim, axis ) );
+    if ( axis + 1 == dim ) return;
+    size_t slab = slab_size( end - begin, node_size, dim, axis );
+    for ( size_t i = begin; i < end; i += slab )
+      str_sort( order, i, std::min( i + slab, end ), centers, dim, axis + 1, node_size );
+  }
+
+  class SlabTask : public Task {
+    std::vector<uint32>& m_order;
+    std::vector<double> const& m_centers;
+    size_t m_begin, m_end, m_dim, m_node_size;
+  public:
+    SlabTask( std::vector<uint32>& order, std::vector<double> const& centers,
+              size_t begin, size_t end, size_t dim, size_t node_size ) :
+      m_order(order), m_centers(centers), m_begin(begin), m_end(end), m_dim(dim), m_node_size(node_size) {}
+    virtual void operator()() {
+      str_sort( m_order, m_begin, m_end, m_centers, m_dim, 1, m_node_size );
+    }
+  };
+
+  // Runs a range of queries of a batch.
+  template <class QueryT>
+  class QueryTask : public Task {
+    PackedRTree const& m_tree;
+    std::vector<QueryT> const& m_queries;
+    std::vector<std::vector<uint32> >& m_results;
+    size_t m_begin, m_end;
+  public:
+    QueryTask( PackedRTree const& tree, std::vector<QueryT> const& queries,
+               std::vector<std::vector<uint32> >& results, size_t begin, size_t end ) :
+      m_tree(tree), m_queries(queries), m_results(results), m_begin(begin), m_end(end) {}
+    virtual void operator()();
+  };
+
+  template <>
+  void QueryTask<BBoxN>::operator()() {
+    for ( size_t i = m_begin; i < m_end; i++ )
+      m_tree.intersects( m_queries[i], m_results[i] );
+  }
+
+  template <>
+  void QueryTask<Vector<double> >::operator()() {
+    for ( size_t i = m_begin; i < m_end; i++ )
+      m_tree.contains( m_queries[i], m_results[i] );
+  }
+
+  template <class QueryT>
+  void run_queries( PackedRTree const& tree, std::vector<QueryT> const& queries,
+                    std::vector<std::vector<uint32> >& results ) {
+    results.resize( queries.size() );
+    int num_threads = vw_settings().default_num_threads();
+    if ( num_threads <= 1 || queries.size() < 64 ) {
+      QueryTask<QueryT>( tree, queries, results, 0, queries.size() )();
+      return;
+    }
+    size_t chunk = std::max( size_t(16), queries.size() / ( 4 * num_threads ) + 1 );
+    FifoWorkQueue queue( num_threads );
+    for ( size_t i = 0; i < queries.size(); i += chunk )
+      queue.add_task( boost::shared_ptr<Task>(
+        new QueryTask<QueryT>( tree, queries, results, i, std::min( i + chunk, queries.size() ) ) ) );
+    queue.join_all();
+  }
+
+  // Whether a box overlaps [qmin,qmax), or contains the point qmin.
+  inline bool overlaps( const double* bmin, const double* bmax,
+                        const double* qmin, const double* qmax, size_t dim, bool point ) {
+    for ( size_t d = 0; d < dim; d++ ) {
+      if ( point ? ( qmin[d] < bmin[d] || qmin[d] >= bmax[d] )
+                 : ( bmin[d] >= qmax[d] || bmax[d] <= qmin[d] ) )
+        return false;
+    }
+    return true;
+  }
+
+} // namespace
+
+void PackedRTree::build( size_t dim, size_t num_boxes,
+                         std::vector<double> const& min, std::vector<double> const& max,
+                         size_t node_size ) {
+  VW_ASSERT( dim <= max_dim,
+             ArgumentErr() << "PackedRTree: at most " << max_dim << " dimensions are supported." );
+  VW_ASSERT( node_size >= 2,
+             ArgumentErr() << "PackedRTree: nodes must have at least two children." );
+  VW_ASSERT( min.size() == dim * num_boxes && max.size() == dim * num_boxes,
+             ArgumentErr() << "PackedRTree: wrong number of box corners." );
+  VW_ASSERT( num_boxes <= size_t( std::numeric_limits<uint32>::max() ),
+             ArgumentErr() << "PackedRTree: too many boxes." );
+
+  m_dim       = dim;
+  m_node_size = node_size;
+  m_num_boxes = num_boxes;
+  m_levels.clear();
+  m_min.clear();
+  m_max.clear();
+  m_ids.clear();
+  if ( dim == 0 ) return;
+
+  std::vector<double> centers( dim * num_boxes );
+  for ( size_t i = 0; i < num_boxes; i++ ) {
+    bool inverted = false;
+    for ( size_t d = 0; d < dim; d++ ) {
+      inverted = inverted || min[i*dim+d] > max[i*dim+d];
+      centers[i*dim+d] = 0.5 * ( min[i*dim+d] + max[i*dim+d] );
+    }
+    if ( !inverted )
+      m_ids.push_back( uint32(i) );
+  }
+  if ( m_ids.empty() ) return;
+
+  // Pack the leaves.  The slabs of the first axis are independent, so
+  // big trees sort them in parallel.
+  size_t count = m_ids.size();
+  int num_threads = vw_settings().default_num_threads();
+  if ( num_threads > 1 && dim > 1 && count > ( size_t(1) << 14 ) ) {
+    std::sort( m_ids.begin(), m_ids.end(), CenterLess( &centers[0], dim, 0 ) );
+    size_t slab = slab_size( count, node_size, dim, 0 );
+    FifoWorkQueue queue( num_threads );
+    for ( size_t i = 0; i < count; i += slab )
+      queue.add_task( boost::shared_ptr<Task>(
+        new SlabTask( m_ids, centers, i, std::min( i + slab, count ), dim, node_size ) ) );
+    queue.join_all();
+  } else {
+    str_sort( m_ids, 0, count, centers, dim, 0, node_size );
+  }
+
+  m_min.reserve( dim * ( count + count / ( node_size - 1 ) + 1 ) );
+  m_max.reserve( m_min.capacity() );
+  for ( size_t i = 0; i < count; i++ )
+    for ( size_t d = 0; d < dim; d++ ) {
+      m_min.push_back( min[m_ids[i]*dim+d] );
+      m_max.push_back( max[m_ids[i]*dim+d] );
+    }
+
+  // Each level above bounds consecutive groups of the level below.
+  // The leaf order already keeps neighboring groups close together.
+  m_levels.push_back( 0 );
+  m_levels.push_back( count );
+  while ( m_levels.back() - m_levels[m_levels.size()-2] > 1 ) {
+    size_t begin = m_levels[m_levels.size()-2], end = m_levels.back();
+    for ( size_t first = begin; first < end; first += node_size ) {
+      size_t last = std::min( first + node_size, end );
+      for ( size_t d = 0; d < dim; d++ ) {
+        double lo = m_min[first*dim+d], hi = m_max[first*dim+d];
+        for ( size_t e = first + 1; e < last; e++ ) {
+          lo = std::min( lo, m_min[e*dim+d] );
+          hi = std::max( hi, m_max[e*dim+d] );
+        }
+        m_min.push_back( lo );
+        m_max.push_back( hi );
+      }
+    }
+    m_levels.push_back( m_min.size() / dim );
+  }
+}
+
+BBoxN PackedRTree::bounding_box() const {
+  BBoxN result;
+  if ( m_levels.empty() ) return result;
+  size_t root = m_levels[m_levels.size()-2];
+  Vector<double> min( m_dim ), max( m_dim );
+  for ( size_t d = 0; d < m_dim; d++ ) {
+    min[d] = m_min[root*m_dim+d];
+    max[d] = m_max[root*m_dim+d];
+  }
+  return BBoxN( min, max );
+}
+
+void PackedRTree::query( const double* qmin, const double* qmax, bool point,
+                         std::vector<uint32>& result ) const {
+  // Nodes still to be checked, as an entry and the level it lies in.
+  std::vector<std::pair<size_t,size_t> > stack;
+  stack.reserve( m_node_size * m_levels.size() );
+  size_t root = m_levels.size() - 2;
+  if ( overlaps( &m_min[m_levels[root]*m_dim], &m_max[m_levels[root]*m_dim], qmin, qmax, m_dim, point ) )
+    stack.push_back( std::make_pair( m_levels[root], root ) );
+
+  while ( !stack.empty() ) {
+    size_t entry = stack.back().first, level = stack.back().second;
+    stack.pop_back();
+    if ( level == 0 ) {
+      result.push_back( m_ids[entry] );
+      continue;
+    }
+    // Test the children here, so only the ones that overlap are pushed.
+    size_t first = m_levels[level-1] + ( entry - m_levels[level] ) * m_node_size;
+    size_t last  = std::min( first + m_node_size, m_levels[level] );
+    for ( size_t e = first; e < last; e++ ) {
+      if ( !overlaps( &m_min[e*m_dim], &m_max[e*m_dim], qmin, qmax, m_dim, point ) )
+        continue;
+      if ( level == 1 )
+        result.push_back( m_ids[e] );
+      else
+        stack.push_back( std::make_pair( e, level - 1 ) );
+    }
+  }
+  std::sort( result.begin(), result.end() );
+}
+
+void PackedRTree::intersects( std::vector<BBoxN> const& boxes,
+                              std::vector<std::vector<uint32> >& results ) const {
+  run_queries( *this, boxes, results );
+}
+
+void PackedRTree::contains( std::vector<Vector<double> > const& points,
+                            std::vector<std::vector<uint32> >& results ) const {
+  run_queries( *this, points, results );
+}
+
+}} // namespace vw::geometry
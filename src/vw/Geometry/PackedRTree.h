@@ -0,0 +1,161 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file PackedRTree.h
+///
+/// A static R-tree over a set of bounding boxes, bulk loaded with the
+/// Sort-Tile-Recursive algorithm of
+///
+/// Leutenegger, Scott T., Edgington, Jeffrey M. and Lopez, Mario A.
+/// "STR: A Simple and Efficient Algorithm for R-Tree Packing" (1997)
+///
+/// Every node but the last of each level is full, and the nodes of a
+/// level are stored one after another with their boxes in flat
+/// arrays, so the tree takes a few words per box and a query touches
+/// little memory.  Unlike SpatialTree the boxes cannot be added one
+/// at a time; build the tree again when they change.
+///
+#ifndef __VW_GEOMETRY_PACKED_RTREE_H__
+#define __VW_GEOMETRY_PACKED_RTREE_H__
+
+#include <limits>
+#include <vector>
+
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Math/Vector.h>
+#include <vw/Math/BBox.h>
+
+namespace vw {
+namespace geometry {
+
+  class PackedRTree {
+  public:
+    /// The number of children of each node.
+    static const size_t default_node_size = 16;
+
+    /// An empty tree.
+    PackedRTree() : m_dim(0), m_node_size(default_node_size), m_num_boxes(0) {}
+
+    /// Builds the tree over the given boxes, which must all have the
+    /// same dimension.  Queries return indices into boxes.  Inverted
+    /// boxes, with min > max on some axis, are left out; this includes
+    /// default-constructed ones.  Boxes of zero width are kept, as
+    /// BBox::intersects() reports boxes that straddle them.
+    template <class RealT, size_t DimN>
+    explicit PackedRTree( std::vector<BBox<RealT,DimN> > const& boxes,
+                          size_t node_size = default_node_size ) {
+      build( boxes, node_size );
+    }
+
+    template <class RealT, size_t DimN>
+    void build( std::vector<BBox<RealT,DimN> > const& boxes,
+                size_t node_size = default_node_size ) {
+      std::vector<double> min, max;
+      size_t dim = 0;
+      for ( size_t i = 0; i < boxes.size(); i++ )
+        if ( boxes[i].min().size() != 0 ) {
+          dim = boxes[i].min().size();
+          break;
+        }
+      min.reserve( boxes.size() * dim );
+      max.reserve( boxes.size() * dim );
+      for ( size_t i = 0; i < boxes.size(); i++ ) {
+        VW_ASSERT( boxes[i].min().size() == dim || boxes[i].min().size() == 0,
+                   ArgumentErr() << "PackedRTree: boxes must have the same dimension." );
+        for ( size_t d = 0; d < dim; d++ ) {
+          min.push_back( boxes[i].min().size() ? double(boxes[i].min()[d]) :  std::numeric_limits<double>::max() );
+          max.push_back( boxes[i].min().size() ? double(boxes[i].max()[d]) : -std::numeric_limits<double>::max() );
+        }
+      }
+      build( dim, boxes.size(), min, max, node_size );
+    }
+
+    /// Builds the tree from num_boxes boxes of dimension dim, whose
+    /// corners are given one box after another.
+    void build( size_t dim, size_t num_boxes,
+                std::vector<double> const& min, std::vector<double> const& max,
+                size_t node_size = default_node_size );
+
+    /// The number of boxes the tree was built from, including inverted ones.
+    size_t size() const { return m_num_boxes; }
+    size_t dim () const { return m_dim; }
+
+    /// The box containing all the boxes.
+    BBoxN bounding_box() const;
+
+    /// Finds, in increasing order, the boxes that intersect the given
+    /// box, in the sense of BBox::intersects().  A box of zero width
+    /// is found by a query that straddles it.  The queries only read
+    /// the tree, so several threads may make them at once.
+    template <class RealT, size_t DimN>
+    void intersects( BBox<RealT,DimN> const& box, std::vector<uint32>& result ) const {
+      result.clear();
+      if ( box.min().size() == 0 || m_levels.empty() ) return;
+      VW_ASSERT( box.min().size() == m_dim,
+                 ArgumentErr() << "PackedRTree: query has the wrong dimension." );
+      double qmin[max_dim], qmax[max_dim];
+      for ( size_t d = 0; d < m_dim; d++ ) {
+        qmin[d] = box.min()[d];
+        qmax[d] = box.max()[d];
+      }
+      query( qmin, qmax, false, result );
+    }
+
+    /// Finds, in increasing order, the boxes that contain the given
+    /// point, in the sense of BBox::contains().
+    template <class VectorT>
+    void contains( VectorBase<VectorT> const& point, std::vector<uint32>& result ) const {
+      result.clear();
+      if ( m_levels.empty() ) return;
+      VW_ASSERT( point.impl().size() == m_dim,
+                 ArgumentErr() << "PackedRTree: query has the wrong dimension." );
+      double p[max_dim];
+      for ( size_t d = 0; d < m_dim; d++ )
+        p[d] = point.impl()[d];
+      query( p, p, true, result );
+    }
+
+    /// Runs one intersects() query per box, in parallel.
+    void intersects( std::vector<BBoxN> const& boxes, std::vector<std::vector<uint32> >& results ) const;
+
+    /// Runs one contains() query per point, in parallel.
+    void contains( std::vector<Vector<double> > const& points, std::vector<std::vector<uint32> >& results ) const;
+
+    /// The largest dimension supported.
+    static const size_t max_dim = 8;
+
+  private:
+    size_t m_dim, m_node_size, m_num_boxes;
+
+    // Level 0 holds the boxes that are not inverted, in packed order, and each
+    // level above holds one box per group of m_node_size boxes of the
+    // level below.  The boxes of level l are entries m_levels[l] up to
+    // m_levels[l+1], and entry e has corners m_min[e*m_dim+d] and
+    // m_max[e*m_dim+d].  The last level is the root.
+    std::vector<size_t> m_levels;
+    std::vector<double> m_min, m_max;
+    std::vector<uint32> m_ids;     // The index of each box of level 0
+
+    // Finds the boxes overlapping [qmin,qmax), or containing the point
+    // qmin if point is true.
+    void query( const double* qmin, const double* qmax, bool point, std::vector<uint32>& result ) const;
+  };
+
+}} // namespace vw::geometry
+
+#endif // __VW_GEOMETRY_PACKED_RTREE_H__
@@ -0,0 +1,129 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+#include <vw/Geometry/PackedRTree.h>
+#include <vw/Core/Settings.h>
+
+#include <cstdlib>
+
+using namespace vw;
+using namespace vw::geometry;
+
+namespace {
+  double random_value( double range ) {
+    return range * std::rand() / double(RAND_MAX);
+  }
+}
+
+TEST(PackedRTree, Empty) {
+  PackedRTree tree;
+  std::vector<uint32> result( 1, 7 );
+  tree.intersects( BBox2( 0, 0, 1, 1 ), result );
+  EXPECT_TRUE( result.empty() );
+
+  std::vector<BBox2> boxes( 2 );  // Default boxes are empty
+  tree.build( boxes );
+  EXPECT_EQ( 2u, tree.size() );
+  tree.contains( Vector2( 0, 0 ), result );
+  EXPECT_TRUE( result.empty() );
+}
+
+TEST(PackedRTree, Small) {
+  std::vector<BBox2i> boxes;
+  boxes.push_back( BBox2i( 0, 0, 10, 10 ) );
+  boxes.push_back( BBox2i( 5, 5, 10, 10 ) );
+  boxes.push_back( BBox2i( 3, 3, 0, 4 ) );  // Zero width
+  boxes.push_back( BBox2i( 4, 4, -2, 2 ) ); // Inverted
+  boxes.push_back( BBox2i( 20, 0, 5, 5 ) );
+  PackedRTree tree( boxes, 2 );
+  EXPECT_EQ( BBoxN( Vector2( 0, 0 ), Vector2( 25, 15 ) ), tree.bounding_box() );
+
+  std::vector<uint32> result;
+  tree.intersects( BBox2i( 9, 9, 2, 2 ), result );
+  ASSERT_EQ( 2u, result.size() );
+  EXPECT_EQ( 0u, result[0] );
+  EXPECT_EQ( 1u, result[1] );
+
+  // A box of zero width is found by queries that straddle it, but
+  // contains no points.
+  tree.intersects( BBox2i( 2, 4, 2, 2 ), result );
+  ASSERT_EQ( 2u, result.size() );
+  EXPECT_EQ( 0u, result[0] );
+  EXPECT_EQ( 2u, result[1] );
+  tree.contains( Vector2( 3, 4 ), result );
+  ASSERT_EQ( 1u, result.size() );
+  EXPECT_EQ( 0u, result[0] );
+
+  // Boxes that only touch do not intersect.
+  tree.intersects( BBox2i( 10, 0, 10, 5 ), result );
+  EXPECT_TRUE( result.empty() );
+
+  // Points on the max edge are outside.
+  tree.contains( Vector2( 10, 2 ), result );
+  EXPECT_TRUE( result.empty() );
+  tree.contains( Vector2( 20, 0 ), result );
+  ASSERT_EQ( 1u, result.size() );
+  EXPECT_EQ( 4u, result[0] );
+}
+
+TEST(PackedRTree, Random) {
+  int old_threads = vw_settings().default_num_threads();
+  vw_settings().set_default_num_threads( 4 );
+
+  std::srand( 3 );
+  std::vector<BBox3> boxes;
+  for ( int i = 0; i < 20000; i++ ) {
+    Vector3 min( random_value(1000), random_value(1000), random_value(100) );
+    Vector3 size( random_value(30), random_value(30), random_value(10) );
+    if ( i % 10 == 0 )
+      size[i % 3] = 0;
+    boxes.push_back( BBox3( min, min + size ) );
+  }
+  PackedRTree tree( boxes );
+
+  std::vector<BBoxN> queries;
+  std::vector<Vector<double> > points;
+  for ( int i = 0; i < 200; i++ ) {
+    Vector3 min( random_value(1000), random_value(1000), random_value(100) );
+    queries.push_back( BBoxN( min, min + Vector3( random_value(100), random_value(100), random_value(20) ) ) );
+    points.push_back( min );
+  }
+  std::vector<std::vector<uint32> > found_boxes, found_points;
+  tree.intersects( queries, found_boxes );
+  tree.contains( points, found_points );
+  ASSERT_EQ( queries.size(), found_boxes.size() );
+  ASSERT_EQ( points.size(), found_points.size() );
+
+  size_t total = 0;
+  for ( size_t q = 0; q < queries.size(); q++ ) {
+    std::vector<uint32> expected_boxes, expected_points;
+    for ( size_t i = 0; i < boxes.size(); i++ ) {
+      if ( boxes[i].intersects( queries[q] ) )
+        expected_boxes.push_back( uint32(i) );
+      if ( boxes[i].contains( points[q] ) )
+        expected_points.push_back( uint32(i) );
+    }
+    EXPECT_EQ( expected_boxes, found_boxes[q] );
+    EXPECT_EQ( expected_points, found_points[q] );
+    total += expected_boxes.size();
+  }
+  EXPECT_GT( total, 0u );
+
+  vw_settings().set_default_num_threads( old_threads );
+}
@@ -108,6 +108,17 @@ namespace hdr {
     return subvector(x,0,n);
   }
 
+  std::vector<Vector<double> > estimate_camera_curves(std::vector<vw::Matrix<double> > const& pixels,
+                                                      std::vector<double> const& brightness_values) {
+    // The channels are solved one after another, as the LAPACK
+    // routines behind least_squares() are not known to be safe to call
+    // from several threads at once.
+    std::vector<Vector<double> > curves(pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+      curves[i] = estimate_camera_curve(pixels[i], brightness_values);
+    return curves;
+  }
+
   void write_curves(std::string const& curves_file,
                     CameraCurveFn const &curves) {
 
@@ -29,6 +29,11 @@
 #include <vw/Image/Statistics.h>
 #include <vw/Math/Matrix.h>
 #include <vw/Math/Vector.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <algorithm>
+#include <boost/shared_ptr.hpp>
 
 // Number of LDR intensity pairs to sample
 const int VW_HDR_DEFAULT_NUM_PIXEL_SAMPLES = 300;
@@ -39,6 +44,12 @@ namespace hdr {
     inline uint32 dice(uint32 max_) {
       return static_cast<uint32>(max_ * (double(rand()) / double(RAND_MAX)));
     }
+
+    // Orders sample positions by row, so that samples from the same
+    // tiles or strips of an image on disk are read together.
+    inline bool row_major_less(Vector2i const& a, Vector2i const& b) {
+      return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+    }
   }
 
 
@@ -143,9 +154,34 @@ namespace hdr {
     return pair_list;
   }
 
-  /// Generates an Nx3 matrix where each row contains a channel value
-  /// from one LDR image, the corresponding pixel value from a second
-  /// LDR image, and the ratio of exposure between these two images.
+  namespace detail {
+    // Samples one channel of one image at a list of positions, filling
+    // one column of a sample matrix.
+    template <class ViewT, class ChannelT>
+    class SampleImageTask : public Task {
+      ViewT const& m_image;
+      std::vector<Vector2i> const& m_positions;
+      Matrix<ChannelT>& m_samples;
+      size_t m_column;
+      int m_channel, m_kernel_size;
+    public:
+      SampleImageTask(ViewT const& image, std::vector<Vector2i> const& positions,
+                      Matrix<ChannelT>& samples, size_t column, int channel, int kernel_size) :
+        m_image(image), m_positions(positions), m_samples(samples), m_column(column),
+        m_channel(channel), m_kernel_size(kernel_size) {}
+      virtual void operator()() {
+        for (size_t i = 0; i < m_positions.size(); ++i)
+          m_samples(i,m_column) = sample_image(m_image.impl(), m_positions[i].x(), m_positions[i].y(),
+                                               m_channel, m_kernel_size);
+      }
+    };
+  }
+
+  /// Generates an NxM matrix where each row contains a channel value
+  /// sampled at the same random position in each of the M LDR images.
+  ///
+  /// The positions are drawn first and then each image is sampled by
+  /// its own task, so reading images from disk proceeds in parallel.
   template <class ViewT>
   Matrix<typename PixelChannelType<typename ViewT::pixel_type>::type> sample_ldr_images(std::vector<ViewT> const &images,
                                                                                         std::vector<double> const &/*brightness_values*/,
@@ -164,15 +200,24 @@ namespace hdr {
     int width = images[0].impl().cols();
 
     srand(time(0)); // Initialize random number generator
-    int i = 0;
-    while (i < num_pairs) {
-      // Generate random indices for two images
-      int rand_x = detail::dice(width);
-      int rand_y = detail::dice(height);
+    std::vector<Vector2i> positions(num_pairs);
+    for (int i = 0; i < num_pairs; ++i) {
+      // Generate random indices into the images
+      positions[i].x() = detail::dice(width);
+      positions[i].y() = detail::dice(height);
+    }
+    std::sort(positions.begin(), positions.end(), detail::row_major_less);
 
+    typedef detail::SampleImageTask<ViewT, channel_type> task_type;
+    int num_threads = vw_settings().default_num_threads();
+    if (num_threads <= 1) {
+      for (unsigned j = 0; j < images.size(); ++j)
+        task_type(images[j], positions, pair_list, j, channel, kernel_size)();
+    } else {
+      FifoWorkQueue queue(std::min(num_threads, int(images.size())));
       for (unsigned j = 0; j < images.size(); ++j)
-        pair_list(i,j) = sample_image(images[j].impl(), rand_x, rand_y, channel, kernel_size);
-      ++i;
+        queue.add_task(boost::shared_ptr<Task>(new task_type(images[j], positions, pair_list, j, channel, kernel_size)));
+      queue.join_all();
     }
 
     return pair_list;
@@ -243,6 +288,18 @@ namespace hdr {
       return result;
     }
 
+    /// Tabulates the luminance of each integer pixel value 0 through
+    /// levels-1, where levels-1 stands for a pixel value of 1.0.  An
+    /// 8- or 16-bit channel can then be converted by indexing the
+    /// table, without interpolating or taking exp() for every pixel.
+    std::vector<double> luminance_table(size_t channel, size_t levels) const {
+      VW_ASSERT(levels > 1, ArgumentErr() << "CameraCurveFn: a luminance table needs at least two levels.");
+      std::vector<double> table(levels);
+      for (size_t i = 0; i < levels; ++i)
+        table[i] = this->operator()(double(i) / double(levels-1), channel);
+      return table;
+    }
+
     size_t num_channels() const { return m_lookup_tables.size(); }
 
     Vector<double> const& lookup_table(size_t channel) const {
@@ -259,6 +316,11 @@ namespace hdr {
   Vector<double> estimate_camera_curve(vw::Matrix<double> const& pixels,
                                       std::vector<double> const& brightness_values);
 
+  /// Estimates one lookup table per matrix of samples, as
+  /// estimate_camera_curve() does.
+  std::vector<Vector<double> > estimate_camera_curves(std::vector<vw::Matrix<double> > const& pixels,
+                                                      std::vector<double> const& brightness_values);
+
   /// Computes the camera curve for LDR images of the same scene.
   ///
   /// The input to this function, 'images', is a std::vector of images
@@ -283,12 +345,7 @@ namespace hdr {
     }
 
     // Compute camera response curve for each channel.
-    std::vector<Vector<double> > lookup_tables(n_channels);
-    for ( int32 i = 0; i < n_channels; ++i ) {
-      lookup_tables[i] = estimate_camera_curve(pixels[i], brightness_values);
-    }
-
-    return CameraCurveFn(lookup_tables);
+    return CameraCurveFn(estimate_camera_curves(pixels, brightness_values));
   }
 
   /// Write the camera curve values in a tabulated format on disk.
@@ -35,10 +35,13 @@
 #ifndef __VW_HDR_LDRTOHDR_H__
 #define __VW_HDR_LDRTOHDR_H__
 
+#include <vw/Image/ImageView.h>
 #include <vw/Image/ImageViewRef.h>
+#include <vw/Image/Manipulation.h>
 #include <vw/HDR/CameraCurve.h>
 
 #include <vector>
+#include <limits>
 
 namespace vw {
 namespace hdr {
@@ -46,6 +49,15 @@ namespace hdr {
   /// Converts each pixel value in the image to scaled illuminance
   /// values based on a set of polynomial response curves, one
   /// curve for each image channel.
+  ///
+  /// Floating point pixels are expected to lie in [0.0 1.0].  Pixels
+  /// with 8- or 16-bit unsigned channels are taken relative to their
+  /// full scale, and are converted through luminance tables computed
+  /// once for each channel.
+  ///
+  /// Rasterizing a block reads each exposure of the block once and
+  /// merges it a row at a time, so blocks can be merged in parallel
+  /// by block_rasterize() or block_write_image().
   template <class SrcPixelT>
   class HighDynamicRangeView : public ImageViewBase<HighDynamicRangeView<SrcPixelT> > {
 
@@ -56,16 +68,65 @@ namespace hdr {
     typedef ProceduralPixelAccessor<HighDynamicRangeView> pixel_accessor;
 
   private:
+    typedef typename PixelChannelType<SrcPixelT>::type channel_type;
+
     std::vector<ImageViewRef<SrcPixelT> > m_views;
     CameraCurveFn m_curves;
     std::vector<double> m_brightness_vals;
 
+    // The luminance of every value of each channel, for integer
+    // channel types small enough to tabulate, and the full scale pixel
+    // value.
+    std::vector<std::vector<double> > m_luminance_tables;
+    double m_full_scale;
+
+    static bool use_luminance_tables() {
+      return std::numeric_limits<channel_type>::is_integer &&
+            !std::numeric_limits<channel_type>::is_signed &&
+             std::numeric_limits<channel_type>::digits <= 16;
+    }
+
+    // We will use a gaussian weighting scheme that peak at 0.5 and
+    // falls off to very close to zero at 0.0 and 1.0.
+    //
+    // Although it was constructed by "eyeballing it" in MATLAB,
+    // we find that this scheme works very well in practice.  It
+    // is certainly better than our old "linear" weighting scheme:
+    //
+    //        double weight = 2.0 * (-abs(0.5 - gray) + 0.5);
+    //
+    inline double weight( SrcPixelT const& pixel ) const {
+      double gray = PixelGray<double>(pixel).v() / m_full_scale;  // Convert to grayscale
+      return exp(-pow((gray-0.5),2)/(0.07));
+    }
+
+    // The camera response function returns a relative luminance
+    // value between 0.0 and 2.0.
+    inline pixel_type luminance( SrcPixelT const& pixel ) const {
+      if ( m_luminance_tables.empty() )
+        return m_curves( pixel );
+      pixel_type result;
+      for ( size_t c = 0; c < m_luminance_tables.size(); ++c )
+        result[c] = m_luminance_tables[c][pixel[c]];
+      return result;
+    }
+
   public:
 
     HighDynamicRangeView( std::vector<ImageViewRef<SrcPixelT> > const& views,
                           CameraCurveFn const& curves,
                           std::vector<double> brightness_vals) :
-      m_views(views), m_curves(curves), m_brightness_vals(brightness_vals) {
+      m_views(views), m_curves(curves), m_brightness_vals(brightness_vals), m_full_scale(1.0) {
+      VW_ASSERT( !m_views.empty() && m_views.size() == m_brightness_vals.size(),
+                 ArgumentErr() << "HighDynamicRangeView: need one brightness value for each image." );
+      if ( use_luminance_tables() ) {
+        VW_ASSERT( m_curves.num_channels() == size_t(CompoundNumChannels<SrcPixelT>::value),
+                   ArgumentErr() << "HighDynamicRangeView: pixels do not have the same number of channels as there are curves." );
+        m_full_scale = std::numeric_limits<channel_type>::max();
+        m_luminance_tables.resize( m_curves.num_channels() );
+        for ( size_t c = 0; c < m_luminance_tables.size(); ++c )
+          m_luminance_tables[c] = m_curves.luminance_table( c, size_t(m_full_scale) + 1 );
+      }
     }
 
     inline int32 cols() const { return m_views[0].cols(); }
@@ -81,25 +142,10 @@ namespace hdr {
       // Bring all images into same domain and average pixels across images using
       // a weighting function that favors pixels in middle of dynamic range.
       for ( unsigned c = 0; c < m_views.size(); ++c ) {
-
-        // We will use a gaussian weighting scheme that peak at 0.5 and
-        // falls off to very close to zero at 0.0 and 1.0.
-        //
-        // Although it was constructed by "eyeballing it" in MATLAB,
-        // we find that this scheme works very well in practice.  It
-        // is certainly better than our old "linear" weighting scheme:
-        //
-        //        double weight = 2.0 * (-abs(0.5 - gray) + 0.5);
-        //
-        // Gaussian Weighting:
-        PixelGray<double> gray(m_views[c](i,j,p));  // Convert to grayscale
-        double weight = exp(-pow((gray-0.5),2)/(0.07));
-
-        // The camera response function returns a relative luminance
-        // value between 0.0 and 2.0.
-        pixel_type src_val = m_curves( m_views[c](i,j,p) );
-        hdr_pix += weight * m_brightness_vals[c] * src_val;
-        weight_sum += weight;
+        SrcPixelT pixel = m_views[c](i,j,p);
+        double w = weight( pixel );
+        hdr_pix += w * m_brightness_vals[c] * luminance( pixel );
+        weight_sum += w;
       }
 
       // Divide by sum of weights
@@ -144,15 +190,39 @@ namespace hdr {
     }
 
     /// \cond INTERNAL
-    typedef HighDynamicRangeView<SrcPixelT> prerasterize_type;
+    typedef CropView<ImageView<pixel_type> > prerasterize_type;
     inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+      ImageView<pixel_type> hdr( bbox.width(), bbox.height(), planes() );
+      ImageView<double> weight_sum( bbox.width(), bbox.height(), planes() );
 
-      // Rasterize each of the individual LDR images if necessary.
-      std::vector<ImageViewRef<SrcPixelT> > m_prerast_views(m_views.size());
-      for (unsigned i = 0; i < m_views.size(); ++i)
-        m_prerast_views[i] = m_views[i].prerasterize(bbox);
+      // Accumulate one exposure of the block at a time, a row at a
+      // time, in the same order as operator() so the sums agree.
+      ImageView<SrcPixelT> exposure;
+      for ( unsigned c = 0; c < m_views.size(); ++c ) {
+        exposure = crop( m_views[c], bbox );
+        for ( int32 p = 0; p < hdr.planes(); ++p ) {
+          for ( int32 j = 0; j < hdr.rows(); ++j ) {
+            const SrcPixelT* src = &exposure(0,j,p);
+            pixel_type* dst = &hdr(0,j,p);
+            double* wsum = &weight_sum(0,j,p);
+            for ( int32 i = 0; i < hdr.cols(); ++i ) {
+              double w = weight( src[i] );
+              dst[i] += w * m_brightness_vals[c] * luminance( src[i] );
+              wsum[i] += w;
+            }
+          }
+        }
+      }
 
-      return prerasterize_type( m_prerast_views, m_curves, m_brightness_vals );
+      for ( int32 p = 0; p < hdr.planes(); ++p ) {
+        for ( int32 j = 0; j < hdr.rows(); ++j ) {
+          pixel_type* dst = &hdr(0,j,p);
+          const double* wsum = &weight_sum(0,j,p);
+          for ( int32 i = 0; i < hdr.cols(); ++i )
+            dst[i] = dst[i] / wsum[i];
+        }
+      }
+      return crop( hdr, -bbox.min().x(), -bbox.min().y(), cols(), rows() );
     }
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const { vw::rasterize( prerasterize(bbox), dest, bbox ); }
     /// \endcond
@@ -22,10 +22,10 @@
 #include <vw/Image/ImageMath.h>
 #include <vw/Image/Filter.h>
 #include <vw/Image/Algorithms.h>
+#include <vw/Image/BlockRasterize.h>
 #include <vw/Core/Functors.h>
 
 #include <vector>
-#include <iostream>
 
 using namespace vw;
 using namespace vw::hdr;
@@ -35,86 +35,90 @@ using namespace vw::hdr;
 // ********************************************************************
 const unsigned ASH_MAX_KERNEL = 10;
 
-ImageView<double> ashikhmin_world_adaptation_luminance(ImageView<double> L_w, double threshold) {
-  typedef ImageView<double> Map;
+namespace {
 
-  std::vector<Map> L_w_blur(ASH_MAX_KERNEL * 2);
-  std::vector<Map> V(ASH_MAX_KERNEL);
+  // Finds the world adaptation luminance of the pixels of inner: the
+  // blur of L_w at the largest scale s_t whose blurs of width s and 2s
+  // agree to within threshold for all s < s_t.  The blurs are computed
+  // over the whole of L_w, which must hold a halo around inner.
+  ImageView<float> ashikhmin_world_adaptation_luminance(ImageView<float> const& L_w,
+                                                        BBox2i const& inner, double threshold) {
+    typedef ImageView<float> Map;
 
-  vw_out() << "Computing L_w_blur\n";
-  for ( unsigned s = 1; s <= ASH_MAX_KERNEL * 2; ++s ) {
-    if ((s < ASH_MAX_KERNEL) || (s % 2 == 0)) {
-      vw_out() << "L_w_blur[" << (s) << "]\n";
-      L_w_blur[s-1] = gaussian_filter(L_w, 1.0, 1.0, s, s);
+    std::vector<Map> L_w_blur(ASH_MAX_KERNEL * 2);
+    for ( unsigned s = 1; s <= ASH_MAX_KERNEL * 2; ++s ) {
+      if ((s < ASH_MAX_KERNEL) || (s % 2 == 0))
+        L_w_blur[s-1] = crop(gaussian_filter(L_w, 1.0, 1.0, s, s), inner);
     }
-  }
-
-  vw_out() << "Computing Vs\n";
-  for ( unsigned s = 1; s <= ASH_MAX_KERNEL; ++s ) {
-    V[s-1] = abs((L_w_blur[s-1] - L_w_blur[2*s - 1]) / (L_w_blur[s-1] + 0.0001));
-  }
 
-  vw_out() << "Computing L_wa\n";
-  Map L_wa(L_w.cols(), L_w.rows());
-  for ( int32 x = 0; x < L_wa.cols(); ++x ) {
+    Map L_wa(inner.width(), inner.height());
     for ( int32 y = 0; y < L_wa.rows(); ++y ) {
-      unsigned s_t = 1;
-      while ((s_t < ASH_MAX_KERNEL) && (V[s_t - 1](x,y) <= threshold)) {
-        ++s_t;
+      for ( int32 x = 0; x < L_wa.cols(); ++x ) {
+        unsigned s_t = 1;
+        while (s_t < ASH_MAX_KERNEL) {
+          float blur_s = L_w_blur[s_t - 1](x,y), blur_2s = L_w_blur[2*s_t - 1](x,y);
+          if (fabs((blur_s - blur_2s) / (blur_s + 0.0001)) > threshold)
+            break;
+          ++s_t;
+        }
+        L_wa(x,y) = L_w_blur[s_t - 1](x,y);
       }
-      L_wa(x,y) = L_w_blur[s_t - 1](x,y);
     }
+    return L_wa;
   }
 
-  return L_wa;
-}
+  class AshikhminCompressiveFunctor {
+    double C_L_wmin, k;
 
-struct AshikhminCompressiveFunctor : ReturnFixedType<double> {
-private:
-  double C_L_wmin, k;
+  public:
+    AshikhminCompressiveFunctor(double L_wmin, double L_wmax, double L_dmax = 1.0) {
+      C_L_wmin = C(L_wmin);
+      k = L_dmax / (C(L_wmax) - C_L_wmin);
+    }
 
-public:
-  AshikhminCompressiveFunctor(double L_wmin, double L_wmax, double L_dmax = 1.0) {
-    C_L_wmin = C(L_wmin);
-    k = L_dmax / (C(L_wmax) - C_L_wmin);
-    vw_out() << "C(L_wmin) = " << C_L_wmin << "\n";
-    vw_out() << "k = " << k << "\n";
-  }
+    double C(double L) const {
+      if (L < 0.0034) return (L / 0.0014);
+      if (L < 1.0) return (2.4483 + log10(L/0.0034) / 0.4027);
+      if (L < 7.2444) return (16.5630 + (L-1) / 0.4027);
+      return (32.0693 + log10(L/7.2444) / 0.0556);
+    }
 
-  double C(double L) const {
-    if (L < 0.0034) return (L / 0.0014);
-    if (L < 1.0) return (2.4483 + log10(L/0.0034) / 0.4027);
-    if (L < 7.2444) return (16.5630 + (L-1) / 0.4027);
-    return (32.0693 + log10(L/7.2444) / 0.0556);
-  }
+    double operator() (double L_wa) const {
+      return k * (C(L_wa) - C_L_wmin);
+    }
+  };
 
-  double operator() (double L_wa) const {
-    return k * (C(L_wa) - C_L_wmin);
-  }
-};
+} // namespace
 
-ImageView<PixelRGB<double> > vw::hdr::ashikhmin_tone_map(ImageView<PixelRGB<double> > hdr_image, double threshold) {
-  ImageView<PixelGray<double> > gray = pixel_cast<PixelGray<double> >(hdr_image);
-  ImageView<double> L_w = channels_to_planes(gray);
-  //  write_image("lw.jpg", L_w);
-  ImageView<PixelRGB<double> > out_image = copy(hdr_image) / L_w;
+ImageView<PixelRGB<float> > vw::hdr::ashikhmin_tone_map_tile(ImageView<PixelRGB<float> > const& hdr_tile,
+                                                             double threshold, double L_wmin, double L_wmax) {
+  BBox2i inner(ASHIKHMIN_HALO, ASHIKHMIN_HALO,
+               hdr_tile.cols() - 2*ASHIKHMIN_HALO, hdr_tile.rows() - 2*ASHIKHMIN_HALO);
+  VW_ASSERT(inner.width() > 0 && inner.height() > 0,
+            ArgumentErr() << "ashikhmin_tone_map_tile: the tile is smaller than its halo.");
 
   // Compute world adaptation luminance
-  ImageView<double> L_wa = ashikhmin_world_adaptation_luminance(L_w, threshold);
-  //  write_image("lwa.jpg", L_wa);
-
-  // Compute display luminances
-  vw_out() << "Computing L_wmin and L_wmax\n";
-  double L_wmin, L_wmax;
-  min_max_channel_values(L_w, L_wmin, L_wmax);
-  vw_out() << "Computing F(L_wa)\n";
+  ImageView<float> L_w = channels_to_planes(pixel_cast<PixelGray<float> >(hdr_tile));
+  ImageView<float> L_wa = ashikhmin_world_adaptation_luminance(L_w, inner, threshold);
+
+  // Compute display luminances and recombine them with the colors
   AshikhminCompressiveFunctor F(L_wmin, L_wmax);
-  ImageView<double> F_L_wa = per_pixel_filter(L_wa, F);
-  //  write_image("flwa.jpg", F_L_wa);
-  vw_out() << "Computing display luminances\n";
-  ImageView<double> L_d = F_L_wa * L_w / L_wa;
-  //  write_image("ld.jpg", L_d);
-
-  // Recombine luminance values into color image
-  return normalize(out_image * L_d);
+  ImageView<PixelRGB<float> > result(inner.width(), inner.height());
+  for ( int32 y = 0; y < result.rows(); ++y ) {
+    for ( int32 x = 0; x < result.cols(); ++x ) {
+      float L = L_w(x + inner.min().x(), y + inner.min().y());
+      if (L == 0) continue;
+      float L_d = F(L_wa(x,y)) * L / L_wa(x,y);
+      result(x,y) = hdr_tile(x + inner.min().x(), y + inner.min().y()) * (L_d / L);
+    }
+  }
+  return result;
+}
+
+ImageView<PixelRGB<double> > vw::hdr::ashikhmin_tone_map(ImageView<PixelRGB<double> > const& hdr_image, double threshold) {
+  // Tone map in blocks, in parallel, rather than as one big tile.
+  ImageView<PixelRGB<double> > result =
+    pixel_cast<PixelRGB<double> >(block_rasterize(ashikhmin_tone_map_view(hdr_image, threshold),
+                                                  Vector2i(256, 256)));
+  return normalize(result);
 }
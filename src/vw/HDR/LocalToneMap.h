@@ -23,16 +23,133 @@
 ///
 /// This file implements the following tone mapping operators.
 ///
+/// - Ashikhmin Local Tonemap Operator
 ///
 #ifndef __VW_HDR_LOCALTONEMAP_H__
 #define __VW_HDR_LOCALTONEMAP_H__
 
 #include <vw/Image/ImageView.h>
+#include <vw/Image/ImageViewBase.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Image/PixelMath.h>
+#include <vw/Image/EdgeExtension.h>
+#include <vw/Image/Manipulation.h>
+#include <vw/Image/Statistics.h>
+#include <vw/Core/Thread.h>
+
+#include <boost/shared_ptr.hpp>
 
 namespace vw {
 namespace hdr {
 
-  ImageView<PixelRGB<double> > ashikhmin_tone_map(ImageView<PixelRGB<double> > hdr_image,
+  /// Half the width of the largest luminance blur of the Ashikhmin
+  /// operator, and so the overlap each tile needs with its neighbors.
+  const int32 ASHIKHMIN_HALO = 10;
+
+  /// Tone maps one tile with Ashikhmin's operator.  hdr_tile holds the
+  /// tile grown by ASHIKHMIN_HALO pixels on each side, with the image
+  /// edges extended by repeating the edge pixels.  L_wmin and L_wmax
+  /// are the luminance range of the whole image.  Returns the tone
+  /// mapped pixels of the tile without the halo.
+  ImageView<PixelRGB<float> > ashikhmin_tone_map_tile( ImageView<PixelRGB<float> > const& hdr_tile,
+                                                       double threshold, double L_wmin, double L_wmax );
+
+  /// Ashikhmin's local tone mapping operator, computed a tile at a
+  /// time so that images larger than memory can be streamed through
+  /// it, e.g.
+  ///
+  ///   block_write_image( "out.tif",
+  ///                      clamp( ashikhmin_tone_map_view( DiskImageView<PixelRGB<float> >( "in.exr" ) ) ),
+  ///                      progress );
+  ///
+  /// Each tile is rasterized with a halo wide enough for the largest
+  /// blur, so the result does not depend on the tiling.  The display
+  /// luminances lie roughly in [0,1] but are not normalized, since that
+  /// would need the whole result; clamp them before writing to an
+  /// integer format.
+  template <class ImageT>
+  class AshikhminToneMapView : public ImageViewBase<AshikhminToneMapView<ImageT> > {
+    ImageT m_image;
+    double m_threshold, m_L_wmin, m_L_wmax;
+
+    // The block last tone mapped for operator(), shared by copies of
+    // the view.
+    struct PixelCache {
+      Mutex mutex;
+      BBox2i bbox;
+      ImageView<PixelRGB<float> > block;
+    };
+    boost::shared_ptr<PixelCache> m_cache;
+
+    // The side of the blocks that operator() tone maps.
+    static const int32 pixel_block_size = 64;
+
+    ImageView<PixelRGB<float> > tone_map( BBox2i const& bbox ) const {
+      BBox2i grown = bbox;
+      grown.expand( ASHIKHMIN_HALO );
+      ImageView<PixelRGB<float> > tile =
+        crop( edge_extend( pixel_cast<PixelRGB<float> >( m_image ), ConstantEdgeExtension() ), grown );
+      return ashikhmin_tone_map_tile( tile, m_threshold, m_L_wmin, m_L_wmax );
+    }
+
+  public:
+    typedef PixelRGB<float> pixel_type;
+    typedef PixelRGB<float> result_type;
+    typedef ProceduralPixelAccessor<AshikhminToneMapView> pixel_accessor;
+
+    /// Finds the luminance range of the image, which takes one pass
+    /// over it.
+    AshikhminToneMapView( ImageT const& image, double threshold ) :
+      m_image(image), m_threshold(threshold), m_cache(new PixelCache) {
+      float L_wmin, L_wmax;
+      min_max_channel_values( pixel_cast<PixelGray<float> >( m_image ), L_wmin, L_wmax );
+      m_L_wmin = L_wmin;
+      m_L_wmax = L_wmax;
+    }
+
+    AshikhminToneMapView( ImageT const& image, double threshold, double L_wmin, double L_wmax ) :
+      m_image(image), m_threshold(threshold), m_L_wmin(L_wmin), m_L_wmax(L_wmax),
+      m_cache(new PixelCache) {}
+
+    inline int32 cols() const { return m_image.cols(); }
+    inline int32 rows() const { return m_image.rows(); }
+    inline int32 planes() const { return 1; }
+
+    inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+
+    /// Computing a single pixel needs a whole halo around it, so this
+    /// tone maps the block of pixel_block_size pixels around it and
+    /// keeps that for the next call.  Rasterize blocks instead where
+    /// possible.
+    inline result_type operator()( int32 i, int32 j, int32 /*p*/ = 0 ) const {
+      Mutex::Lock lock( m_cache->mutex );
+      if ( !m_cache->bbox.contains( Vector2i( i, j ) ) ) {
+        int32 x = i - ( ( i % pixel_block_size ) + pixel_block_size ) % pixel_block_size;
+        int32 y = j - ( ( j % pixel_block_size ) + pixel_block_size ) % pixel_block_size;
+        m_cache->bbox = BBox2i( x, y, pixel_block_size, pixel_block_size );
+        m_cache->block = tone_map( m_cache->bbox );
+      }
+      return m_cache->block( i - m_cache->bbox.min().x(), j - m_cache->bbox.min().y() );
+    }
+
+    typedef CropView<ImageView<pixel_type> > prerasterize_type;
+    inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+      return crop( tone_map( bbox ), -bbox.min().x(), -bbox.min().y(), cols(), rows() );
+    }
+
+    template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+      vw::rasterize( prerasterize(bbox), dest, bbox );
+    }
+  };
+
+  template <class ImageT>
+  AshikhminToneMapView<ImageT> ashikhmin_tone_map_view( ImageViewBase<ImageT> const& hdr_image,
+                                                        double threshold = 0.5 ) {
+    return AshikhminToneMapView<ImageT>( hdr_image.impl(), threshold );
+  }
+
+  /// Tone maps a whole image in memory, normalizing the result.
+  ImageView<PixelRGB<double> > ashikhmin_tone_map(ImageView<PixelRGB<double> > const& hdr_image,
                                                   double threshold = 0.5);
 
 }} // namespace vw::HDR
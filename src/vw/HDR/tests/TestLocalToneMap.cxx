@@ -0,0 +1,100 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+#include <test/Helpers.h>
+#include <vw/HDR/LocalToneMap.h>
+#include <vw/Image/BlockRasterize.h>
+#include <vw/Image/Algorithms.h>
+
+#include <cmath>
+
+using namespace vw;
+using namespace vw::hdr;
+
+namespace {
+
+  // A scene with several orders of magnitude of luminance and sharp
+  // edges, so that the adaptation scale varies across it.
+  ImageView<PixelRGB<float> > make_scene() {
+    ImageView<PixelRGB<float> > image( 70, 45 );
+    for ( int32 y = 0; y < image.rows(); ++y )
+      for ( int32 x = 0; x < image.cols(); ++x ) {
+        float L = std::pow( 10.0f, float(x) / 15 - 2 );
+        if ( ( x / 9 + y / 7 ) % 2 )
+          L *= 20;
+        image( x, y ) = PixelRGB<float>( L, 0.5f * L + 0.01f * y, 0.25f * L );
+      }
+    return image;
+  }
+
+  // The operator applied to the whole image as a single tile.
+  ImageView<PixelRGB<float> > whole_image( ImageView<PixelRGB<float> > const& image, double threshold ) {
+    float L_wmin, L_wmax;
+    min_max_channel_values( pixel_cast<PixelGray<float> >( image ), L_wmin, L_wmax );
+    BBox2i grown = bounding_box( image );
+    grown.expand( ASHIKHMIN_HALO );
+    return ashikhmin_tone_map_tile( crop( edge_extend( image, ConstantEdgeExtension() ), grown ),
+                                    threshold, L_wmin, L_wmax );
+  }
+
+}
+
+TEST( LocalToneMap, AshikhminBlockSizes ) {
+  ImageView<PixelRGB<float> > image = make_scene();
+  ImageView<PixelRGB<float> > expected = whole_image( image, 0.5 );
+
+  // Blocks smaller than the halo, and blocks that do not divide the
+  // image evenly.
+  Vector2i block_sizes[] = { Vector2i( 8, 8 ), Vector2i( 23, 41 ) };
+  for ( int b = 0; b < 2; ++b ) {
+    SCOPED_TRACE( ::testing::Message() << "block size " << block_sizes[b] );
+    ImageView<PixelRGB<float> > result = block_rasterize( ashikhmin_tone_map_view( image ), block_sizes[b] );
+    ASSERT_EQ( expected.cols(), result.cols() );
+    ASSERT_EQ( expected.rows(), result.rows() );
+    for ( int32 y = 0; y < result.rows(); ++y )
+      for ( int32 x = 0; x < result.cols(); ++x )
+        EXPECT_PIXEL_NEAR( expected( x, y ), result( x, y ), 1e-6 );
+  }
+}
+
+TEST( LocalToneMap, AshikhminPixelAccess ) {
+  ImageView<PixelRGB<float> > image = make_scene();
+  ImageView<PixelRGB<float> > expected = whole_image( image, 0.5 );
+
+  AshikhminToneMapView<ImageView<PixelRGB<float> > > view = ashikhmin_tone_map_view( image );
+  for ( int32 y = 0; y < image.rows(); ++y )
+    for ( int32 x = 0; x < image.cols(); ++x )
+      EXPECT_PIXEL_NEAR( expected( x, y ), view( x, y ), 1e-6 );
+
+  // Out of order, across blocks.
+  EXPECT_PIXEL_NEAR( expected( 69, 44 ), view( 69, 44 ), 1e-6 );
+  EXPECT_PIXEL_NEAR( expected( 0, 0 ), view( 0, 0 ), 1e-6 );
+}
+
+TEST( LocalToneMap, AshikhminWholeImage ) {
+  ImageView<PixelRGB<float> > image = make_scene();
+  ImageView<PixelRGB<double> > expected = normalize( pixel_cast<PixelRGB<double> >( whole_image( image, 0.5 ) ) );
+
+  ImageView<PixelRGB<double> > result = ashikhmin_tone_map( pixel_cast<PixelRGB<double> >( image ) );
+  ASSERT_EQ( expected.cols(), result.cols() );
+  ASSERT_EQ( expected.rows(), result.rows() );
+  for ( int32 y = 0; y < result.rows(); ++y )
+    for ( int32 x = 0; x < result.cols(); ++x )
+      EXPECT_PIXEL_NEAR( expected( x, y ), result( x, y ), 1e-6 );
+}
@@ -23,6 +23,8 @@
 #ifndef __VW_IMAGE_ALGORITHM_FUNCTIONS_H__
 #define __VW_IMAGE_ALGORITHM_FUNCTIONS_H__
 
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/MaskViews.h>
 
@@ -62,6 +64,37 @@ namespace vw {
     return result;
   }
 
+  // *******************************************************************
+  // euclidean_distance_transform()
+  // *******************************************************************
+
+  /// Computes the exact Euclidean distance from each pixel to the
+  /// nearest pixel with zero value, assuming the borders of the image
+  /// are zero, as grassfire() does for the Manhattan distance.
+  /// - Uses the separable algorithm of Felzenszwalb and Huttenlocher,
+  ///   which is linear in the number of pixels. Both passes are split
+  ///   among num_threads threads, so src should be an image in memory.
+  /// - If ignore_borders is set, borders are not treated as zero value,
+  ///   and if there are no zero pixels the output is cols+rows.
+  /// - If nearest is provided it is filled with the location of the
+  ///   nearest zero pixel. A location just outside the image means that
+  ///   the border was nearest, and (-1,-1) means there was nothing.
+  template <class SourceT>
+  void euclidean_distance_transform( ImageViewBase<SourceT> const& src,
+                                     ImageView<float>& dst,
+                                     bool ignore_borders=false,
+                                     ImageView<Vector2i>* nearest=NULL,
+                                     int num_threads=vw_settings().default_num_threads() );
+
+  // Without destination given, return in a newly-created ImageView<float>
+  template <class SourceT>
+  ImageView<float> euclidean_distance_transform( ImageViewBase<SourceT> const& src,
+                                                 bool ignore_borders=false ) {
+    ImageView<float> result;
+    euclidean_distance_transform( src, result, ignore_borders );
+    return result;
+  }
+
   // *******************************************************************
   // centerline_weights()
   // *******************************************************************
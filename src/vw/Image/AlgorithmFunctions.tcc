@@ -203,6 +203,205 @@ namespace vw {
   }
 
 
+  // *******************************************************************
+  // euclidean_distance_transform()
+  // *******************************************************************
+
+  namespace detail {
+
+    /// Marks a column with no zero pixel in it.
+    const int32 EDT_NO_FEATURE = std::numeric_limits<int32>::min();
+
+    /// Where the parabolas rooted at q and p intersect.
+    inline double edt_intersection( std::vector<double> const& f, int32 q, int32 p ) {
+      return ((f[q] + double(q)*q) - (f[p] + double(p)*p)) / (2.0*(q - p));
+    }
+
+    /// Lower envelope of the parabolas (x-q)^2 + f[q], from Felzenszwalb
+    /// and Huttenlocher, "Distance Transforms of Sampled Functions".
+    /// Infinite samples are skipped. Sets d[x] to the squared distance and
+    /// arg[x] to the minimizing q, or -1 if all samples are infinite.
+    inline void edt_lower_envelope( std::vector<double> const& f,
+                                    std::vector<double> & d, std::vector<int32> & arg,
+                                    std::vector<int32 > & v, std::vector<double> & z ) {
+      const double inf = std::numeric_limits<double>::infinity();
+      int32 n = f.size(), k = -1;
+      for ( int32 q = 0; q < n; q++ ) {
+        if ( f[q] == inf )
+          continue;
+        if ( k < 0 ) {
+          k = 0; v[0] = q; z[0] = -inf; z[1] = inf;
+          continue;
+        }
+        // Drop the parabolas hidden by the new one. Since z[0] is -inf
+        // the first one is never dropped.
+        double s = edt_intersection( f, q, v[k] );
+        while ( s <= z[k] ) {
+          k--;
+          s = edt_intersection( f, q, v[k] );
+        }
+        k++; v[k] = q; z[k] = s;
+        z[k+1] = inf;
+      }
+
+      if ( k < 0 ) {
+        std::fill( d.begin(), d.end(), inf );
+        std::fill( arg.begin(), arg.end(), -1 );
+        return;
+      }
+      k = 0;
+      for ( int32 x = 0; x < n; x++ ) {
+        while ( z[k+1] < x )
+          k++;
+        d  [x] = double(x - v[k])*(x - v[k]) + f[v[k]];
+        arg[x] = v[k];
+      }
+    }
+
+    /// First pass: for each pixel in a range of columns, find the row of
+    /// the nearest zero pixel in the same column. Works a row at a time
+    /// to read the source in raster order.
+    template <class SourceT>
+    class EdtColumnTask : public Task {
+      SourceT const&    m_src;
+      ImageView<int32>& m_rows;
+      int32 m_begin, m_end;
+      bool  m_ignore_borders;
+    public:
+      EdtColumnTask( SourceT const& src, ImageView<int32>& rows,
+                     int32 begin, int32 end, bool ignore_borders )
+        : m_src(src), m_rows(rows), m_begin(begin), m_end(end),
+          m_ignore_borders(ignore_borders) {}
+
+      virtual void operator()() {
+        const typename SourceT::pixel_type zero = typename SourceT::pixel_type();
+        int32 rows = m_src.rows();
+        // Going down, remember the last zero pixel seen in each column
+        std::vector<int32> last( m_end - m_begin, m_ignore_borders ? EDT_NO_FEATURE : -1 );
+        for ( int32 row = 0; row < rows; row++ ) {
+          for ( int32 col = m_begin; col < m_end; col++ ) {
+            if ( m_src(col,row) == zero )
+              last[col-m_begin] = row;
+            m_rows(col,row) = last[col-m_begin];
+          }
+        }
+        // Going up, keep the next zero pixel if it is closer
+        std::fill( last.begin(), last.end(), m_ignore_borders ? EDT_NO_FEATURE : rows );
+        for ( int32 row = rows-1; row >= 0; row-- ) {
+          for ( int32 col = m_begin; col < m_end; col++ ) {
+            int32 & current = m_rows(col,row);
+            int32 & next    = last[col-m_begin];
+            if ( current == row )
+              next = row;
+            else if ( next != EDT_NO_FEATURE &&
+                      ( current == EDT_NO_FEATURE || next - row < row - current ) )
+              current = next;
+          }
+        }
+      }
+    };
+
+    /// Second pass: for each row in a range, combine the column results
+    /// with the lower envelope to get the exact distance.
+    class EdtRowTask : public Task {
+      ImageView<int32   > const& m_rows;
+      ImageView<float   >      & m_dst;
+      ImageView<Vector2i>      * m_nearest;
+      int32 m_begin, m_end;
+      bool  m_ignore_borders;
+    public:
+      EdtRowTask( ImageView<int32> const& rows, ImageView<float>& dst,
+                  ImageView<Vector2i>* nearest, int32 begin, int32 end, bool ignore_borders )
+        : m_rows(rows), m_dst(dst), m_nearest(nearest), m_begin(begin), m_end(end),
+          m_ignore_borders(ignore_borders) {}
+
+      virtual void operator()() {
+        const double inf = std::numeric_limits<double>::infinity();
+        int32 cols = m_dst.cols(), rows = m_dst.rows();
+        // Unless borders are ignored, add zero samples just outside the row.
+        int32 pad = m_ignore_borders ? 0 : 1, n = cols + 2*pad;
+        std::vector<double> f(n, 0), d(n), z(n+1);
+        std::vector<int32 > arg(n), v(n);
+        for ( int32 row = m_begin; row < m_end; row++ ) {
+          for ( int32 col = 0; col < cols; col++ ) {
+            int32 r = m_rows(col,row);
+            f[col+pad] = ( r == EDT_NO_FEATURE ) ? inf : double(row - r)*(row - r);
+          }
+          edt_lower_envelope( f, d, arg, v, z );
+          for ( int32 col = 0; col < cols; col++ ) {
+            int32 q = arg[col+pad];
+            if ( q < 0 ) { // No zero pixels in the image
+              m_dst(col,row) = cols + rows;
+              if ( m_nearest )
+                (*m_nearest)(col,row) = Vector2i(-1,-1);
+              continue;
+            }
+            m_dst(col,row) = sqrt( d[col+pad] );
+            if ( m_nearest ) {
+              int32 qcol = q - pad;
+              if ( qcol < 0 || qcol >= cols ) // The left or right border
+                (*m_nearest)(col,row) = Vector2i(qcol, row);
+              else
+                (*m_nearest)(col,row) = Vector2i(qcol, m_rows(qcol,row));
+            }
+          }
+        }
+      }
+    };
+
+    /// Start of the i-th of num_tasks ranges splitting [0,size).
+    inline int32 edt_range_start( int32 size, int32 i, int32 num_tasks ) {
+      return int32( (int64(size)*i)/num_tasks );
+    }
+
+    /// Run the tasks, in this thread if there is only one.
+    inline void edt_run_tasks( std::vector<boost::shared_ptr<Task> > const& tasks ) {
+      if ( tasks.size() == 1 ) {
+        (*tasks[0])();
+        return;
+      }
+      FifoWorkQueue queue( tasks.size() );
+      for ( size_t i = 0; i < tasks.size(); i++ )
+        queue.add_task( tasks[i] );
+      queue.join_all();
+    }
+
+  } // namespace detail
+
+  template <class SourceT>
+  void euclidean_distance_transform( ImageViewBase<SourceT> const& src,
+                                     ImageView<float>& dst,
+                                     bool ignore_borders,
+                                     ImageView<Vector2i>* nearest,
+                                     int num_threads ) {
+    int32 cols = src.impl().cols(), rows = src.impl().rows();
+    dst.set_size( cols, rows );
+    if ( nearest )
+      nearest->set_size( cols, rows );
+    if ( cols == 0 || rows == 0 )
+      return;
+
+    // Row of the nearest zero pixel in the same column
+    ImageView<int32> nearest_rows( cols, rows );
+
+    std::vector<boost::shared_ptr<Task> > tasks;
+    int32 num_tasks = std::max( 1, std::min( num_threads, cols ) );
+    for ( int32 i = 0; i < num_tasks; i++ )
+      tasks.push_back( boost::shared_ptr<Task>( new detail::EdtColumnTask<SourceT>
+        ( src.impl(), nearest_rows, detail::edt_range_start( cols, i,   num_tasks ),
+                                    detail::edt_range_start( cols, i+1, num_tasks ), ignore_borders ) ) );
+    detail::edt_run_tasks( tasks );
+
+    tasks.clear();
+    num_tasks = std::max( 1, std::min( num_threads, rows ) );
+    for ( int32 i = 0; i < num_tasks; i++ )
+      tasks.push_back( boost::shared_ptr<Task>( new detail::EdtRowTask
+        ( nearest_rows, dst, nearest, detail::edt_range_start( rows, i,   num_tasks ),
+                                      detail::edt_range_start( rows, i+1, num_tasks ), ignore_borders ) ) );
+    detail::edt_run_tasks( tasks );
+  }
+
+
   // *******************************************************************
   // centerline_weights()
   // *******************************************************************
@@ -339,6 +339,26 @@ namespace vw {
   }
 
 
+  // ******************************************************************
+  // EuclideanDistanceView
+  // ******************************************************************
+
+  /// Lazy version of euclidean_distance_transform() for images too large
+  /// to process in memory, such as the masks of large orthomosaics.
+  /// - Each tile is computed from the source tile expanded by
+  ///   max_distance, so the output is exact where the distance is at most
+  ///   max_distance, and max_distance everywhere else.
+  /// - Dividing by max_distance gives feathered blending weights.
+  template <class ImageT>
+  class EuclideanDistanceView;
+
+  template <class ImageT>
+  EuclideanDistanceView<ImageT>
+  euclidean_distance_view(ImageViewBase<ImageT> const& image, float max_distance,
+                          bool ignore_borders = false) {
+    return EuclideanDistanceView<ImageT>(image.impl(), max_distance, ignore_borders);
+  }
+
 } // namespace vw
 
 #include "Algorithms.tcc"
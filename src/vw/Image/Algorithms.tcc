@@ -786,4 +786,68 @@ public:
 
 
 
+template <class ImageT>
+class EuclideanDistanceView: public ImageViewBase<EuclideanDistanceView<ImageT> >{
+
+  ImageT m_image;
+  float  m_max_distance;
+  bool   m_ignore_borders;
+public:
+  EuclideanDistanceView(ImageT const& image, float max_distance, bool ignore_borders):
+    m_image(image), m_max_distance(max_distance), m_ignore_borders(ignore_borders) {
+    VW_ASSERT(max_distance > 0, ArgumentErr() << "EuclideanDistanceView: max_distance must be positive.");
+  }
+
+  // Image View interface
+  typedef float      pixel_type;
+  typedef pixel_type result_type;
+  typedef ProceduralPixelAccessor<EuclideanDistanceView> pixel_accessor;
+
+  inline int32 cols  () const { return m_image.cols(); }
+  inline int32 rows  () const { return m_image.rows(); }
+  inline int32 planes() const { return 1; }
+
+  inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+
+  inline pixel_type operator()( double i, double j, int32 p = 0 ) const {
+    vw_throw(NoImplErr() << "EuclideanDistanceView: operator()(...) is not implemented");
+    return pixel_type();
+  }
+
+  typedef CropView<ImageView<pixel_type> > prerasterize_type;
+  inline prerasterize_type prerasterize(BBox2i const& bbox) const {
+
+    // Any zero pixel within max_distance of the tile is in the expanded tile.
+    BBox2i big_bbox = bbox;
+    big_bbox.expand(int32(ceil(m_max_distance)));
+
+    // Pixels outside the image are zero unless borders are ignored, so
+    // the expanded tile boundary itself is never treated as zero.
+    ImageView<typename ImageT::pixel_type> input_tile;
+    if (m_ignore_borders) {
+      big_bbox.crop(bounding_box(m_image));
+      input_tile = crop(m_image, big_bbox);
+    } else {
+      input_tile = crop(edge_extend(m_image, ZeroEdgeExtension()), big_bbox);
+    }
+
+    // The tiles are already processed in parallel.
+    ImageView<pixel_type> distance;
+    euclidean_distance_transform(input_tile, distance, true, NULL, 1);
+
+    ImageView<pixel_type> output_tile = crop(distance, bbox - big_bbox.min());
+    for (int r=0; r<output_tile.rows(); ++r)
+      for (int c=0; c<output_tile.cols(); ++c)
+        output_tile(c,r) = std::min(output_tile(c,r), m_max_distance);
+
+    return prerasterize_type(output_tile, -bbox.min().x(), -bbox.min().y(),
+                             cols(), rows() );
+  }
+
+  template <class DestT>
+  inline void rasterize(DestT const& dest, BBox2i bbox) const {
+    vw::rasterize(prerasterize(bbox), dest, bbox);
+  }
+}; // End class EuclideanDistanceView
+
 } // namespace vw
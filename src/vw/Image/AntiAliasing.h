@@ -23,6 +23,11 @@
 #include <vw/Image/Transform.h>
 #include <vw/Image/PerPixelAccessorViews.h>
 #include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 namespace vw {
 
@@ -305,6 +310,387 @@ namespace vw {
                         int32(.5+(input.impl().rows()*factor)) );
   }
 
+
+  // -------------------------------------------------------------------
+  // 2:1 pyramid reduction
+  // -------------------------------------------------------------------
+
+  /// Filters for reduce_view() and reduce_pyramid().
+  /// - BoxReduceFilter averages each 2x2 block, so output pixel i covers
+  ///   input pixels 2i and 2i+1.
+  /// - GaussianReduceFilter is the 5-tap binomial [1 4 6 4 1]/16 of the
+  ///   Burt-Adelson pyramid, centered on input pixel 2i.
+  /// - LanczosReduceFilter is a Lanczos-3 windowed sinc stretched to the
+  ///   new pixel size, centered like the box filter.
+  enum ReduceFilterType { BoxReduceFilter, GaussianReduceFilter, LanczosReduceFilter };
+
+  namespace detail {
+
+    // The taps of a 2:1 reduce filter.  Output pixel i is the weighted
+    // sum of input pixels 2i+first through 2i+first+weights.size()-1.
+    struct ReduceKernel {
+      int32 first;
+      std::vector<double> weights;
+
+      ReduceKernel( ReduceFilterType filter ) {
+        switch( filter ) {
+        case BoxReduceFilter:
+          first = 0;
+          weights.resize( 2, 0.5 );
+          break;
+        case GaussianReduceFilter:
+          first = -2;
+          weights.resize( 5 );
+          weights[0] = weights[4] = 1.0/16;
+          weights[1] = weights[3] = 4.0/16;
+          weights[2] = 6.0/16;
+          break;
+        case LanczosReduceFilter: {
+          first = -5;
+          weights.resize( 12 );
+          double sum = 0;
+          for( int32 k=0; k<12; ++k ) {
+            double d = (k + first - 0.5) / 2, pd = M_PI * d;
+            weights[k] = sin(pd) / pd * sin(pd/3) / (pd/3);
+            sum += weights[k];
+          }
+          for( int32 k=0; k<12; ++k )
+            weights[k] /= sum;
+          break;
+        }
+        default:
+          vw_throw( ArgumentErr() << "ReduceKernel: unknown filter type." );
+        }
+      }
+
+      int32 size() const { return int32(weights.size()); }
+
+      // The input pixels [begin,end) needed for output pixels [begin,end),
+      // clipped to an input level of the given size.
+      Vector2i input_range( int32 begin, int32 end, int32 size ) const {
+        return Vector2i( std::max( 2*begin + first, 0 ),
+                         std::min( 2*(end-1) + first + this->size(), size ) );
+      }
+    };
+
+    // Splits a pixel into the value that gets filtered and its validity.
+    template <class PixelT>
+    struct ReducePixel {
+      typedef PixelT value_type;
+      static inline bool valid( PixelT const& /*pixel*/ ) { return true; }
+      static inline value_type const& value( PixelT const& pixel ) { return pixel; }
+      static inline PixelT pixel( value_type const& value, bool /*valid*/ ) { return value; }
+    };
+
+    template <class ChildT>
+    struct ReducePixel<PixelMask<ChildT> > {
+      typedef ChildT value_type;
+      static inline bool valid( PixelMask<ChildT> const& pixel ) { return is_valid(pixel); }
+      static inline value_type const& value( PixelMask<ChildT> const& pixel ) { return pixel.child(); }
+      static inline PixelMask<ChildT> pixel( value_type const& value, bool valid ) {
+        PixelMask<ChildT> result( value );
+        if( !valid ) result.invalidate();
+        return result;
+      }
+    };
+
+    /// One level of a streaming 2:1 reduction.  Input rows are pushed in
+    /// order, filtered horizontally into a ring of rows, and each output
+    /// row is produced as soon as the last input row it needs arrives.
+    /// The output goes to an image, to the next level, or both, so a
+    /// whole chain of levels is built in a single pass over the source.
+    ///
+    /// Values are carried as real numbers multiplied by a validity weight.
+    /// Filter taps that fall outside the input level or on invalid pixels
+    /// drop out and the rest are renormalized; with zero_edges set the
+    /// input is instead taken to be zero outside its bounds.
+    template <class PixelT>
+    class ReduceStage {
+      typedef ReducePixel<PixelT> traits;
+      typedef typename traits::value_type value_type;
+      typedef typename CompoundChannelType<value_type>::type channel_type;
+    public:
+      typedef typename FloatType<channel_type>::type real_type;
+      static const int32 channels = CompoundNumChannels<value_type>::value;
+    private:
+      // Output pixels with less than this share of the filter's weight
+      // on valid input are invalid.
+      static inline real_type min_weight() { return real_type(0.01); }
+
+      ReduceKernel m_kernel;
+      Vector2i     m_in_size;
+      BBox2i       m_in_bbox, m_out_bbox;
+      bool         m_zero_edges;
+
+      std::vector<real_type> m_ring_value, m_ring_weight; // Horizontally filtered rows
+      std::vector<int32>     m_ring_row;
+      std::vector<real_type> m_out_value, m_out_weight;   // The last output row
+      int32                  m_next_row;
+
+      ImageView<PixelT> m_dest;
+      ReduceStage*      m_next;
+
+      inline int32 slot( int32 row ) const { return row % m_kernel.size(); }
+
+      void filter_row( int32 row, real_type const* value, real_type const* weight ) {
+        int32 s = slot( row );
+        m_ring_row[s] = row;
+        real_type* dst_value  = &m_ring_value [ size_t(s) * m_out_bbox.width() * channels ];
+        real_type* dst_weight = &m_ring_weight[ size_t(s) * m_out_bbox.width() ];
+        int32 taps = m_kernel.size();
+        for( int32 o=0; o<m_out_bbox.width(); ++o ) {
+          int32 begin = 2*(o + m_out_bbox.min().x()) + m_kernel.first;
+          real_type sum[channels], sum_weight = 0;
+          for( int32 c=0; c<channels; ++c ) sum[c] = 0;
+          if( begin >= 0 && begin + taps <= m_in_size.x() ) {
+            real_type const* v = value  + ptrdiff_t(begin - m_in_bbox.min().x()) * channels;
+            real_type const* w = weight + (begin - m_in_bbox.min().x());
+            for( int32 k=0; k<taps; ++k ) {
+              real_type kw = real_type( m_kernel.weights[k] );
+              for( int32 c=0; c<channels; ++c )
+                sum[c] += kw * v[k*channels+c];
+              sum_weight += kw * w[k];
+            }
+          }
+          else {
+            for( int32 k=std::max(0,-begin); k<taps && begin+k<m_in_size.x(); ++k ) {
+              real_type kw = real_type( m_kernel.weights[k] );
+              ptrdiff_t i = begin + k - m_in_bbox.min().x();
+              for( int32 c=0; c<channels; ++c )
+                sum[c] += kw * value[i*channels+c];
+              sum_weight += kw * weight[i];
+            }
+          }
+          for( int32 c=0; c<channels; ++c )
+            dst_value[o*channels+c] = sum[c];
+          dst_weight[o] = sum_weight;
+        }
+      }
+
+      void emit_row( int32 out_row ) {
+        int32 width = m_out_bbox.width();
+        std::fill( m_out_value.begin(), m_out_value.end(), real_type(0) );
+        std::fill( m_out_weight.begin(), m_out_weight.end(), real_type(0) );
+        int32 begin = 2*out_row + m_kernel.first;
+        for( int32 k=0; k<m_kernel.size(); ++k ) {
+          int32 row = begin + k;
+          if( row < 0 || row >= m_in_size.y() )
+            continue;
+          VW_DEBUG_ASSERT( m_ring_row[slot(row)] == row, LogicErr() << "ReduceStage: missing input row." );
+          real_type kw = real_type( m_kernel.weights[k] );
+          real_type const* v = &m_ring_value [ size_t(slot(row)) * width * channels ];
+          real_type const* w = &m_ring_weight[ size_t(slot(row)) * width ];
+          for( int32 i=0; i<width*channels; ++i )
+            m_out_value[i] += kw * v[i];
+          for( int32 i=0; i<width; ++i )
+            m_out_weight[i] += kw * w[i];
+        }
+
+        // Normalize, then hand the row on with binary validity.
+        if( !m_zero_edges || IsMasked<PixelT>::value ) {
+          for( int32 o=0; o<width; ++o ) {
+            bool valid = m_out_weight[o] > min_weight();
+            real_type scale = valid ? 1/m_out_weight[o] : real_type(0);
+            for( int32 c=0; c<channels; ++c )
+              m_out_value[o*channels+c] *= scale;
+            m_out_weight[o] = valid ? 1 : 0;
+          }
+        }
+        else {
+          std::fill( m_out_weight.begin(), m_out_weight.end(), real_type(1) );
+        }
+
+        if( m_dest.is_valid_image() ) {
+          typedef typename CompoundChannelCast<value_type,real_type>::type real_pixel;
+          typename ImageView<PixelT>::pixel_accessor dst = m_dest.origin().advance( 0, out_row - m_out_bbox.min().y() );
+          for( int32 o=0; o<width; ++o, dst.next_col() ) {
+            real_pixel result;
+            for( int32 c=0; c<channels; ++c )
+              compound_select_channel<real_type&>( result, c ) = m_out_value[o*channels+c];
+            *dst = traits::pixel( channel_cast_round_and_clamp_if_int<channel_type>( result ),
+                                  m_out_weight[o] > 0 );
+          }
+        }
+        if( m_next )
+          m_next->push_row( out_row, &m_out_value[0], &m_out_weight[0] );
+      }
+
+    public:
+      /// Reduce the part of an input level of size in_size that is needed
+      /// for out_bbox of the next level.
+      ReduceStage( ReduceFilterType filter, Vector2i const& in_size, BBox2i const& out_bbox, bool zero_edges = false )
+        : m_kernel( filter ), m_in_size( in_size ), m_out_bbox( out_bbox ), m_zero_edges( zero_edges ),
+          m_next_row( out_bbox.min().y() ), m_next( 0 ) {
+        Vector2i xr = m_kernel.input_range( out_bbox.min().x(), out_bbox.max().x(), in_size.x() );
+        Vector2i yr = m_kernel.input_range( out_bbox.min().y(), out_bbox.max().y(), in_size.y() );
+        m_in_bbox = BBox2i( xr[0], yr[0], xr[1]-xr[0], yr[1]-yr[0] );
+        m_ring_value .resize( size_t(m_kernel.size()) * out_bbox.width() * channels );
+        m_ring_weight.resize( size_t(m_kernel.size()) * out_bbox.width() );
+        m_ring_row   .resize( m_kernel.size(), -1 );
+        m_out_value  .resize( size_t(out_bbox.width()) * channels );
+        m_out_weight .resize( out_bbox.width() );
+      }
+
+      BBox2i const& input_bbox () const { return m_in_bbox;  }
+      BBox2i const& output_bbox() const { return m_out_bbox; }
+
+      /// Write the output rows into dest, which covers output_bbox().
+      void set_output( ImageView<PixelT> const& dest ) { m_dest = dest; }
+      /// Push the output rows into the next level.
+      void set_next( ReduceStage* next ) { m_next = next; }
+
+      /// Push one row covering the columns of input_bbox().
+      void push_row( int32 row, real_type const* value, real_type const* weight ) {
+        if( row < m_in_bbox.min().y() || row >= m_in_bbox.max().y() )
+          return;
+        filter_row( row, value, weight );
+        int32 last = m_kernel.size() + m_kernel.first - 1;
+        while( m_next_row < m_out_bbox.max().y() &&
+               ( 2*m_next_row + last <= row || row == m_in_bbox.max().y()-1 ) )
+          emit_row( m_next_row++ );
+      }
+    };
+
+    /// Reduce an image by 2^levels, producing out_bbox of the last level.
+    /// The source is read once, a strip of rows at a time, and passed
+    /// down the chain of levels.  If level_images is given, it receives
+    /// each level's output too (only the part needed for out_bbox).
+    template <class ImageT>
+    void reduce_levels( ImageT const& image, BBox2i const& out_bbox, int32 levels,
+                        ReduceFilterType filter, bool zero_edges,
+                        ImageView<typename ImageT::pixel_type> const& dest,
+                        std::vector<ImageView<typename ImageT::pixel_type> >* level_images = 0 ) {
+      typedef typename ImageT::pixel_type pixel_type;
+      typedef ReduceStage<pixel_type> stage_type;
+      typedef typename stage_type::real_type real_type;
+      typedef ReducePixel<pixel_type> traits;
+      static const int32 channels = stage_type::channels;
+      VW_ASSERT( levels >= 1, ArgumentErr() << "reduce_levels: need at least one level." );
+
+      // Level sizes going up, then the region needed at each level going down.
+      std::vector<Vector2i> sizes( 1, Vector2i( image.cols(), image.rows() ) );
+      for( int32 l=0; l<levels; ++l )
+        sizes.push_back( Vector2i( (sizes.back().x()+1)/2, (sizes.back().y()+1)/2 ) );
+      std::vector<boost::shared_ptr<stage_type> > chain( levels );
+      BBox2i bbox = out_bbox;
+      for( int32 l=levels-1; l>=0; --l ) {
+        chain[l].reset( new stage_type( filter, sizes[l], bbox, zero_edges ) );
+        bbox = chain[l]->input_bbox();
+      }
+      for( int32 l=0; l<levels-1; ++l ) {
+        chain[l]->set_next( chain[l+1].get() );
+        if( level_images ) {
+          BBox2i const& b = chain[l]->output_bbox();
+          level_images->push_back( ImageView<pixel_type>( b.width(), b.height() ) );
+          chain[l]->set_output( level_images->back() );
+        }
+      }
+      chain[levels-1]->set_output( dest );
+      if( level_images )
+        level_images->push_back( dest );
+
+      BBox2i in_bbox = chain[0]->input_bbox();
+      if( in_bbox.empty() )
+        return;
+      std::vector<real_type> value( size_t(in_bbox.width()) * channels ), weight( in_bbox.width() );
+      const int32 strip_rows = 64;
+      for( int32 y=in_bbox.min().y(); y<in_bbox.max().y(); y+=strip_rows ) {
+        BBox2i strip_bbox( in_bbox.min().x(), y, in_bbox.width(), std::min( strip_rows, in_bbox.max().y()-y ) );
+        ImageView<pixel_type> strip = crop( image, strip_bbox );
+        for( int32 r=0; r<strip.rows(); ++r ) {
+          typename ImageView<pixel_type>::pixel_accessor src = strip.origin().advance( 0, r );
+          for( int32 i=0; i<strip.cols(); ++i, src.next_col() ) {
+            bool valid = traits::valid( *src );
+            typename traits::value_type const& v = traits::value( *src );
+            for( int32 c=0; c<channels; ++c )
+              value[i*channels+c] = valid ? real_type( compound_select_channel<typename CompoundChannelType<typename traits::value_type>::type const&>( v, c ) ) : real_type(0);
+            weight[i] = valid ? 1 : 0;
+          }
+          chain[0]->push_row( y + r, &value[0], &weight[0] );
+        }
+      }
+    }
+
+  } // namespace detail
+
+  /// Reduces an image by a factor of 2^levels in each direction, with
+  /// antialiasing.  Each level halves the previous one, rounding up, and
+  /// all levels of a tile are computed in one pass over its source.
+  ///
+  /// Pixels with an alpha channel are taken to be premultiplied, as
+  /// elsewhere in VW, so they are filtered like any other channel.
+  /// Masked pixels are averaged over their valid neighbors only, and a
+  /// result is invalid if nearly none of the filter covered valid data.
+  /// Taps beyond the image edges are dropped in the same way.
+  template <class ImageT>
+  class ReduceView : public ImageViewBase<ReduceView<ImageT> > {
+    ImageT           m_image;
+    int32            m_levels;
+    ReduceFilterType m_filter;
+    int32            m_cols, m_rows;
+
+  public:
+    typedef typename ImageT::pixel_type pixel_type;
+    typedef pixel_type                  result_type;
+    typedef ProceduralPixelAccessor<ReduceView> pixel_accessor;
+
+    ReduceView( ImageT const& image, int32 levels, ReduceFilterType filter )
+      : m_image( image ), m_levels( levels ), m_filter( filter ),
+        m_cols( image.cols() ), m_rows( image.rows() ) {
+      VW_ASSERT( levels >= 1, ArgumentErr() << "ReduceView: need at least one level." );
+      VW_ASSERT( image.planes() == 1, ArgumentErr() << "ReduceView: multi-plane images are not supported." );
+      for( int32 l=0; l<levels; ++l ) {
+        m_cols = (m_cols+1)/2;
+        m_rows = (m_rows+1)/2;
+      }
+    }
+
+    inline int32 cols  () const { return m_cols; }
+    inline int32 rows  () const { return m_rows; }
+    inline int32 planes() const { return 1; }
+
+    inline pixel_accessor origin() const { return pixel_accessor( *this, 0, 0 ); }
+
+    inline result_type operator()( int32 /*i*/, int32 /*j*/, int32 /*p*/=0 ) const {
+      vw_throw( NoImplErr() << "ReduceView doesn't support single pixel access." );
+    }
+
+    typedef CropView<ImageView<pixel_type> > prerasterize_type;
+    inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+      ImageView<pixel_type> tile( bbox.width(), bbox.height() );
+      detail::reduce_levels( m_image, bbox, m_levels, m_filter, false, tile );
+      return crop( tile, -bbox.min().x(), -bbox.min().y(), cols(), rows() );
+    }
+    template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+      vw::rasterize( prerasterize(bbox), dest, bbox );
+    }
+  };
+
+  /// Reduce an image by 2^levels in each direction.  See ReduceView.
+  template <class ImageT>
+  inline ReduceView<ImageT> reduce_view( ImageViewBase<ImageT> const& image, int32 levels = 1,
+                                         ReduceFilterType filter = GaussianReduceFilter ) {
+    return ReduceView<ImageT>( image.impl(), levels, filter );
+  }
+
+  /// Build levels 1 through num_levels of an image pyramid in one pass
+  /// over the source.  Level l is the source reduced by 2^l, as by
+  /// reduce_view().
+  template <class ImageT>
+  std::vector<ImageView<typename ImageT::pixel_type> >
+  reduce_pyramid( ImageViewBase<ImageT> const& image, int32 num_levels,
+                  ReduceFilterType filter = GaussianReduceFilter ) {
+    typedef typename ImageT::pixel_type pixel_type;
+    std::vector<ImageView<pixel_type> > levels;
+    if( num_levels < 1 )
+      return levels;
+    ReduceView<ImageT> top( image.impl(), num_levels, filter );
+    ImageView<pixel_type> dest( top.cols(), top.rows() );
+    levels.reserve( num_levels );
+    detail::reduce_levels( image.impl(), bounding_box(top), num_levels, filter, false, dest, &levels );
+    return levels;
+  }
+
 }
 
 #endif//__VW_IMAGE_ANTIALIASING_H__
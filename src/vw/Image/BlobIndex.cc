@@ -26,7 +26,6 @@
 
 #include <math.h>
 
-#include <boost/foreach.hpp>
 
 namespace vw {
 
@@ -43,23 +42,6 @@ void BlobCompressed::shift_x( int32 const& value ) {
   m_min[0] += value;
 }
 
-void BlobCompressed::refactor() {
-  for ( uint32 i = 0; i < m_row_end.size(); i++ ) {
-    std::list<int32>::iterator iter_n_start = m_row_start[i].begin(),
-      iter_end = m_row_end[i].begin();
-    iter_n_start++;
-    while ( iter_n_start != m_row_start[i].end() ) {
-      if ( *iter_n_start == *iter_end ) {
-        iter_n_start = m_row_start[i].erase( iter_n_start );
-        iter_end = m_row_end[i].erase( iter_end );
-      } else {
-        iter_n_start++;
-        iter_end++;
-      }
-    }
-  }
-}
-
 BlobCompressed::BlobCompressed( Vector2i const& top_left,
                                 std::vector<std::list<int32> > const& row_start,
                                 std::vector<std::list<int32> > const& row_end ) :
@@ -136,45 +118,6 @@ bool BlobCompressed::intersects( BBox2i const& input ) const {
   return false;
 }
 
-bool BlobCompressed::is_on_right( BlobCompressed const& right ) const {
-  int32 y_offset = m_min.y()-right.min().y()-1;
-  // Starting r_i on the index above
-  for( int32 i = 0, r_i = y_offset;
-       (i < int32(m_row_end.size()))&&(r_i < right.num_rows());
-       i++, r_i++ ) {
-    if ( r_i >= 0 && r_i < int32(right.num_rows()) )
-      if ( m_row_end[i].back() + m_min.x() ==
-           right.m_row_start[r_i].front()+right.min().x() )
-        return true;
-    if ( r_i+1 >= 0 && r_i+1 < int32(right.num_rows()) )
-      if ( m_row_end[i].back() + m_min.x() ==
-           right.m_row_start[r_i+1].front()+right.min().x() )
-        return true;
-    if ( r_i+2 >= 0 && r_i+2 < int32(right.num_rows()) )
-      if ( m_row_end[i].back() + m_min.x() ==
-           right.m_row_start[r_i+2].front()+right.min().x() )
-        return true;
-  }
-  return false;
-}
-
-bool BlobCompressed::is_on_bottom( BlobCompressed const& bottom ) const {
-  if ( bottom.min().y() != m_min.y()+int32(m_row_start.size()) )
-    return false;
-  // Are the rows connected ?
-  for ( std::list<int32>::const_iterator top_start = m_row_start.back().begin(),
-          top_end = m_row_end.back().begin(); top_start != m_row_start.back().end();
-        top_start++, top_end++ )
-    for ( std::list<int32>::const_iterator bot_start = bottom.m_row_start[0].begin(),
-            bot_end = bottom.m_row_end[0].begin(); bot_start != bottom.m_row_start[0].end();
-          bot_start++, bot_end++ ) {
-      if ( (*top_end+m_min.x() >= *bot_start + bottom.min().x()) &&
-           (*top_start+m_min.x() <= *bot_end+bottom.min().x()) )
-        return true;
-    }
-  return false;
-}
-
 void BlobCompressed::add_row( Vector2i const& start,
                               int const& width ) {
   if ( m_min[0] == -1 ) {
@@ -210,174 +153,6 @@ void BlobCompressed::add_row( Vector2i const& start,
   }
 }
 
-void BlobCompressed::absorb( BlobCompressed const& victim ) {
-
-  // First check to see if I'm empty
-  if ( m_row_start.empty() ) {
-    m_min = victim.min();
-    for ( int i = 0; i < victim.num_rows(); i++ ) {
-      m_row_start.push_back( victim.m_row_start[i] );
-      m_row_end.push_back( victim.m_row_end[i] );
-    }
-    return;
-  }
-
-  // Normal operations
-  int y_offset =- m_min.y() + victim.min().y();
-  for ( int i = 0; i < victim.num_rows(); i++ ) {
-    // Index i is in terms of the victim
-    // m_index is in terms of this
-    int m_index = y_offset+i;
-
-    // Checking if can insert
-    if ( m_index >= 0 && m_index < int32(m_row_start.size()) ) {
-
-      // Inserting victim's connected rows in singletons at a time
-      // become sometimes they connect like zippers.
-      for ( std::list<int32>::const_iterator v_singleton_start = victim.m_row_start[i].begin(),
-              v_singleton_end = victim.m_row_end[i].begin(); v_singleton_start != victim.m_row_start[i].end();
-            v_singleton_start++, v_singleton_end++ ) {
-
-        std::list<int32>::iterator start_insertion_point = m_row_start[m_index].begin(),
-          end_insertion_point = m_row_end[m_index].begin(),
-          start_lookahead = m_row_start[m_index].begin();
-        bool found_good_spot = false;
-        if ( m_row_start[m_index].empty()  )
-          found_good_spot = true;
-        else if ( *v_singleton_end+victim.min().x()-m_min.x() <=
-                  m_row_start[m_index].front() )
-          found_good_spot = true;
-        else {
-          start_lookahead++;
-        }
-        while ( start_lookahead != m_row_start[m_index].end() &&
-                !found_good_spot ) {
-          if ( (*v_singleton_start+victim.min().x()-m_min.x() >=
-                *end_insertion_point ) &&
-               (*v_singleton_end+victim.min().x()-m_min.x() <=
-                *start_lookahead ) ) {
-            found_good_spot = true;
-          }
-          start_insertion_point++;
-          end_insertion_point++;
-          start_lookahead++;
-        }
-        // If insert on end
-        if ( (start_lookahead == m_row_start[m_index].end()) &&
-             !found_good_spot ) {
-          if ( *v_singleton_start+victim.min().x()-m_min.x() >=
-               *end_insertion_point ) {
-            found_good_spot = true;
-            start_insertion_point++;
-            end_insertion_point++;
-          }
-        }
-        // Checking for error and debug
-        if ( !found_good_spot ) {
-          vw_out() << "index =  " << m_index << std::endl;
-          vw_out() << "Have: min[" << m_min << "] ";
-          for ( std::list<int32>::const_iterator m_i_str = m_row_start[m_index].begin(),
-                  m_i_end = m_row_end[m_index].begin();
-                m_i_str != m_row_start[m_index].end(); m_i_str++, m_i_end++ )
-            vw_out() << "(" << *m_i_str << "-" << *m_i_end << ")";
-          vw_out() << "\nTrying to insert singleton: (" << *v_singleton_start << "-"
-                   << *v_singleton_end << ")\n";
-
-          vw_throw( NoImplErr() << "BlobCompressed: Seems to be inserting an overlapping blob compressed object.\n" );
-        }
-        // Inserting ( but apply offset fix first)
-        // Is there a simpler way of inserting, without making an intermediate
-        { // Start
-          std::list<int32> temp;
-          temp.push_back( *v_singleton_start+victim.min().x()-m_min.x() );
-          m_row_start[m_index].insert(start_insertion_point,
-                                      temp.begin(),temp.end() );
-        }
-        { // End
-          std::list<int32> temp;
-          temp.push_back( *v_singleton_end+victim.min().x()-m_min.x() );
-          m_row_end[m_index].insert(end_insertion_point,
-                                    temp.begin(), temp.end() );
-        }
-      }
-    }
-  }
-  // Now handle the rows that didn't previously exist
-  // > Insert any on top?
-  if ( victim.min().y() < m_min.y() ) {
-    std::vector<std::list<int32> > temp_start;
-    std::vector<std::list<int32> > temp_end;
-    for ( int v_i = 0; v_i < m_min.y()-victim.min().y(); v_i++ ) {
-      if ( v_i < victim.num_rows() ) {
-        temp_start.push_back(victim.m_row_start[v_i]);
-        temp_end.push_back(victim.m_row_end[v_i]);
-        for ( std::list<int32>::iterator i_start = temp_start.back().begin(),
-                i_stop = temp_end.back().begin();
-              i_start != temp_start.back().end(); i_start++, i_stop++ ) {
-          *i_start += victim.min().x()-m_min.x();
-          *i_stop += victim.min().x()-m_min.x();
-        }
-      } else {
-        // Blank filling. This happens when building a blob from many
-        // that happen out of connection order. Think a U rotated 90
-        // to the left.
-        temp_start.push_back(std::list<int32>());
-        temp_end.push_back(std::list<int32>());
-      }
-    }
-    m_row_start.insert( m_row_start.begin(),
-                        temp_start.begin(),
-                        temp_start.end() );
-    m_row_end.insert( m_row_end.begin(),
-                      temp_end.begin(),
-                      temp_end.end() );
-    m_min.y()=victim.min().y();
-  }
-  // > Insert any on bottom?
-  if ( victim.num_rows()+victim.min().y() >
-       m_min.y() + int32(m_row_end.size()) ) {
-    std::vector<std::list<int32> > temp_start;
-    std::vector<std::list<int32> > temp_end;
-    for ( int v_i = m_row_end.size()+m_min.y()-victim.min().y();
-          v_i < victim.num_rows(); v_i++ ) {
-      if ( v_i < 0 ) {
-        // Blank filling
-        temp_start.push_back(std::list<int32>());
-        temp_end.push_back(std::list<int32>());
-      } else {
-        temp_start.push_back( victim.m_row_start[v_i] );
-        temp_end.push_back( victim.m_row_end[v_i] );
-        for ( std::list<int32>::iterator i_start = temp_start.back().begin(),
-                i_stop = temp_end.back().begin();
-              i_start != temp_start.back().end(); i_start++, i_stop++ ) {
-          *i_start += victim.min().x()-m_min.x();
-          *i_stop += victim.min().x()-m_min.x();
-        }
-      }
-    }
-    m_row_start.insert( m_row_start.end(),
-                        temp_start.begin(),
-                        temp_start.end() );
-    m_row_end.insert( m_row_end.end(),
-                      temp_end.begin(),
-                      temp_end.end() );
-  }
-  // Recalculate min.x()
-  size_t valid_first = 0;
-  while ( valid_first < m_row_start.size() ) {
-    if ( m_row_start[valid_first].size() )
-      break;
-    valid_first++;
-  }
-  int32 lowest_value = m_row_start[valid_first].front();
-  for (size_t i = ++valid_first; i < m_row_start.size(); i++ ) {
-    if ( m_row_start[i].front() < lowest_value )
-      lowest_value = m_row_start[i].front();
-  }
-  this->shift_x( lowest_value );
-  this->refactor();
-}
-
 void BlobCompressed::decompress( std::list<Vector2i>& output ) const {
   output.clear();
   for (int32 r = 0; r < int32(m_row_end.size()); r++ )
@@ -400,156 +175,186 @@ void BlobCompressed::print() const {
   }
 }
 
-class ConsolidateAbsorbTask : public Task, private boost::noncopyable {
-  std::deque<BlobCompressed> &m_src_c_blob, &m_dest_c_blob;
-  std::deque<BBox2i>& m_dest_blob_bbox;
-  std::vector<uint32>& m_lut;
-  int m_max_area;
-  uint32 m_start_index, m_end_index;
-  Mutex& m_append_mutex;
-public:
-  ConsolidateAbsorbTask( std::deque<BlobCompressed>& src_c_blob,
-                         std::deque<BlobCompressed>& dest_c_blob,
-                         std::deque<BBox2i>& dest_blob_bbox,
-                         std::vector<uint32>& lut, int max_area,
-                         uint32 start, uint32 end, Mutex& mutex ) :
-    m_src_c_blob(src_c_blob), m_dest_c_blob(dest_c_blob),
-    m_dest_blob_bbox(dest_blob_bbox), m_lut(lut),
-    m_max_area(max_area), m_start_index(start),
-    m_end_index(end), m_append_mutex(mutex) {}
+UnionFind::UnionFind( size_t size ) : m_parent(size) {
+  for ( size_t i = 0; i < size; i++ )
+    m_parent[i] = i;
+}
 
-  void operator()() {
-    std::deque<BlobCompressed> result_blobs;
-    std::deque<BBox2i> result_bbox;
+uint32 UnionFind::add() {
+  m_parent.push_back( m_parent.size() );
+  return m_parent.back();
+}
 
-    std::vector<std::list<uint32> > absorbtion_list( m_end_index - m_start_index );
+uint32 UnionFind::find( uint32 i ) {
+  while ( m_parent[i] != i ) {
+    m_parent[i] = m_parent[m_parent[i]]; // Path halving
+    i = m_parent[i];
+  }
+  return i;
+}
 
-    // Build the absorbtion list so that we don't have to keep doing
-    // an exhaustive search over m_lut.x
-    for ( size_t i = 0; i < m_lut.size(); i++ ) {
-      if ( m_lut[i] >= m_start_index && m_lut[i] < m_end_index )
-        absorbtion_list[m_lut[i] - m_start_index].push_back(i);
-    }
+void UnionFind::join( uint32 a, uint32 b ) {
+  a = find(a);
+  b = find(b);
+  if ( a < b )
+    m_parent[b] = a;
+  else if ( b < a )
+    m_parent[a] = b;
+}
 
-    // Build the new consolidated blobs
-    for ( size_t i = 0; i < absorbtion_list.size(); i++ ) {
-      // 1: Check to see that the size is going to be less that the
-      // maximium allowed area. Early exit condition.
-      if ( m_max_area > 0 ) {
-        int32 total_size = 0;
-        BOOST_FOREACH( uint32 src_idx, absorbtion_list[i] ) {
-          total_size += m_src_c_blob[src_idx].size();
-          if ( total_size > m_max_area )
-            break;
-        }
-        if ( total_size > m_max_area )
-          continue;
-      }
-
-      // 2: Start absorbing!
-      BlobCompressed current_blob;
-      BOOST_FOREACH( uint32 src_idx, absorbtion_list[i] ) {
-        current_blob.absorb( m_src_c_blob[src_idx] );
-      }
-
-      // 3: Generate the new bounding bbox & Append the results
-      result_blobs.push_back( current_blob );
-      result_bbox.push_back( current_blob.bounding_box() );
-    }
+void find_touching_runs( std::vector<Run> const& above, size_t above_begin, size_t above_end,
+                         std::vector<Run> const& below, size_t below_begin, size_t below_end,
+                         bool eight_connected,
+                         std::vector<std::pair<uint32,uint32> > & pairs ) {
+  // With eight connectivity runs touch if they are diagonal neighbors.
+  int32 reach = eight_connected ? 1 : 0;
+  size_t a = above_begin, b = below_begin;
+  while ( a < above_end && b < below_end ) {
+    if ( above[a].start < below[b].end + reach && below[b].start < above[a].end + reach )
+      pairs.push_back( std::make_pair(uint32(a), uint32(b)) );
+    // Move past whichever run ends first, it can touch nothing further on.
+    if ( above[a].end < below[b].end )
+      a++;
+    else
+      b++;
+  }
+}
 
-    // Finally append the complete results back to the master lists.
-    Mutex::Lock lock( m_append_mutex );
-    m_dest_c_blob.insert( m_dest_c_blob.end(), result_blobs.begin(), result_blobs.end() );
-    m_dest_blob_bbox.insert( m_dest_blob_bbox.end(), result_bbox.begin(), result_bbox.end() );
+/// Find the runs touching across the boundary below one band.
+class BandBoundaryTask : public Task, private boost::noncopyable {
+  std::vector<Run> const& m_above, & m_below;
+  bool m_eight_connected;
+  std::vector<std::pair<uint32,uint32> > & m_pairs;
+public:
+  BandBoundaryTask( std::vector<Run> const& above, std::vector<Run> const& below,
+                    bool eight_connected, std::vector<std::pair<uint32,uint32> > & pairs ) :
+    m_above(above), m_below(below), m_eight_connected(eight_connected), m_pairs(pairs) {}
+
+  void operator()() {
+    if ( m_above.empty() || m_below.empty() )
+      return;
+    // The last row of the band above and the first row of the band below
+    size_t above_begin = m_above.size();
+    while ( above_begin > 0 && m_above[above_begin-1].row == m_above.back().row )
+      above_begin--;
+    size_t below_end = 0;
+    while ( below_end < m_below.size() && m_below[below_end].row == m_below.front().row )
+      below_end++;
+    if ( m_below.front().row != m_above.back().row + 1 )
+      return;
+    find_touching_runs( m_above, above_begin, m_above.size(), m_below, 0, below_end,
+                        m_eight_connected, m_pairs );
   }
 };
 
 } // end namespace blob
 
-void BlobIndexThreaded::consolidate( Vector2i const& image_size,
-                                     Vector2i const& proc_block_size ) {
-  // Working out divisors
-  uint32 x_divisions = uint32(ceil( float(image_size[0])/float(proc_block_size[0]) ));
-  uint32 y_divisions = uint32(ceil( float(image_size[1])/float(proc_block_size[1]) ));
-  std::vector<uint32> x_div, y_div;
-  for ( uint32 i = 1; i < x_divisions; i++ )
-    x_div.push_back( proc_block_size[0]*i );
-  for ( uint32 i = 1; i < y_divisions; i++ )
-    y_div.push_back( proc_block_size[1]*i );
-
-  // Set up graph
-  typedef boost::adjacency_list<boost::vecS,boost::vecS,boost::undirectedS> Graph;
-  Graph connections;
-  add_edge(m_blob_bbox.size()-1,m_blob_bbox.size()-1,connections);
-
-  // Check for bbox on the division line
-  // --> x div
-  for ( uint32 i = 0; i < x_div.size(); i++ ) {
-    std::vector<uint32> left_side;
-    std::vector<uint32> right_side;
-    for ( uint32 b_i = 0; b_i < m_blob_bbox.size(); b_i++ )
-      if ( m_blob_bbox[b_i].max().x() == int32(x_div[i]) )
-        left_side.push_back( b_i );
-      else if ( m_blob_bbox[b_i].min().x() == int32(x_div[i]) )
-        right_side.push_back( b_i );
-
-    // Cool, work which boxes are side by side
-    for ( uint32 l_i = 0; l_i < left_side.size(); l_i++ )
-      for ( uint32 r_i = 0; r_i < right_side.size(); r_i++ ) {
-        uint32 l = left_side[l_i];
-        uint32 r = right_side[r_i];
-        if ( ( m_blob_bbox[l].max().y()+1 >= m_blob_bbox[r].min().y() ) &&
-             ( m_blob_bbox[r].max().y()+1 >= m_blob_bbox[l].min().y() ) )
-          if ( m_c_blob[l].is_on_right(m_c_blob[r]) )
-            add_edge(l,r,connections);
-      }
+void ConnectedComponents::merge_bands( std::vector<std::vector<blob::Run> > & band_runs,
+                                       std::vector<std::vector<uint32   > > const& band_roots,
+                                       bool eight_connected, int32 num_threads ) {
+  size_t num_bands = band_runs.size();
+
+  // Find the touching runs across band boundaries
+  std::vector<std::vector<std::pair<uint32,uint32> > > boundary_pairs( num_bands );
+  if ( num_bands > 2 && num_threads > 1 ) {
+    FifoWorkQueue queue( std::min(size_t(num_threads), num_bands-1) );
+    for ( size_t b = 0; b+1 < num_bands; b++ ) {
+      boost::shared_ptr<Task> task( new blob::BandBoundaryTask( band_runs[b], band_runs[b+1],
+                                                                eight_connected, boundary_pairs[b] ) );
+      queue.add_task( task );
+    }
+    queue.join_all();
+  } else {
+    for ( size_t b = 0; b+1 < num_bands; b++ ) {
+      blob::BandBoundaryTask task( band_runs[b], band_runs[b+1], eight_connected, boundary_pairs[b] );
+      task();
+    }
+  }
+
+  // Concatenate the bands, joining each run to its root within the band.
+  std::vector<size_t> offsets( num_bands+1, 0 );
+  for ( size_t b = 0; b < num_bands; b++ )
+    offsets[b+1] = offsets[b] + band_runs[b].size();
+  m_runs.clear();
+  m_runs.reserve( offsets[num_bands] );
+  blob::UnionFind sets( offsets[num_bands] );
+  for ( size_t b = 0; b < num_bands; b++ ) {
+    m_runs.insert( m_runs.end(), band_runs[b].begin(), band_runs[b].end() );
+    std::vector<blob::Run>().swap( band_runs[b] ); // Free the memory as we go
+    for ( size_t i = 0; i < band_roots[b].size(); i++ )
+      if ( band_roots[b][i] != i )
+        sets.join( offsets[b] + i, offsets[b] + band_roots[b][i] );
   }
-  // --> y div
-  for ( uint32 i = 0; i < y_div.size(); i++ ) {
-    std::vector<uint32> up_side;
-    std::vector<uint32> down_side;
-    up_side.reserve( m_blob_bbox.size() );
-    down_side.reserve( m_blob_bbox.size() );
-    for ( uint32 b_i = 0; b_i < m_blob_bbox.size(); b_i++ )
-      if ( m_blob_bbox[b_i].max().y() == int32(y_div[i]) )
-        up_side.push_back( b_i );
-      else if ( m_blob_bbox[b_i].min().y() == int32(y_div[i]) )
-        down_side.push_back( b_i );
-
-    // Work out which line up
-    for ( uint32 u_i = 0; u_i < up_side.size(); u_i++ )
-      for ( uint32 d_i = 0; d_i < down_side.size(); d_i++ ) {
-        uint32 u = up_side[u_i];
-        uint32 d = down_side[d_i];
-        if ( ( m_blob_bbox[u].max().x()+1 >= m_blob_bbox[d].min().x() ) &&
-             ( m_blob_bbox[d].max().x()+1 >= m_blob_bbox[u].min().x() ) )
-          if ( m_c_blob[u].is_on_bottom(m_c_blob[d]) )
-            add_edge(u,d,connections);
-      }
+
+  // Then join across the band boundaries
+  for ( size_t b = 0; b+1 < num_bands; b++ )
+    for ( size_t i = 0; i < boundary_pairs[b].size(); i++ )
+      sets.join( offsets[b]   + boundary_pairs[b][i].first,
+                 offsets[b+1] + boundary_pairs[b][i].second );
+
+  // A root is the first run of its set, so its label is assigned before
+  // any other run in the set is reached.
+  m_run_labels.resize( m_runs.size() );
+  m_areas.clear();
+  m_bboxes.clear();
+  for ( size_t i = 0; i < m_runs.size(); i++ ) {
+    blob::Run const& run = m_runs[i];
+    uint32 root = sets.find(i);
+    BBox2i run_bbox( run.start, run.row, run.end - run.start, 1 );
+    if ( root == i ) {
+      m_run_labels[i] = m_areas.size();
+      m_areas.push_back ( 0 );
+      m_bboxes.push_back( run_bbox );
+    } else {
+      m_run_labels[i] = m_run_labels[root];
+      m_bboxes[m_run_labels[i]].grow( run_bbox );
+    }
+    m_areas[m_run_labels[i]] += run.end - run.start;
+  }
+}
+
+void ConnectedComponents::label_image( ImageView<uint32> & dst, int32 cols, int32 rows ) const {
+  dst.set_size( cols, rows );
+  fill( dst, 0 );
+  for ( size_t i = 0; i < m_runs.size(); i++ )
+    for ( int32 c = m_runs[i].start; c < m_runs[i].end; c++ )
+      dst( c, m_runs[i].row ) = m_run_labels[i] + 1;
+}
+
+void BlobIndexThreaded::build_blobs( ConnectedComponents const& components ) {
+  // Slot of each kept label in the output, or -1.
+  std::vector<int32> slot( components.num_labels(), -1 );
+  std::vector<std::vector<std::list<int32> > > starts, ends;
+  for ( uint32 l = 0; l < components.num_labels(); l++ ) {
+    if ( m_max_area > 0 && components.area(l) > uint64(m_max_area) )
+      continue;
+    slot[l] = starts.size();
+    starts.push_back( std::vector<std::list<int32> >( components.bbox(l).height() ) );
+    ends.push_back  ( std::vector<std::list<int32> >( components.bbox(l).height() ) );
   }
 
-  std::vector<uint32> component(boost::num_vertices(connections));
-  int final_num = boost::connected_components(connections,&component[0]);
+  // Runs are in raster order, so each row of each blob is built in order.
+  std::vector<blob::Run> const& runs = components.runs();
+  for ( size_t i = 0; i < runs.size(); i++ ) {
+    uint32 l = components.run_label(i);
+    if ( slot[l] < 0 )
+      continue;
+    Vector2i const& min = components.bbox(l).min();
+    starts[slot[l]][runs[i].row - min.y()].push_back( runs[i].start - min.x() );
+    ends  [slot[l]][runs[i].row - min.y()].push_back( runs[i].end   - min.x() );
+  }
 
-  // Spawn threads to coagulate blobs. Creating 2x max number threads
-  // jobs incase the individual jobs are not evenally distributed with
-  // short-circuit conditions like max_area.
-  FifoWorkQueue absorb_queue;
+  m_c_blob.clear();
   m_blob_bbox.clear();
-  std::deque<blob::BlobCompressed> new_c_blob;
-  int number_of_jobs = vw_settings().default_num_threads() * 2;
-  Mutex append_mutex;
-  for ( int j = 0; j < number_of_jobs; j++ ) {
-    int min = ( final_num * j ) / number_of_jobs;
-    int max = ( final_num * (j+1) ) / number_of_jobs;
-    boost::shared_ptr<Task> absorb_task(
-                                        new blob::ConsolidateAbsorbTask( m_c_blob, new_c_blob,
-                                                                         m_blob_bbox, component, m_max_area,
-                                                                         min, max, append_mutex ) );
-    absorb_queue.add_task( absorb_task );
+  for ( uint32 l = 0; l < components.num_labels(); l++ ) {
+    if ( slot[l] < 0 )
+      continue;
+    m_c_blob.push_back( blob::BlobCompressed( components.bbox(l).min(),
+                                              starts[slot[l]], ends[slot[l]] ) );
+    m_blob_bbox.push_back( components.bbox(l) );
+    std::vector<std::list<int32> >().swap( starts[slot[l]] );
+    std::vector<std::list<int32> >().swap( ends  [slot[l]] );
   }
-  absorb_queue.join_all();
-  m_c_blob = new_c_blob;
 }
 
 uint32 BlobIndexThreaded::num_blobs() const { return m_c_blob.size(); }
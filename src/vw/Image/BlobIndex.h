@@ -72,7 +72,6 @@ namespace blob {
     std::vector< std::list<int32> > m_row_end;
 
     void shift_x ( int32 const& value );
-    void refactor();
 
   public:
     BlobCompressed( Vector2i const& top_left,
@@ -93,20 +92,52 @@ namespace blob {
     BBox2i bounding_box() const;
     bool intersects( BBox2i const& input ) const;
 
-    // Specific conditionals used by BlobIndexThreaded
-    bool is_on_right ( BlobCompressed const& right  ) const;
-    bool is_on_bottom( BlobCompressed const& bottom ) const;
-
     // Append a row (since these guys are built a row at a time )
     void add_row( Vector2i const& start, int const& width );
-    // Use to expand this blob into a non overlapped area
-    void absorb( BlobCompressed const& victim );
     // Dump listing of every pixel used
     void decompress( std::list<Vector2i>& output ) const;
     // Print internal data
     void print() const;
   };
 
+  // Run
+  ////////////////////////////////////
+  /// A horizontal run of valid pixels in one row, from column start up
+  /// to but not including column end.
+  struct Run {
+    int32 row, start, end;
+    Run() : row(0), start(0), end(0) {}
+    Run( int32 row_, int32 start_, int32 end_ ) : row(row_), start(start_), end(end_) {}
+  };
+
+  // Union Find
+  ////////////////////////////////////
+  /// Disjoint sets of the integers 0 to size()-1, with path halving.
+  /// - The root of each set is its smallest member, so a set of runs
+  ///   is named by its first run in raster order.
+  class UnionFind {
+    std::vector<uint32> m_parent;
+  public:
+    UnionFind( size_t size = 0 );
+
+    size_t size() const { return m_parent.size(); }
+
+    /// Add a new set holding only the integer size(), and return it.
+    uint32 add();
+    /// The root of the set containing i.
+    uint32 find( uint32 i );
+    /// Merge the sets containing a and b.
+    void   join( uint32 a, uint32 b );
+  };
+
+  /// Append to pairs the index of every run in [above_begin,above_end)
+  /// that touches a run in [below_begin,below_end), the run below being
+  /// in the next row. Both ranges must be sorted by start column.
+  void find_touching_runs( std::vector<Run> const& above, size_t above_begin, size_t above_end,
+                           std::vector<Run> const& below, size_t below_begin, size_t below_end,
+                           bool eight_connected,
+                           std::vector<std::pair<uint32,uint32> > & pairs );
+
   // Blob Index Custom
   ////////////////////////////////////
   /// A different version of Blob index that uses the compressed format and the new options
@@ -314,68 +345,142 @@ namespace blob {
 
 
 
-  // Blob Index Task
+  // Connected Components Band Task
   /////////////////////////////////////
-  /// A task wrapper to allow threading
+  /// Find the runs in a band of rows and join the touching ones. The
+  /// roots are indices into the runs of this band.
   template <class SourceT>
-  class BlobIndexTask : public Task, private boost::noncopyable {
-
-    ImageViewBase<SourceT> const& m_view;
-    BBox2i const& m_bbox;
-    Mutex&        m_append_mutex;
-
-    std::deque<BlobCompressed> &m_c_blob; // reference to global
-    std::deque<BBox2i>     &m_blob_bbox;
-    int m_id;
-    int m_max_area;
+  class ConnectedComponentsBandTask : public Task, private boost::noncopyable {
+    SourceT const&       m_src;
+    int32                m_row_begin, m_row_end;
+    bool                 m_eight_connected;
+    std::vector<Run>   & m_runs;
+    std::vector<uint32>& m_roots;
   public:
-    BlobIndexTask( ImageViewBase<SourceT> const& view,
-                   BBox2i const& bbox, Mutex &mutex,
-                   std::deque<BlobCompressed> & blobs,
-                   std::deque<BBox2i> & blob_boxes,
-                   int const& id, int const& max_area ) :
-    m_view(view), m_bbox(bbox), m_append_mutex(mutex),
-      m_c_blob(blobs), m_blob_bbox(blob_boxes), m_id(id), m_max_area(max_area) {}
+    ConnectedComponentsBandTask( SourceT const& src, int32 row_begin, int32 row_end,
+                                 bool eight_connected,
+                                 std::vector<Run> & runs, std::vector<uint32> & roots ) :
+      m_src(src), m_row_begin(row_begin), m_row_end(row_end),
+      m_eight_connected(eight_connected), m_runs(runs), m_roots(roots) {}
 
     void operator()() {
-      Stopwatch sw;
-      sw.start();
-      ImageView<uint32> index_image(m_bbox.width(),
-                                            m_bbox.height() );
-
-      // Render so threads don't wait on each other
-      ImageView<typename SourceT::pixel_type> cropped_copy = crop(m_view,m_bbox);
-      // Decided only to do trimming in the global perspective. This
-      // avoids weird edge effects.
-      BlobIndex bindex( cropped_copy, index_image);
-
-      // Build local bboxes
-      std::vector<BBox2i> local_bboxes( bindex.num_blobs() );
-      for ( uint32 i = 0; i < bindex.num_blobs(); i++ ) {
-        local_bboxes[i] = bindex.blob(i).bounding_box() + m_bbox.min();
-      }
-
-      { // Append results (single thread)
-        Mutex::Lock lock(m_append_mutex);
-        for ( uint i = 0; i < local_bboxes.size(); i++ ) {
-          m_c_blob.push_back( bindex.blob(i) );
-          m_c_blob.back().min() += m_bbox.min(); // Fix offset
-          m_blob_bbox.push_back( local_bboxes[i] );
+      // Only this band of the image is in memory at once
+      ImageView<typename SourceT::pixel_type> band
+        = crop( m_src, BBox2i(0, m_row_begin, m_src.cols(), m_row_end - m_row_begin) );
+
+      UnionFind sets;
+      std::vector<std::pair<uint32,uint32> > pairs;
+      size_t prev_begin = 0, prev_end = 0;
+      for ( int32 r = 0; r < band.rows(); r++ ) {
+        size_t begin = m_runs.size();
+        int32 c = 0;
+        while ( c < band.cols() ) {
+          if ( !is_valid(band(c,r)) ) {
+            c++;
+            continue;
+          }
+          int32 start = c;
+          while ( c < band.cols() && is_valid(band(c,r)) )
+            c++;
+          m_runs.push_back( Run(m_row_begin + r, start, c) );
+          sets.add();
         }
+
+        pairs.clear();
+        find_touching_runs( m_runs, prev_begin, prev_end, m_runs, begin, m_runs.size(),
+                            m_eight_connected, pairs );
+        for ( size_t i = 0; i < pairs.size(); i++ )
+          sets.join( pairs[i].first, pairs[i].second );
+        prev_begin = begin;
+        prev_end   = m_runs.size();
       }
 
-      sw.stop();
-      vw_out(VerboseDebugMessage,"inpaint") << "Task " << m_id << ": finished, " << sw.elapsed_seconds() << "s\n";
+      m_roots.resize( m_runs.size() );
+      for ( size_t i = 0; i < m_runs.size(); i++ )
+        m_roots[i] = sets.find(i);
     }
   };
+
 } // end namespace blob
 
 
+// Connected Components
+///////////////////////////////////
+/// Labels the connected regions of valid pixels in an image, storing
+/// them as runs in contiguous arrays.
+/// - The image is read one band of rows at a time, so at most
+///   num_threads bands are in memory at once. Each band is labeled
+///   with its own union-find, then the band boundaries are merged.
+/// - Labels are numbered from zero in raster order of their first pixel.
+class ConnectedComponents {
+
+  std::vector<blob::Run> m_runs;       ///< All runs in raster order
+  std::vector<uint32   > m_run_labels; ///< The label of each run
+  std::vector<uint64   > m_areas;      ///< Number of pixels in each label
+  std::vector<BBox2i   > m_bboxes;     ///< Bounding box of each label
+
+  /// Join the band results and compute the final labels.
+  void merge_bands( std::vector<std::vector<blob::Run> > & band_runs,
+                    std::vector<std::vector<uint32   > > const& band_roots,
+                    bool eight_connected, int32 num_threads );
+
+public:
+
+  /// Constructor does all the processing.
+  /// - With eight_connected diagonal neighbors are connected, as in BlobIndex.
+  /// - band_rows is the number of image rows read at a time.
+  template <class SourceT>
+  ConnectedComponents( ImageViewBase<SourceT> const& src,
+                       bool  eight_connected = true,
+                       int32 band_rows       = vw_settings().default_tile_size(),
+                       int32 num_threads     = vw_settings().default_num_threads() ) {
+    VW_ASSERT( band_rows > 0, ArgumentErr() << "ConnectedComponents: band_rows must be positive." );
+    int32 rows = src.impl().rows();
+    int32 num_bands = (rows + band_rows - 1) / band_rows;
+    std::vector<std::vector<blob::Run> > band_runs (num_bands);
+    std::vector<std::vector<uint32   > > band_roots(num_bands);
+
+    typedef blob::ConnectedComponentsBandTask<SourceT> task_type;
+    if ( num_bands > 1 && num_threads > 1 ) {
+      FifoWorkQueue queue( std::min(num_threads, num_bands) );
+      for ( int32 b = 0; b < num_bands; b++ ) {
+        boost::shared_ptr<Task> task( new task_type( src.impl(), b*band_rows,
+                                                     std::min(rows, (b+1)*band_rows),
+                                                     eight_connected, band_runs[b], band_roots[b] ) );
+        queue.add_task( task );
+      }
+      queue.join_all();
+    } else {
+      for ( int32 b = 0; b < num_bands; b++ ) {
+        task_type task( src.impl(), b*band_rows, std::min(rows, (b+1)*band_rows),
+                        eight_connected, band_runs[b], band_roots[b] );
+        task();
+      }
+    }
+
+    merge_bands( band_runs, band_roots, eight_connected, num_threads );
+  }
+
+  uint32 num_labels() const { return m_areas.size(); }
+
+  /// All runs of valid pixels, in raster order.
+  std::vector<blob::Run> const& runs() const { return m_runs; }
+  /// The label of a run.
+  uint32 run_label( size_t run_index ) const { return m_run_labels[run_index]; }
+
+  uint64        area( uint32 label ) const { return m_areas [label]; }
+  BBox2i const& bbox( uint32 label ) const { return m_bboxes[label]; }
+
+  /// Write label+1 at each valid pixel and zero elsewhere.
+  void label_image( ImageView<uint32> & dst, int32 cols, int32 rows ) const;
+};
+
   // Simple interface
+  /// Label the 8-connected blobs of valid pixels from 1, with 0 elsewhere.
   template <class SourceT>
   ImageView<uint32> blob_index( ImageViewBase<SourceT> const& src ) {
-    ImageView<uint32> result( src.impl().cols(), src.impl().rows() );
-    blob::BlobIndex( src, result );
+    ImageView<uint32> result;
+    ConnectedComponents( src ).label_image( result, src.impl().cols(), src.impl().rows() );
     return result;
   }
 
@@ -387,20 +492,18 @@ class BlobIndexThreaded {
   std::deque<BBox2i>           m_blob_bbox;
   std::deque<blob::BlobCompressed> m_c_blob;
 
-  Mutex m_insert_mutex;
   int m_max_area;
   int m_tile_size;
 
-  // Tasks might section a blob in half.
-  // This will match them
-  void consolidate( Vector2i const& image_size,
-                    Vector2i const& proc_block_size );
+  /// Convert the labels no larger than m_max_area to compressed blobs.
+  void build_blobs( ConnectedComponents const& components );
 
  public:
  
   /// Constructor does most of the processing work
   /// - This is the function to call to detect blobs!
   /// - Blobs larger than max_area (if > zero) are discarded.
+  /// - The image is labeled tile_size rows at a time, see ConnectedComponents.
   template <class SourceT>
   BlobIndexThreaded( ImageViewBase<SourceT> const& src,
                      int32 const& max_area    = 0,
@@ -408,49 +511,13 @@ class BlobIndexThreaded {
                      int32 const& num_threads = vw_settings().default_num_threads()
                      )
     : m_max_area(max_area), m_tile_size(tile_size) {
-    
-    std::vector<BBox2i> bboxes = subdivide_bbox( src.impl(), m_tile_size, m_tile_size );
     // User needs to remember to give a pixel mask'd input
-    typedef blob::BlobIndexTask<SourceT> task_type;
-    if (bboxes.size() > 1){
-      Stopwatch sw;
-      sw.start();
-      FifoWorkQueue queue(num_threads);
-      
-      for ( size_t i = 0; i < bboxes.size(); ++i ) {
-        boost::shared_ptr<task_type> task(new task_type(src, bboxes[i],
-                                                        m_insert_mutex,
-                                                        m_c_blob, m_blob_bbox,
-                                                        i, m_max_area ));
-        queue.add_task(task);
-      }
-      queue.join_all();
-      
-      sw.stop();
-      vw_out(DebugMessage,"inpaint") << "Blob detection took " << sw.elapsed_seconds() << "s\n";
-      consolidate( Vector2i( src.impl().cols(), src.impl().rows() ),
-                   Vector2i( m_tile_size, m_tile_size ) );
-    }else if (bboxes.size() == 1){
-      // This is a special case when we want to fill in holes
-      // in a single small image.
-      boost::shared_ptr<task_type> task(new task_type(src, bboxes[0],
-                                                      m_insert_mutex,
-                                                      m_c_blob, m_blob_bbox,
-                                                      0, m_max_area ));
-      (*task.get())();
-    }
-    
-
-    // Cull blobs that are too big.
-    if ( m_max_area > 0 ) {
-      for ( std::deque<blob::BlobCompressed>::iterator iter = m_c_blob.begin();
-            iter != m_c_blob.end(); iter++ ) {
-        if ( iter->size() > m_max_area ) {
-          iter = m_c_blob.erase( iter );
-          iter--;
-        }
-      }
-    }
+    Stopwatch sw;
+    sw.start();
+    ConnectedComponents components( src, true, m_tile_size, num_threads );
+    build_blobs( components );
+    sw.stop();
+    vw_out(DebugMessage,"inpaint") << "Blob detection took " << sw.elapsed_seconds() << "s\n";
   }
 
   /// Wipe blobs bigger than this size.
@@ -548,53 +615,21 @@ public:
     ImageView<typename ImageT::pixel_type> input_tile = crop(m_input_image, big_bbox);
     //std::cout << "Searching for blobs in " << big_bbox << std::endl;
 
-    // Use a single thread to search for blobs in this image with no max blob size.
-    int tile_size = std::max(big_bbox.width(), big_bbox.height());
-    BlobIndexThreaded blob_index(input_tile, 0, tile_size, 1);
-    
-    // Loop through all the blobs and assign pixel scores
-    BlobIndexThreaded::const_blob_iterator blob_iter = blob_index.begin();
-    //std::cout << "Found " << blob_index.num_blobs() << " blobs.\n";
-    while (blob_iter != blob_index.end()) { // Loop through blobs
-      uint32 blob_size = blob_iter->size();
-      //std::cout << "Blob size =  " << blob_size << "\n";
-      if (blob_size > m_size_limit)
-        blob_size = m_size_limit;
-        
-      // Loop through rows in blobs
-      int num_rows = blob_iter->num_rows();
-      //std::cout << "num_rows = " << num_rows << std::endl;
-      std::list<int32>::const_iterator start_iter, stop_iter;
-      for (int r=0; r<num_rows; ++r) {
-      
-        // Loop through sections in row
-        int row = r + blob_iter->min()[1] + big_bbox.min()[1]; // Absolute row
-        start_iter = blob_iter->start(r).begin();
-        stop_iter  = blob_iter->end(r).begin();
-        while (start_iter != blob_iter->start(r).end()) { 
-          //std::cout << "start = " << *start_iter << ", stop = " << *stop_iter << std::endl;
-          
-          // Loop through pixels in section
-          for (int c=*start_iter; c<*stop_iter; ++c) { 
-            int col = c + blob_iter->min()[0] + big_bbox.min()[0]; // Absolute col
-            Vector2i pixel(col,row);
-            //std::cout << "Searching for blobs in " << big_bbox << std::endl;
-            //std::cout << "Pixel = " << pixel << ", raw = " << Vector2i(c,r) << std::endl;
-            if (!bbox.contains(pixel))
-              continue; // Skip blob pixels outside the current tile
-            Vector2i tile_pixel = pixel - bbox.min();
-            //std::cout << "Pixel = " << pixel << ", tile_pixel = " << tile_pixel << ", raw = " << Vector2i(c,r) << std::endl;
-            output_tile(tile_pixel[0], tile_pixel[1]) = blob_size; // Set the size of the pixel!
-          } // End loop through pixels
-          
-          ++start_iter;
-          ++stop_iter;
-        } // End loop through sections
-        
-      } // End loop through rows
-      
-      ++blob_iter;
-    } // End loop through blobs
+    // Use a single thread to label this tile, all at once.
+    ConnectedComponents components(input_tile, true, std::max(1, input_tile.rows()), 1);
+
+    // Write the size of its blob at each pixel in each run inside the tile
+    std::vector<blob::Run> const& runs = components.runs();
+    for (size_t i = 0; i < runs.size(); i++) {
+      int row = runs[i].row + big_bbox.min().y(); // Absolute row
+      if (row < bbox.min().y() || row >= bbox.max().y())
+        continue; // Skip runs outside the current tile
+      uint64 blob_size = std::min(components.area(components.run_label(i)), uint64(m_size_limit));
+      int col_begin = std::max(runs[i].start + big_bbox.min().x(), bbox.min().x());
+      int col_end   = std::min(runs[i].end   + big_bbox.min().x(), bbox.max().x());
+      for (int col = col_begin; col < col_end; ++col)
+        output_tile(col - bbox.min().x(), row - bbox.min().y()) = blob_size;
+    }
 
     // Perform tile size faking trick to make small tile look the size of the entire image
     return prerasterize_type(output_tile,
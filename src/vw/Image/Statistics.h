@@ -410,6 +410,7 @@ namespace vw {
   }
 
   // Find the histogram of an image. 
+  // - This reads the image twice, first for the range and then for the bins.
   template <class ViewT>
   void histogram( const ImageViewBase<ViewT> &view, int num_bins, math::Histogram &hist);
 
@@ -435,6 +436,9 @@ namespace vw {
   double optimal_threshold( const ImageViewBase<ViewT> &view);
 
   /// Converts a single channel image into a uint8 image with percentile based intensity scaling.
+  /// - The range and the percentiles are found in one read of the image,
+  ///   with a quantile estimate.  As before, the percentiles are rounded
+  ///   up to the edge of their bin in a histogram of num_bins bins.
   template <class ViewT>
   void percentile_scale_convert(ImageViewBase<ViewT> const& input_image,
                                 ImageView<vw::uint8> &output_image,
@@ -470,78 +474,72 @@ namespace vw {
     }
   };
 
-  // TODO: Replace!
-  template <typename T>
-  struct PixelCollector {
-    std::vector<T> m_vec;
-    
-    void operator()(T p) {
-      m_vec.push_back(p);
+  /// Thread safe functor to apply an accumulator to the valid pixels of
+  /// a single channel image, one block at a time.
+  /// - Each block is accumulated into its own copy of the initial
+  ///   accumulator, which is then merged into the result, so AccumT must
+  ///   support merging through operator()(AccumT&).
+  /// - The accumulator object must be "fresh" when passed in, since its
+  ///   settings are copied for each block.
+  template <class AccumT>
+  class ParallelAccumulatorFunctor {
+
+    AccumT * m_accum_ptr;
+    AccumT   m_prototype;
+    int      m_subsample_amt;
+    Mutex    m_mutex;
+
+  public:
+
+    /// Constructor takes a pointer to the accumulator that will be populated.
+    ParallelAccumulatorFunctor(AccumT* ptr, int subsample_amt=1)
+      : m_accum_ptr(ptr), m_prototype(*ptr), m_subsample_amt(subsample_amt) {
+      VW_ASSERT(subsample_amt > 0, ArgumentErr() << "Subsample amount must be positive.");
     }
-  };
-  
-  /// Thread safe functor to accumulate CDF results on multiple single channel images.
-  /// - A CDF is computed for each image and they are then merged together.
-  template<typename T>
-  class ParallelCdfFunctor {
 
-    typedef vw::math::CDFAccumulator<T> CdfType;
+    /// Process an image block and merge it into the result.
+    template <class PixelT>
+    void operator()(ImageView<PixelT> const& image, BBox2i const& bbox) {
 
-    CdfType * m_cdf_ptr;
-    int m_subsample_amt;
-    Mutex  m_mutex;
+      AccumT local_accum(m_prototype);
+      for (int row = 0; row < image.rows(); row += m_subsample_amt) {
+        for (int col = 0; col < image.cols(); col += m_subsample_amt) {
+          if ( is_valid(image(col, row)) )
+            local_accum(remove_mask(image(col, row)));
+        }
+      }
 
+      Mutex::Lock lock(m_mutex);
+      m_accum_ptr->operator()(local_accum);
+    }
+  }; // End class ParallelAccumulatorFunctor
+
+  /// Thread safe functor to accumulate CDF results on multiple single channel images.
+  /// - A CDF is computed for each image and they are then merged together.
+  template<typename T>
+  class ParallelCdfFunctor : public ParallelAccumulatorFunctor<vw::math::CDFAccumulator<T> > {
   public:
+    ParallelCdfFunctor(vw::math::CDFAccumulator<T>* ptr, int subsample_amt=1)
+      : ParallelAccumulatorFunctor<vw::math::CDFAccumulator<T> >(ptr, subsample_amt) {}
+  };
 
-    /// Constructor takes a pointer to the CDF object that will be populated.
-    ParallelCdfFunctor(CdfType* ptr, int subsample_amt=1)
-      : m_cdf_ptr(ptr), m_subsample_amt(subsample_amt) {}
-
-    /// Process an image and incorporate it into the input CDF object.
-    template <class ImageT>
-    void operator()(ImageView<ImageT> const& image, BBox2i const& bbox) {
-
-      // Compute a CDF on just this input image.
-      //CdfType local_cdf(1000, 20);
-      //SingleChannelAccumulator<CdfType> accumulator(&local_cdf);
-
-      // TODO: The CDF class cannot merge properly, so use this alternative
-      //       method until it is fixed!
-      typedef PixelCollector<float> PC; // TODO: Fix type!
-      PC pixel_accum;
-      float est_num_pixels = (image.rows()/m_subsample_amt)*(image.cols()/m_subsample_amt);
-      pixel_accum.m_vec.reserve(int(est_num_pixels * 1.2));
-      SingleChannelAccumulator<PC> accumulator(&pixel_accum);
-      for_each_pixel( subsample( edge_extend(image, ConstantEdgeExtension()),
-                                 m_subsample_amt ),
-                      accumulator);
-
-      // Merge the local CDF with the main CDF.
-      m_mutex.lock();
-      /*
-      std::cout << "\nBLOCK val =";
-      std::cout << "\nval = " << local_cdf.quantile(0);
-      std::cout << "\nval = " << local_cdf.quantile(1); // Max
-      std::cout << "\nval = " << local_cdf.approximate_mean();
-      std::cout << "\nval = " << local_cdf.approximate_stddev();
-      std::cout << "\nval = " << local_cdf.quantile(0.02); // Percentile values
-      std::cout << "\nval = " << local_cdf.quantile(0.98) << std::endl;
-      */
-      //m_cdf_ptr->operator()(local_cdf);  // TODO: Fix this!
-      for (size_t i=0; i<pixel_accum.m_vec.size(); ++i)
-        m_cdf_ptr->operator()(pixel_accum.m_vec[i]);
-      /*
-      std::cout << "\nNEW val =";
-      std::cout << "\nval = " << m_cdf_ptr->quantile(0);
-      std::cout << "\nval = " << m_cdf_ptr->quantile(1); // Max
-      std::cout << "\nval = " << m_cdf_ptr->approximate_mean();
-      std::cout << "\nval = " << m_cdf_ptr->approximate_stddev();
-      std::cout << "\nval = " << m_cdf_ptr->quantile(0.02); // Percentile values
-      std::cout << "\nval = " << m_cdf_ptr->quantile(0.98) << std::endl;*/
-      m_mutex.unlock();
-    }
-  }; // End class ParallelCdfFunctor
-  
+  /// Apply an accumulator to all valid pixels of a single channel image,
+  /// reading the image only once.
+  /// - See ParallelAccumulatorFunctor for the requirements on AccumT.
+  /// - math::StatisticsAccumulator can compute the range, mean, standard
+  ///   deviation, quantiles and histogram of the image at the same time.
+  /// - The blocks are processed with the default number of threads, as
+  ///   in block_cdf_computation().
+  template <class ViewT, class AccumT>
+  void block_accumulate(ImageViewBase<ViewT> const& image,
+                        AccumT  &accum,
+                        int      subsample_amt = 1,
+                        Vector2i block_size    = Vector2i(256,256)) {
+    ParallelAccumulatorFunctor<AccumT> functor(&accum, subsample_amt);
+
+    // No need for a cache since each tile will be visited only once.
+    block_op(image, functor, block_size);
+  }
 
   /// Compute the CDF of an image using multiple threads.
   /// - The CDF object must be "fresh" when passed to this function.
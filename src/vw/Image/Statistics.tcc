@@ -24,48 +24,28 @@ void histogram( const ImageViewBase<ViewT> &view, int num_bins, math::Histogram
   
   VW_ASSERT(num_bins > 0, ArgumentErr() << "histogram: number of input bins must be positive");
   
-  // Find the maximum and minimum
-  double max_val = -std::numeric_limits<double>::max(), min_val = -max_val;
-  for (int row = 0; row < view.impl().rows(); row++){
-    for (int col = 0; col < view.impl().cols(); col++){
-      if ( !is_valid(view.impl()(col, row)) )
-        continue;
-      double val = view.impl()(col, row);
-      if (val < min_val) min_val = val;
-      if (val > max_val) max_val = val;
-    }
-  }
-  if (max_val == min_val)
-    max_val = min_val + 1.0;
-    
-  hist.initialize(num_bins, min_val, max_val);
-  for (int row = 0; row < view.impl().rows(); row++){
-    for (int col = 0; col < view.impl().cols(); col++){
-      if ( !is_valid(view.impl()(col, row)) )
-        continue;
-      double val = view.impl()(col, row);
-      hist.add_value_no_check(val);
-    }
-  }
+  // Find the maximum and minimum. The bins depend on them, so this
+  // reads the image a second time to fill the histogram.
+  double min_val, max_val;
+  find_image_min_max(view, min_val, max_val);
 
-  return;
+  histogram(view, num_bins, min_val, max_val, hist);
 }
 
 
 template <class ViewT>
 void find_image_min_max( const ImageViewBase<ViewT> &view, double &min_val, double &max_val){
 
-  max_val = -std::numeric_limits<double>::max();
-  min_val = -max_val;
-  for (int row = 0; row < view.impl().rows(); row++){
-    for (int col = 0; col < view.impl().cols(); col++){
-      if ( !is_valid(view.impl()(col, row)) ) 
-        continue;
-      double val = view.impl()(col, row);
-      if (val < min_val) min_val = val;
-      if (val > max_val) max_val = val;
-    }
+  math::StatisticsAccumulator accum;
+  block_accumulate(view, accum);
+
+  if (accum.num_samples() == 0) {
+    max_val = -std::numeric_limits<double>::max();
+    min_val = -max_val;
+    return;
   }
+  min_val = accum.minimum();
+  max_val = accum.maximum();
 }
 
 template <class ViewT>
@@ -77,16 +57,10 @@ void histogram( const ImageViewBase<ViewT> &view, int num_bins, double min_val,
   if (max_val == min_val) 
     max_val = min_val + 1.0;
   
-  hist.initialize(num_bins, min_val, max_val);
-  for (int row = 0; row < view.impl().rows(); row++){
-    for (int col = 0; col < view.impl().cols(); col++){
-      if ( !is_valid(view.impl()(col, row)) )
-        continue;
-      double val = view.impl()(col, row);
-      hist.add_value(val);
-    }
-  }
-  return;
+  math::StatisticsAccumulator accum;
+  accum.set_histogram(num_bins, min_val, max_val);
+  block_accumulate(view, accum);
+  hist = accum.histogram();
 }
 
 
@@ -148,20 +122,29 @@ void percentile_scale_convert(ImageViewBase<ViewT> const& input_image,
                               ImageView<vw::uint8> &output_image,
                               double low_percentile, double high_percentile, int num_bins) {
 
-  // First get the min and max values
-  double min_val, max_val;
-  find_image_min_max(input_image, min_val, max_val);
+  VW_ASSERT(num_bins > 0, ArgumentErr() << "percentile_scale_convert: number of input bins must be positive");
 
-  // Compute the input image histogram
-  math::Histogram hist;
-  histogram(input_image, num_bins, min_val, max_val, hist);
-
-  // Find the bins at the input percentiles
-  size_t low_bin  = hist.get_percentile(low_percentile );
-  size_t high_bin = hist.get_percentile(high_percentile);
+  // Find the range and the percentiles in a single read of the image.
+  // The quantiles are estimated a little finer than the bins.
+  math::StatisticsAccumulator accum(std::max(251, 2*num_bins+1));
+  block_accumulate(input_image, accum);
+  if (accum.num_samples() == 0) {
+    output_image.set_size(input_image.impl().cols(), input_image.impl().rows());
+    fill(output_image, 0);
+    return;
+  }
+  double min_val = accum.minimum(), max_val = accum.maximum();
+  if (max_val == min_val)
+    max_val = min_val + 1.0;
 
-  // Find the input values that correspond to the bin indices
-  double bin_width  = hist.get_bin_width();
+  // Round the percentiles up to the edge of their bin in a histogram of
+  // num_bins bins over the range, as the percentiles of such a histogram
+  // used to be taken.
+  double bin_width = (max_val - min_val) / num_bins;
+  double low_bin   = floor((accum.quantile(low_percentile ) - min_val) / bin_width);
+  double high_bin  = floor((accum.quantile(high_percentile) - min_val) / bin_width);
+  low_bin  = std::min(std::max(low_bin,  0.0), num_bins - 1.0);
+  high_bin = std::min(std::max(high_bin, 0.0), num_bins - 1.0);
   double low_value  = (low_bin +1) * bin_width + min_val;
   double high_value = (high_bin+1) * bin_width + min_val;
 
@@ -169,6 +152,3 @@ void percentile_scale_convert(ImageViewBase<ViewT> const& input_image,
   output_image = pixel_cast<vw::uint8>(normalize( clamp(input_image, low_value, high_value),
                                                         low_value, high_value, 0.0, 255.0 ));
 }
-
-
-
@@ -29,6 +29,12 @@
 #include <vw/Image/ImageViewBase.h>
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/Interpolation.h>
+#include <vw/Image/PixelMask.h>
+
+#include <boost/utility/enable_if.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <vector>
+#include <algorithm>
 
 static const double VW_DEFAULT_MIN_TRANSFORM_IMAGE_SIZE = 1;
 static const double VW_DEFAULT_MAX_TRANSFORM_IMAGE_SIZE = 1e10; // Ten gigapixels
@@ -135,87 +141,203 @@ namespace vw {
   // ApproximateTransform image transform functor template.
   //
   // Mimics the behavior of a given transform functor, but attempts to
-  // build a lookup table to linearly interpolate approimate results
-  // to the reverse() function for arguments within the given bounding
-  // box, to within the original transform functor's tolerance.
+  // linearly interpolate approximate results to the reverse() function
+  // for arguments within the given bounding box, to within the original
+  // transform functor's tolerance.
+  //
+  // The bounding box is covered by a quadtree of cells.  A cell is split
+  // in four only where the transform bends too much for bilinear
+  // interpolation between its corners, so a difficult corner of the box
+  // (near a pole, or the edge of a DEM) does not densify the rest of it.
+  // Cells that are still too curved at a couple of pixels across are
+  // evaluated exactly.  Points are found through a uniform index over
+  // the upper levels of the tree.
   template <class TransformT>
   class ApproximateTransform : public TransformT {
-    BBox2i m_bbox;
-    ImageView<Vector2> m_table;
+
+    // A quadtree cell, spanning [x0,x0+width] x [y0,y0+height].
+    struct Cell {
+      double  x0, y0, width, height;
+      Vector2 m00, m10, m01, m11; // reverse() at the four corners
+      int32   child;              // First of four children, or -1 for a leaf
+      bool    exact;              // A leaf too curved to interpolate
+    };
+
+    BBox2i            m_bbox;
+    std::vector<Cell> m_cells;
+    std::vector<int32> m_index;   // Cell for each index bin, row major
+    int32             m_index_size;
+    double            m_index_sx, m_index_sy;
+
+    // Maximum depth of the uniform index; deeper cells are reached
+    // from the index bins by descending the tree.
+    static const int32 MAX_INDEX_DEPTH = 8;
+
+    // Cells narrower or shorter than this are not split.
+    static const int32 MIN_SPLIT_SIZE = 4;
+
+    static inline Vector2 interpolate( Cell const& c, double normx, double normy ) {
+      return Vector2( (c.m00.x()*(1-normy)+c.m01.x()*normy)*(1-normx) +
+                      (c.m10.x()*(1-normy)+c.m11.x()*normy)*normx,
+                      (c.m00.y()*(1-normy)+c.m01.y()*normy)*(1-normx) +
+                      (c.m10.y()*(1-normy)+c.m11.y()*normy)*normx );
+    }
+
+    // Find the leaf holding p.  Points outside the box land in the
+    // nearest leaf, which then extrapolates.
+    inline int32 find_leaf( double x, double y ) const {
+      int32 ix = math::impl::_floor( (x - m_bbox.min().x()) * m_index_sx );
+      int32 iy = math::impl::_floor( (y - m_bbox.min().y()) * m_index_sy );
+      if( ix < 0 ) ix = 0;
+      if( ix >= m_index_size ) ix = m_index_size-1;
+      if( iy < 0 ) iy = 0;
+      if( iy >= m_index_size ) iy = m_index_size-1;
+      int32 id = m_index[iy*m_index_size+ix];
+      while( m_cells[id].child >= 0 ) {
+        Cell const& c = m_cells[id];
+        id = c.child + ( x >= c.x0 + c.width /2 ? 1 : 0 )
+                     + ( y >= c.y0 + c.height/2 ? 2 : 0 );
+      }
+      return id;
+    }
+
   public:
     ApproximateTransform( TransformT const& transform, BBox2i const& bbox )
-      : TransformT( transform ), m_bbox( bbox ), m_table(2,2)
+      : TransformT( transform ), m_bbox( bbox ), m_index_size(1)
     {
-      // Initialize with a simple 2x2 lookup table
-      int32 n=2;
-      m_table(0,0) = TransformT::reverse(bbox.min());
-      m_table(1,0) = TransformT::reverse(Vector2(bbox.max().x(),bbox.min().y()));
-      m_table(0,1) = TransformT::reverse(Vector2(bbox.min().x(),bbox.max().y()));
-      m_table(1,1) = TransformT::reverse(bbox.max());
-
-      // Double the grid density until the worst (squared) approximation error
-      // is less than the allowed (squared) tolerance.
-      double max_sqr_err = 0;
       double tol_sqr = TransformT::tolerance() * TransformT::tolerance();
-      Vector2 origin = bbox.min(), diag = bbox.size();
-      do {
-        n = 2*n-1;
-        // Fall back for unapproximatably crazy transform functions.
-        if( n>=bbox.width()|| n>=bbox.height() ) {
-          m_table.reset();
-          return;
+
+      Cell root;
+      root.x0 = bbox.min().x();  root.width  = bbox.width();
+      root.y0 = bbox.min().y();  root.height = bbox.height();
+      root.m00 = TransformT::reverse( bbox.min() );
+      root.m10 = TransformT::reverse( Vector2(bbox.max().x(),bbox.min().y()) );
+      root.m01 = TransformT::reverse( Vector2(bbox.min().x(),bbox.max().y()) );
+      root.m11 = TransformT::reverse( bbox.max() );
+      root.child = -1;
+      root.exact = false;
+      m_cells.push_back( root );
+
+      // Split cells breadth first, checking the transform at the center
+      // and edge midpoints of each cell against the interpolated
+      // value.  Those samples become the corners of the children.
+      int32 max_depth = 0;
+      std::vector<int32> level( 1, 0 ), next;
+      while( !level.empty() ) {
+        next.clear();
+        for( size_t k=0; k<level.size(); ++k ) {
+          Cell c = m_cells[level[k]];
+          double cx = c.x0 + c.width/2, cy = c.y0 + c.height/2;
+          double x1 = c.x0 + c.width,   y1 = c.y0 + c.height;
+          Vector2 top    = TransformT::reverse( Vector2(cx,c.y0) );
+          Vector2 bottom = TransformT::reverse( Vector2(cx,y1)   );
+          Vector2 left   = TransformT::reverse( Vector2(c.x0,cy) );
+          Vector2 right  = TransformT::reverse( Vector2(x1,cy)   );
+          Vector2 center = TransformT::reverse( Vector2(cx,cy)   );
+          double sqr_err = std::max( std::max( norm_2_sqr( top    - (c.m00+c.m10)/2.0 ),
+                                               norm_2_sqr( bottom - (c.m01+c.m11)/2.0 ) ),
+                                     std::max( std::max( norm_2_sqr( left  - (c.m00+c.m01)/2.0 ),
+                                                         norm_2_sqr( right - (c.m10+c.m11)/2.0 ) ),
+                                               norm_2_sqr( center - (c.m00+c.m10+c.m01+c.m11)/4.0 ) ) );
+          if( !(sqr_err > tol_sqr) )
+            continue;
+          if( c.width < MIN_SPLIT_SIZE || c.height < MIN_SPLIT_SIZE ) {
+            m_cells[level[k]].exact = true;
+            continue;
+          }
+
+          int32 first = int32( m_cells.size() );
+          m_cells[level[k]].child = first;
+          Cell q;
+          q.width = c.width/2;  q.height = c.height/2;
+          q.child = -1;  q.exact = false;
+          q.x0 = c.x0;  q.y0 = c.y0;
+          q.m00 = c.m00;  q.m10 = top;    q.m01 = left;   q.m11 = center;  m_cells.push_back( q );
+          q.x0 = cx;
+          q.m00 = top;    q.m10 = c.m10;  q.m01 = center; q.m11 = right;   m_cells.push_back( q );
+          q.x0 = c.x0;  q.y0 = cy;
+          q.m00 = left;   q.m10 = center; q.m01 = c.m01;  q.m11 = bottom;  m_cells.push_back( q );
+          q.x0 = cx;
+          q.m00 = center; q.m10 = right;  q.m01 = bottom; q.m11 = c.m11;   m_cells.push_back( q );
+          for( int32 i=0; i<4; ++i )
+            next.push_back( first+i );
         }
-        ImageView<Vector2> prev = m_table;
-        m_table.set_size(n,n);
-        max_sqr_err = 0;
-        for( int y=0; y<n; ++y ) {
-          for( int x=0; x<n; ++x ) {
-            if( (y%2)==0 && (x%2==0) ) {
-              m_table(x,y) = prev(x/2,y/2);
-            }
-            else {
-              Vector2 pos = Vector2(x,y)/(n-1);
-              m_table(x,y) = TransformT::reverse(origin+elem_prod(pos,diag));
-              Vector2 interp;
-              if( (y%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2+1,y/2)) / 2.0;
-              else if( (x%2)==0 ) interp = (prev(x/2,y/2) + prev(x/2,y/2+1)) / 2.0;
-              else interp = (prev(x/2,y/2) + prev(x/2,y/2+1) + prev(x/2+1,y/2) + prev(x/2+1,y/2+1)) / 4.0;
-              double sqr_err = norm_2_sqr( m_table(x,y) - interp );
-              if( sqr_err > max_sqr_err ) max_sqr_err = sqr_err;
-            }
+        if( !next.empty() )
+          ++max_depth;
+        level.swap( next );
+      }
+
+      // Point each index bin at the deepest cell that covers all of it.
+      int32 depth = std::min( max_depth, int32(MAX_INDEX_DEPTH) );
+      m_index_size = 1 << depth;
+      m_index_sx = bbox.width () > 0 ? m_index_size / double(bbox.width ()) : 0;
+      m_index_sy = bbox.height() > 0 ? m_index_size / double(bbox.height()) : 0;
+      m_index.resize( m_index_size * m_index_size );
+      for( int32 iy=0; iy<m_index_size; ++iy ) {
+        for( int32 ix=0; ix<m_index_size; ++ix ) {
+          double x = bbox.min().x() + (ix+0.5) / m_index_sx;
+          double y = bbox.min().y() + (iy+0.5) / m_index_sy;
+          int32 id = 0;
+          for( int32 d=0; d<depth && m_cells[id].child >= 0; ++d ) {
+            Cell const& c = m_cells[id];
+            id = c.child + ( x >= c.x0 + c.width /2 ? 1 : 0 )
+                         + ( y >= c.y0 + c.height/2 ? 2 : 0 );
           }
+          m_index[iy*m_index_size+ix] = id;
         }
-      } while( max_sqr_err > tol_sqr );
+      }
     }
 
     inline Vector2 reverse( Vector2 const& p ) const {
-      // Fall back if the function was not approximatable.
-      if( ! m_table.is_valid_image() )
+      Cell const& c = m_cells[ find_leaf( p.x(), p.y() ) ];
+      if( c.exact || c.width <= 0 || c.height <= 0 )
         return TransformT::reverse( p );
+      return interpolate( c, (p.x() - c.x0) / c.width, (p.y() - c.y0) / c.height );
+    }
+
+    // Evaluate reverse() for count pixels of an output row starting at
+    // (col,row), with the same results.  Along a row a cell is linear
+    // in x, so its two interpolated endpoints are only computed again
+    // when the row crosses into another cell.
+    void reverse_row( int32 row, int32 col, int32 count, double* xs, double* ys ) const {
+      int32  cell = -1;
+      double x_end = 0, normy = 0;
+      double ax = 0, ay = 0, bx = 0, by = 0;
+      for( int32 i=0; i<count; ++i ) {
+        double x = col + i;
+        if( cell < 0 || x >= x_end || x < m_cells[cell].x0 ) {
+          cell = find_leaf( x, row );
+          Cell const& c = m_cells[cell];
+          x_end = c.x0 + c.width;
+          normy = (row - c.y0) / c.height;
+          ax = c.m00.x()*(1-normy)+c.m01.x()*normy;  ay = c.m00.y()*(1-normy)+c.m01.y()*normy;
+          bx = c.m10.x()*(1-normy)+c.m11.x()*normy;  by = c.m10.y()*(1-normy)+c.m11.y()*normy;
+        }
+        Cell const& c = m_cells[cell];
+        if( c.exact || c.width <= 0 || c.height <= 0 ) {
+          Vector2 pt = TransformT::reverse( Vector2(x,row) );
+          xs[i] = pt.x();
+          ys[i] = pt.y();
+          continue;
+        }
+        double normx = (x - c.x0) / c.width;
+        xs[i] = ax*(1-normx) + bx*normx;
+        ys[i] = ay*(1-normx) + by*normx;
+      }
+    }
 
-      // We re-implement bilinear interpolation by hand here because for
-      // some reason the BilinearInterpolation object is exceptionally
-      // slow for Vector data still.
-      int    n  = m_table.cols() - 1;
-      double px = n * (p.x() - m_bbox.min().x()) / (m_bbox.max().x() - m_bbox.min().x());
-      double py = n * (p.y() - m_bbox.min().y()) / (m_bbox.max().y() - m_bbox.min().y());
-      int32  ix = math::impl::_floor(px);
-      if( ix < 0  ) ix = 0;
-      if( ix >= n ) ix = n-1;
-      int32 iy = math::impl::_floor(py);
-      if( iy < 0  ) iy = 0;
-      if( iy >= n ) iy = n-1;
-      double normx = px-ix, normy = py-iy;
-
-      Vector2 const& m00 = m_table(ix,  iy);
-      Vector2 const& m10 = m_table(ix+1,iy);
-      Vector2 const& m01 = m_table(ix,  iy+1);
-      Vector2 const& m11 = m_table(ix+1,iy+1);
-
-      return Vector2( (m00.x()*(1-normy)+m01.x()*normy)*(1-normx) +
-                      (m10.x()*(1-normy)+m11.x()*normy)*normx,
-                      (m00.y()*(1-normy)+m01.y()*normy)*(1-normx) +
-                      (m10.y()*(1-normy)+m11.y()*normy)*normx );
+    // The number of leaf cells, and how many of them are evaluated exactly.
+    int32 num_cells() const {
+      int32 count = 0;
+      for( size_t i=0; i<m_cells.size(); ++i )
+        if( m_cells[i].child < 0 ) ++count;
+      return count;
+    }
+    int32 num_exact_cells() const {
+      int32 count = 0;
+      for( size_t i=0; i<m_cells.size(); ++i )
+        if( m_cells[i].child < 0 && m_cells[i].exact ) ++count;
+      return count;
     }
 
     // Never re-approximate the approximation.
@@ -325,6 +447,282 @@ namespace vw {
   }
 
 
+  // ------------------------
+  // Row resampling
+  // ------------------------
+
+  /// Transforms that can compute the source coordinates of a whole
+  /// output row faster than one reverse() call per pixel specialize
+  /// this and provide a member
+  ///   void reverse_row( int32 row, int32 col, int32 count, double* xs, double* ys ) const;
+  /// giving the same results as reverse() for the count pixels
+  /// starting at (col,row).
+  template <class TransformT>
+  struct HasReverseRow : public false_type {};
+
+  template <class TransformT>
+  struct HasReverseRow<ApproximateTransform<TransformT> > : public true_type {};
+
+  namespace detail {
+
+    // Compute the source coordinates of count pixels of an output row
+    // starting at (col,row).
+    template <class TransformT>
+    inline typename boost::disable_if<HasReverseRow<TransformT> >::type
+    reverse_row( TransformT const& mapper, int32 row, int32 col, int32 count,
+                 double* xs, double* ys ) {
+      for( int32 i=0; i<count; ++i ) {
+        Vector2 pt = mapper.reverse( Vector2(col+i,row) );
+        xs[i] = pt.x();
+        ys[i] = pt.y();
+      }
+    }
+
+    template <class TransformT>
+    inline typename boost::enable_if<HasReverseRow<TransformT> >::type
+    reverse_row( TransformT const& mapper, int32 row, int32 col, int32 count,
+                 double* xs, double* ys ) {
+      mapper.reverse_row( row, col, count, xs, ys );
+    }
+
+    // Interpolation kernels working directly on rasterized, interleaved
+    // channel data.  They perform the same operations in the same order
+    // as the generic *InterpolationImpl functor, so both produce the
+    // same pixels, but loop over a compile-time number of channels so
+    // the compiler can unroll and vectorize them for each pixel type.
+    // 'before' and 'after' give the extent of the kernel around
+    // floor(x) and floor(y).  (The SSE PixelRGBA<uint8> bicubic
+    // specialization in Interpolation.h is compiled out; should it
+    // return, that pixel type has to be excluded in RowResamplePixel.)
+    template <class InterpT>
+    struct RowResampleKernel {
+      static const bool supported = false;
+    };
+
+    template <>
+    struct RowResampleKernel<BilinearInterpolation> {
+      static const bool  supported = true;
+      static const int32 before = 0, after = 1;
+      template <class ChannelT> struct RealType { typedef typename FloatType<ChannelT>::type type; };
+      template <class RealT> static inline RealT norm( double i, int32 x ) { return RealT(i) - RealT(x); }
+
+      template <int32 N, class ChannelT, class RealT>
+      static inline void apply( ChannelT const* src, ptrdiff_t rstride, RealT normx, RealT normy, RealT* out ) {
+        RealT norm1mx = 1-normx, norm1my = 1-normy;
+        ChannelT const* next = src + rstride;
+        for( int32 c=0; c<N; ++c ) {
+          RealT result = src[c] * norm1mx;
+          result += src[c+N] * normx;
+          result *= norm1my;
+          RealT row = next[c] * norm1mx;
+          row += next[c+N] * normx;
+          out[c] = result + row * normy;
+        }
+      }
+
+      template <class ChannelT, class PixelT>
+      static inline PixelT cast( typename CompoundChannelCast<PixelT,typename RealType<ChannelT>::type>::type const& result ) {
+        return channel_cast_round_if_int<ChannelT>( result );
+      }
+    };
+
+    template <>
+    struct RowResampleKernel<BicubicInterpolation> {
+      static const bool  supported = true;
+      static const int32 before = 1, after = 2;
+      template <class ChannelT> struct RealType { typedef double type; };
+      template <class RealT> static inline RealT norm( double i, int32 x ) { return i - x; }
+
+      template <int32 N, class ChannelT, class RealT>
+      static inline void apply( ChannelT const* src, ptrdiff_t rstride, RealT normx, RealT normy, RealT* out ) {
+        RealT s0 = ((2-normx)*normx-1)*normx,   t[4];
+        RealT s1 = (3*normx-5)*normx*normx+2;   t[0] = ((2-normy)*normy-1)*normy;
+        RealT s2 = ((4-3*normx)*normx+1)*normx; t[1] = (3*normy-5)*normy*normy+2;
+        RealT s3 = (normx-1)*normx*normx;       t[2] = ((4-3*normy)*normy+1)*normy;
+                                                t[3] = (normy-1)*normy*normy;
+        for( int32 c=0; c<N; ++c )
+          out[c] = t[0] * (s0*src[c] + s1*src[c+N] + s2*src[c+2*N] + s3*src[c+3*N]);
+        for( int32 r=1; r<4; ++r ) {
+          src += rstride;
+          for( int32 c=0; c<N; ++c ) {
+            RealT row = s0*src[c] + s1*src[c+N] + s2*src[c+2*N] + s3*src[c+3*N];
+            out[c] += t[r]*row;
+          }
+        }
+        for( int32 c=0; c<N; ++c )
+          out[c] *= 0.25;
+      }
+
+      template <class ChannelT, class PixelT>
+      static inline PixelT cast( typename CompoundChannelCast<PixelT,double>::type const& result ) {
+        return channel_cast_round_and_clamp_if_int<ChannelT>( result );
+      }
+    };
+
+    // Pixel types whose channels are stored back to back and
+    // interpolate channel by channel.  Masked pixels are left to the
+    // generic path, which propagates their validity.
+    template <class PixelT>
+    struct RowResamplePixel {
+      typedef typename CompoundChannelType<PixelT>::type channel_type;
+      static const bool value = boost::is_arithmetic<channel_type>::value &&
+                                !boost::is_same<channel_type,bool>::value &&
+                                !IsMasked<PixelT>::value &&
+                                sizeof(PixelT) == CompoundNumChannels<PixelT>::value * sizeof(channel_type);
+    };
+
+    // Interpolate one pixel whose kernel lies inside the rasterized source tile.
+    template <class KernelT, class PixelT>
+    inline PixelT resample_pixel( typename CompoundChannelType<PixelT>::type const* tile, ptrdiff_t rstride,
+                                  int32 tile_x, int32 tile_y, double i, double j ) {
+      typedef typename CompoundChannelType<PixelT>::type channel_type;
+      typedef typename KernelT::template RealType<channel_type>::type real_type;
+      typedef typename CompoundChannelCast<PixelT,real_type>::type result_type;
+      static const int32 N = CompoundNumChannels<PixelT>::value;
+
+      int32 x = math::impl::_floor(i), y = math::impl::_floor(j);
+      channel_type const* src = tile + (y - tile_y) * rstride + (x - tile_x) * N;
+
+      // Integer positions return the source pixel, as the generic functors do.
+      if( x == i && y == j ) {
+        PixelT result;
+        for( int32 c=0; c<N; ++c )
+          compound_select_channel<channel_type&>( result, c ) = src[c];
+        return result;
+      }
+
+      real_type accum[N];
+      KernelT::template apply<N>( src - KernelT::before * (rstride + N), rstride,
+                                  KernelT::template norm<real_type>( i, x ),
+                                  KernelT::template norm<real_type>( j, y ), accum );
+      result_type result;
+      for( int32 c=0; c<N; ++c )
+        compound_select_channel<real_type&>( result, c ) = accum[c];
+      return KernelT::template cast<channel_type,PixelT>( result );
+    }
+
+    // The child pixels needed to resample the given region of an edge
+    // extended view.  src_bbox receives the region they cover, in child
+    // coordinates; it is clipped to the child by the view's
+    // source_bbox(), so only pixels that exist are rasterized however
+    // far the region reaches beyond the image.
+    template <class ChildT, class EdgeT>
+    inline ImageView<typename ChildT::pixel_type>
+    resample_source( EdgeExtensionView<ChildT,EdgeT> const& view, BBox2i const& bbox, BBox2i& src_bbox ) {
+      src_bbox = view.source_bbox( bbox );
+      if( src_bbox.empty() )
+        src_bbox = BBox2i(0,0,0,0);
+      ImageView<typename ChildT::pixel_type> tile( src_bbox.width(), src_bbox.height(), view.planes() );
+      view.child().rasterize( tile, src_bbox );
+      return tile;
+    }
+
+    // An image already in memory is read in place.
+    template <class PixelT, class EdgeT>
+    inline ImageView<PixelT>
+    resample_source( EdgeExtensionView<ImageView<PixelT>,EdgeT> const& view, BBox2i const& /*bbox*/, BBox2i& src_bbox ) {
+      src_bbox = bounding_box( view.child() );
+      return view.child();
+    }
+
+    // Views that the row resampler does not handle.
+    template <class ImageT, class TransformT, class DestT>
+    inline bool resample_rows( ImageT const& /*image*/, TransformT const& /*mapper*/,
+                               DestT const& /*dest*/, BBox2i const& /*bbox*/ ) {
+      return false;
+    }
+
+    // Rasterize a transformed, interpolated, edge-extended image one
+    // output row at a time.  The source footprint of the whole tile is
+    // fetched once (see resample_source), the source coordinates of
+    // each row are computed in one batch, and the kernel then reads the
+    // source memory directly.  A row whose samples only touch fetched
+    // child pixels skips all bounds checks; other samples are
+    // interpolated from the fetched pixels through the view's own edge
+    // extension, and any that stray outside the footprint go through
+    // the original view.
+    template <class ChildT, class EdgeT, class InterpT, class TransformT, class DestT>
+    typename boost::enable_if_c<RowResampleKernel<InterpT>::supported &&
+                                RowResamplePixel<typename ChildT::pixel_type>::value, bool>::type
+    resample_rows( InterpolationView<EdgeExtensionView<ChildT,EdgeT>,InterpT> const& image,
+                   TransformT const& mapper, DestT const& dest, BBox2i const& bbox ) {
+      typedef typename ChildT::pixel_type pixel_type;
+      typedef typename DestT::pixel_type  dest_pixel_type;
+      typedef typename CompoundChannelType<pixel_type>::type channel_type;
+      typedef RowResampleKernel<InterpT> kernel_type;
+      typedef InterpolationView<EdgeExtensionView<CropView<ImageView<pixel_type> >,EdgeT>,InterpT> tile_view_type;
+      static const int32 N = CompoundNumChannels<pixel_type>::value;
+
+      EdgeExtensionView<ChildT,EdgeT> const& source = image.child();
+      BBox2i footprint = mapper.reverse_bbox(bbox);
+      if( footprint.empty() )
+        return false;
+      footprint.expand( InterpT::pixel_buffer );
+      BBox2i src_bbox;
+      ImageView<pixel_type> tile = resample_source( source, footprint, src_bbox );
+      tile_view_type tile_view( edge_extend( crop( tile, -src_bbox.min().x(), -src_bbox.min().y(),
+                                                   source.child().cols(), source.child().rows() ),
+                                             source.xoffset(), source.yoffset(), source.cols(), source.rows(),
+                                             source.func() ) );
+
+      // Samples whose kernel reads only fetched pixels of the child
+      // itself, in view coordinates.
+      BBox2i direct = src_bbox;
+      direct.crop( bounding_box( source.child() ) );
+      direct -= Vector2i( source.xoffset(), source.yoffset() );
+      double min_x = direct.min().x() + kernel_type::before, max_x = direct.max().x() - kernel_type::after;
+      double min_y = direct.min().y() + kernel_type::before, max_y = direct.max().y() - kernel_type::after;
+      // Samples whose kernel lies inside the footprint.
+      double fmin_x = footprint.min().x() + kernel_type::before, fmax_x = footprint.max().x() - kernel_type::after;
+      double fmin_y = footprint.min().y() + kernel_type::before, fmax_y = footprint.max().y() - kernel_type::after;
+      int32 tile_x = src_bbox.min().x() - source.xoffset(), tile_y = src_bbox.min().y() - source.yoffset();
+
+      channel_type const* data = reinterpret_cast<channel_type const*>( tile.data() );
+      ptrdiff_t rstride = ptrdiff_t(N) * tile.cols();
+      ptrdiff_t pstride = rstride * tile.rows();
+
+      int32 width = bbox.width();
+      std::vector<double> xs( width ), ys( width );
+      std::vector<uint8>  inside( width );
+      for( int32 row=0; row<bbox.height(); ++row ) {
+        reverse_row( mapper, bbox.min().y()+row, bbox.min().x(), width, &xs[0], &ys[0] );
+        bool row_inside = true;
+        for( int32 i=0; i<width; ++i ) {
+          if( xs[i] >= min_x && xs[i] < max_x && ys[i] >= min_y && ys[i] < max_y )
+            inside[i] = 1;
+          else if( xs[i] >= fmin_x && xs[i] < fmax_x && ys[i] >= fmin_y && ys[i] < fmax_y )
+            inside[i] = 2;
+          else
+            inside[i] = 0;
+          row_inside = row_inside && inside[i] == 1;
+        }
+
+        for( int32 p=0; p<tile.planes(); ++p ) {
+          channel_type const* plane = data + p * pstride;
+          typename DestT::pixel_accessor dcol = dest.origin().advance( 0, row, p );
+          if( row_inside ) {
+            for( int32 i=0; i<width; ++i, dcol.next_col() )
+              *dcol = dest_pixel_type( resample_pixel<kernel_type,pixel_type>( plane, rstride, tile_x, tile_y,
+                                                                               xs[i], ys[i] ) );
+          }
+          else {
+            for( int32 i=0; i<width; ++i, dcol.next_col() ) {
+              if( inside[i] == 1 )
+                *dcol = dest_pixel_type( resample_pixel<kernel_type,pixel_type>( plane, rstride, tile_x, tile_y,
+                                                                                 xs[i], ys[i] ) );
+              else if( inside[i] == 2 )
+                *dcol = dest_pixel_type( tile_view( xs[i], ys[i], p ) );
+              else
+                *dcol = dest_pixel_type( image( xs[i], ys[i], p ) );
+            }
+          }
+        }
+      }
+      return true;
+    }
+
+  } // namespace detail
+
   // ------------------------
   // class TransformView
   // ------------------------
@@ -373,13 +771,20 @@ namespace vw {
       BBox2i transformed_bbox = m_mapper.reverse_bbox(bbox);
       return prerasterize_type( m_image.prerasterize(transformed_bbox), m_mapper, m_width, m_height );
     }
+    // Bilinear and bicubic interpolation of an edge-extended image are
+    // resampled a row at a time (see detail::resample_rows), anything
+    // else one pixel at a time through the prerasterized view.
     template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
       if( m_mapper.tolerance() > 0.0 ) {
         ApproximateTransform<TransformT> approx_transform( m_mapper, bbox );
+        if( detail::resample_rows( m_image, approx_transform, dest, bbox ) )
+          return;
         TransformView<ImageT, ApproximateTransform<TransformT> > approx_view( m_image, approx_transform, m_width, m_height );
         vw::rasterize( approx_view.prerasterize(bbox), dest, bbox );
       }
       else {
+        if( detail::resample_rows( m_image, m_mapper, dest, bbox ) )
+          return;
         vw::rasterize( prerasterize(bbox), dest, bbox );
       }
     }
@@ -29,6 +29,8 @@
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/ImageViewRef.h>
 
+#include <boost/numeric/conversion/bounds.hpp>
+
 namespace vw {
 
 
@@ -277,6 +279,458 @@ median_filter_view(ImageT const& image, Vector2i window_size) {
   return return_type(image, window_size, functor, ConstantEdgeExtension());
 }
 
+
+
+//============================================================================
+
+
+/// Maps channel values to the histogram bins used by RankFilterView.
+/// - 8 and 16 bit data can use one bin per value, so results are exact.
+/// - Other data is quantized to num_bins evenly spaced values in
+///   [min_value, max_value]; values outside the range are clamped.
+class RankFilterBins {
+  double m_min_value, m_max_value, m_scale;
+  int    m_num_bins;
+public:
+  RankFilterBins( double min_value, double max_value, int num_bins )
+    : m_min_value(min_value), m_max_value(max_value), m_num_bins(num_bins) {
+    VW_ASSERT( num_bins >= 2 && num_bins <= 65536,
+               ArgumentErr() << "RankFilterBins: The number of bins must be between 2 and 65536." );
+    VW_ASSERT( max_value > min_value,
+               ArgumentErr() << "RankFilterBins: max_value must be greater than min_value." );
+    m_scale = (num_bins - 1) / (max_value - min_value);
+  }
+
+  int num_bins() const { return m_num_bins; }
+
+  int bin( double value ) const {
+    double b = (value - m_min_value) * m_scale + 0.5;
+    if (b < 0)
+      return 0;
+    if (b >= m_num_bins)
+      return m_num_bins - 1;
+    return int(b);
+  }
+
+  double value( int bin ) const {
+    return m_min_value + bin / m_scale;
+  }
+};
+
+/// One bin per value for 8 bit data.
+inline RankFilterBins rank_filter_bins_uint8 () { return RankFilterBins(0, 255,   256  ); }
+/// One bin per value for 16 bit data.
+inline RankFilterBins rank_filter_bins_uint16() { return RankFilterBins(0, 65535, 65536); }
+
+
+/// For each pixel compute a percentile of the valid pixels in a neighborhood,
+/// with the constant time algorithm of Perreault and Hebert, "Median Filtering
+/// in Constant Time".
+/// - Each column of the tile keeps a histogram of the pixels in the window
+///   height, updated by one pixel in and one out per row. The window
+///   histogram is then updated by one column in and one out per pixel.
+/// - Histograms have two levels, so the per pixel cost grows with the square
+///   root of the number of bins instead of with the window size. The fine
+///   level of the window histogram is only brought up to date for the coarse
+///   bin which contains the result.
+/// - Each column only stores the fine level of the coarse bins it holds
+///   pixels in, so with 65536 bins a tile costs a few blocks of 256 counts
+///   per column for short windows rather than a full histogram.
+/// - The image must have a single channel. Window sizes should be odd.
+/// - Pixels with fewer than min_valid_fraction of their window valid are
+///   invalid in the output, as in WindowMedianFunctor.
+template <class ImageT, class EdgeT>
+class RankFilterView : public ImageViewBase<RankFilterView<ImageT,EdgeT> >
+{
+private:
+  ImageT         m_image;
+  EdgeT          m_edge;     ///< Edge extension type
+  Vector2i       m_window_size;
+  double         m_percentile;
+  RankFilterBins m_bins;
+  double         m_min_valid_fraction;
+  int            m_half_width;
+  int            m_half_height;
+
+public:
+  typedef typename ImageT::pixel_type pixel_type;  ///< The pixel type of the image view.
+  typedef pixel_type                  result_type; ///< We compute the result, so we return by value.
+  typedef ProceduralPixelAccessor<RankFilterView<ImageT, EdgeT> >
+                                      pixel_accessor; ///< The view's pixel_accessor type.
+  typedef typename PixelChannelType<pixel_type>::type channel_type;
+
+  /// Constructor
+  /// - percentile is from 0 to 1, with 0.5 giving the median.
+  RankFilterView( ImageT const& image, Vector2i window_size, double percentile,
+                  RankFilterBins const& bins, double min_valid_fraction = 0.9,
+                  EdgeT const& edge = EdgeT() )
+    : m_image(image), m_edge(edge), m_window_size(window_size), m_percentile(percentile),
+      m_bins(bins), m_min_valid_fraction(min_valid_fraction) {
+    VW_ASSERT( percentile >= 0 && percentile <= 1,
+               ArgumentErr() << "RankFilterView: The percentile must be between 0 and 1." );
+    m_half_width  = m_window_size[0]/2;
+    m_half_height = m_window_size[1]/2;
+    VW_ASSERT( 2*m_half_height+1 <= 65535,
+               ArgumentErr() << "RankFilterView: The window is too tall." );
+  }
+
+  inline int32 cols  () const { return m_image.cols  (); }
+  inline int32 rows  () const { return m_image.rows  (); }
+  inline int32 planes() const { return 1; }
+
+  /// Returns a pixel_accessor pointing to the origin.
+  inline pixel_accessor origin() const { return pixel_accessor( *this ); }
+
+  /// Not implemented, the class is designed for fast operation on tiles.
+  inline result_type operator()( int32 x, int32 y, int32 p=0 ) const {
+    vw_throw(NoImplErr() << "RankFilterView::operator()(...) is not implemented");
+    return pixel_type();
+  }
+
+  // Generate the output tile
+  typedef CropView<ImageView<pixel_type> > prerasterize_type;
+  inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+
+    // Rasterize the input support region
+    const int win_w = 2*m_half_width+1, win_h = 2*m_half_height+1;
+    BBox2i src_bbox( bbox.min().x() - m_half_width, bbox.min().y() - m_half_height,
+                     bbox.width() + win_w - 1, bbox.height() + win_h - 1 );
+    ImageView<pixel_type> src = edge_extend(m_image, src_bbox, m_edge);
+
+    // The bin of each input pixel, or -1 if it is invalid
+    ImageView<int32> bins(src.cols(), src.rows());
+    for (int r=0; r<src.rows(); ++r)
+      for (int c=0; c<src.cols(); ++c)
+        bins(c,r) = is_valid(src(c,r)) ?
+          m_bins.bin(compound_select_channel<channel_type const&>(src(c,r), 0)) : -1;
+
+    // Split the bins into coarse and fine levels
+    const int num_bins = m_bins.num_bins();
+    const int fine     = int(ceil(sqrt(double(num_bins))));
+    const int coarse   = (num_bins + fine - 1) / fine;
+    const int ncols    = src.cols();
+
+    // Histograms of the window height in each column. The fine level of a
+    // coarse bin lives in a block of fine_pool while the bin is non-empty,
+    // and col_block holds its index (or -1).
+    std::vector<uint16> col_coarse(ncols*coarse, 0), fine_pool;
+    std::vector<int32 > col_block (ncols*coarse, -1), free_blocks;
+    std::vector<int32 > col_count (ncols, 0);
+    // The window histogram, and the window column at which each fine
+    // level segment was last brought up to date.
+    std::vector<int32> win_coarse(coarse), win_fine(coarse*fine), synced(coarse);
+
+    ImageView<pixel_type> dst(bbox.width(), bbox.height());
+    const double window_area = double(win_w) * win_h;
+    for (int r=0; r<dst.rows(); ++r) {
+
+      // Slide the column histograms down to cover rows r to r+win_h-1
+      for (int c=0; c<ncols; ++c) {
+        if (r > 0 && bins(c,r-1) >= 0) {
+          const int b = bins(c,r-1), i = c*coarse + b/fine;
+          fine_pool[col_block[i]*fine + b%fine]--;
+          if (--col_coarse[i] == 0) {
+            free_blocks.push_back(col_block[i]);
+            col_block[i] = -1;
+          }
+          col_count[c]--;
+        }
+        for (int y = (r == 0 ? 0 : r+win_h-1); y < r+win_h; ++y) {
+          const int b = bins(c,y);
+          if (b < 0) continue;
+          const int i = c*coarse + b/fine;
+          if (col_coarse[i]++ == 0) {
+            if (free_blocks.empty()) {
+              col_block[i] = int32(fine_pool.size() / fine);
+              fine_pool.resize(fine_pool.size() + fine, 0);
+            } else {
+              col_block[i] = free_blocks.back();
+              free_blocks.pop_back();
+            }
+          }
+          fine_pool[col_block[i]*fine + b%fine]++;
+          col_count[c]++;
+        }
+      }
+
+      // At the start of each row build the window coarse histogram from scratch
+      std::fill(win_coarse.begin(), win_coarse.end(), 0);
+      std::fill(synced.begin(), synced.end(), -1);
+      int count = 0;
+      for (int c=0; c<win_w; ++c) {
+        for (int k=0; k<coarse; ++k)
+          win_coarse[k] += col_coarse[c*coarse + k];
+        count += col_count[c];
+      }
+
+      for (int x=0; x<dst.cols(); ++x) {
+        if (x > 0) { // Add the leading column and remove the trailing one
+          const int in = x+win_w-1, out = x-1;
+          for (int k=0; k<coarse; ++k)
+            win_coarse[k] += col_coarse[in*coarse + k] - col_coarse[out*coarse + k];
+          count += col_count[in] - col_count[out];
+        }
+
+        if (count == 0 || count < m_min_valid_fraction * window_area) {
+          pixel_type result(0);
+          invalidate(result);
+          dst(x,r) = result;
+          continue;
+        }
+
+        // Find the coarse bin holding the wanted rank
+        const int rank = int(m_percentile * (count-1) + 0.5);
+        int k = 0, seen = 0;
+        while (seen + win_coarse[k] <= rank)
+          seen += win_coarse[k++];
+
+        // Bring the fine level of that bin up to date with this window
+        int32* fine_hist = &win_fine[k*fine];
+        const int last = synced[k];
+        if (last < 0 || x - last >= win_w) {
+          std::fill(fine_hist, fine_hist+fine, 0);
+          for (int c=x; c<x+win_w; ++c) {
+            const int32 block = col_block[c*coarse + k];
+            if (block < 0) continue;
+            const uint16* col_hist = &fine_pool[block*fine];
+            for (int f=0; f<fine; ++f)
+              fine_hist[f] += col_hist[f];
+          }
+        } else {
+          for (int c=last; c<x; ++c) {
+            const int32 out_block = col_block[c*coarse + k];
+            const int32 in_block  = col_block[(c+win_w)*coarse + k];
+            if (out_block >= 0) {
+              const uint16* out_hist = &fine_pool[out_block*fine];
+              for (int f=0; f<fine; ++f)
+                fine_hist[f] -= out_hist[f];
+            }
+            if (in_block >= 0) {
+              const uint16* in_hist = &fine_pool[in_block*fine];
+              for (int f=0; f<fine; ++f)
+                fine_hist[f] += in_hist[f];
+            }
+          }
+        }
+        synced[k] = x;
+
+        int f = 0;
+        while (seen + fine_hist[f] <= rank)
+          seen += fine_hist[f++];
+        dst(x,r) = pixel_type(channel_type(m_bins.value(k*fine + f)));
+      } // End loop through columns
+    } // End loop through rows
+
+    // Use the crop trick to fake that the support region is the same size as the entire image.
+    return crop(dst, -bbox.min().x(), -bbox.min().y(), m_image.cols(), m_image.rows());
+  }
+
+  template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+    vw::rasterize( prerasterize(bbox), dest, bbox );
+  }
+}; // End class RankFilterView
+
+/// Apply a percentile filter to an input image, see RankFilterView.
+template <class ImageT, class EdgeT>
+RankFilterView<ImageT, EdgeT>
+rank_filter_view(ImageT const& image, Vector2i window_size, double percentile,
+                 RankFilterBins const& bins, EdgeT edge, double min_valid_fraction = 0.9) {
+  typedef RankFilterView<ImageT, EdgeT> return_type;
+  return return_type(image, window_size, percentile, bins, min_valid_fraction, edge);
+}
+/// Overload to set default edge extension.
+template <class ImageT>
+RankFilterView<ImageT, ConstantEdgeExtension>
+rank_filter_view(ImageT const& image, Vector2i window_size, double percentile,
+                 RankFilterBins const& bins) {
+  typedef RankFilterView<ImageT, ConstantEdgeExtension> return_type;
+  return return_type(image, window_size, percentile, bins, 0.9, ConstantEdgeExtension());
+}
+
+/// Constant time median filter. Unlike median_filter_view(), an even number
+/// of values gives the upper middle value rather than the mean of the two.
+template <class ImageT>
+RankFilterView<ImageT, ConstantEdgeExtension>
+fast_median_filter_view(ImageT const& image, Vector2i window_size, RankFilterBins const& bins) {
+  return rank_filter_view(image, window_size, 0.5, bins);
+}
+
+
+
+//============================================================================
+
+
+namespace detail {
+  /// The van Herk / Gil-Werman running extremum over windows of width w.
+  /// The output has w-1 fewer values than the input.
+  /// - Uses three comparisons per value whatever the window size.
+  template <class T, class CompareT>
+  void van_herk_gil_werman(std::vector<T> const& in, std::vector<T>& out, int w,
+                           std::vector<T>& forward, std::vector<T>& backward,
+                           CompareT better) {
+    const int n = in.size();
+    forward.resize(n);
+    backward.resize(n);
+    // Running extremum from the start of each block of w values, and to its end
+    for (int i=0; i<n; ++i)
+      forward[i] = (i % w == 0) ? in[i] : std::min(forward[i-1], in[i], better);
+    for (int i=n-1; i>=0; --i)
+      backward[i] = (i % w == w-1 || i == n-1) ? in[i] : std::min(backward[i+1], in[i], better);
+    // Each window covers the end of one block and the start of the next
+    out.resize(n-w+1);
+    for (int i=0; i<n-w+1; ++i)
+      out[i] = std::min(backward[i], forward[i+w-1], better);
+  }
+} // namespace detail
+
+/// For each pixel compute the minimum or maximum of the valid pixels in a
+/// neighborhood. This is grayscale erosion or dilation with a rectangle.
+/// - Separable, with the van Herk / Gil-Werman algorithm in each direction,
+///   so the cost per pixel does not depend on the window size.
+/// - Works on any single channel type without quantization.
+/// - Pixels with no valid pixels in their window are invalid in the output.
+template <class ImageT, class EdgeT>
+class MinMaxFilterView : public ImageViewBase<MinMaxFilterView<ImageT,EdgeT> >
+{
+private:
+  ImageT   m_image;
+  EdgeT    m_edge;     ///< Edge extension type
+  Vector2i m_window_size;
+  bool     m_use_max;
+  int      m_half_width;
+  int      m_half_height;
+
+  /// Filter along the rows, then along the columns. The output is smaller
+  /// than the input by the window size minus one in each direction.
+  template <class T, class CompareT>
+  ImageView<T> filter(ImageView<T> const& src, CompareT better) const {
+    const int win_w = 2*m_half_width+1, win_h = 2*m_half_height+1;
+    std::vector<T> in, out, forward, backward;
+    ImageView<T> horizontal(src.cols()-win_w+1, src.rows());
+    for (int r=0; r<src.rows(); ++r) {
+      in.resize(src.cols());
+      for (int c=0; c<src.cols(); ++c)
+        in[c] = src(c,r);
+      detail::van_herk_gil_werman(in, out, win_w, forward, backward, better);
+      for (int c=0; c<horizontal.cols(); ++c)
+        horizontal(c,r) = out[c];
+    }
+    ImageView<T> result(horizontal.cols(), src.rows()-win_h+1);
+    in.resize(src.rows());
+    for (int c=0; c<horizontal.cols(); ++c) {
+      for (int r=0; r<src.rows(); ++r)
+        in[r] = horizontal(c,r);
+      detail::van_herk_gil_werman(in, out, win_h, forward, backward, better);
+      for (int r=0; r<result.rows(); ++r)
+        result(c,r) = out[r];
+    }
+    return result;
+  }
+
+public:
+  typedef typename ImageT::pixel_type pixel_type;  ///< The pixel type of the image view.
+  typedef pixel_type                  result_type; ///< We compute the result, so we return by value.
+  typedef ProceduralPixelAccessor<MinMaxFilterView<ImageT, EdgeT> >
+                                      pixel_accessor; ///< The view's pixel_accessor type.
+  typedef typename PixelChannelType<pixel_type>::type channel_type;
+
+  /// Constructor
+  MinMaxFilterView( ImageT const& image, Vector2i window_size, bool use_max,
+                    EdgeT const& edge = EdgeT() )
+    : m_image(image), m_edge(edge), m_window_size(window_size), m_use_max(use_max) {
+    m_half_width  = m_window_size[0]/2;
+    m_half_height = m_window_size[1]/2;
+  }
+
+  inline int32 cols  () const { return m_image.cols  (); }
+  inline int32 rows  () const { return m_image.rows  (); }
+  inline int32 planes() const { return 1; }
+
+  /// Returns a pixel_accessor pointing to the origin.
+  inline pixel_accessor origin() const { return pixel_accessor( *this ); }
+
+  /// Not implemented, the class is designed for fast operation on tiles.
+  inline result_type operator()( int32 x, int32 y, int32 p=0 ) const {
+    vw_throw(NoImplErr() << "MinMaxFilterView::operator()(...) is not implemented");
+    return pixel_type();
+  }
+
+  // Generate the output tile
+  typedef CropView<ImageView<pixel_type> > prerasterize_type;
+  inline prerasterize_type prerasterize( BBox2i const& bbox ) const {
+
+    // Rasterize the input support region
+    BBox2i src_bbox( bbox.min().x() - m_half_width, bbox.min().y() - m_half_height,
+                     bbox.width() + 2*m_half_width, bbox.height() + 2*m_half_height );
+    ImageView<pixel_type> src = edge_extend(m_image, src_bbox, m_edge);
+
+    // Invalid pixels get a value that never wins
+    const channel_type worst = m_use_max ? boost::numeric::bounds<channel_type>::lowest()
+                                         : boost::numeric::bounds<channel_type>::highest();
+    ImageView<channel_type> values(src.cols(), src.rows());
+    ImageView<uint8       > valid (src.cols(), src.rows());
+    bool all_valid = true;
+    for (int r=0; r<src.rows(); ++r) {
+      for (int c=0; c<src.cols(); ++c) {
+        valid(c,r) = is_valid(src(c,r));
+        values(c,r) = valid(c,r) ? compound_select_channel<channel_type const&>(src(c,r), 0) : worst;
+        all_valid = all_valid && valid(c,r);
+      }
+    }
+
+    ImageView<channel_type> extremum = m_use_max ? filter(values, std::greater<channel_type>())
+                                                 : filter(values, std::less   <channel_type>());
+    // Only find which windows have a valid pixel if some are invalid
+    ImageView<uint8> any_valid;
+    if (!all_valid)
+      any_valid = filter(valid, std::greater<uint8>());
+
+    ImageView<pixel_type> dst(bbox.width(), bbox.height());
+    for (int r=0; r<dst.rows(); ++r) {
+      for (int c=0; c<dst.cols(); ++c) {
+        dst(c,r) = pixel_type(extremum(c,r));
+        if (!all_valid && !any_valid(c,r))
+          invalidate(dst(c,r));
+      }
+    }
+
+    // Use the crop trick to fake that the support region is the same size as the entire image.
+    return crop(dst, -bbox.min().x(), -bbox.min().y(), m_image.cols(), m_image.rows());
+  }
+
+  template <class DestT> inline void rasterize( DestT const& dest, BBox2i const& bbox ) const {
+    vw::rasterize( prerasterize(bbox), dest, bbox );
+  }
+}; // End class MinMaxFilterView
+
+/// Apply a minimum filter (grayscale erosion) to an input image
+template <class ImageT, class EdgeT>
+MinMaxFilterView<ImageT, EdgeT>
+min_filter_view(ImageT const& image, Vector2i window_size, EdgeT edge) {
+  return MinMaxFilterView<ImageT, EdgeT>(image, window_size, false, edge);
+}
+/// Overload to set default edge extension.
+template <class ImageT>
+MinMaxFilterView<ImageT, ConstantEdgeExtension>
+min_filter_view(ImageT const& image, Vector2i window_size) {
+  return MinMaxFilterView<ImageT, ConstantEdgeExtension>(image, window_size, false,
+                                                         ConstantEdgeExtension());
+}
+
+/// Apply a maximum filter (grayscale dilation) to an input image
+template <class ImageT, class EdgeT>
+MinMaxFilterView<ImageT, EdgeT>
+max_filter_view(ImageT const& image, Vector2i window_size, EdgeT edge) {
+  return MinMaxFilterView<ImageT, EdgeT>(image, window_size, true, edge);
+}
+/// Overload to set default edge extension.
+template <class ImageT>
+MinMaxFilterView<ImageT, ConstantEdgeExtension>
+max_filter_view(ImageT const& image, Vector2i window_size) {
+  return MinMaxFilterView<ImageT, ConstantEdgeExtension>(image, window_size, true,
+                                                         ConstantEdgeExtension());
+}
+
 } // namespace vw
 
 
@@ -24,6 +24,7 @@
 #include <vw/Image/ImageView.h>
 #include <vw/Image/PixelTypes.h>
 #include <vw/Image/Manipulation.h>
+#include <vw/Image/BlockRasterize.h>
 
 #include <test/Helpers.h>
 
@@ -169,6 +170,68 @@ TEST( Algorithms, Grassfire_no_border ) {
   }
 }
 
+TEST( Algorithms, EuclideanDistanceTransform ) {
+  // A sparse pseudo-random pattern of zero pixels
+  ImageView<uint8> im(37,23);
+  fill(im, 1);
+  for (int i = 0; i < 12; i++)
+    im((i*17+5)%37, (i*11+3)%23) = 0;
+
+  for (int ignore_borders = 0; ignore_borders < 2; ignore_borders++) {
+    ImageView<float>    dist;
+    ImageView<Vector2i> nearest;
+    euclidean_distance_transform(im, dist, ignore_borders, &nearest, 4);
+
+    // Compare with a brute force search
+    for (int r = 0; r < im.rows(); r++) {
+      for (int c = 0; c < im.cols(); c++) {
+        double best = std::numeric_limits<double>::max();
+        for (int r2 = 0; r2 < im.rows(); r2++)
+          for (int c2 = 0; c2 < im.cols(); c2++)
+            if (im(c2,r2) == 0)
+              best = std::min(best, norm_2(Vector2(c2-c, r2-r)));
+        if (!ignore_borders)
+          best = std::min(best, double(std::min(std::min(c+1, im.cols()-c),
+                                                std::min(r+1, im.rows()-r))));
+        ASSERT_NEAR(best, dist(c,r), 1e-5);
+        EXPECT_NEAR(dist(c,r), norm_2(Vector2(nearest(c,r) - Vector2i(c,r))), 1e-5);
+      }
+    }
+  }
+
+  // Same results as grassfire along a straight edge
+  ImageView<uint8> im2(5,5);
+  fill(crop(im2,1,1,3,3), 255);
+  ImageView<float> d2 = euclidean_distance_transform(im2);
+  EXPECT_EQ( 0, d2(0,0) );
+  EXPECT_EQ( 1, d2(1,1) );
+  EXPECT_EQ( 2, d2(2,2) );
+  EXPECT_EQ( 1, d2(1,2) );
+
+  // With no zero pixels the distance is capped like in grassfire
+  fill(im2, 255);
+  d2 = euclidean_distance_transform(im2, true);
+  EXPECT_EQ( 10, d2(2,2) );
+}
+
+TEST( Algorithms, EuclideanDistanceView ) {
+  ImageView<uint8> im(70,50);
+  fill(im, 1);
+  im(10,10) = 0;
+  im(60,20) = 0;
+  im(35,45) = 0;
+
+  const float max_dist = 12;
+  for (int ignore_borders = 0; ignore_borders < 2; ignore_borders++) {
+    ImageView<float> full  = euclidean_distance_transform(im, ignore_borders);
+    ImageView<float> tiled = block_rasterize(euclidean_distance_view(im, max_dist, ignore_borders),
+                                             Vector2i(16,16), 2);
+    for (int r = 0; r < im.rows(); r++)
+      for (int c = 0; c < im.cols(); c++)
+        EXPECT_NEAR(std::min(full(c,r), max_dist), tiled(c,r), 1e-5);
+  }
+}
+
 TEST( Algorithms, CenterlineWeights ) {
   ImageView<uint8> image(5,5);
   fill(crop(image,1,1,3,3), 255);
@@ -358,6 +421,110 @@ TEST( Algorithms, MedianFilter ) {
   EXPECT_EQ( 7, output(1,4));
 }
 
+TEST( Algorithms, RankFilter ) {
+
+  // A pseudo-random image with a few invalid pixels
+  ImageView<PixelMask<uint8> > image(23, 17);
+  for (int r=0; r<image.rows(); ++r)
+    for (int c=0; c<image.cols(); ++c)
+      image(c,r) = PixelMask<uint8>((c*37 + r*91 + c*r*13) % 256);
+  image(4,4).invalidate();
+  image(10,3).invalidate();
+
+  const Vector2i window(5,3);
+  const double percentiles[] = {0.0, 0.3, 0.5, 1.0};
+  for (int i=0; i<4; ++i) {
+    // Use small tiles to check that they agree along their edges
+    ImageView<PixelMask<uint8> > output
+      = block_rasterize(rank_filter_view(image, window, percentiles[i], rank_filter_bins_uint8(),
+                                         ConstantEdgeExtension(), 0.5),
+                        Vector2i(8,8), 2);
+
+    // Compare with sorting each window
+    ImageViewRef<PixelMask<uint8> > extended = edge_extend(image, ConstantEdgeExtension());
+    for (int r=0; r<image.rows(); ++r) {
+      for (int c=0; c<image.cols(); ++c) {
+        std::vector<int> values;
+        for (int y=r-1; y<=r+1; ++y)
+          for (int x=c-2; x<=c+2; ++x)
+            if (is_valid(extended(x,y)))
+              values.push_back(extended(x,y).child());
+        std::sort(values.begin(), values.end());
+        int expected = values[int(percentiles[i]*(values.size()-1) + 0.5)];
+        ASSERT_TRUE(is_valid(output(c,r)));
+        EXPECT_EQ(expected, int(output(c,r).child()));
+      }
+    }
+  }
+
+  // 16 bit data spread over many coarse bins, with one bin per value
+  ImageView<uint16> wide(31, 22);
+  for (int r=0; r<wide.rows(); ++r)
+    for (int c=0; c<wide.cols(); ++c)
+      wide(c,r) = uint16((c*7919 + r*104729 + c*r*31) % 65536);
+  ImageView<uint16> wide_median
+    = block_rasterize(rank_filter_view(wide, Vector2i(3,7), 0.5, rank_filter_bins_uint16(),
+                                       ConstantEdgeExtension()),
+                      Vector2i(16,16), 2);
+  ImageViewRef<uint16> wide_extended = edge_extend(wide, ConstantEdgeExtension());
+  for (int r=0; r<wide.rows(); ++r)
+    for (int c=0; c<wide.cols(); ++c) {
+      std::vector<int> values;
+      for (int y=r-3; y<=r+3; ++y)
+        for (int x=c-1; x<=c+1; ++x)
+          values.push_back(wide_extended(x,y));
+      std::sort(values.begin(), values.end());
+      EXPECT_EQ(values[10], int(wide_median(c,r)));
+    }
+
+  // With quantized floats the median matches median_filter_view on odd windows
+  ImageView<float> fimage(12, 9);
+  for (int r=0; r<fimage.rows(); ++r)
+    for (int c=0; c<fimage.cols(); ++c)
+      fimage(c,r) = 0.5*((c*7 + r*3 + c*r) % 21);
+  ImageView<float> slow = median_filter_view(fimage, Vector2i(3,5));
+  ImageView<float> fast = fast_median_filter_view(fimage, Vector2i(3,5), RankFilterBins(0, 10, 21));
+  for (int r=0; r<fimage.rows(); ++r)
+    for (int c=0; c<fimage.cols(); ++c)
+      EXPECT_NEAR(slow(c,r), fast(c,r), 1e-6);
+}
+
+TEST( Algorithms, MinMaxFilter ) {
+
+  ImageView<PixelMask<float> > image(19, 14);
+  for (int r=0; r<image.rows(); ++r)
+    for (int c=0; c<image.cols(); ++c)
+      image(c,r) = PixelMask<float>(((c*53 + r*29 + c*r*7) % 97) - 40.5);
+  fill(crop(image, 3, 3, 5, 4), PixelMask<float>()); // An invalid hole
+
+  const Vector2i window(5,3);
+  ImageView<PixelMask<float> > erode  = block_rasterize(min_filter_view(image, window),
+                                                        Vector2i(8,8), 2);
+  ImageView<PixelMask<float> > dilate = block_rasterize(max_filter_view(image, window),
+                                                        Vector2i(8,8), 2);
+
+  ImageViewRef<PixelMask<float> > extended = edge_extend(image, ConstantEdgeExtension());
+  for (int r=0; r<image.rows(); ++r) {
+    for (int c=0; c<image.cols(); ++c) {
+      std::vector<float> values;
+      for (int y=r-1; y<=r+1; ++y)
+        for (int x=c-2; x<=c+2; ++x)
+          if (is_valid(extended(x,y)))
+            values.push_back(extended(x,y).child());
+      if (values.empty()) {
+        EXPECT_FALSE(is_valid(erode (c,r)));
+        EXPECT_FALSE(is_valid(dilate(c,r)));
+        continue;
+      }
+      ASSERT_TRUE(is_valid(erode(c,r)));
+      EXPECT_EQ(*std::min_element(values.begin(), values.end()), erode (c,r).child());
+      EXPECT_EQ(*std::max_element(values.begin(), values.end()), dilate(c,r).child());
+    }
+  }
+  // The middle of the hole has no valid pixels nearby
+  EXPECT_FALSE(is_valid(erode(5,4)));
+}
+
 TEST( Algorithms, StdDevFilter ) {
 
   // Create a test image
@@ -18,6 +18,8 @@
 
 #include <gtest/gtest_VW.h>
 #include <vw/Image/AntiAliasing.h>
+#include <vw/Image/BlockRasterize.h>
+#include <test/Helpers.h>
 
 using namespace vw;
 
@@ -57,3 +59,79 @@ TEST( AntiAliasing, VerifySameOperation ) {
     }
   }
 }
+
+TEST( AntiAliasing, ReduceBox ) {
+  ImageView<float> input( 5, 4 );
+  for ( int32 y = 0; y < input.rows(); y++ )
+    for ( int32 x = 0; x < input.cols(); x++ )
+      input(x,y) = float(x + 10*y);
+
+  ImageView<float> output = reduce_view( input, 1, BoxReduceFilter );
+  ASSERT_EQ( 3, output.cols() );
+  ASSERT_EQ( 2, output.rows() );
+  EXPECT_FLOAT_EQ( 5.5,  output(0,0) );
+  EXPECT_FLOAT_EQ( 7.5,  output(1,0) );
+  EXPECT_FLOAT_EQ( 25.5, output(0,1) );
+  // The last column only has one input column.
+  EXPECT_FLOAT_EQ( 9,    output(2,0) );
+
+  // Invalid pixels are left out, and a block with none is invalid.
+  typedef PixelMask<float> PT;
+  ImageView<PT> masked( 4, 2 );
+  masked(0,0) = PT(1); masked(1,0) = PT(2); masked(0,1) = PT(3);
+  masked(1,1) = PT(100); masked(1,1).invalidate();
+  masked(2,0).invalidate(); masked(3,0).invalidate();
+  masked(2,1).invalidate(); masked(3,1).invalidate();
+  ImageView<PT> masked_output = reduce_view( masked, 1, BoxReduceFilter );
+  ASSERT_EQ( 2, masked_output.cols() );
+  EXPECT_TRUE ( is_valid( masked_output(0,0) ) );
+  EXPECT_FLOAT_EQ( 2, masked_output(0,0).child() );
+  EXPECT_FALSE( is_valid( masked_output(1,0) ) );
+}
+
+TEST( AntiAliasing, ReduceFilters ) {
+  // Every filter keeps a constant image constant, edges included.
+  ImageView<PixelRGBA<uint8> > constant( 19, 13 );
+  fill( constant, PixelRGBA<uint8>( 10, 20, 30, 200 ) );
+  ReduceFilterType filters[] = { BoxReduceFilter, GaussianReduceFilter, LanczosReduceFilter };
+  for ( int32 f = 0; f < 3; f++ ) {
+    ImageView<PixelRGBA<uint8> > output = reduce_view( constant, 2, filters[f] );
+    ASSERT_EQ( 5, output.cols() );
+    ASSERT_EQ( 4, output.rows() );
+    for ( int32 y = 0; y < output.rows(); y++ )
+      for ( int32 x = 0; x < output.cols(); x++ )
+        EXPECT_EQ( PixelRGBA<uint8>( 10, 20, 30, 200 ), output(x,y) );
+  }
+
+  // The Gaussian filter removes a pattern that decimation would alias.
+  ImageView<float> stripes( 32, 32 );
+  for ( int32 y = 0; y < stripes.rows(); y++ )
+    for ( int32 x = 0; x < stripes.cols(); x++ )
+      stripes(x,y) = x % 2;
+  ImageView<float> smooth = reduce_view( stripes, 1, GaussianReduceFilter );
+  for ( int32 x = 1; x < smooth.cols()-1; x++ )
+    EXPECT_NEAR( 0.5, smooth(x,8), 1e-6 );
+}
+
+TEST( AntiAliasing, ReducePyramid ) {
+  ImageView<float> input( 103, 77 );
+  for ( int32 y = 0; y < input.rows(); y++ )
+    for ( int32 x = 0; x < input.cols(); x++ )
+      input(x,y) = sin(0.37*x) + cos(0.21*y) + ((x*y) % 7);
+
+  std::vector<ImageView<float> > pyramid = reduce_pyramid( input, 3, LanczosReduceFilter );
+  ASSERT_EQ( 3u, pyramid.size() );
+
+  ImageView<float> level = input;
+  for ( int32 l = 0; l < 3; l++ ) {
+    // Each level matches reducing the one before it...
+    level = reduce_view( level, 1, LanczosReduceFilter );
+    ASSERT_EQ( level.cols(), pyramid[l].cols() );
+    ASSERT_EQ( level.rows(), pyramid[l].rows() );
+    EXPECT_MATRIX_NEAR( level, pyramid[l], 1e-4 );
+
+    // ...and reducing in tiles matches reducing all at once.
+    ImageView<float> tiled = block_rasterize( reduce_view( input, l+1, LanczosReduceFilter ), Vector2i(8,8), 2 );
+    EXPECT_MATRIX_NEAR( pyramid[l], tiled, 1e-4 );
+  }
+}
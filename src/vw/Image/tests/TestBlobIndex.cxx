@@ -81,6 +81,47 @@ TEST(BlobIndexThreaded, TestImage3) {
 */
 
 
+TEST( BlobIndex, ConnectedComponents ) {
+  typedef PixelMask<uint8> MPx;
+  ImageView<MPx> im(9,8);
+  fill( crop(im,1,1,3,1), MPx(255) ); // A U shape whose arms only meet
+  fill( crop(im,1,2,1,4), MPx(255) ); //  at the bottom, across bands.
+  fill( crop(im,3,2,1,4), MPx(255) );
+  fill( crop(im,1,6,3,1), MPx(255) );
+  im(6,1) = MPx(1); // Two pixels touching diagonally
+  im(7,2) = MPx(1);
+  fill( crop(im,6,5,3,3), MPx(7) ); // A square on the corner
+
+  // The result must not depend on the bands or the threads
+  for ( int band_rows = 1; band_rows <= 8; band_rows++ ) {
+    ConnectedComponents components( im, true, band_rows, 3 );
+    ASSERT_EQ( 3u, components.num_labels() );
+    EXPECT_EQ( 14u, components.area(0) );
+    EXPECT_EQ( BBox2i(1,1,3,6), components.bbox(0) );
+    EXPECT_EQ( 2u,  components.area(1) );
+    EXPECT_EQ( BBox2i(6,1,2,2), components.bbox(1) );
+    EXPECT_EQ( 9u,  components.area(2) );
+    EXPECT_EQ( BBox2i(6,5,3,3), components.bbox(2) );
+
+    ImageView<uint32> labels;
+    components.label_image( labels, im.cols(), im.rows() );
+    EXPECT_EQ( 0u, labels(0,0) );
+    EXPECT_EQ( 1u, labels(3,5) );
+    EXPECT_EQ( 2u, labels(7,2) );
+    EXPECT_EQ( 3u, labels(8,7) );
+  }
+
+  // Without diagonals the two pixels are separate
+  ConnectedComponents four( im, false, 2, 2 );
+  EXPECT_EQ( 4u, four.num_labels() );
+
+  // The blob index built on top gives the same blobs
+  BlobIndexThreaded bindex( im, 5, 3 );
+  ASSERT_EQ( 1u, bindex.num_blobs() ); // The others are too big
+  EXPECT_EQ( 2, bindex.compressed_blob(0).size() );
+  EXPECT_EQ( BBox2i(6,1,2,2), bindex.blob_bbox(0) );
+}
+
 TEST(BlobIndex, BlobCompressedIntersect) {
   std::vector<std::list<int32> > starts, ends;
   starts += list_of(0), list_of(0), list_of(0), list_of(0), list_of(0);
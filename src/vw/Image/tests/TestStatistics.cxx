@@ -23,6 +23,8 @@
 #include <vw/Image/PixelTypes.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Manipulation.h>
+#include <vw/Image/ImageViewRef.h>
+#include <vw/Image/Algorithms.h>
 
 #include <test/Helpers.h>
 
@@ -527,7 +529,7 @@ TEST( Statistics, OptimalThreshold ) {
   EXPECT_NEAR(t, t0, 1e-15);
 }
 
-TEST(BlockOperations, DISABLED_CDF) {
+TEST(BlockOperations, CDF) {
 
   const Vector2i block_size(128, 128);
   int sumsample_amount = 1;
@@ -562,3 +564,76 @@ TEST(BlockOperations, DISABLED_CDF) {
   EXPECT_NEAR(normal_cdf.quantile(0.02),       parallel_cdf.quantile(0.02), EPS);
   EXPECT_NEAR(normal_cdf.quantile(0.98),       parallel_cdf.quantile(0.98), EPS);
 }
+
+TEST(BlockOperations, Accumulate) {
+
+  // A masked image whose valid pixels are 0, 1, ..., 99.
+  ImageView<PixelMask<float> > image(300, 200);
+  int count = 0;
+  for (int row = 0; row < image.rows(); row++) {
+    for (int col = 0; col < image.cols(); col++) {
+      if ((col + row) % 7 == 0 && count < 100)
+        image(col, row) = PixelMask<float>(count++);
+      else
+        image(col, row).invalidate();
+    }
+  }
+  ASSERT_EQ(100, count);
+
+  vw::math::StatisticsAccumulator accum(100);
+  accum.set_histogram(100, 0, 99);
+  block_accumulate(image, accum, 1, Vector2i(64, 64));
+
+  EXPECT_EQ(100u, accum.num_samples());
+  EXPECT_EQ(0.0,  accum.minimum());
+  EXPECT_EQ(99.0, accum.maximum());
+  EXPECT_NEAR(49.5, accum.mean(), 1e-10);
+  EXPECT_NEAR(std::sqrt(9999.0/12.0), accum.stddev(), 1e-10);
+  EXPECT_NEAR(49.5, accum.quantile(0.5), 1.0);
+  for (int bin = 0; bin < 100; bin++)
+    EXPECT_EQ(1, accum.histogram().get_bin_value(bin));
+
+  // The single pass range must agree with the old two pass results.
+  double min_val, max_val;
+  find_image_min_max(image, min_val, max_val);
+  EXPECT_EQ(0.0,  min_val);
+  EXPECT_EQ(99.0, max_val);
+}
+
+TEST(BlockOperations, PercentileScaleConvert) {
+
+  // A ramp with a few outliers, read through a view which is not an
+  // ImageView, so it goes through block rasterization.
+  ImageView<float> image(200, 150);
+  for (int row = 0; row < image.rows(); row++)
+    for (int col = 0; col < image.cols(); col++)
+      image(col, row) = float(col + 2*row);
+  image(3, 4)   = -1000;
+  image(150, 9) =  5000;
+  ImageViewRef<float> view = image;
+
+  ImageView<uint8> result;
+  percentile_scale_convert(view, result, 0.02, 0.98, 256);
+  ASSERT_EQ(image.cols(), result.cols());
+  ASSERT_EQ(image.rows(), result.rows());
+
+  // The stretch found with a full histogram of the image.
+  double min_val, max_val;
+  find_image_min_max(image, min_val, max_val);
+  math::Histogram hist;
+  histogram(image, 256, min_val, max_val, hist);
+  double low_value  = (hist.get_percentile(0.02)+1) * hist.get_bin_width() + min_val;
+  double high_value = (hist.get_percentile(0.98)+1) * hist.get_bin_width() + min_val;
+
+  // The outliers are clipped, and the rest of the image matches to
+  // within the quantile estimate, which may round to the next bin.
+  EXPECT_EQ(0,   result(3, 4));
+  EXPECT_EQ(255, result(150, 9));
+  double tol = 255.0 * 2 * hist.get_bin_width() / (high_value - low_value) + 1;
+  for (int row = 0; row < image.rows(); row += 7) {
+    for (int col = 0; col < image.cols(); col += 5) {
+      double v = std::min(std::max(double(image(col, row)), low_value), high_value);
+      EXPECT_NEAR(255.0*(v - low_value)/(high_value - low_value), result(col, row), tol);
+    }
+  }
+}
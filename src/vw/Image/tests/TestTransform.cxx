@@ -20,6 +20,7 @@
 
 #include <vw/Image/ImageView.h>
 #include <vw/Image/Transform.h>
+#include <vw/Image/ImageMath.h>
 
 using namespace vw;
 
@@ -202,3 +203,119 @@ TEST( Transform, FreeForward ) {
                         tx.forward(tx.reverse(Vector2(i*i,i))), 1e-3 );
   }
 }
+
+// Rasterize a transformed view pixel by pixel through its accessor,
+// which bypasses the row resampler.
+template <class ViewT>
+static ImageView<typename ViewT::pixel_type> rasterize_per_pixel( ViewT const& view ) {
+  ImageView<typename ViewT::pixel_type> result( view.cols(), view.rows() );
+  vw::rasterize( view, result, bounding_box(view) );
+  return result;
+}
+
+template <class PixelT>
+static void expect_identical( ImageView<PixelT> const& a, ImageView<PixelT> const& b ) {
+  ASSERT_EQ( a.cols(), b.cols() );
+  ASSERT_EQ( a.rows(), b.rows() );
+  for ( int32 y = 0; y < a.rows(); y++ )
+    for ( int32 x = 0; x < a.cols(); x++ )
+      for ( int32 c = 0; c < int32(CompoundNumChannels<PixelT>::value); c++ )
+        EXPECT_EQ( compound_select_channel<typename CompoundChannelType<PixelT>::type const&>( a(x,y), c ),
+                   compound_select_channel<typename CompoundChannelType<PixelT>::type const&>( b(x,y), c ) );
+}
+
+TEST( Transform, RowResample ) {
+  ImageView<float> src(37,29);
+  ImageView<PixelRGB<uint8> > src_rgb(37,29);
+  for ( int32 y = 0; y < src.rows(); y++ )
+    for ( int32 x = 0; x < src.cols(); x++ ) {
+      src(x,y) = sin(0.3*x) * cos(0.2*y) + 0.01*x*y;
+      src_rgb(x,y) = PixelRGB<uint8>( (x*29+y*7)%256, (x*x+y)%256, (x*y)%256 );
+    }
+
+  // A mild perspective warp whose output covers the image edges.
+  Matrix3x3 H;
+  H(0,0) = 1.1;  H(0,1) = 0.2; H(0,2) = -3;
+  H(1,0) = -0.1; H(1,1) = 0.9; H(1,2) = 4;
+  H(2,0) = 1e-3; H(2,1) = 2e-3; H(2,2) = 1;
+  HomographyTransform tx(H);
+
+  // The row resampler reproduces the per-pixel path exactly.
+  ImageView<float> fast, slow;
+  fast = transform( src, tx, 45, 35, ZeroEdgeExtension(), BilinearInterpolation() );
+  slow = rasterize_per_pixel( transform( src, tx, 45, 35, ZeroEdgeExtension(), BilinearInterpolation() ) );
+  expect_identical( fast, slow );
+  fast = transform( src, tx, 45, 35, ConstantEdgeExtension(), BicubicInterpolation() );
+  slow = rasterize_per_pixel( transform( src, tx, 45, 35, ConstantEdgeExtension(), BicubicInterpolation() ) );
+  expect_identical( fast, slow );
+
+  // A lazy source view is rasterized into a tile first.
+  fast = transform( 2*src, tx, 45, 35, ConstantEdgeExtension(), BilinearInterpolation() );
+  slow = rasterize_per_pixel( transform( 2*src, tx, 45, 35, ConstantEdgeExtension(), BilinearInterpolation() ) );
+  expect_identical( fast, slow );
+
+  // Footprints reaching far beyond the source, partly and entirely.
+  TranslateTransform shift( -20.25, 150.5 ), away( 4000.5, -3000.75 );
+  fast = transform( 2*src, shift, 45, 35, ConstantEdgeExtension(), BicubicInterpolation() );
+  slow = rasterize_per_pixel( transform( 2*src, shift, 45, 35, ConstantEdgeExtension(), BicubicInterpolation() ) );
+  expect_identical( fast, slow );
+  fast = transform( 2*src, shift, 45, 35, PeriodicEdgeExtension(), BilinearInterpolation() );
+  slow = rasterize_per_pixel( transform( 2*src, shift, 45, 35, PeriodicEdgeExtension(), BilinearInterpolation() ) );
+  expect_identical( fast, slow );
+  fast = transform( 2*src, away, 45, 35, ZeroEdgeExtension(), BicubicInterpolation() );
+  slow = rasterize_per_pixel( transform( 2*src, away, 45, 35, ZeroEdgeExtension(), BicubicInterpolation() ) );
+  expect_identical( fast, slow );
+
+  ImageView<PixelRGB<uint8> > fast_rgb, slow_rgb;
+  fast_rgb = transform( src_rgb, tx, 45, 35, PeriodicEdgeExtension(), BicubicInterpolation() );
+  slow_rgb = rasterize_per_pixel( transform( src_rgb, tx, 45, 35, PeriodicEdgeExtension(), BicubicInterpolation() ) );
+  expect_identical( fast_rgb, slow_rgb );
+  fast_rgb = transform( src_rgb, shift, 45, 35, ConstantEdgeExtension(), BilinearInterpolation() );
+  slow_rgb = rasterize_per_pixel( transform( src_rgb, shift, 45, 35, ConstantEdgeExtension(), BilinearInterpolation() ) );
+  expect_identical( fast_rgb, slow_rgb );
+
+  // The batched lookup of an approximated transform matches reverse().
+  tx.set_tolerance( 0.01 );
+  ApproximateTransform<HomographyTransform> approx( tx, BBox2i(0,0,45,35) );
+  std::vector<double> xs(45), ys(45);
+  for ( int32 y = 0; y < 35; y += 7 ) {
+    approx.reverse_row( y, 0, 45, &xs[0], &ys[0] );
+    for ( int32 x = 0; x < 45; x++ ) {
+      EXPECT_DOUBLE_EQ( approx.reverse(Vector2(x,y)).x(), xs[x] );
+      EXPECT_DOUBLE_EQ( approx.reverse(Vector2(x,y)).y(), ys[x] );
+    }
+  }
+}
+
+// Bends strongly near the origin and hardly at all elsewhere.
+class CornerWarpTransform : public TransformBase<CornerWarpTransform> {
+public:
+  inline Vector2 reverse( const Vector2& p ) const {
+    return p + Vector2(30,20) * exp(-norm_2(p)/20);
+  }
+};
+
+TEST( Transform, ApproximateAdaptive ) {
+  CornerWarpTransform tx;
+  tx.set_tolerance( 0.1 );
+  BBox2i bbox(0,0,512,512);
+  ApproximateTransform<CornerWarpTransform> approx( tx, bbox );
+
+  double max_err = 0;
+  for ( int32 y = 0; y < bbox.height(); y += 3 )
+    for ( int32 x = 0; x < bbox.width(); x += 3 )
+      max_err = std::max( max_err, norm_2( approx.reverse(Vector2(x,y)) - tx.reverse(Vector2(x,y)) ) );
+  EXPECT_LT( max_err, 2*tx.tolerance() );
+
+  // Only the corner near the origin is refined; a uniform grid fine
+  // enough for that corner would have thousands of cells.
+  EXPECT_LT( approx.num_cells(), 400 );
+  EXPECT_GT( approx.num_cells(), 10 );
+
+  // A transform that is linear needs a single cell.
+  TranslateTransform translate(3.5,-2);
+  translate.set_tolerance( 0.1 );
+  ApproximateTransform<TranslateTransform> approx_translate( translate, bbox );
+  EXPECT_EQ( 1, approx_translate.num_cells() );
+  EXPECT_VECTOR_NEAR( Vector2(96.5,52), approx_translate.reverse(Vector2(100,50)), 1e-9 );
+}
@@ -0,0 +1,465 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <vw/Math/BlockSparseCholesky.h>
+#include <vw/Core/Exception.h>
+
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <cmath>
+
+namespace vw {
+namespace math {
+
+namespace {
+
+  // Dense operations on n x n row-major blocks.
+
+  // In-place Cholesky factor of the lower triangle; the upper triangle
+  // is zeroed.  Returns false if the block is not positive definite.
+  bool block_cholesky( double* a, size_t n ) {
+    for ( size_t j = 0; j < n; ++j ) {
+      double d = a[j*n+j];
+      for ( size_t k = 0; k < j; ++k )
+        d -= a[j*n+k] * a[j*n+k];
+      if ( !(d > 0) )
+        return false;
+      d = std::sqrt(d);
+      a[j*n+j] = d;
+      for ( size_t i = j+1; i < n; ++i ) {
+        double s = a[i*n+j];
+        for ( size_t k = 0; k < j; ++k )
+          s -= a[i*n+k] * a[j*n+k];
+        a[i*n+j] = s / d;
+      }
+      for ( size_t k = j+1; k < n; ++k )
+        a[j*n+k] = 0;
+    }
+    return true;
+  }
+
+  // Solve L x = b in place, L lower triangular.
+  void forward_solve( double const* l, double* x, size_t n ) {
+    for ( size_t i = 0; i < n; ++i ) {
+      double s = x[i];
+      for ( size_t k = 0; k < i; ++k )
+        s -= l[i*n+k] * x[k];
+      x[i] = s / l[i*n+i];
+    }
+  }
+
+  // Solve L^T x = b in place, L lower triangular.
+  void backward_solve( double const* l, double* x, size_t n ) {
+    for ( size_t i = n; i-- > 0; ) {
+      double s = x[i];
+      for ( size_t k = i+1; k < n; ++k )
+        s -= l[k*n+i] * x[k];
+      x[i] = s / l[i*n+i];
+    }
+  }
+
+  // c -= a b^T
+  void subtract_abt( double* c, double const* a, double const* b, size_t n ) {
+    for ( size_t i = 0; i < n; ++i )
+      for ( size_t j = 0; j < n; ++j ) {
+        double s = 0;
+        for ( size_t k = 0; k < n; ++k )
+          s += a[i*n+k] * b[j*n+k];
+        c[i*n+j] -= s;
+      }
+  }
+
+  // y += a x, or y += a^T x
+  void add_ax( double* y, double const* a, double const* x, size_t n ) {
+    for ( size_t i = 0; i < n; ++i ) {
+      double s = 0;
+      for ( size_t k = 0; k < n; ++k )
+        s += a[i*n+k] * x[k];
+      y[i] += s;
+    }
+  }
+
+  void add_atx( double* y, double const* a, double const* x, size_t n ) {
+    for ( size_t k = 0; k < n; ++k )
+      for ( size_t i = 0; i < n; ++i )
+        y[i] += a[k*n+i] * x[k];
+  }
+
+  // y -= a x, or y -= a^T x
+  void subtract_ax( double* y, double const* a, double const* x, size_t n ) {
+    for ( size_t i = 0; i < n; ++i ) {
+      double s = 0;
+      for ( size_t k = 0; k < n; ++k )
+        s += a[i*n+k] * x[k];
+      y[i] -= s;
+    }
+  }
+
+  void subtract_atx( double* y, double const* a, double const* x, size_t n ) {
+    for ( size_t k = 0; k < n; ++k )
+      for ( size_t i = 0; i < n; ++i )
+        y[i] -= a[k*n+i] * x[k];
+  }
+
+  // The block graph of a BlockSparseMatrix, without self loops.
+  std::vector<std::vector<size_t> > block_adjacency( BlockSparseMatrix const& A ) {
+    std::vector<std::vector<size_t> > adj( A.num_blocks() );
+    for ( size_t i = 0; i < A.num_blocks(); ++i )
+      for ( size_t k = A.row_begin(i); k < A.row_end(i); ++k ) {
+        size_t j = A.col_index(k);
+        if ( j == i ) continue;
+        adj[i].push_back(j);
+        adj[j].push_back(i);
+      }
+    for ( size_t i = 0; i < adj.size(); ++i )
+      std::sort( adj[i].begin(), adj[i].end() );
+    return adj;
+  }
+
+} // namespace
+
+  // ---------------------------------------------------------------------
+  // BlockSparseMatrix
+  // ---------------------------------------------------------------------
+
+  BlockSparseMatrix::BlockSparseMatrix( size_t block_size, std::vector<std::vector<size_t> > const& pattern )
+    : m_block_size( block_size ), m_num_blocks( pattern.size() ) {
+    VW_ASSERT( block_size > 0, ArgumentErr() << "BlockSparseMatrix: block size must be positive." );
+    m_row_start.reserve( m_num_blocks+1 );
+    m_row_start.push_back( 0 );
+    for ( size_t i = 0; i < m_num_blocks; ++i ) {
+      std::vector<size_t> row( pattern[i] );
+      std::sort( row.begin(), row.end() );
+      row.erase( std::unique( row.begin(), row.end() ), row.end() );
+      VW_ASSERT( row.empty() || row.back() < i,
+                 ArgumentErr() << "BlockSparseMatrix: pattern must only list blocks below the diagonal." );
+      m_cols.insert( m_cols.end(), row.begin(), row.end() );
+      m_cols.push_back( i );
+      m_row_start.push_back( m_cols.size() );
+    }
+    m_values.resize( m_cols.size() * m_block_size * m_block_size );
+  }
+
+  double* BlockSparseMatrix::block( size_t i, size_t j ) {
+    return const_cast<double*>( static_cast<BlockSparseMatrix const&>(*this).block( i, j ) );
+  }
+
+  double const* BlockSparseMatrix::block( size_t i, size_t j ) const {
+    VW_DEBUG_ASSERT( i < m_num_blocks && j <= i, ArgumentErr() << "BlockSparseMatrix: block is not in the lower triangle." );
+    std::vector<size_t>::const_iterator begin = m_cols.begin() + m_row_start[i];
+    std::vector<size_t>::const_iterator end   = m_cols.begin() + m_row_start[i+1];
+    std::vector<size_t>::const_iterator it    = std::lower_bound( begin, end, j );
+    if ( it == end || *it != j )
+      return 0;
+    return block_data( it - m_cols.begin() );
+  }
+
+  void BlockSparseMatrix::set_zero() {
+    std::fill( m_values.begin(), m_values.end(), 0.0 );
+  }
+
+  Vector<double> BlockSparseMatrix::multiply( Vector<double> const& x ) const {
+    VW_ASSERT( x.size() == cols(), ArgumentErr() << "BlockSparseMatrix: vector size does not match." );
+    Vector<double> y( rows() );
+    if ( rows() == 0 )
+      return y;
+    const size_t n = m_block_size;
+    for ( size_t i = 0; i < m_num_blocks; ++i )
+      for ( size_t k = m_row_start[i]; k < m_row_start[i+1]; ++k ) {
+        size_t j = m_cols[k];
+        add_ax( &y[i*n], block_data(k), &x[j*n], n );
+        if ( j != i )
+          add_atx( &y[j*n], block_data(k), &x[i*n], n );
+      }
+    return y;
+  }
+
+  Matrix<double> BlockSparseMatrix::dense() const {
+    const size_t n = m_block_size;
+    Matrix<double> result( rows(), cols() );
+    for ( size_t i = 0; i < m_num_blocks; ++i )
+      for ( size_t k = m_row_start[i]; k < m_row_start[i+1]; ++k ) {
+        size_t j = m_cols[k];
+        double const* b = block_data(k);
+        for ( size_t r = 0; r < n; ++r )
+          for ( size_t c = 0; c < n; ++c ) {
+            result( i*n+r, j*n+c ) = b[r*n+c];
+            if ( j != i )
+              result( j*n+c, i*n+r ) = b[r*n+c];
+          }
+      }
+    return result;
+  }
+
+  // ---------------------------------------------------------------------
+  // Ordering
+  // ---------------------------------------------------------------------
+
+  std::vector<size_t> minimum_degree_ordering( BlockSparseMatrix const& A ) {
+    std::vector<std::vector<size_t> > adj = block_adjacency( A );
+    const size_t n = adj.size();
+
+    // Eliminating a node joins its neighbours into a clique.  The
+    // elimination graph is kept explicitly, which is fine for block
+    // graphs where each node is a whole camera.
+    std::set<std::pair<size_t,size_t> > queue;
+    for ( size_t i = 0; i < n; ++i )
+      queue.insert( std::make_pair( adj[i].size(), i ) );
+
+    std::vector<size_t> order;
+    order.reserve( n );
+    std::vector<size_t> merged;
+    while ( !queue.empty() ) {
+      size_t v = queue.begin()->second;
+      queue.erase( queue.begin() );
+      order.push_back( v );
+
+      std::vector<size_t> const& clique = adj[v];
+      for ( size_t c = 0; c < clique.size(); ++c ) {
+        size_t u = clique[c];
+        queue.erase( std::make_pair( adj[u].size(), u ) );
+        merged.clear();
+        std::set_union( adj[u].begin(), adj[u].end(), clique.begin(), clique.end(),
+                        std::back_inserter( merged ) );
+        adj[u].clear();
+        for ( size_t k = 0; k < merged.size(); ++k )
+          if ( merged[k] != u && merged[k] != v )
+            adj[u].push_back( merged[k] );
+        queue.insert( std::make_pair( adj[u].size(), u ) );
+      }
+      std::vector<size_t>().swap( adj[v] );
+    }
+    return order;
+  }
+
+  // ---------------------------------------------------------------------
+  // BlockSparseCholesky
+  // ---------------------------------------------------------------------
+
+  void BlockSparseCholesky::analyze( BlockSparseMatrix const& A ) {
+    m_pattern    = A;
+    m_block_size = A.block_size();
+    m_num_blocks = A.num_blocks();
+    m_perm       = minimum_degree_ordering( A );
+    m_inverse_perm.resize( m_num_blocks );
+    for ( size_t k = 0; k < m_num_blocks; ++k )
+      m_inverse_perm[ m_perm[k] ] = k;
+
+    // Symbolic factorization.  The pattern of column k of L is the
+    // pattern of column k of the permuted A, merged with the patterns
+    // of its children in the elimination tree.
+    std::vector<std::vector<size_t> > adj = block_adjacency( A );
+    std::vector<std::vector<size_t> > columns( m_num_blocks ), children( m_num_blocks );
+    for ( size_t k = 0; k < m_num_blocks; ++k ) {
+      std::vector<size_t>& col = columns[k];
+      std::vector<size_t> const& neighbours = adj[ m_perm[k] ];
+      for ( size_t c = 0; c < neighbours.size(); ++c )
+        if ( m_inverse_perm[ neighbours[c] ] > k )
+          col.push_back( m_inverse_perm[ neighbours[c] ] );
+      for ( size_t c = 0; c < children[k].size(); ++c ) {
+        std::vector<size_t> const& child = columns[ children[k][c] ];
+        for ( size_t r = 0; r < child.size(); ++r )
+          if ( child[r] > k )
+            col.push_back( child[r] );
+      }
+      std::sort( col.begin(), col.end() );
+      col.erase( std::unique( col.begin(), col.end() ), col.end() );
+      if ( !col.empty() )
+        children[ col.front() ].push_back( k );
+    }
+
+    m_col_start.assign( 1, 0 );
+    m_rows.clear();
+    for ( size_t k = 0; k < m_num_blocks; ++k ) {
+      m_rows.insert( m_rows.end(), columns[k].begin(), columns[k].end() );
+      m_col_start.push_back( m_rows.size() );
+      std::vector<size_t>().swap( columns[k] );
+    }
+
+    // Where each block of A lands in L.  Diagonal blocks are numbered
+    // by column, and the others follow.
+    m_source.resize( A.num_nonzero_blocks() );
+    m_source_transposed.resize( A.num_nonzero_blocks() );
+    for ( size_t i = 0; i < m_num_blocks; ++i )
+      for ( size_t q = A.row_begin(i); q < A.row_end(i); ++q ) {
+        size_t ri = m_inverse_perm[i], rj = m_inverse_perm[ A.col_index(q) ];
+        if ( ri == rj ) {
+          m_source[q] = ri;
+          m_source_transposed[q] = false;
+          continue;
+        }
+        size_t row = std::max( ri, rj ), col = std::min( ri, rj );
+        std::vector<size_t>::const_iterator it =
+          std::lower_bound( m_rows.begin() + m_col_start[col], m_rows.begin() + m_col_start[col+1], row );
+        m_source[q] = m_num_blocks + ( it - m_rows.begin() );
+        m_source_transposed[q] = ri < rj;
+      }
+
+    m_analyzed = true;
+    m_factored = false;
+  }
+
+  bool BlockSparseCholesky::factor( BlockSparseMatrix const& A ) {
+    if ( !analyzed_for( A ) )
+      analyze( A );
+
+    const size_t n = m_block_size, bb = n*n;
+    m_diagonal.assign( m_num_blocks * bb, 0.0 );
+    m_values.assign( m_rows.size() * bb, 0.0 );
+    for ( size_t q = 0; q < m_source.size(); ++q ) {
+      double const* src = A.block_data(q);
+      double* dst = m_source[q] < m_num_blocks ? &m_diagonal[ m_source[q]*bb ]
+                                               : &m_values[ (m_source[q]-m_num_blocks)*bb ];
+      if ( m_source_transposed[q] ) {
+        for ( size_t r = 0; r < n; ++r )
+          for ( size_t c = 0; c < n; ++c )
+            dst[r*n+c] = src[c*n+r];
+      } else {
+        std::copy( src, src+bb, dst );
+      }
+    }
+
+    // Right-looking factorization, one block column at a time.  The
+    // rows of column k below row j are always rows of column j, so the
+    // updates to column j can be found by walking both lists together.
+    m_factored = false;
+    for ( size_t k = 0; k < m_num_blocks; ++k ) {
+      double* d = &m_diagonal[k*bb];
+      if ( !block_cholesky( d, n ) )
+        return false;
+
+      const size_t begin = m_col_start[k], end = m_col_start[k+1];
+      for ( size_t p = begin; p < end; ++p ) {
+        // L_pk = A_pk D^{-T}, solved a row at a time.
+        double* l = &m_values[p*bb];
+        for ( size_t r = 0; r < n; ++r )
+          forward_solve( d, l + r*n, n );
+      }
+
+      for ( size_t pa = begin; pa < end; ++pa ) {
+        size_t ra = m_rows[pa];
+        double const* la = &m_values[pa*bb];
+        subtract_abt( &m_diagonal[ra*bb], la, la, n );
+        size_t q = m_col_start[ra];
+        for ( size_t pb = pa+1; pb < end; ++pb ) {
+          size_t rb = m_rows[pb];
+          while ( m_rows[q] < rb ) ++q;
+          subtract_abt( &m_values[q*bb], &m_values[pb*bb], la, n );
+        }
+      }
+    }
+    m_factored = true;
+    return true;
+  }
+
+  Vector<double> BlockSparseCholesky::solve( Vector<double> const& b ) const {
+    VW_ASSERT( m_factored, LogicErr() << "BlockSparseCholesky: solve() called without a successful factor()." );
+    const size_t n = m_block_size, bb = n*n;
+    VW_ASSERT( b.size() == n*m_num_blocks, ArgumentErr() << "BlockSparseCholesky: vector size does not match." );
+
+    Vector<double> y( b.size() );
+    if ( b.size() == 0 )
+      return y;
+    for ( size_t k = 0; k < m_num_blocks; ++k )
+      for ( size_t r = 0; r < n; ++r )
+        y[k*n+r] = b[ m_perm[k]*n+r ];
+
+    // L z = y
+    for ( size_t k = 0; k < m_num_blocks; ++k ) {
+      forward_solve( &m_diagonal[k*bb], &y[k*n], n );
+      for ( size_t p = m_col_start[k]; p < m_col_start[k+1]; ++p )
+        subtract_ax( &y[ m_rows[p]*n ], &m_values[p*bb], &y[k*n], n );
+    }
+    // L^T x = z
+    for ( size_t k = m_num_blocks; k-- > 0; ) {
+      for ( size_t p = m_col_start[k]; p < m_col_start[k+1]; ++p )
+        subtract_atx( &y[k*n], &m_values[p*bb], &y[ m_rows[p]*n ], n );
+      backward_solve( &m_diagonal[k*bb], &y[k*n], n );
+    }
+
+    Vector<double> x( b.size() );
+    for ( size_t k = 0; k < m_num_blocks; ++k )
+      for ( size_t r = 0; r < n; ++r )
+        x[ m_perm[k]*n+r ] = y[k*n+r];
+    return x;
+  }
+
+  // ---------------------------------------------------------------------
+  // Conjugate gradient
+  // ---------------------------------------------------------------------
+
+  size_t block_jacobi_pcg( BlockSparseMatrix const& A, Vector<double> const& b, Vector<double>& x,
+                           double tolerance, size_t max_iterations ) {
+    const size_t n = A.block_size(), bb = n*n, size = A.rows();
+    VW_ASSERT( b.size() == size, ArgumentErr() << "block_jacobi_pcg: vector size does not match." );
+    if ( x.size() != size )
+      x = Vector<double>( size );
+    if ( max_iterations == 0 )
+      max_iterations = size;
+    double b_norm = norm_2( b );
+    if ( size == 0 || b_norm == 0 ) {
+      x = Vector<double>( size );
+      return 0;
+    }
+
+    // Factor the diagonal blocks.  A block that is not positive
+    // definite is left out of the preconditioner.
+    std::vector<double> precond( A.num_blocks() * bb );
+    std::vector<bool> use_block( A.num_blocks() );
+    for ( size_t i = 0; i < A.num_blocks(); ++i ) {
+      double* d = &precond[i*bb];
+      std::copy( A.block_data( A.row_end(i)-1 ), A.block_data( A.row_end(i)-1 ) + bb, d );
+      use_block[i] = block_cholesky( d, n );
+    }
+
+    Vector<double> r = b - A.multiply( x );
+    Vector<double> z = r;
+    for ( size_t i = 0; i < A.num_blocks(); ++i )
+      if ( use_block[i] ) {
+        forward_solve ( &precond[i*bb], &z[i*n], n );
+        backward_solve( &precond[i*bb], &z[i*n], n );
+      }
+    Vector<double> p = z;
+    double rz = dot_prod( r, z );
+
+    size_t iteration = 0;
+    while ( iteration < max_iterations && norm_2( r ) > tolerance * b_norm ) {
+      Vector<double> ap = A.multiply( p );
+      double pap = dot_prod( p, ap );
+      if ( !(pap > 0) )
+        break;
+      double alpha = rz / pap;
+      x += alpha * p;
+      r -= alpha * ap;
+      ++iteration;
+
+      z = r;
+      for ( size_t i = 0; i < A.num_blocks(); ++i )
+        if ( use_block[i] ) {
+          forward_solve ( &precond[i*bb], &z[i*n], n );
+          backward_solve( &precond[i*bb], &z[i*n], n );
+        }
+      double rz_next = dot_prod( r, z );
+      p = z + ( rz_next / rz ) * p;
+      rz = rz_next;
+    }
+    return iteration;
+  }
+
+}} // namespace vw::math
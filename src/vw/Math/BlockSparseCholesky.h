@@ -0,0 +1,145 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file BlockSparseCholesky.h
+///
+/// Symmetric matrices made of dense square blocks, such as the reduced
+/// camera system of bundle adjustment, and solvers for them: a sparse
+/// Cholesky factorization that works a block at a time and can be
+/// refactored with new values without repeating the ordering and
+/// symbolic analysis, and a block-Jacobi preconditioned conjugate
+/// gradient for systems too large to factor.
+///
+#ifndef __VW_MATH_BLOCKSPARSECHOLESKY_H__
+#define __VW_MATH_BLOCKSPARSECHOLESKY_H__
+
+#include <vector>
+
+#include <vw/Math/Vector.h>
+#include <vw/Math/Matrix.h>
+
+namespace vw {
+namespace math {
+
+  /// A symmetric matrix of dense square blocks.  Only the lower
+  /// triangle is stored, by block row; each block is stored row-major.
+  /// The pattern of nonzero blocks is fixed on construction.
+  class BlockSparseMatrix {
+    size_t m_block_size, m_num_blocks;
+    std::vector<size_t> m_row_start;   ///< Start of each block row in m_cols
+    std::vector<size_t> m_cols;        ///< Sorted block columns of each row, ending with the diagonal
+    std::vector<double> m_values;
+
+  public:
+    BlockSparseMatrix() : m_block_size(0), m_num_blocks(0), m_row_start(1,0) {}
+
+    /// pattern[i] lists the block columns j < i of the nonzero blocks in
+    /// block row i, in any order.  The diagonal blocks are always present.
+    BlockSparseMatrix( size_t block_size, std::vector<std::vector<size_t> > const& pattern );
+
+    size_t block_size() const { return m_block_size; }
+    size_t num_blocks() const { return m_num_blocks; }
+    size_t rows()       const { return m_block_size * m_num_blocks; }
+    size_t cols()       const { return m_block_size * m_num_blocks; }
+
+    /// The number of stored blocks, including the diagonal.
+    size_t num_nonzero_blocks() const { return m_cols.size(); }
+
+    /// The block at block row i, block column j <= i, or null if the
+    /// block is not in the pattern.
+    double*       block( size_t i, size_t j );
+    double const* block( size_t i, size_t j ) const;
+
+    /// Iterate over the stored blocks of block row i.
+    size_t row_begin( size_t i ) const { return m_row_start[i]; }
+    size_t row_end  ( size_t i ) const { return m_row_start[i+1]; }
+    size_t col_index( size_t k ) const { return m_cols[k]; }
+    double*       block_data( size_t k )       { return &m_values[k*m_block_size*m_block_size]; }
+    double const* block_data( size_t k ) const { return &m_values[k*m_block_size*m_block_size]; }
+
+    /// Whether the other matrix has the same block size and pattern.
+    bool same_pattern( BlockSparseMatrix const& other ) const {
+      return m_block_size == other.m_block_size && m_row_start == other.m_row_start && m_cols == other.m_cols;
+    }
+
+    void set_zero();
+
+    /// y = A x
+    Vector<double> multiply( Vector<double> const& x ) const;
+
+    /// The full matrix, for testing and debugging.
+    Matrix<double> dense() const;
+  };
+
+  /// A fill-reducing ordering of the block rows of a symmetric matrix,
+  /// chosen greedily by minimum degree.  Entry k is the block row to
+  /// eliminate k-th.  Ties are broken by the lowest index, so the
+  /// ordering is deterministic.
+  std::vector<size_t> minimum_degree_ordering( BlockSparseMatrix const& A );
+
+  /// Sparse Cholesky factorization, L L^T = P A P^T, of a symmetric
+  /// positive definite BlockSparseMatrix.
+  ///
+  /// analyze() computes the ordering and the pattern of L.  factor()
+  /// computes the values, and may be called again for any matrix with
+  /// the same pattern, as happens across Levenberg-Marquardt iterations.
+  class BlockSparseCholesky {
+    BlockSparseMatrix   m_pattern;     ///< The analyzed pattern (values unused)
+    size_t              m_block_size, m_num_blocks;
+    std::vector<size_t> m_perm, m_inverse_perm;
+    std::vector<size_t> m_col_start;   ///< Start of each block column of L in m_rows
+    std::vector<size_t> m_rows;        ///< Sorted rows below the diagonal in each column
+    std::vector<double> m_diagonal;    ///< Diagonal blocks of L, row-major
+    std::vector<double> m_values;      ///< Blocks below the diagonal, row-major
+    std::vector<size_t> m_source;      ///< Where each block of A goes in L
+    std::vector<bool>   m_source_transposed;
+    bool                m_analyzed, m_factored;
+
+  public:
+    BlockSparseCholesky() : m_block_size(0), m_num_blocks(0), m_analyzed(false), m_factored(false) {}
+
+    /// Order A and compute the pattern of its factor.
+    void analyze( BlockSparseMatrix const& A );
+
+    /// Whether analyze() has been called for a matrix with A's pattern.
+    bool analyzed_for( BlockSparseMatrix const& A ) const { return m_analyzed && m_pattern.same_pattern( A ); }
+
+    /// Factor A, analyzing it first if its pattern is new.  Returns
+    /// false if A is not positive definite.
+    bool factor( BlockSparseMatrix const& A );
+
+    /// Solve A x = b with the last factorization.
+    Vector<double> solve( Vector<double> const& b ) const;
+
+    std::vector<size_t> const& ordering() const { return m_perm; }
+
+    /// The number of blocks in L, including the diagonal.
+    size_t num_factor_blocks() const { return m_num_blocks + m_rows.size(); }
+  };
+
+  /// Solve A x = b by conjugate gradient, preconditioned by the inverses
+  /// of A's diagonal blocks.  x holds the initial guess and receives
+  /// the solution.  Iteration stops when the residual norm falls below
+  /// tolerance times the norm of b, or after max_iterations (zero means
+  /// the size of A).  Returns the number of iterations taken.
+  size_t block_jacobi_pcg( BlockSparseMatrix const& A, Vector<double> const& b, Vector<double>& x,
+                           double tolerance = 1e-10, size_t max_iterations = 0 );
+
+}} // namespace vw::math
+
+#endif // __VW_MATH_BLOCKSPARSECHOLESKY_H__
@@ -26,14 +26,11 @@
 /// Tree only supports searches on records of numeric data
 ///
 /// Methods
-/// -- Building a KD tree (optimized, balanced, or randomly built,
-///    depending on the the choice of partitioner and discriminator selector).
+/// -- Building a balanced KD tree, in parallel for large files
 ///   -- KD m nearest neighbors
 ///   -- Insertion of a single record into the tree
 ///   -- size of tree
-/// -- Max and Min depth of tree (requires testing to insure that
-///    depths are consistent regardless of whether build_tree or insert
-///    was used.)
+/// -- Max and Min depth of the leaves
 ///   -- Region/Constrained Search (return all records within a region)
 ///      Constraint functors are likely to place constraints on records' keys,
 ///      but since the constraint functor has access to the record object, the
@@ -54,96 +51,41 @@
 /// Some terminology:
 /// A file is a container of records. A record is a container of k keys.
 ///
-/// Each vertex in the tree has associated properties, which can be accessed via
-/// BGL property maps. The properties are:
-///    -a record of k keys,
-///    -a discriminator index,
-///    -identifiers for its LO and HI subtrees, and
-///    -hi and low ranges.
+/// The tree is stored in flat arrays rather than as linked vertices.
+/// Each internal node splits its cell at a key value along one
+/// dimension (the discriminator): records in the LO child have keys
+/// <= the split, and records in the HI child have keys >= the split.
+/// The two children of a node are adjacent in the node array.
 ///
+/// Records are kept in the leaves, in buckets of up to leaf_size
+/// records.  The keys of a bucket are stored dimension by dimension,
+/// so the distances from a query to a whole bucket are computed in a
+/// single pass over contiguous memory.
 ///
-/// The record is the k-dimensional object. It must be iterable.
-///
-/// The discriminator identifies which of the vertex's k keys is used
-/// to divide the subtrees. For some vertex P, let j =
-/// discriminator(P). Then, any vertex Q in the LO subtree satisfies
-/// Key_j(Q) < Key_j(P), and any vertex R in the HI subtree satisfies
-/// Key_j(r) >= Key_j(Q). Note "=" for the HI subtree; this allows for
-/// duplicate keys (multisets), but sacrifices any guarantees that the
-/// tree be balanced.
-///
-/// Lo and Hi identifiers - bgl vertex descriptors 'loson' and 'hison'
-/// which are the roots of the low and high subtrees below a vertex.
-///
-/// Lo and Hi ranges - Each vertex represents a partitioning of the
-/// k-dimensional space along the dimension specified by the
-/// discriminator. For any vertex P in the tree, all values in the
-/// subtree rooted at P fall within the hyper-rectangle bounded by
-/// lorange(P) and hirange(p)
-///
-///
-///
-///   The root's range is -infinity to infinity on each dimension, represented
-///   as LO_Range = record of -inf, HI_Range = record of +inf.
-///
-///     L: [-inf, -inf, ..., -inf]
-///     H: [+inf, +inf, ..., +inf]      root, disc = 1
-///     Record:[0, 1, ..., -3]          | |
-///                                    |   |
-///                                   |     |
-///       L: [-inf, -inf,...,-inf]   A        B  L:   [-inf, 1, ..., -inf]
-///       H: (+inf, 1, ... ,+inf)                     H: [+inf, +inf, .., +inf]
-///
-///     By convention, the left has "<" and the rigt has ">="
-///
-///     Range variables should use the typedef range_t.
+/// A search descends to the cell containing the query, then visits
+/// the other cells in order of the tree, skipping any cell whose
+/// distance from the query is more than that of the mth nearest
+/// record found so far.
 ///
 #ifndef __VW_MATH_KDTREE_H__
 #define __VW_MATH_KDTREE_H__
 
 #include <vw/Core/FundamentalTypes.h>
 
-#include <boost/config.hpp>
-#include <boost/graph/adjacency_list.hpp>
+#include <vw/Core/Exception.h>
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
 
-#if (BOOST_VERSION >= 104000)
-#include <boost/property_map/property_map.hpp>
-#else
-#include <boost/property_map.hpp>
-#endif
+#include <boost/shared_ptr.hpp>
 
 // Std C++
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <vector>
 #include <iterator>
-#include <queue>
-
-// for INT_MAX
-#include <climits>
-
-//for printing graph
-//#include <boost/graph/breadth_first_search.hpp>
-
-//Create custom property tags. See section 3.6 in the BGL user guide
-namespace boost{
-  enum vertex_record_t{vertex_record = 511}; //A unique number
-  BOOST_INSTALL_PROPERTY(vertex, record);
-
-  enum vertex_discriminator_t{vertex_discriminator = 512};
-  BOOST_INSTALL_PROPERTY(vertex, discriminator);
-
-  enum vertex_LOSON_t{vertex_LOSON = 513};
-  BOOST_INSTALL_PROPERTY(vertex, LOSON);
-
-  enum vertex_HISON_t{vertex_HISON = 514};
-  BOOST_INSTALL_PROPERTY(vertex, HISON);
-
-  enum vertex_LORANGE_t{vertex_LORANGE = 515};
-  BOOST_INSTALL_PROPERTY(vertex, LORANGE);
-
-  enum vertex_HIRANGE_t{vertex_HIRANGE = 516};
-  BOOST_INSTALL_PROPERTY(vertex, HIRANGE);
-}
+#include <limits>
+#include <utility>
+#include <vector>
 
 namespace vw {
 namespace math {
@@ -483,7 +425,18 @@ namespace math {
   /////////////////////////////////////////////////////////////////////////
   /// KD Tree
   //
-  //  template <typename RandomAccessIterT>
+  // The nodes are a flat array in which the two children of a node
+  // are adjacent, and the records live in fixed size leaf buckets
+  // whose keys are stored one dimension after another, so that the
+  // distances to a whole bucket are computed in one vectorizable pass.
+  //
+  // Each split is at the median of the dimension with the largest
+  // spread, which takes O(n log n) overall.  Large files are split
+  // near the root on the calling thread and the subtrees below are
+  // built in parallel.
+  //
+  // Searches keep all their state on the stack, so a built tree may
+  // be searched from several threads at once.
   template <class FileT>
   class KDTree{
 
@@ -493,145 +446,307 @@ namespace math {
 
     typedef typename std::vector<key_t> range_t; //range_t should be selected to provide the operator[]
 
-    typedef boost::graph_traits< boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS > >::vertex_descriptor Vertex;
-    //      typedef boost::graph_traits< adjacency_list<vecS, vecS, undirectedS > >::edge_descriptor Edge;
-
-    //The underlying graph structure:
-    typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS,
-                                  boost::property<boost::vertex_discriminator_t, size_t,
-                                    boost::property<boost::vertex_record_t, record_t,
-                                             boost::property<boost::vertex_LOSON_t, Vertex,
-                                                      boost::property<boost::vertex_HISON_t, Vertex,
-                                                               boost::property<boost::vertex_LORANGE_t, range_t,
-                                                                        boost::property<boost::vertex_HIRANGE_t, range_t > > > > > > > BGL_KDTree;
+    // An internal node splits its cell at split along dimension dim;
+    // its lo child, with keys <= split, is node first and its hi
+    // child, with keys >= split, is node first+1.  A leaf holds count
+    // records in bucket first.
+    struct Node {
+      key_t  split;
+      uint32 dim;
+      uint32 first;
+      uint32 count;
+      bool is_leaf() const { return dim == leaf_flag; }
+    };
+    static const uint32 leaf_flag = 0xffffffff;
 
     //////////////////  --- KD Members --- /////////////////////////
 
     key_t m_POSITIVE_INFINITY;
     key_t m_NEGATIVE_INFINITY;
-    BGL_KDTree m_kdTree;
-    Vertex m_NIL;
-    Vertex m_root;
     size_t m_k; //dimensionality of kd tree
-    size_t m_max_depth;
-    size_t m_min_depth;
-
-    class VertexDistanceComparator;
-
-    //The m closest records encountered so far during a nearest neighbor search
-    //The double is the distance of the Vertex from the query
-    std::priority_queue< std::pair<Vertex, key_t>, std::vector<std::pair<Vertex, key_t> >, VertexDistanceComparator > m_priority_queue;
-
-    // Property maps:
-    // given a vertex descriptor V, its properties can be accessed like:
-    // size_t disc = m_discriminator_map[V];
-    typename boost::property_map<BGL_KDTree, boost::vertex_record_t>::type m_record_map;
-    typename boost::property_map<BGL_KDTree, boost::vertex_discriminator_t>::type m_discriminator_map;
-    typename boost::property_map<BGL_KDTree, boost::vertex_LOSON_t>::type m_LOSON_map;
-    typename boost::property_map<BGL_KDTree, boost::vertex_HISON_t>::type m_HISON_map;
-    typename boost::property_map<BGL_KDTree, boost::vertex_LORANGE_t>::type m_LORANGE_map;
-    typename boost::property_map<BGL_KDTree, boost::vertex_HIRANGE_t>::type m_HIRANGE_map;
+    size_t m_leaf_size;
+    size_t m_size;
+    std::vector<Node>     m_nodes;   // The root is node 0
+    std::vector<key_t>    m_keys;    // Bucket b, dimension d, slot i at (b*m_k + d)*m_leaf_size + i
+    std::vector<record_t> m_records; // Bucket b, slot i at b*m_leaf_size + i
 
   public:
 
+    /// Buckets of this size balance the cost of descending the tree
+    /// against that of scanning a bucket.
+    static const size_t default_leaf_size = 8;
+
     ///////////////  --- KD Constructors ---  //////////////////////
 
-    KDTree(size_t k) : m_k(k), m_max_depth(0), m_min_depth(INT_MAX){
-      //initialize
-      initialize_property_maps();
+    KDTree(size_t k, size_t leaf_size = default_leaf_size) : m_k(k), m_leaf_size(leaf_size){
       initialize_infinity();
-
-      //build tree:
-      m_NIL = add_vertex(m_kdTree);
-      m_root = m_NIL;
+      clear();
     }
 
-    KDTree(size_t k, FileT const& file) : m_k(k), m_max_depth(0), m_min_depth(INT_MAX)
+    KDTree(size_t k, FileT const& file, size_t leaf_size = default_leaf_size) : m_k(k), m_leaf_size(leaf_size)
     {
-      //initialize
-      initialize_property_maps();
       initialize_infinity();
-
-      //build tree
-      initialize_tree(file, ModuloDiscSelector(m_k), MedianPartitioner());
+      initialize_tree(file);
     }
 
-    //Specify functors to select discriminator and partition
+    // The selector and partitioner are accepted for compatibility.
+    // Every split is at the median of the dimension of largest spread.
     template<typename DiscSelector, typename Partitioner>
     KDTree(size_t k, FileT const& file,
-           DiscSelector discSelector, Partitioner partitioner) : m_k(k), m_max_depth(0), m_min_depth(INT_MAX)
+           DiscSelector /*discSelector*/, Partitioner /*partitioner*/,
+           size_t leaf_size = default_leaf_size) : m_k(k), m_leaf_size(leaf_size)
     {
-      //initialize
-      initialize_property_maps();
       initialize_infinity();
-
-      //build tree
-      initialize_tree(file, discSelector, partitioner);
+      initialize_tree(file);
     }
 
   private:
 
-    //Capture the redundant initialization in the different constructors:
-    void initialize_property_maps(){
-      m_record_map = get(boost::vertex_record, m_kdTree);
-      m_discriminator_map = get(boost::vertex_discriminator, m_kdTree);
-      m_LOSON_map = get(boost::vertex_LOSON, m_kdTree);
-      m_HISON_map = get(boost::vertex_HISON, m_kdTree);
-      m_LORANGE_map = get(boost::vertex_LORANGE, m_kdTree);
-      m_HIRANGE_map = get(boost::vertex_HIRANGE, m_kdTree);
-    }
     void initialize_infinity(){
+      VW_ASSERT( m_k > 0 && m_leaf_size > 0,
+                 ArgumentErr() << "KDTree: the dimension and leaf size must be positive." );
       m_POSITIVE_INFINITY = vw::ScalarTypeLimits<key_t>::highest();
       m_NEGATIVE_INFINITY = vw::ScalarTypeLimits<key_t>::lowest();
     }
-    template<typename DiscSelector, typename Partitioner>
-    void initialize_tree(FileT const& file,
-                         DiscSelector /*discselector*/, Partitioner /*partitioner*/)
+
+    // A subtree left to build after the top of the tree is split.
+    struct Pending {
+      uint32 node, begin, end;
+    };
+
+    // Builds the subtree of the records in order[begin,end) as node
+    // index of nodes.  Leaves refer to their range of order, not yet
+    // to a bucket.  Below stop_depth, subtrees are left in pending.
+    void build_tree(std::vector<Node>& nodes, uint32 index,
+                    std::vector<uint32>& order, uint32 begin, uint32 end,
+                    std::vector<key_t> const& keys,
+                    size_t depth, size_t stop_depth, std::vector<Pending>* pending) const
     {
-      range_t lo_range(m_k, m_NEGATIVE_INFINITY);
-      range_t hi_range(m_k, m_POSITIVE_INFINITY);
+      if (end - begin <= m_leaf_size){
+        nodes[index].dim   = leaf_flag;
+        nodes[index].first = begin;
+        nodes[index].count = end - begin;
+        return;
+      }
+      if (pending && depth == stop_depth){
+        Pending p = { index, begin, end };
+        pending->push_back(p);
+        return;
+      }
 
-      m_NIL = add_vertex(m_kdTree);
+      uint32 dim = widest_dimension(order.begin() + begin, order.begin() + end, keys);
+      uint32 middle = begin + (end - begin) / 2;
+      std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                       KeyCompare(keys, m_k, dim));
+
+      uint32 first = nodes.size();
+      nodes[index].split = keys[order[middle]*m_k + dim];
+      nodes[index].dim   = dim;
+      nodes[index].first = first;
+      nodes[index].count = 0;
+      nodes.resize(first + 2);
+      build_tree(nodes, first,   order, begin,  middle, keys, depth+1, stop_depth, pending);
+      build_tree(nodes, first+1, order, middle, end,    keys, depth+1, stop_depth, pending);
+    }
+
+    class BuildTask : public Task {
+      KDTree const& m_tree;
+      std::vector<uint32>& m_order;
+      std::vector<key_t> const& m_keys;
+      uint32 m_begin, m_end;
+    public:
+      std::vector<Node> nodes;
 
-      // TODO: This copy is required as the paritioners will run an
-      // in-place sort on sections of the input.
-      std::vector<record_t> temp_file(std::distance(file.begin(), file.end()));
-      std::copy(file.begin(), file.end(), temp_file.begin());
+      BuildTask(KDTree const& tree, std::vector<uint32>& order, std::vector<key_t> const& keys,
+                uint32 begin, uint32 end) :
+        m_tree(tree), m_order(order), m_keys(keys), m_begin(begin), m_end(end), nodes(1) {}
 
-      m_root = build_tree(temp_file.begin(), temp_file.end(), lo_range, hi_range,
-                          ModuloDiscSelector(m_k), MedianPartitioner(), -1, 0);
-    }
+      virtual void operator()() {
+        m_tree.build_tree(nodes, 0, m_order, m_begin, m_end, m_keys, 0, 0, 0);
+      }
+    };
 
+    void initialize_tree(FileT const& file)
+    {
+      std::vector<record_t> records(file.begin(), file.end());
+      VW_ASSERT( records.size() < size_t(leaf_flag),
+                 ArgumentErr() << "KDTree: too many records." );
+
+      std::vector<key_t> keys(records.size() * m_k);
+      for (size_t i = 0; i < records.size(); ++i)
+        copy_keys(records[i], &keys[i*m_k]);
+      std::vector<uint32> order(records.size());
+      for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+      // Split the top of the tree here, into a few subtrees per
+      // thread, then build those in parallel and splice them in.
+      int num_threads = vw_settings().default_num_threads();
+      size_t stop_depth = 0;
+      while (num_threads > 1 && (size_t(1) << stop_depth) < size_t(4 * num_threads))
+        ++stop_depth;
+      bool parallel = num_threads > 1 && records.size() > (size_t(1) << 14);
+
+      std::vector<Pending> pending;
+      m_nodes.assign(1, Node());
+      build_tree(m_nodes, 0, order, 0, order.size(), keys, 0, stop_depth,
+                 parallel ? &pending : 0);
+
+      if (!pending.empty()) {
+        std::vector<boost::shared_ptr<BuildTask> > tasks;
+        FifoWorkQueue queue(num_threads);
+        for (size_t i = 0; i < pending.size(); ++i) {
+          tasks.push_back(boost::shared_ptr<BuildTask>(
+            new BuildTask(*this, order, keys, pending[i].begin, pending[i].end)));
+          queue.add_task(tasks.back());
+        }
+        queue.join_all();
+        for (size_t i = 0; i < pending.size(); ++i) {
+          std::vector<Node> const& sub = tasks[i]->nodes;
+          uint32 offset = m_nodes.size() - 1;
+          for (size_t j = 0; j < sub.size(); ++j) {
+            Node node = sub[j];
+            if (!node.is_leaf())
+              node.first += offset;
+            if (j == 0)
+              m_nodes[pending[i].node] = node;
+            else
+              m_nodes.push_back(node);
+          }
+        }
+      }
 
-    //A private class provides the needed binary predicate for the queue:
-    //With this, priority_queue.top() always returns the pair of greatest distance.
-    class VertexDistanceComparator{
-    public:
-      template<typename T>
-      bool operator()(const std::pair<Vertex,T>& pairA,
-                      const std::pair<Vertex,T>& pairB) const{
-        return (pairA.second < pairB.second);
+      // Give each leaf its bucket, in node order.
+      size_t num_leaves = 0;
+      for (size_t i = 0; i < m_nodes.size(); ++i)
+        if (m_nodes[i].is_leaf())
+          ++num_leaves;
+      m_keys.assign(num_leaves * m_k * m_leaf_size, key_t());
+      m_records.assign(num_leaves * m_leaf_size, record_t());
+      uint32 bucket = 0;
+      for (size_t i = 0; i < m_nodes.size(); ++i) {
+        Node& node = m_nodes[i];
+        if (!node.is_leaf())
+          continue;
+        for (uint32 slot = 0; slot < node.count; ++slot)
+          store(bucket, slot, records[order[node.first + slot]]);
+        node.first = bucket++;
       }
+      m_size = records.size();
+    }
+
+    struct KeyCompare {
+      std::vector<key_t> const& keys;
+      size_t k, dim;
+      KeyCompare(std::vector<key_t> const& keys, size_t k, size_t dim) : keys(keys), k(k), dim(dim) {}
+      bool operator()(uint32 a, uint32 b) const { return keys[a*k + dim] < keys[b*k + dim]; }
     };
 
+    // The dimension in which the given records are most spread out.
+    template <typename IterT>
+    uint32 widest_dimension(IterT begin, IterT end, std::vector<key_t> const& keys) const {
+      std::vector<key_t> lo(keys.begin() + (*begin)*m_k, keys.begin() + (*begin+1)*m_k), hi(lo);
+      for (IterT i = begin; i != end; ++i) {
+        typename std::vector<key_t>::const_iterator key = keys.begin() + (*i)*m_k;
+        for (size_t d = 0; d < m_k; ++d) {
+          lo[d] = std::min(lo[d], key[d]);
+          hi[d] = std::max(hi[d], key[d]);
+        }
+      }
+      uint32 dim = 0;
+      for (size_t d = 1; d < m_k; ++d)
+        if (double(hi[d]) - double(lo[d]) > double(hi[dim]) - double(lo[dim]))
+          dim = d;
+      return dim;
+    }
+
+    void copy_keys(record_t const& record, key_t* keys) const {
+      record_iter_t key = record.begin();
+      for (size_t d = 0; d < m_k; ++d, ++key)
+        keys[d] = *key;
+    }
+
+    void store(uint32 bucket, uint32 slot, record_t const& record) {
+      m_records[bucket*m_leaf_size + slot] = record;
+      record_iter_t key = record.begin();
+      for (size_t d = 0; d < m_k; ++d, ++key)
+        m_keys[(bucket*m_k + d)*m_leaf_size + slot] = *key;
+    }
+
+    uint32 add_bucket() {
+      m_keys.resize(m_keys.size() + m_k * m_leaf_size);
+      m_records.resize(m_records.size() + m_leaf_size);
+      return m_records.size() / m_leaf_size - 1;
+    }
+
   public:
 
     //////////////////   --- KD Public Methods ---  /////////////////////////
 
-    //  Insert one record into an existing k-d tree. Does not guarantee
-    //  a balanced tree. Allowing duplicate records produces a multiset, where all records
-    //  in the left subtree are < root, and all records in the right subtree are >= the root.
+    //  Insert one record into an existing k-d tree.  The record goes
+    //  into the bucket of its cell, and a full bucket is split in two
+    //  at its median.  Inserts do not rebalance the tree.  Allowing
+    //  duplicate records produces a multiset.
     void insert(record_t r){
-      kd_insert(r, m_root, 0);
-    }
+      uint32 index = 0;
+      while (!m_nodes[index].is_leaf()) {
+        Node const& node = m_nodes[index];
+        record_iter_t key = r.begin();
+        std::advance(key, node.dim);
+        index = node.first + (*key < node.split ? 0 : 1);
+      }
 
-    /*
-    //TODO:
+      ++m_size;
+      if (m_nodes[index].count < m_leaf_size) {
+        store(m_nodes[index].first, m_nodes[index].count++, r);
+        return;
+      }
+
+      // Split the full bucket and the new record between two children.
+      uint32 bucket = m_nodes[index].first;
+      std::vector<record_t> records(m_records.begin() + bucket*m_leaf_size,
+                                    m_records.begin() + (bucket+1)*m_leaf_size);
+      records.push_back(r);
+      std::vector<key_t> keys(records.size() * m_k);
+      std::vector<uint32> order(records.size());
+      for (size_t i = 0; i < records.size(); ++i) {
+        copy_keys(records[i], &keys[i*m_k]);
+        order[i] = i;
+      }
+      uint32 dim = widest_dimension(order.begin(), order.end(), keys);
+      uint32 middle = order.size() / 2;
+      std::nth_element(order.begin(), order.begin() + middle, order.end(), KeyCompare(keys, m_k, dim));
+
+      Node lo, hi;
+      lo.dim = hi.dim = leaf_flag;
+      lo.first = bucket;
+      lo.count = middle;
+      hi.first = add_bucket();
+      hi.count = order.size() - middle;
+      for (uint32 i = 0; i < lo.count; ++i)
+        store(lo.first, i, records[order[i]]);
+      for (uint32 i = 0; i < hi.count; ++i)
+        store(hi.first, i, records[order[middle + i]]);
+
+      Node& node = m_nodes[index];
+      node.split = keys[order[middle]*m_k + dim];
+      node.dim   = dim;
+      node.first = m_nodes.size();
+      node.count = 0;
+      m_nodes.push_back(lo);
+      m_nodes.push_back(hi);
+    }
+
+    // Removes all records.
     void clear(){
-    //remove all vertices
-    //clear all state
+      m_nodes.assign(1, Node());
+      m_nodes[0].dim   = leaf_flag;
+      m_nodes[0].first = 0;
+      m_nodes[0].count = 0;
+      m_keys.assign(m_k * m_leaf_size, key_t());
+      m_records.assign(m_leaf_size, record_t());
+      m_size = 0;
     }
-    */
 
 
     /// M_NEAREST_NEIGHBORS
@@ -646,503 +761,168 @@ namespace math {
     template <typename ContainerT>
     size_t m_nearest_neighbors(ContainerT const& query,
                                std::vector<record_t>& nearest_records,
-                               size_t m = 1)
+                               size_t m = 1) const
     {
       return m_nearest_neighbors(query, nearest_records, m,
                                  NullRecordConstraintKD(),
                                  SafeEuclideanDistanceMetric());
     }
 
+    // The search prunes cells by their Euclidean distance to the
+    // query, so the distance metric must be no smaller than that.
     template <typename ContainerT, typename RecordConstraintT, typename DistanceMetricT>
     size_t m_nearest_neighbors(ContainerT const& query,
                                  std::vector<record_t>& nearest_records,
                                  size_t m = 1,
                                  RecordConstraintT recordConstraint = NullRecordConstraintKD(),
-                                 DistanceMetricT distanceMetric = SafeEuclideanDistanceMetric())
+                                 DistanceMetricT distanceMetric = SafeEuclideanDistanceMetric()) const
     {
       assert( m_k == (size_t) std::distance(query.begin(), query.end()) );
       nearest_records.clear();
+      if (m == 0)
+        return 0;
 
-      //Initialize the priority queue with m sentinel NIL pairs
-      std::pair<Vertex, key_t> nil_pair(m_NIL, m_POSITIVE_INFINITY);
-      while (!m_priority_queue.empty()){
-        m_priority_queue.pop();
-      }
-      for(size_t i = 0; i < m; ++i){
-        m_priority_queue.push(nil_pair);
-      }
-
-      //convert input into a range_t object, which is more convenient for
-      //internal operations (provides the operator[])
-      range_t _query(m_k);
-      std::copy(query.begin(), query.end(), _query.begin());
+      SearchState state(m_k, m, m_leaf_size, m_NEGATIVE_INFINITY, m_POSITIVE_INFINITY);
+      std::copy(query.begin(), query.end(), state.query.begin());
+      std::copy(query.begin(), query.end(), state.query_keys.begin());
 
-      nearest_neighbors(m_root, _query, m, recordConstraint, distanceMetric);
+      nearest_neighbors(0, 0.0, state, recordConstraint, distanceMetric);
 
-      //Now parse m_priority_queue into nearest_records
-      size_t num_records_found = 0;
-      std::pair<Vertex, key_t> temp_pair;
+      std::sort_heap(state.best.begin(), state.best.end());
+      for (size_t i = 0; i < state.best.size(); ++i)
+        nearest_records.push_back(m_records[state.best[i].second]);
+      return nearest_records.size();
+    }
 
-      while (!m_priority_queue.empty()){
+    size_t size() const {return m_size;}
 
-        temp_pair = m_priority_queue.top();
-        if (temp_pair.first == m_NIL){
-          m_priority_queue.pop();
-        }else{
-          //add record of neighbor node
-          ++num_records_found;
-          nearest_records.push_back(m_record_map[temp_pair.first]);
-          m_priority_queue.pop();
-        }
-      }
-      // The priority queue is ordered in decreasing distance from the query,
-      // so nearest_records will need to be reversed after it is filled
-      reverse (nearest_records.begin(), nearest_records.end());
+    // The depths of the deepest and shallowest leaves.  The root is
+    // at depth 0.
+    size_t max_depth() const {return depth(0, true);}
+    size_t min_depth() const {return depth(0, false);}
 
-      return num_records_found;
-    }
-
-    //The number of vertices in the graph, less one for the NIL vertex
-    size_t size(){return num_vertices(m_kdTree)-1;}
-    //The root vertex is at depth 0.
-    //TODO: ...but an empty tree also has depth 0... hmmm...
-    size_t max_depth(){return m_max_depth;}
-    size_t min_depth(){return m_min_depth;}
+    size_t leaf_size() const {return m_leaf_size;}
 
   private:
 
     ///////////////// --- KD Private Methods --- ////////////////////
 
-    /// BUILD_TREE
-    //
-    // Given all the records, building the k-d tree is a matter of
-    // selecting the proper discriminator and a pivot which evenly partitions
-    // the input file. Returns the root of the k-d tree.
-    //
-    // DiscSelector:a functor which must support
-    //  size_t operator() (IterT beg, IterT end, size_t disc)
-    //  and return a discriminator between 0 and k-1, inclusive.
-    //
-    // Partitioner: a functor which must support
-    //  IterT operator() (IterT beg, IterT end, size_t disc)
-    //  and return the position of an element to be used for partitioning
-    //
-    template <typename IterT, typename DiscSelector, typename Partitioner>
-    Vertex build_tree(IterT file_beg, IterT file_end,
-                      range_t lo_range, range_t hi_range,
-                      DiscSelector discSelector, Partitioner partitioner,
-                      int previous_disc, size_t depth)
-    {
-      // End recursion?
-      if (file_beg == file_end){
-        if(depth < m_min_depth){
-          m_min_depth = depth;
-        }
-        return m_NIL;
-      }
-
-      if (depth > m_max_depth){
-        m_max_depth = depth;
-      }
-
-      //Choose discriminator and partition
-      size_t disc = discSelector(file_beg, file_end, previous_disc);
-      IterT partition = partitioner(file_beg, file_end, disc);
-
-      Vertex P = add_vertex(m_kdTree);
-      m_record_map[P] = *partition;
-      m_discriminator_map[P] = disc;
-
-      m_LORANGE_map[P] = lo_range;
-      m_HIRANGE_map[P] = hi_range;
-
-      //Create high range for LOSON:
-      range_t LOSON_hi_range = hi_range;
-      set_range_value(LOSON_hi_range.begin(), (*partition).begin(), disc);
-      //Create low range for HISON
-      range_t HISON_lo_range = lo_range;
-      set_range_value(HISON_lo_range.begin(), (*partition).begin(), disc);
-
-      //The subtrees below P should not include P
-      IterT one_past_partition = IterT(partition);
-      std::advance(one_past_partition,1);
-
-      Vertex lo = build_tree(file_beg, partition, lo_range, LOSON_hi_range, discSelector, partitioner, disc, ++depth);
-      Vertex hi = build_tree(one_past_partition, file_end, HISON_lo_range, hi_range, discSelector, partitioner, disc, ++depth);
-      m_LOSON_map[P] = lo;
-      m_HISON_map[P] = hi;
-
-      //TODO:
-      //Also insert bgl edges. This increases memory usage, so perhaps
-      //should be commented out after debugging?
-      /*
-        Edge ed;
-        bool inserted;
-        boost::tie(ed, inserted) = add_edge(P,lo,m_kdTree);
-        boost::tie(ed, inserted) = add_edge(P,hi,m_kdTree);
-      */
-
-      //Print out P, LOSON, HISON, discriminator, ranges
-      //print__vertex(P, lo, hi);
-      return P;
-    }
-
-
-    // Insert attempts to find a vertex with a nil child. The edge
-    // (both the explicit BGL edge and the implicit edge defined by LOSON[P]
-    // or HISON[P] ) from parent to the nil child are removed. A new vertex
-    // is created for the new record, and it is inserted as a child to repace
-    // P's previous nil child.
-    // The new vertex's discriminator is determined using via modulo
-    //
-    // TODO: test updates for m_min_depth and m_max_depth
-    void kd_insert(record_t r, Vertex P, size_t depth){
-      if(P == m_NIL){
-        //this must be an empty tree
-        Vertex new_vertex = add_vertex(m_kdTree);
-        m_min_depth = 0;
-        m_max_depth = 0;
-
-        //initialize properties for new vertex
-        //range_t lo_range(m_k, -ScalarTypeLimits<double>::highest());
-        //range_t hi_range(m_k, ScalarTypeLimits<double>::highest());
-        range_t lo_range(m_k, m_NEGATIVE_INFINITY);
-        range_t hi_range(m_k, m_POSITIVE_INFINITY);
-
-        m_record_map[new_vertex] = r;
-        m_discriminator_map[new_vertex] = 0;
-        m_LORANGE_map[new_vertex] = lo_range;
-        m_HIRANGE_map[new_vertex] = hi_range;
-        m_LOSON_map[new_vertex] = m_NIL;
-        m_HISON_map[new_vertex] = m_NIL;
-
-        //BGL Edges
-        /*
-          Edge ed;
-          bool inserted;
-          boost::tie(ed, inserted) = add_edge(new_vertex, m_NIL,m_kdTree);
-          boost::tie(ed, inserted) = add_edge(new_vertex, m_NIL,m_kdTree);
-        */
-
-        m_root = new_vertex;
-        return;
+    size_t depth(uint32 index, bool deepest) const {
+      Node const& node = m_nodes[index];
+      if (node.is_leaf())
+        return 0;
+      size_t lo = depth(node.first, deepest), hi = depth(node.first+1, deepest);
+      return 1 + (deepest ? std::max(lo, hi) : std::min(lo, hi));
+    }
+
+    struct SearchState {
+      size_t m;
+      std::vector<double> query;
+      range_t query_keys;
+      std::vector<std::pair<double, uint32> > best; // A max-heap of the m nearest so far
+      double worst, worst_squared;                   // The mth nearest distance
+      std::vector<double> offsets;                   // Per dimension distance to the cell, squared
+      std::vector<double> distances;                 // Scratch for a bucket
+      range_t lorange, hirange;                      // The current cell
+
+      SearchState(size_t k, size_t m, size_t leaf_size, key_t lowest, key_t highest) :
+        m(m), query(k), query_keys(k), worst(std::numeric_limits<double>::infinity()),
+        worst_squared(worst), offsets(k, 0.0), distances(leaf_size),
+        lorange(k, lowest), hirange(k, highest) {
+        best.reserve(m + 1);
       }
 
-      size_t disc_P = m_discriminator_map[P];
-
-      if( on_low_side(r, P) ){
-        if( m_LOSON_map[P] == m_NIL ){
-          //Insert r as P's loson:
-          //remove_edge(P, m_NIL, m_kdTree); //explicit BGL edge
-          Vertex new_vertex = add_vertex(m_kdTree);
-          m_LOSON_map[P] = new_vertex;  //implicit edge
-
-          //initialize properties for new vertex
-          record_t record_P = m_record_map[P];
-          range_t new_hirange = m_HIRANGE_map[P];
-          set_range_value(new_hirange.begin(), record_P.begin(), disc_P);
-
-          m_record_map[new_vertex] = r;
-          m_discriminator_map[new_vertex] = ( (disc_P + 1) % m_k);
-          m_HIRANGE_map[new_vertex] = new_hirange;
-          m_LORANGE_map[new_vertex] = m_LORANGE_map[P];
-          m_LOSON_map[new_vertex] = m_NIL;
-          m_HISON_map[new_vertex] = m_NIL;
-
-          //BGL Edges
-          /*
-            Edge ed;
-            bool inserted;
-            boost::tie(ed, inserted) = add_edge(new_vertex, m_NIL, m_kdTree);
-            boost::tie(ed, inserted) = add_edge(new_vertex, m_NIL, m_kdTree);
-          */
-
-          //P is at depth 'depth', so P's son is at depth 'depth+1'
-          if(depth+1 < m_min_depth)
-            m_min_depth = depth+1;
-
-          if (depth+1 > m_max_depth)
-            m_max_depth = depth+1;
-
-          return;
+      void add(double distance, uint32 slot) {
+        best.push_back(std::make_pair(distance, slot));
+        std::push_heap(best.begin(), best.end());
+        if (best.size() > m) {
+          std::pop_heap(best.begin(), best.end());
+          best.pop_back();
         }
-        //otherwise continue the recursion
-        kd_insert(r, m_LOSON_map[P], ++depth);
-      }
-      else{ //on high side of partition
-        if(m_HISON_map[P] == m_NIL){
-          // Insert r as P's hison
-          //remove_edge(P, m_NIL, m_kdTree);
-          Vertex new_vertex = add_vertex(m_kdTree);
-          m_HISON_map[P] = new_vertex;
-
-          // Initialize properties for new vertex
-          record_t record_P = m_record_map[P];
-          range_t new_lorange = m_LORANGE_map[P];
-          set_range_value(new_lorange.begin(), record_P.begin(), disc_P);
-
-          m_record_map[new_vertex] = r;
-          m_discriminator_map[new_vertex] = ( (disc_P + 1) % m_k);
-          m_LORANGE_map[new_vertex] = new_lorange;
-          m_HIRANGE_map[new_vertex] = m_HIRANGE_map[P];
-          m_LOSON_map[new_vertex] = m_NIL;
-          m_HISON_map[new_vertex] = m_NIL;
-
-          //BGL Edges
-          /*
-            Edge ed;
-            bool inserted;
-            boost::tie(ed, inserted) = add_edge(new_vertex, m_NIL, m_kdTree);
-            boost::tie(ed, inserted) = add_edge(new_vertex, m_NIL, m_kdTree);
-          */
-
-          //P is at depth 'depth', so P's son is at depth 'depth+1'
-          if(depth+1 < m_min_depth)
-            m_min_depth = depth+1;
-
-          if (depth+1 > m_max_depth)
-            m_max_depth = depth+1;
-
-          return;
+        if (best.size() == m) {
+          worst = best.front().first;
+          worst_squared = worst * worst;
         }
-        //otherwise continue the recursion
-        kd_insert(r, m_HISON_map[P], ++depth);
       }
-    }
-
+    };
 
     /// Nearest Neighbors
     //
-    // Finds the m nearest records to the query, and stores them in
-    // m_priority_queue.
-    //
-    // The return value 0 indicates 'return' from recursion, whereas a
-    // return value of 1 indicates the search is complete
-    // TODO: Consider using std::make_pair in place of boost's tie function
-    //
-    // Constrained searches would be faster if children's ranges were checked
-    // for overlap with the constraint region: only children whose ranges
-    // might contain records satisfying the constraint would be explored.
-    // This could be done by only searching a child if the child's lorange or
-    // the child's hirange satisfies the constraint.
+    // Searches the cell of node index, whose squared distance from the
+    // query is cell_distance, nearer child first.  The far child is
+    // skipped if it is farther than the mth nearest record so far.
     template<typename RecordConstraint, typename DistanceMetric>
-    int nearest_neighbors(Vertex const& N, range_t const& query, size_t m,
-                          RecordConstraint const& recordConstraint,
-                          DistanceMetric const& distanceMetric ) {
-      if (N == m_NIL)
-        return 0;
-
-      range_t& N_lorange = get(m_LORANGE_map, N);
-      range_t& N_hirange = get(m_HIRANGE_map, N);
+    void nearest_neighbors(uint32 index, double cell_distance, SearchState& state,
+                           RecordConstraint const& recordConstraint,
+                           DistanceMetric const& distanceMetric) const {
+      //If no part of the cell satisfies the constraint, don't search
+      if (!recordConstraint.domains_overlap(state.lorange, state.hirange))
+        return;
 
-      //If no part of N's domain satisfies the constraint, don't search
-      if(!recordConstraint.domains_overlap(N_lorange,  N_hirange)){
-        return 0;
-      }
-      record_t& N_record = get(m_record_map, N);
-      size_t disc = get(m_discriminator_map, N);
-      Vertex& loson = get(m_LOSON_map, N);
-      Vertex& hison = get(m_HISON_map, N);
-
-      //Calculate distance from query to N's record.
-      //double distance_to_N = kd_euclidean_distance(query.begin(), query.end(), N_record.begin());
-      double distance_to_N = distanceMetric(query.begin(), query.end(), N_record.begin());
-
-      //Update the list of m best.
-      Vertex dummy = m_NIL;
-      double distance_to_mth_best = m_POSITIVE_INFINITY;
-      if (!m_priority_queue.empty()){
-        boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
-      } else {
-        std::cout<<"Priority Queue is empty!?\n";
+      Node const& node = m_nodes[index];
+      if (node.is_leaf()) {
+        search_bucket(node, state, recordConstraint, distanceMetric);
+        return;
       }
 
-      if ((distance_to_N < distance_to_mth_best) && recordConstraint(N_record) ){
-        //if (distance_to_N < distance_to_mth_best){
-        std::pair<Vertex, double> temp_pair(N, distance_to_N);
-        m_priority_queue.push(temp_pair);
-
-        while(m_priority_queue.size() > m){
-          m_priority_queue.pop();
-        }
-        boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
+      size_t dim = node.dim;
+      double diff = state.query[dim] - double(node.split);
+      uint32 nearer = node.first + (diff < 0 ? 0 : 1);
+      key_t& near_bound = diff < 0 ? state.hirange[dim] : state.lorange[dim];
+      key_t& far_bound  = diff < 0 ? state.lorange[dim] : state.hirange[dim];
+
+      key_t saved = near_bound;
+      near_bound = node.split;
+      nearest_neighbors(nearer, cell_distance, state, recordConstraint, distanceMetric);
+      near_bound = saved;
+
+      double saved_offset = state.offsets[dim];
+      double far_distance = cell_distance - saved_offset + diff*diff;
+      if (far_distance <= state.worst_squared) {
+        saved = far_bound;
+        far_bound = node.split;
+        state.offsets[dim] = diff*diff;
+        nearest_neighbors(node.first + node.first + 1 - nearer, far_distance, state,
+                          recordConstraint, distanceMetric);
+        state.offsets[dim] = saved_offset;
+        far_bound = saved;
       }
-
-      // Now it is necesary to search the subtree on the same side of
-      // the partition as the query. When recursion returns, if it is
-      // possible that the other subtree could contain nearer
-      // neighbors, it is necessary to search that subtree too.
-      record_iter_t partition_key_position = N_record.begin();
-      std::advance(partition_key_position, disc);
-      double partition_key = *partition_key_position;
-      double query_key = query[disc];
-
-      int done = 0;
-      if (query_key < partition_key)
-        {
-          //query is on low side of partition at vertex N
-          done = nearest_neighbors(loson, query, m, recordConstraint, distanceMetric);
-          if (done == 1)
-            return 1;
-          //m nearest may have changed from searching loson
-          if (!m_priority_queue.empty())
-            boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
-          N_lorange[disc] = partition_key;
-          if (bounds_overlap_ball(query, N_lorange, N_hirange, distance_to_mth_best))
-            {
-              //std::cout<<"Hison's Bounds Overlap Ball, check hi side too.\n";
-              done = nearest_neighbors(hison, query, m, recordConstraint, distanceMetric);
-              if(done == 1)
-                return 1;
-            }
-        }else{
-        //query is on the high side of the partition
-        done = nearest_neighbors(hison, query, m, recordConstraint, distanceMetric);
-        if (done == 1)
-          return 1;
-        //m nearest may have changed from searching hison
-        if (!m_priority_queue.empty())
-          boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
-        N_hirange[disc] = partition_key;
-        if (bounds_overlap_ball(query, N_lorange, N_hirange, distance_to_mth_best))
-          {
-            //std::cout<<"LOson's's Bounds Overlap Ball, check lo side too.\n";
-            done = nearest_neighbors(loson, query, m, recordConstraint, distanceMetric);
-            if (done == 1)
-              return 1;
-          }
-      }
-      //After checking children, the ball containing the m best may be entirely in N's range:
-      boost::tie(dummy, distance_to_mth_best) = m_priority_queue.top();
-      if(ball_within_bounds(query, N_lorange, N_hirange, distance_to_mth_best) ){
-        return 1;
-      }
-      return 0;
     }
 
-
-
-    // The following two functions refer to a "ball" centered at the query.
-    // The radius of the ball is the distance from the query to the mth
-    // nearest record examined so far in the search. The ball, then,
-    // represents a region where possibly closer records could be found. If a
-    // region overlaps this ball, that means part of the ball is within that
-    // region's bounds, and the region must be
-    // examined. (bounds_overlap_ball) If a ball fits entirely within a
-    // region that has been examined, the search is
-    // finished. (ball_within_bounds)
-
-
-    /// Bounds Overlap Ball
-    //
-    // Checks if ANY part of the ball lies within the given bounds.
-    // If the distance from the query to the bounded region is greater
-    // than the radius then there is no overlap. This is implemented by
-    // checking if d^2 = d_1^2 + d_2^2 + ... + d_k^2 > r^2
-    //
-    // If the radius is infinite, than it is considered to overlap any
-    // bounds, even if they are also infinite.
-    inline bool bounds_overlap_ball(range_t const& query, range_t const& lorange, range_t const& hirange, double radius) const {
-
-      //Now we can assume that the query has no infinities in it.
-      double radius_squared = pow(radius, 2);
-      double d_squared = 0;
-      typename range_t::const_iterator iter = query.begin();
-      typename range_t::const_iterator lorange_iter = lorange.begin();
-      typename range_t::const_iterator hirange_iter = hirange.begin();
-      for( ; iter != query.end(); ++iter, ++lorange_iter, ++hirange_iter) {
-
-        if(*iter < *lorange_iter) {
-          d_squared += pow( *iter - *lorange_iter, 2);
-          if (d_squared > radius_squared)
-            return false;
-
-        } else if(*iter > *hirange_iter) {
-          d_squared += pow( *iter - *hirange_iter, 2);
-          if (d_squared > radius_squared)
-            return false;
-        }
-        //else if *lorange_iter < *iter < *hirange_iter then within
-        //bounds, and the ith coordiante distance is 0
+    template<typename RecordConstraint, typename DistanceMetric>
+    void search_bucket(Node const& node, SearchState& state,
+                       RecordConstraint const& recordConstraint,
+                       DistanceMetric const& distanceMetric) const {
+      uint32 base = node.first * m_leaf_size;
+      for (uint32 i = 0; i < node.count; ++i) {
+        record_t const& record = m_records[base + i];
+        if (!recordConstraint(record))
+          continue;
+        double distance = distanceMetric(state.query_keys.begin(), state.query_keys.end(), record.begin());
+        if (distance < state.worst)
+          state.add(distance, base + i);
       }
-      //d_squared < radius_squared, so no overlap
-      return true;
     }
 
-    /// Ball Within Bounds
-    //
-    // Checks if a sphere of given radius fits entirely within the bounds
-    // by checking if the 'coordinate distance' from the query to the
-    // bounded region is less than the radius of the ball.
-    //
-    // TODO: all uses of ScalarTypeLimits<double>::highest() should be replaced with a C implementation of infinity!
-    bool ball_within_bounds(range_t const& query, range_t const& lorange, range_t const& hirange, double radius){
-
-      //If any coordinate distance is less less than radius, ball
-      //escapes bounds, so return false if a bound is +/- infinity,
-      //the coordinate distance is infinity
-      typename range_t::const_iterator iter = query.begin();
-      typename range_t::const_iterator lorange_iter = lorange.begin();
-      typename range_t::const_iterator hirange_iter = hirange.begin();
-      for( ; iter != query.end(); ++iter, ++lorange_iter, ++hirange_iter) {
-        // DELETE?
-        //         if ((fabs(*lorange_iter) == m_POSITIVE_INFINITY) || (fabs(*hirange_iter) == m_POSITIVE_INFINITY))
-        //           return false;
-        if (fabs( *iter - *lorange_iter ) <= radius)
-          return false;
-        if (fabs( *iter - *hirange_iter ) <= radius)
-          return false;
+    // Unconstrained Euclidean searches read the keys of the bucket
+    // directly, one dimension at a time.
+    void search_bucket(Node const& node, SearchState& state,
+                       NullRecordConstraintKD const& /*recordConstraint*/,
+                       SafeEuclideanDistanceMetric const& /*distanceMetric*/) const {
+      double* distances = &state.distances[0];
+      uint32 count = node.count;
+      std::fill(distances, distances + count, 0.0);
+      key_t const* keys = &m_keys[node.first * m_k * m_leaf_size];
+      for (size_t d = 0; d < m_k; ++d, keys += m_leaf_size) {
+        double q = state.query[d];
+        for (uint32 i = 0; i < count; ++i) {
+          double diff = double(keys[i]) - q;
+          distances[i] += diff * diff;
+        }
       }
-      return true;
-    }
-
-    //checks if a record is on the low side of the vertex's partition.
-    //That is, if d is V's discriminator, record[d] < V[d]
-    //V probably shouldn't be NIL...
-    template<typename QueryT>
-    bool on_low_side(QueryT r, Vertex V)
-    {
-      size_t disc = m_discriminator_map[V];
-      record_t partition = m_record_map[V];
-      record_iter_t partition_iter = partition.begin();
-      typename QueryT::iterator r_iter = r.begin();
-      std::advance(partition_iter, disc);
-      std::advance(r_iter, disc);
-      return *r_iter < *partition_iter;
-    }
-
-    //Performs A[k] = B[k]
-    template<typename IterA, typename IterB>
-    void set_range_value(IterA iterA, IterB iterB, size_t k){
-      std::advance(iterA, k);
-      std::advance(iterB, k);
-      *iterA = *iterB;
-    }
-
-    //Given vertex descriptors for a vertex Q, its loson P and hison R,
-    //output the vertices' records, and the discriminator used
-    void print_vertex(Vertex P, Vertex Q, Vertex R){
-      record_t P_record = get(m_record_map, P);
-      record_t Q_record = get(m_record_map, Q);
-      record_t R_record = get(m_record_map, R);
-      range_t P_lorange = get(m_LORANGE_map, P);
-      range_t P_hirange = get(m_HIRANGE_map, P);
-
-      std::cout<< "\tRecord[P] : ";
-      print_record(P_record.begin(), P_record.end());
-
-      std::cout<< "\tRecord[loson] : ";
-      print_record(Q_record.begin(), Q_record.end());
-
-      std::cout<< "\tRecord[hison] : ";
-      print_record(R_record.begin(), R_record.end());
-
-      std::cout<<"\tDiscrimnator[P] : " <<m_discriminator_map[P]<<"\n";
-      std::cout<<"Lo-Range of Subtree rooted at P: ";
-      print_record(P_lorange.begin(), P_lorange.end());
-      std::cout<<"Hi-Range of Subtree rooted at P: ";
-      print_record(P_hirange.begin(), P_hirange.end());
-      std::cout<<"\n";
+      for (uint32 i = 0; i < count; ++i)
+        if (distances[i] < state.worst_squared)
+          state.add(std::sqrt(distances[i]), node.first * m_leaf_size + i);
     }
   }; //end KDTree class
 
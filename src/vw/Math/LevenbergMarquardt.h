@@ -34,8 +34,12 @@
 #include <vw/Math/Vector.h>
 #include <vw/Math/LinearAlgebra.h>
 
+#include <vw/Core/Settings.h>
+#include <vw/Core/ThreadPool.h>
+
 // Boost
 #include <boost/concept_check.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace vw {
 namespace math {
@@ -330,7 +334,14 @@ namespace math {
 
   // ----- Speed optimized versions are below -----
 
-  /// As the similar class above, but with fixed matrix sizes and no loggin.
+  /// As the similar class above, but with fixed matrix sizes and no
+  /// logging, so that nothing is allocated on the heap.  NI is the
+  /// size of the domain and NO the size of the result.  As above, a
+  /// model with an analytic Jacobian should define
+  ///
+  ///   Matrix<double, NO, NI> jacobian( domain_type const& x ) const;
+  ///
+  /// which hides the numerical one below.
   template <class ImplT, int NI, int NO>
   struct LeastSquaresModelBaseFixed {
 
@@ -344,21 +355,15 @@ namespace math {
     inline Matrix<double, NO, NI> jacobian( DomainT const& x ) const {
 
       // Get nominal function value
-      //std::cout << "x; = " << x << std::endl;
-      //std::cout << "impl().operator()(x); = " << impl().operator()(x) << std::endl;
       Vector<double, NO> h0 = impl().operator()(x);
-      //Vector<double> h0 = impl().operator()(x);
-      //std::cout << "h0 = " << h0 << std::endl;
 
       // Jacobian is #params x #outputs
-      Matrix<double, NO, NI> H(h0.size(), x.size());
-      //Matrix<double> H(h0.size(), x.size());
-      //std::cout << "H = " << H << std::endl;
+      Matrix<double, NO, NI> H;
 
       // For each param dimension, add epsilon and re-evaluate h() to
       // get numerical derivative w.r.t. that parameter
       Vector<double, NO> hi;
-      for ( unsigned i=0; i<x.size(); ++i ){
+      for ( unsigned i=0; i<NI; ++i ){
         DomainT xi = x;
 
         // Variable step size, depending on parameter value
@@ -367,11 +372,8 @@ namespace math {
 
         // Evaluate function with this step and compute the derivative w.r.t. parameter i
         hi = impl().operator()(xi);
-        //Vector<double> hi = impl().operator()(xi);
-        //std::cout << "hi = " << hi << std::endl;
         select_col(H,i) = this->difference(hi,h0)/epsilon;
       }
-      //std::cout << "H = " << H << std::endl;
       return H;
     }
 
@@ -379,7 +381,47 @@ namespace math {
     inline T difference( T const& a, T const& b ) const {
       return (a-b);
     }
-  }; // End LeastSquaresModelBaseSQ
+  }; // End LeastSquaresModelBaseFixed
+
+
+  /// Solves A x = b for a small symmetric positive-definite matrix by
+  /// Cholesky decomposition on the stack.  The loops have fixed
+  /// bounds, so for the 2x2, 3x3 and 6x6 systems of the camera and
+  /// lens solvers the compiler unrolls them into closed form.  Returns
+  /// false, leaving x unchanged, if A is not numerically positive
+  /// definite.
+  template <size_t N>
+  bool cholesky_solve_fixed( Matrix<double, N, N> const& A, Vector<double, N> const& b,
+                             Vector<double, N>& x ) {
+    double L[N][N], y[N];
+    for ( size_t j = 0; j < N; ++j ) {
+      double d = A(j,j);
+      for ( size_t k = 0; k < j; ++k )
+        d -= L[j][k]*L[j][k];
+      if ( !(d > 1e-300) )
+        return false;
+      L[j][j] = std::sqrt(d);
+      for ( size_t i = j+1; i < N; ++i ) {
+        double s = A(i,j);
+        for ( size_t k = 0; k < j; ++k )
+          s -= L[i][k]*L[j][k];
+        L[i][j] = s / L[j][j];
+      }
+    }
+    for ( size_t i = 0; i < N; ++i ) {
+      double s = b[i];
+      for ( size_t k = 0; k < i; ++k )
+        s -= L[i][k]*y[k];
+      y[i] = s / L[i][i];
+    }
+    for ( size_t i = N; i-- > 0; ) {
+      double s = y[i];
+      for ( size_t k = i+1; k < N; ++k )
+        s -= L[k][i]*x[k];
+      x[i] = s / L[i][i];
+    }
+    return true;
+  }
 
 
   /// As the similar function above, but with a fixed, square matrix size.
@@ -420,7 +462,7 @@ namespace math {
     Matrix<double, NI, NO> J_trans;
     Matrix<double, NI, NI> J_trans_J;
     Vector<double, NI> del_J;
-    Matrix<double, NI, NI> hessian, hessian_lm, hessian_lm_inv;
+    Matrix<double, NI, NI> hessian, hessian_lm;
     
     //std::cout << "loop" << std::endl;
     int outer_iter = 0;
@@ -474,27 +516,18 @@ namespace math {
           hessian_lm(i,i) += hessian_lm(i,i)*lambda + lambda;
         }
 
-        // Solve for update
-        typename ImplT::domain_type delta_x;
-        if (hessian_lm.rows() <= 2 && det(hessian_lm) > 0.0){
-          // Direct method is more efficient for small matrices, also
-          // here we avoid calling LAPACK which we've seen misbehave
-          // in this situation in a multi-threaded environment.
-          hessian_lm_inv = inverse(hessian_lm);
-          delta_x = hessian_lm_inv*del_J;
-        }else{
-          try{
-            // By construction, hessian_lm is symmetric and
-            // positive-definite.
-            delta_x = solve_symmetric(hessian_lm, del_J);
-          }catch ( const ArgumentErr& e ) {
-            // If lambda is very small, the matrix becomes numerically
-            // singular. In that case use the more general
-            // least_squares solver.
-            delta_x = least_squares(hessian_lm, del_J);
-          }
-
+        // Solve for update.  By construction hessian_lm is symmetric
+        // and positive-definite, so a Cholesky solve on the stack
+        // normally suffices.  This also avoids calling LAPACK, which
+        // we've seen misbehave in a multi-threaded environment.
+        Vector<double, NI> delta;
+        if (!cholesky_solve_fixed(hessian_lm, del_J, delta)) {
+          // If lambda is very small, the matrix becomes numerically
+          // singular. In that case use the more general
+          // least_squares solver.
+          delta = least_squares(Matrix<double>(hessian_lm), Vector<double>(del_J));
         }
+        typename ImplT::domain_type delta_x = delta;
 
         // update parameter vector
         x_try = x - delta_x;
@@ -557,10 +590,75 @@ namespace math {
     //VW_OUT(DebugMessage, "math") << "LM: finished with: " << outer_iter << "\n";
     return x;
   } // End levenberg_marquardtFixed
-  
-  
-  
-  
+
+
+  /// \cond INTERNAL
+  // Solves a range of the problems of a batch.
+  template <class ImplT>
+  class LevenbergMarquardtBatchTask : public Task {
+    std::vector<ImplT> const& m_models;
+    std::vector<typename ImplT::domain_type> const& m_seeds;
+    std::vector<typename ImplT::result_type> const& m_observations;
+    std::vector<typename ImplT::domain_type>& m_solutions;
+    std::vector<int>& m_status;
+    size_t m_begin, m_end;
+    double m_abs_tolerance, m_rel_tolerance, m_max_iterations;
+  public:
+    LevenbergMarquardtBatchTask( std::vector<ImplT> const& models,
+                                 std::vector<typename ImplT::domain_type> const& seeds,
+                                 std::vector<typename ImplT::result_type> const& observations,
+                                 std::vector<typename ImplT::domain_type>& solutions,
+                                 std::vector<int>& status, size_t begin, size_t end,
+                                 double abs_tolerance, double rel_tolerance, double max_iterations ) :
+      m_models(models), m_seeds(seeds), m_observations(observations), m_solutions(solutions),
+      m_status(status), m_begin(begin), m_end(end), m_abs_tolerance(abs_tolerance),
+      m_rel_tolerance(rel_tolerance), m_max_iterations(max_iterations) {}
+
+    virtual void operator()() {
+      for ( size_t i = m_begin; i < m_end; ++i )
+        m_solutions[i] = levenberg_marquardtFixed( m_models[i], m_seeds[i], m_observations[i],
+                                                   m_status[i], m_abs_tolerance,
+                                                   m_rel_tolerance, m_max_iterations );
+    }
+  };
+  /// \endcond
+
+  /// Solves many independent problems with levenberg_marquardtFixed,
+  /// spread over the default number of threads.  Problem i fits
+  /// models[i] to observations[i] starting from seeds[i].  The models
+  /// are only read, so they must be safe to evaluate concurrently.
+  template <class ImplT>
+  void levenberg_marquardtFixed_batch( std::vector<ImplT> const& models,
+                                       std::vector<typename ImplT::domain_type> const& seeds,
+                                       std::vector<typename ImplT::result_type> const& observations,
+                                       std::vector<typename ImplT::domain_type>& solutions,
+                                       std::vector<int>& status,
+                                       double abs_tolerance = VW_MATH_LM_ABS_TOL,
+                                       double rel_tolerance = VW_MATH_LM_REL_TOL,
+                                       double max_iterations = VW_MATH_LM_MAX_ITER ) {
+    VW_ASSERT( seeds.size() == models.size() && observations.size() == models.size(),
+               ArgumentErr() << "levenberg_marquardtFixed_batch: need a seed and an observation per model." );
+    solutions.resize( models.size() );
+    status.resize( models.size() );
+
+    int num_threads = vw_settings().default_num_threads();
+    if ( num_threads <= 1 || models.size() < 64 ) {
+      LevenbergMarquardtBatchTask<ImplT>( models, seeds, observations, solutions, status,
+                                          0, models.size(), abs_tolerance,
+                                          rel_tolerance, max_iterations )();
+      return;
+    }
+    size_t chunk = std::max( size_t(16), models.size() / ( 4 * num_threads ) + 1 );
+    FifoWorkQueue queue( num_threads );
+    for ( size_t i = 0; i < models.size(); i += chunk )
+      queue.add_task( boost::shared_ptr<Task>(
+        new LevenbergMarquardtBatchTask<ImplT>( models, seeds, observations, solutions, status,
+                                                i, std::min( i + chunk, models.size() ),
+                                                abs_tolerance, rel_tolerance, max_iterations ) ) );
+    queue.join_all();
+  }
+
+
 }} // namespace vw::math
 
 #endif // __VW_OPTIMIZATION_H__
@@ -50,12 +50,33 @@
 ///    set of points, this routine could compute the 2-norm of the
 ///    error: || p2 - H * p1 ||
 ///
+/// The number of hypotheses adapts to the inlier ratio found so far,
+/// hypotheses are fitted and scored in parallel, and two options from
+/// the literature cut the work further: the T(d,d) pretest of
+///
+/// Matas, Jiri and Chum, Ondrej. "Randomized RANSAC with T(d,d)
+/// Test" (2004)
+///
+/// and the progressive sampling of best matches first (PROSAC) of
+///
+/// Chum, Ondrej and Matas, Jiri. "Matching with PROSAC - Progressive
+/// Sample Consensus" (2005)
+///
 
 #ifndef __VW_MATH_RANSAC_H__
 #define __VW_MATH_RANSAC_H__
 
+#include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <limits>
+
 #include <vw/Math/Vector.h>
 #include <vw/Core/Log.h>
+#include <vw/Core/ThreadPool.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace vw {
 namespace math {
@@ -105,18 +126,40 @@ namespace math {
   typedef HomogeneousL2NormErrorMetric<2> InterestPointErrorMetric;
 
   /// RANSAC Driver class
+  ///
+  /// Hypotheses are drawn in batches on the calling thread and then
+  /// fitted and scored in parallel, so the fitting and error functors
+  /// must be safe to call from several threads at once.  Each batch is
+  /// reduced in the order it was drawn, so the result does not depend
+  /// on the number of threads.
+  ///
+  /// num_iterations is an upper bound.  Once a hypothesis with a
+  /// fraction w of inliers is found, the search stops after enough
+  /// hypotheses to have drawn an all-inlier sample with probability
+  /// confidence().  Scoring a hypothesis stops as soon as it has too
+  /// many outliers to reach the required number of inliers.
   template <class FittingFuncT, class ErrorFuncT>
   class RandomSampleConsensus {
+    typedef typename FittingFuncT::result_type result_type;
+
     const FittingFuncT& m_fitting_func;
     const ErrorFuncT  & m_error_func;
           int           m_num_iterations;
           double        m_inlier_threshold;
           int           m_min_num_output_inliers;
           bool          m_reduce_min_num_output_inliers_if_no_fit;
-    
+          double        m_confidence;
+          int           m_num_pretest;
+          bool          m_progressive_sampling;
+          int           m_num_threads;
+
+    /// The number of hypotheses drawn before checking whether enough
+    /// have been tried.
+    static const int hypothesis_batch_size = 32;
+
     /// \cond INTERNAL
     // Utility Function: Pick N UNIQUE, random integers in the range [0, size]
-    inline void get_n_unique_integers(int size, std::vector<int> & samples) const {
+    inline static void get_n_unique_integers(int size, std::vector<int> & samples) {
 
       // Note: We do not modify the initial random seed. As such, if
       // a program uses RANSAC, repeatedly running this program will
@@ -124,7 +167,7 @@ namespace math {
       // calls RANSAC twice while within the same instance of the
       // program, the second time the result of RANSAC will be
       // different, since we keep on pulling new random numbers.
-        
+
       int n = samples.size();
       VW_ASSERT(size >= n, ArgumentErr() << "Not enough samples (" << n << " / " << size << ")\n");
 
@@ -140,6 +183,266 @@ namespace math {
         }
       }
     }
+
+    // The growth function of PROSAC (Chum and Matas, "Matching with
+    // PROSAC - Progressive Sample Consensus", 2005).  The t-th sample
+    // is drawn from the n best matches only, with n growing so that
+    // after max_samples samples every match has had its chance.
+    class ProgressiveSampler {
+      int    m_sample_size, m_num_points, m_n;
+      double m_T_n, m_T_n_prime;
+    public:
+      ProgressiveSampler( int sample_size, int num_points, double max_samples = 200000 ) :
+        m_sample_size(sample_size), m_num_points(num_points), m_n(sample_size),
+        m_T_n(max_samples), m_T_n_prime(1) {
+        for ( int i = 0; i < sample_size; i++ )
+          m_T_n *= double(sample_size - i) / double(num_points - i);
+      }
+
+      void operator()( int t, std::vector<int>& samples ) {
+        while ( t > m_T_n_prime && m_n < m_num_points ) {
+          double T_n_next = m_T_n * double(m_n + 1) / double(m_n + 1 - m_sample_size);
+          m_T_n_prime += std::ceil( T_n_next - m_T_n );
+          m_T_n = T_n_next;
+          m_n++;
+        }
+        if ( m_T_n_prime < t ) {
+          samples.resize( m_sample_size );
+          get_n_unique_integers( m_n, samples );
+        } else {
+          // The n-th best match, and the rest from those before it
+          samples.resize( m_sample_size - 1 );
+          get_n_unique_integers( m_n - 1, samples );
+          samples.push_back( m_n - 1 );
+        }
+      }
+    };
+
+    // One sample and what became of it.  num_inliers is negative if
+    // the hypothesis was rejected before it was fully scored.
+    struct Hypothesis {
+      std::vector<int>   sample;  // The sample, then the points of the pretest
+      result_type        H;
+      int                num_inliers;
+      double             error;
+      std::exception_ptr failure;
+    };
+
+    template <class ContainerT1, class ContainerT2>
+    void evaluate( Hypothesis& hyp, int sample_size, int min_num_inliers,
+                   std::vector<ContainerT1> const& p1,
+                   std::vector<ContainerT2> const& p2,
+                   std::vector<ContainerT1>      & try1,
+                   std::vector<ContainerT2>      & try2 ) const {
+      hyp.num_inliers = -1;
+      try {
+        // 1. Compute the fit using the samples.
+        try1.resize(sample_size);
+        try2.resize(sample_size);
+        for (int i = 0; i < sample_size; ++i) {
+          try1[i] = p1[hyp.sample[i]];
+          try2[i] = p2[hyp.sample[i]];
+        }
+        hyp.H = m_fitting_func(try1, try2);
+
+        // 2. The T(d,d) test: reject the fit unless all of a few other
+        //    random points are inliers.
+        for (size_t i = sample_size; i < hyp.sample.size(); ++i)
+          if (!(m_error_func(hyp.H, p1[hyp.sample[i]], p2[hyp.sample[i]]) < m_inlier_threshold))
+            return;
+
+        // 3. Find all the inliers for this fit, giving up once there
+        //    are too many outliers to keep it.
+        size_t max_outliers = p1.size() - min_num_inliers, num_outliers = 0;
+        try1.clear();
+        try2.clear();
+        for (size_t i = 0; i < p1.size(); ++i) {
+          if (m_error_func(hyp.H, p1[i], p2[i]) < m_inlier_threshold) {
+            try1.push_back(p1[i]);
+            try2.push_back(p2[i]);
+          } else if (++num_outliers > max_outliers) {
+            return;
+          }
+        }
+
+        // 4. Re-estimate the model using the inliers.
+        hyp.H = m_fitting_func(try1, try2, hyp.H);
+
+        // 5. Find the mean error for the inliers.
+        double err_val = 0.0;
+        for (size_t i = 0; i < try1.size(); i++)
+          err_val += m_error_func(hyp.H, try1[i], try2[i]);
+        hyp.error       = err_val / try1.size();
+        hyp.num_inliers = try1.size();
+      } catch ( ... ) {
+        hyp.failure = std::current_exception();
+      }
+    }
+
+    template <class ContainerT1, class ContainerT2>
+    class EvaluateTask : public Task {
+      RandomSampleConsensus    const& m_ransac;
+      std::vector<Hypothesis>       & m_hypotheses;
+      size_t m_begin, m_end;
+      int    m_sample_size, m_min_num_inliers;
+      std::vector<ContainerT1> const& m_p1;
+      std::vector<ContainerT2> const& m_p2;
+    public:
+      EvaluateTask( RandomSampleConsensus const& ransac, std::vector<Hypothesis>& hypotheses,
+                    size_t begin, size_t end, int sample_size, int min_num_inliers,
+                    std::vector<ContainerT1> const& p1, std::vector<ContainerT2> const& p2 ) :
+        m_ransac(ransac), m_hypotheses(hypotheses), m_begin(begin), m_end(end),
+        m_sample_size(sample_size), m_min_num_inliers(min_num_inliers), m_p1(p1), m_p2(p2) {}
+
+      virtual void operator()() {
+        std::vector<ContainerT1> try1;
+        std::vector<ContainerT2> try2;
+        for (size_t i = m_begin; i < m_end; ++i)
+          m_ransac.evaluate(m_hypotheses[i], m_sample_size, m_min_num_inliers,
+                            m_p1, m_p2, try1, try2);
+      }
+    };
+
+    // The number of hypotheses needed to draw a sample of inliers
+    // that passes the pretest with probability m_confidence, when
+    // num_inliers of num_points are inliers.
+    int needed_iterations( int num_inliers, size_t num_points, int sample_size ) const {
+      if (m_confidence >= 1.0 || num_inliers <= 0)
+        return m_num_iterations;
+      double good = std::pow( double(num_inliers) / double(num_points),
+                              sample_size + m_num_pretest );
+      if (good >= 1.0)
+        return 1;
+      double needed = std::log(1.0 - m_confidence) / std::log1p(-good);
+      if (!(needed < m_num_iterations))
+        return m_num_iterations;
+      return std::max( int(std::ceil(needed)), 1 );
+    }
+
+    // The inlier counts to try in turn, as operator() relaxes them.
+    template <class ContainerT1>
+    std::vector<int> output_inlier_thresholds(std::vector<ContainerT1> const& p1) const {
+      std::vector<int> thresholds(1, m_min_num_output_inliers);
+      if (!m_reduce_min_num_output_inliers_if_no_fit || p1.empty())
+        return thresholds;
+      int min_elems_for_fit = m_fitting_func.min_elements_needed_for_fit(p1[0]);
+      int threshold = m_min_num_output_inliers;
+      for (int attempt = 1; attempt < 10; attempt++) {
+        threshold = int(threshold/1.5);
+        // Can't possibly compute a transform with 1 or 0 samples!
+        if (threshold < std::max(2, min_elems_for_fit))
+          break;
+        thresholds.push_back(threshold);
+      }
+      return thresholds;
+    }
+
+    // Runs RANSAC once, keeping the best fit for each of the
+    // decreasing inlier counts in thresholds.  Returns false if no
+    // hypothesis had thresholds.back() inliers; otherwise best_H is the
+    // fit for the first count that was reached, which is level.
+    template <class ContainerT1, class ContainerT2>
+    bool find_fit(std::vector<ContainerT1> const& p1,
+                  std::vector<ContainerT2> const& p2,
+                  std::vector<int>         const& thresholds,
+                  result_type& best_H, size_t& level) const {
+
+      VW_ASSERT( !p1.empty(),
+                 RANSACErr() << "RANSAC Error.  Insufficient data.\n");
+      VW_ASSERT( p1.size() == p2.size(),
+                 RANSACErr() << "RANSAC Error.  Data vectors are not the same size." );
+
+      int min_elems_for_fit = m_fitting_func.min_elements_needed_for_fit(p1[0]);
+
+      VW_ASSERT( (int)p1.size() >= min_elems_for_fit,
+                 RANSACErr() << "RANSAC Error.  Not enough potential matches for this fitting functor. (" << p1.size() << "/" << min_elems_for_fit << ")\n");
+
+      VW_ASSERT( thresholds[0] >= min_elems_for_fit,
+                 RANSACErr() << "RANSAC Error.  Number of requested inliers is less than min number of elements needed for fit. (" << thresholds[0] << "/" << min_elems_for_fit << ")\n");
+
+      std::vector<result_type> level_H     (thresholds.size());
+      std::vector<double>      level_error (thresholds.size(), std::numeric_limits<double>::max());
+      std::vector<int>         level_inliers(thresholds.size(), 0);
+
+      boost::scoped_ptr<ProgressiveSampler> progressive;
+      if (m_progressive_sampling)
+        progressive.reset( new ProgressiveSampler(min_elems_for_fit, p1.size()) );
+      int num_pretest = std::min( m_num_pretest, int(p1.size()) );
+
+      std::vector<Hypothesis> batch;
+      std::vector<int> pretest(num_pretest);
+      int iteration = 0, needed = m_num_iterations, best_inliers = 0;
+      while (iteration < needed) {
+
+        // 0. Get min_elems_for_fit points at random, taking care not
+        //    to select the same point twice.
+        batch.resize( std::min(needed - iteration, int(hypothesis_batch_size)) );
+        for (size_t i = 0; i < batch.size(); ++i) {
+          Hypothesis& hyp = batch[i];
+          ++iteration;
+          if (progressive) {
+            (*progressive)(iteration, hyp.sample);
+          } else {
+            hyp.sample.resize(min_elems_for_fit);
+            get_n_unique_integers(p1.size(), hyp.sample);
+          }
+          get_n_unique_integers(p1.size(), pretest);
+          hyp.sample.insert(hyp.sample.end(), pretest.begin(), pretest.end());
+          hyp.failure = std::exception_ptr();
+        }
+
+        // 1-5. Fit and score the hypotheses.
+        int num_tasks = std::min( m_num_threads, int(batch.size()) );
+        if (num_tasks > 1) {
+          FifoWorkQueue queue(m_num_threads);
+          for (int t = 0; t < num_tasks; ++t)
+            queue.add_task( boost::shared_ptr<Task>(
+              new EvaluateTask<ContainerT1,ContainerT2>( *this, batch,
+                                                         batch.size() * t / num_tasks,
+                                                         batch.size() * (t+1) / num_tasks,
+                                                         min_elems_for_fit, thresholds.back(),
+                                                         p1, p2 ) ) );
+          queue.join_all();
+        } else {
+          EvaluateTask<ContainerT1,ContainerT2>( *this, batch, 0, batch.size(),
+                                                 min_elems_for_fit, thresholds.back(),
+                                                 p1, p2 )();
+        }
+
+        // 6. Save each model if its error is lowest so far.
+        for (size_t i = 0; i < batch.size(); ++i) {
+          Hypothesis const& hyp = batch[i];
+          if (hyp.failure)
+            std::rethrow_exception(hyp.failure);
+          if (hyp.num_inliers < 0)
+            continue;
+          best_inliers = std::max(best_inliers, hyp.num_inliers);
+          for (size_t l = 0; l < thresholds.size(); ++l) {
+            if (hyp.num_inliers >= thresholds[l] && hyp.error < level_error[l]) {
+              level_error  [l] = hyp.error;
+              level_H      [l] = hyp.H;
+              level_inliers[l] = hyp.num_inliers;
+            }
+          }
+        }
+
+        needed = needed_iterations(best_inliers, p1.size(), min_elems_for_fit);
+      }
+
+      for (level = 0; level < thresholds.size(); ++level)
+        if (level_inliers[level] > 0)
+          break;
+      if (level == thresholds.size())
+        return false;
+      best_H = level_H[level];
+
+      // For debugging
+      VW_OUT(InfoMessage, "interest_point") << "\nRANSAC Summary:"     << std::endl;
+      VW_OUT(InfoMessage, "interest_point") << "\tFit = "              << best_H      << std::endl;
+      VW_OUT(InfoMessage, "interest_point") << "\tInliers / Total  = " << level_inliers[level] << " / " << p1.size() << "\n";
+      VW_OUT(InfoMessage, "interest_point") << "\tHypotheses = "       << iteration   << "\n\n";
+      return true;
+    }
     /// \endcond
 
   public:
@@ -147,9 +450,9 @@ namespace math {
     // Returns the list of inliers.
     template <class ContainerT1, class ContainerT2>
     void inliers(typename FittingFuncT::result_type const& H,
-                          std::vector<ContainerT1>  const& p1, 
+                          std::vector<ContainerT1>  const& p1,
                           std::vector<ContainerT2>  const& p2,
-                          std::vector<ContainerT1>       & inliers1, 
+                          std::vector<ContainerT1>       & inliers1,
                           std::vector<ContainerT2>       & inliers2) const {
 
       inliers1.clear();
@@ -178,9 +481,38 @@ namespace math {
     void reduce_min_num_output_inliers(){
       m_min_num_output_inliers = int(m_min_num_output_inliers/1.5);
     }
-      
+
+    /// The probability of having drawn a sample of inliers at which
+    /// the search stops.  With 1 all num_iterations hypotheses are
+    /// tried.  Defaults to 0.99.
+    double confidence() const { return m_confidence; }
+    void set_confidence(double confidence) {
+      VW_ASSERT( confidence > 0 && confidence <= 1,
+                 ArgumentErr() << "RANSAC confidence must be in (0,1]." );
+      m_confidence = confidence;
+    }
+
+    /// The d of the T(d,d) test: each fit is rejected without scoring
+    /// it unless d random points are all inliers.  This saves most of
+    /// the scoring when inliers are scarce, at the cost of more
+    /// hypotheses.  Defaults to 0, no pretest.
+    int num_pretest() const { return m_num_pretest; }
+    void set_num_pretest(int d) { m_num_pretest = std::max(d, 0); }
+
+    /// With progressive sampling (PROSAC), the data must be sorted
+    /// from the best match to the worst, and the early samples are
+    /// drawn from the best matches.  Defaults to false.
+    bool progressive_sampling() const { return m_progressive_sampling; }
+    void set_progressive_sampling(bool progressive) { m_progressive_sampling = progressive; }
+
+    /// The number of threads that fit and score hypotheses.  Defaults
+    /// to one; with more, the fitting and error functors must be safe
+    /// to call from several threads at once.
+    int num_threads() const { return m_num_threads; }
+    void set_num_threads(int num_threads) { m_num_threads = std::max(num_threads, 1); }
+
     /// Constructor - Stores all the inputs in member variables
-    RandomSampleConsensus(FittingFuncT const& fitting_func, 
+    RandomSampleConsensus(FittingFuncT const& fitting_func,
                           ErrorFuncT   const& error_func,
                           int    num_iterations,
                           double inlier_threshold,
@@ -188,41 +520,46 @@ namespace math {
                           bool   reduce_min_num_output_inliers_if_no_fit = false
                           ):
       m_fitting_func(fitting_func), m_error_func(error_func),
-      m_num_iterations(num_iterations), 
+      m_num_iterations(num_iterations),
       m_inlier_threshold(inlier_threshold),
       m_min_num_output_inliers(min_num_output_inliers),
-      m_reduce_min_num_output_inliers_if_no_fit(reduce_min_num_output_inliers_if_no_fit){}
-
-    /// As attempt_ransac but keep trying with smaller numbers of required inliers.
+      m_reduce_min_num_output_inliers_if_no_fit(reduce_min_num_output_inliers_if_no_fit),
+      m_confidence(0.99), m_num_pretest(0), m_progressive_sampling(false),
+      m_num_threads(1) {}
+
+    /// As attempt_ransac but keep trying with smaller numbers of
+    /// required inliers.  The best fit for each of those numbers is
+    /// kept during a single run, so the smaller numbers only need
+    /// another run if a fit throws.
     template <class ContainerT1, class ContainerT2>
     typename FittingFuncT::result_type operator()(std::vector<ContainerT1> const& p1,
                                                   std::vector<ContainerT2> const& p2) {
 
-      // Try to fit using RANSAC. Perform repeated fits with smaller
-      // m_min_num_output_inliers if the fit fails and
-      // m_reduce_min_num_output_inliers_if_no_fit is true.
-
+      std::vector<int> thresholds = output_inlier_thresholds(p1);
       typename FittingFuncT::result_type H;
       bool success = false;
-      
-      for (int attempt = 0; attempt < 10; attempt++){
-        try{
-          H = attempt_ransac(p1, p2);
-          success = true;
-          break; 
-        } catch ( const std::exception& e ) { 
+
+      while (!thresholds.empty()) {
+        try {
+          size_t level = 0;
+          success = find_fit(p1, p2, thresholds, H, level);
+          if (success) {
+            m_min_num_output_inliers = thresholds[level];
+            if (level > 0)
+              vw_out() << "RANSAC found a fit with " << m_min_num_output_inliers << " output inliers.\n";
+          }
+          break;
+        } catch ( const std::exception& e ) {
           vw_out() << e.what() << "\n";
-          if (!m_reduce_min_num_output_inliers_if_no_fit) 
+          if (!m_reduce_min_num_output_inliers_if_no_fit)
             break;
-          reduce_min_num_output_inliers();
-          if (m_min_num_output_inliers < 2) // Can't possibly compute a transform with 1 or 0 samples!
-            break;
-          vw_out() << "Attempting RANSAC with " << m_min_num_output_inliers << " of output inliers.\n";
-          
+          thresholds.erase(thresholds.begin());
+          if (!thresholds.empty())
+            vw_out() << "Attempting RANSAC with " << thresholds[0] << " of output inliers.\n";
         }
       }
 
-      if (!success) 
+      if (!success)
         vw_throw( RANSACErr() << "RANSAC was unable to find a fit that matched the supplied data." );
 
       return H;
@@ -232,79 +569,12 @@ namespace math {
     template <class ContainerT1, class ContainerT2>
     typename FittingFuncT::result_type attempt_ransac(std::vector<ContainerT1> const& p1,
                                                       std::vector<ContainerT2> const& p2) const {
-
-      VW_ASSERT( !p1.empty(),
-                 RANSACErr() << "RANSAC Error.  Insufficient data.\n");
-      VW_ASSERT( p1.size() == p2.size(),
-                 RANSACErr() << "RANSAC Error.  Data vectors are not the same size." );
-
-      int min_elems_for_fit = m_fitting_func.min_elements_needed_for_fit(p1[0]);
-
-      VW_ASSERT( (int)p1.size() >= min_elems_for_fit,
-                 RANSACErr() << "RANSAC Error.  Not enough potential matches for this fitting functor. (" << p1.size() << "/" << min_elems_for_fit << ")\n");
-
-      VW_ASSERT( m_min_num_output_inliers >= min_elems_for_fit,
-                 RANSACErr() << "RANSAC Error.  Number of requested inliers is less than min number of elements needed for fit. (" << m_min_num_output_inliers << "/" << min_elems_for_fit << ")\n");
-
-      typename FittingFuncT::result_type best_H;
-
-      std::vector<ContainerT1> try1;
-      std::vector<ContainerT2> try2;
-      std::vector<int> random_indices(min_elems_for_fit);
-
-      int num_inliers = 0;
-      double min_err = std::numeric_limits<double>::max();
-      for (int iteration = 0; iteration < m_num_iterations; ++iteration) {
-
-        // 0. Get min_elems_for_fit points at random, taking care not
-        //    to select the same point twice.
-        get_n_unique_integers(p1.size(), random_indices);
-        // Resizing below is essential, as by now their size may have changed
-        try1.resize(min_elems_for_fit);
-        try2.resize(min_elems_for_fit);
-        for (int i = 0; i < min_elems_for_fit; ++i) {
-          try1[i] = p1[random_indices[i]];
-          try2[i] = p2[random_indices[i]];
-        }
-
-        // 1. Compute the fit using these samples.
-        typename FittingFuncT::result_type H = m_fitting_func(try1, try2);
-
-        // 2. Find all the inliers for this fit.
-        inliers(H, p1, p2, try1, try2);
-
-        // 3. Skip this model if too few inliers.
-        if ((int)try1.size() < m_min_num_output_inliers) 
-          continue;
-
-        // 4. Re-estimate the model using the inliers.
-        H = m_fitting_func(try1, try2, H);
-        
-        // 5. Find the mean error for the inliers.
-        double err_val = 0.0;
-        for (size_t i = 0; i < try1.size(); i++) 
-          err_val += m_error_func(H, try1[i], try2[i]);
-        err_val /= try1.size();
-
-        // 6. Save this model if its error is lowest so far.
-        if (err_val < min_err){
-          min_err     = err_val;
-          best_H      = H;
-          num_inliers = try1.size();
-        }
-
-      }
-
-      if (num_inliers < m_min_num_output_inliers) {
+      std::vector<int> thresholds(1, m_min_num_output_inliers);
+      typename FittingFuncT::result_type H;
+      size_t level = 0;
+      if (!find_fit(p1, p2, thresholds, H, level))
         vw_throw( RANSACErr() << "RANSAC was unable to find a fit that matched the supplied data." );
-      }
-
-      // For debugging
-      VW_OUT(InfoMessage, "interest_point") << "\nRANSAC Summary:"     << std::endl;
-      VW_OUT(InfoMessage, "interest_point") << "\tFit = "              << best_H      << std::endl;
-      VW_OUT(InfoMessage, "interest_point") << "\tInliers / Total  = " << num_inliers << " / " << p1.size() << "\n\n";
-      
-      return best_H;
+      return H;
     }
 
   }; // End of RandomSampleConsensus class definition
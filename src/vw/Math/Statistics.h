@@ -101,8 +101,14 @@ public:
   void operator()( ValT const& arg );
 
   /// Function to merge to CDFs
+  /// - The other CDF is represented by a set of evenly spaced quantiles,
+  ///   each weighted by its share of the samples, and folded in the same
+  ///   way as a batch of new data.
   void operator()( CDFAccumulator<ValT>& other );
 
+  /// Number of values seen, including any not yet merged in.
+  double num_samples() const { return m_num_samples + m_buffer_idx; }
+
   /// Make this object an exact copy of the other object
   void duplicate(CDFAccumulator<ValT> const& other);
   
@@ -120,25 +126,17 @@ public:
   
 private: // Variables
   size_t m_num_quantiles, m_buffer_idx;
-  size_t m_num_samples; // nq, nd, nt
+  double m_num_samples; // nq, nd, nt
   std::vector<double> m_cdf, m_sample_buf, m_quantile;
   double m_q0, m_qm;  // quantile min and max;
 
 private: // Functions
-  // Trapezoidal Rule functor for numeric integration
-  template <class InputIterator1, class InputIterator2>
-  double trapezoidal_rule( InputIterator1 first1, InputIterator1 last1,
-                           InputIterator2 first2 );
-
-  // PDF differentiation. Requires an output vector that is qual
-  // in length to the CDF but doesn't touch index 0 or the last element.
-  void pdf_differentiation( std::vector<double> const& quantile,
-                            std::vector<double> const& cdf,
-                            std::vector<double> & output_pdf );
-
-  void correct_pdf_integral_to_1( std::vector<double> const& quantile,
-                                  std::vector<double> & pdf,
-                                  double additional_scalar );
+  /// Fold a sorted batch of values into the CDF, each one standing for
+  /// 'weight' samples. update() uses this with a weight of one.
+  void merge_sorted(double const* values, size_t num_values, double weight);
+
+  /// Interpolate the value at a probability, without casting to ValT.
+  double quantile_value( double arg ) const;
 }; // End class CDFAccumulator
 
 
@@ -159,6 +157,9 @@ public: // Functions
   // Set up the histogram so values can be added
   void initialize(size_t num_bins, double min_value, double max_value);
 
+  size_t get_num_bins  ()        const { return m_num_bins;         }
+  double get_min_value ()        const { return m_min_value;        }
+  double get_max_value ()        const { return m_max_value;        }
   double get_bin_width ()        const { return m_bin_width;        }
   double get_bin_center(int bin) const { return m_bin_centers[bin]; }
   double get_bin_value (int bin) const { return m_bin_values [bin]; }
@@ -172,6 +173,9 @@ public: // Functions
   /// Add a value with no bounds checking on the input!
   void add_value_no_check(double value);
 
+  /// Add the counts of another histogram with the same bins to this one.
+  void merge(Histogram const& other);
+
   /// Return the bin index containing the specified histogram percentile
   size_t get_percentile(double percentile) const;
 
@@ -189,6 +193,55 @@ private: // Variables
 }; // End class histogram
 
 
+/// Computes in one pass the count, minimum, maximum, mean and standard
+/// deviation of a set of values, and optionally approximate quantiles
+/// and a histogram over a range given in advance.
+/// - Two of these can be merged, so parts of a large data set can be
+///   processed in parallel and combined at the end.
+/// - The standard deviation normalizes by num_samples, as in StdDevAccumulator.
+class StatisticsAccumulator : public ReturnFixedType<void> {
+public:
+  /// If num_quantiles is not zero, quantiles are estimated with a
+  /// CDFAccumulator of that many quantiles.
+  StatisticsAccumulator(size_t num_quantiles = 0, size_t cdf_buffer_size = 1000);
+
+  /// Also build a histogram. Values out of range go into the end bins.
+  void set_histogram(size_t num_bins, double min_value, double max_value);
+
+  /// Add a value
+  void operator()(double value);
+
+  /// Merge in the values seen by another accumulator with the same settings.
+  void operator()(StatisticsAccumulator & other);
+
+  size_t num_samples() const { return m_count; }
+  double minimum() const;
+  double maximum() const;
+  double mean   () const;
+  double stddev () const;
+
+  /// Fold values added one at a time into the quantile estimate.  Call
+  /// this after the last value is added and before quantile().  Merging
+  /// does this already.
+  void update();
+
+  bool   has_quantiles() const { return m_use_cdf; }
+  /// Estimate the value at the given probability, in [0, 1].
+  double quantile(double p) const;
+
+  bool             has_histogram() const { return m_use_hist; }
+  Histogram const& histogram    () const { return m_hist; }
+
+private:
+  size_t m_count;
+  double m_min, m_max, m_mean, m_m2; // m_m2 is the sum of squared deviations from the mean
+  bool   m_use_cdf, m_use_hist;
+  bool   m_cdf_pending; // Values added since the last update()
+  CDFAccumulator<double> m_cdf;
+  Histogram m_hist;
+}; // End class StatisticsAccumulator
+
+
 
 
 
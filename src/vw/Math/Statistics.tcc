@@ -184,58 +184,6 @@ bool find_outlier_brackets(std::vector<T> const& vec,
 // ------------------------------------------------------------------
 //   CDFAccumulator
 
-template <class ValT>
-template <class InputIterator1, class InputIterator2>
-double CDFAccumulator<ValT>::trapezoidal_rule( InputIterator1 first1, InputIterator1 last1,
-                                               InputIterator2 first2 ) {
-  // We will never acess last1 .. remember that
-  double sum = 0.0;
-  while ( first1 + 1 != last1 ) {
-    sum += 0.5 * ( *(first1+1) - *first1 ) * ( *first2 + *(first2+1) );
-    first1++;
-    first2++;
-  }
-  return sum;
-}
-
-template <class ValT>
-void CDFAccumulator<ValT>::pdf_differentiation( std::vector<double> const& quantile,
-                                                std::vector<double> const& cdf,
-                                                std::vector<double> & output_pdf ) {
-  output_pdf[0] = 0;
-  output_pdf[output_pdf.size()-1] = 0;
-
-  for ( size_t i = 1; i < quantile.size() - 1; i++ ) {
-    // Trying to get a centered derivative
-    output_pdf[i] = 0;
-    double quantile_diff = quantile[i] - quantile[i-1];
-    if ( fabs(quantile_diff) > 1e-3 )
-      output_pdf[i] = (cdf[i] - cdf[i-1])/quantile_diff;
-    quantile_diff = quantile[i+1]-quantile[i];
-    if ( fabs(quantile_diff) > 1e-3 )
-      output_pdf[i] += (cdf[i+1]-cdf[i])/quantile_diff;
-    output_pdf[i] /= 2;
-  }
-}
-
-template <class ValT>
-void CDFAccumulator<ValT>::correct_pdf_integral_to_1( std::vector<double> const& quantile,
-                                                      std::vector<double> & pdf,
-                                                      double additional_scalar ) {
-
-  double pdf_error = trapezoidal_rule( quantile.begin(), quantile.end(), pdf.begin() );
-
-  const double MAX_PDF_ERROR = 0.01;
-  if ( pdf_error >= 1.0 - MAX_PDF_ERROR ) {
-    double correction = (1.0 / pdf_error) * additional_scalar;
-    for ( size_t i = 0; i < pdf.size(); i++ )
-      pdf[i] *= correction;
-  } else {
-    vw_throw( MathErr() << "CDFMathAccumulator: pdf_error < 0.99: " << pdf_error );
-  }
-}
-
-
 template <class ValT>
 void CDFAccumulator<ValT>::resize( size_t buffersize, size_t quantiles ) {
   VW_ASSERT(quantiles > 0, LogicErr() << "Cannot have 0 quantiles");
@@ -275,22 +223,31 @@ void CDFAccumulator<ValT>::update() {
   if (!m_buffer_idx)
     return;
 
+  std::sort( m_sample_buf.begin(),
+             m_sample_buf.begin()+m_buffer_idx ); // For partial updates
+  size_t num_values = m_buffer_idx;
+  m_buffer_idx = 0;
+  merge_sorted( &m_sample_buf[0], num_values, 1.0 );
+}
+
+template <class ValT>
+void CDFAccumulator<ValT>::merge_sorted(double const* values, size_t num_values,
+                                        double weight) {
   size_t jd=0, jq=1;
   double target, told=0, tnew=0, qold, qnew;
+  double total = m_num_samples + num_values*weight;
   std::vector<double> m_new_quantile(m_num_quantiles);
-  std::sort( m_sample_buf.begin(),
-             m_sample_buf.begin()+m_buffer_idx ); // For partial updates
   // Setting to global min and max;
   qold = qnew = m_quantile[0] = m_new_quantile[0] = m_q0;
   m_quantile.back() = m_new_quantile.back() = m_qm;
   // .. then setting comparable probabilities
-  m_cdf[0] = std::min(0.5/(m_buffer_idx+m_num_samples),
+  m_cdf[0] = std::min(0.5/total,
                       0.5*m_cdf[1]);
-  m_cdf.back() = std::max(1-0.5/(m_buffer_idx+m_num_samples),
+  m_cdf.back() = std::max(1-0.5/total,
                           0.5*(1+m_cdf[m_num_quantiles-2]));
   // Looping over target probability values for interpolation
   for ( size_t iq = 1; iq < m_num_quantiles-1; iq++ ) {
-    target = (m_num_samples+m_buffer_idx)*m_cdf[iq];
+    target = total*m_cdf[iq];
     if ( tnew < target ) {
       while (1) {
         // Locating a succession of abscissa-ordinate pairs
@@ -298,22 +255,23 @@ void CDFAccumulator<ValT>::update() {
         // slope, breaking to perform an interpolation as we cross
         // each target.
         if ( jq < m_num_quantiles &&
-             ( jd >= m_buffer_idx ||
-               m_quantile[jq] < m_sample_buf[jd] ) ) {
+             ( jd >= num_values ||
+               m_quantile[jq] < values[jd] ) ) {
           // Found slope discontinuity from old CDF.
           qnew = m_quantile[jq];
-          tnew = jd + m_num_samples*m_cdf[jq++];
+          tnew = jd*weight + m_num_samples*m_cdf[jq++];
           if ( tnew >= target ) break;
         } else {
           // Found value discontinuity from batch data CDF.
-          qnew = m_sample_buf[jd];
+          qnew = values[jd];
           tnew = told;
-          if ( m_quantile[jq] > m_quantile[jq-1] )
+          if ( jq < m_num_quantiles && m_quantile[jq] > m_quantile[jq-1] )
             tnew += m_num_samples*(m_cdf[jq]-m_cdf[jq-1])*
               (qnew-qold)/(m_quantile[jq]-m_quantile[jq-1]);
           jd++;
           if ( tnew >= target ) break;
-          told = tnew++;
+          told = tnew;
+          tnew += weight;
           qold = qnew;
           if ( tnew >= target ) break;
         }
@@ -331,8 +289,7 @@ void CDFAccumulator<ValT>::update() {
   }
   // Reset'n
   m_quantile = m_new_quantile;
-  m_num_samples += m_buffer_idx;
-  m_buffer_idx = 0;
+  m_num_samples = total;
 }
 
 template <class ValT>
@@ -349,16 +306,17 @@ void CDFAccumulator<ValT>::operator()( ValT const& arg ) {
 
 template <class ValT>
 void CDFAccumulator<ValT>::operator()( CDFAccumulator<ValT>& other ) {
+
+  update();
+  other.update();
+  if (other.m_num_samples == 0)
+    return;
   
-  // If this is an empty object we need duplicate the other CDF.
-  // -> This not be the ideal behavior but the code below will throw an exception.
+  // If this is an empty object we just duplicate the other CDF.
   if (m_num_samples == 0) {
     duplicate(other);
     return;
   }
-  
-  update();
-  other.update();
 
   // Work out the new range of m_q0 and m_qm
   if ( m_qm < other.m_qm )
@@ -366,97 +324,14 @@ void CDFAccumulator<ValT>::operator()( CDFAccumulator<ValT>& other ) {
   if ( m_q0 > other.m_q0 )
     m_q0 = other.m_q0;
 
-  // Generate PDF of both distribution functions by differentiating
-  std::vector<double> pdf1(m_num_quantiles), pdf2(other.m_num_quantiles);
-  pdf_differentiation( m_quantile, m_cdf, pdf1 );
-  pdf_differentiation( other.m_quantile, other.m_cdf, pdf2 );
-
-  // Resample both PDFs to higher number of quantiles that
-  // intersects both ranges.
-
-  // Defining quantile range
-  std::vector<double> new_quantile( m_quantile.size() );
-  new_quantile[0] = m_q0;
-  new_quantile.back() = m_qm;
-  double distance = m_qm - m_q0;
-  std::transform( m_cdf.begin() + 1, m_cdf.end() - 1, new_quantile.begin() + 1,
-                  std::bind1st( std::multiplies<double>(), distance ) );
-  std::transform( new_quantile.begin() + 1, new_quantile.end() - 1,
-                  new_quantile.begin() + 1,
-                  std::bind1st( std::plus<double>(), m_q0 ) );
-
-  // Resampling PDFs to our new quantile range so that we may
-  // later add these 2 PDFs together.
-  std::vector<double> pdf1_resample( m_quantile.size(), 0.0 ), pdf2_resample( m_quantile.size(), 0.0 );
-  {
-    size_t q1_i0 = 0, q2_i0 = 0;
-    for ( size_t i = 0; i < m_quantile.size(); i++ ) {
-
-      // Finding indexes that are just past our target quantile
-      while ( q1_i0 < m_quantile.size() &&
-              m_quantile[q1_i0] < new_quantile[i] ) {
-        q1_i0++;
-      }
-      while ( q2_i0 < other.m_quantile.size() &&
-              other.m_quantile[q2_i0] < new_quantile[i] ) {
-        q2_i0++;
-      }
-
-      if ( q1_i0 != 0 && q1_i0 < m_quantile.size() ) {
-        // The index represents represents
-        // the next greatest matching quantile.
-        pdf1_resample[i] = pdf1[q1_i0-1] + 
-                           (pdf1[q1_i0] - pdf1[q1_i0-1]) * ( new_quantile[i] - m_quantile[q1_i0-1] ) / (m_quantile[q1_i0] - m_quantile[q1_i0-1]);
-      }
-      if ( q2_i0 != 0 && q2_i0 < other.m_quantile.size() ) {
-        // The index represents represents
-        // the next greatest matching quantile.
-        pdf2_resample[i] = pdf2[q2_i0-1] + 
-                           (pdf2[q2_i0] - pdf2[q2_i0-1]) * ( new_quantile[i] - other.m_quantile[q2_i0-1] ) / (other.m_quantile[q2_i0] - other.m_quantile[q2_i0-1]);
-      }
-    }
-  }
-
-  // Correct the problem where the resampled PDF doesn't actually sum to 1
-  correct_pdf_integral_to_1( new_quantile, pdf1_resample,
-                             double(m_num_samples) / double(m_num_samples+other.m_num_samples) );
-  correct_pdf_integral_to_1( new_quantile, pdf2_resample,
-                             double(other.m_num_samples) / double(m_num_samples+other.m_num_samples) );
-
-  std::transform( pdf1_resample.begin(), pdf1_resample.end(),
-                  pdf2_resample.begin(), pdf1_resample.begin(),
-                  std::plus<double>() );
-
-
-  // Integrate out a CDF
-  std::vector<double> new_cdf( new_quantile.size() );
-  new_cdf[0] = 0.0;
-  for ( size_t i = 0; i < new_quantile.size() - 1; i++ ) {
-    new_cdf[i+1] = new_cdf[i] + trapezoidal_rule( new_quantile.begin() + i,
-                                                  new_quantile.begin() + i + 2,
-                                                  pdf1_resample.begin() + i );
-  }
+  // Sample the other CDF at evenly spaced probabilities. Each sample
+  // stands for an equal share of the other object's data.
+  const size_t num_values = 4*std::max(m_num_quantiles, other.m_num_quantiles);
+  std::vector<double> values(num_values);
+  for ( size_t i = 0; i < num_values; i++ )
+    values[i] = other.quantile_value( (i + 0.5) / num_values );
 
-  // Resample CDF to match our current rig
-  m_quantile[0] = m_q0;
-  m_quantile.back() = m_qm;
-  {
-    size_t cdf_index = 0;
-    for ( size_t i = 1; i < m_quantile.size() - 1; i++ ) {
-      while ( cdf_index < new_cdf.size() && new_cdf[cdf_index] < m_cdf[i] ) {
-        cdf_index++;
-      }
-      if ( cdf_index == 0 ) {
-        m_quantile[i] = new_quantile[cdf_index];
-      } else if ( cdf_index == new_cdf.size() ) {
-        m_quantile[i] = new_quantile.back();
-      } else {
-        m_quantile[i] = new_quantile[cdf_index-1] + 
-                        (m_cdf[i] - new_cdf[cdf_index-1]) * (new_quantile[cdf_index]-new_quantile[cdf_index-1]) / ( new_cdf[cdf_index] - new_cdf[cdf_index-1]);
-      }
-    }
-  }
-  m_num_samples += other.m_num_samples;
+  merge_sorted( &values[0], num_values, other.m_num_samples / num_values );
 }
 
 template <class ValT>
@@ -482,6 +357,11 @@ void CDFAccumulator<ValT>::duplicate(CDFAccumulator<ValT> const& other) {
 
 template <class ValT>
 ValT CDFAccumulator<ValT>::quantile( double const& arg ) const {
+  return quantile_value( arg );
+}
+
+template <class ValT>
+double CDFAccumulator<ValT>::quantile_value( double arg ) const {
   double q;
 
   // if ( m_buffer_idx > 0 ) update();
@@ -578,6 +458,15 @@ void Histogram::add_value_no_check(double value) {
   ++m_num_values;
 }
 inline
+void Histogram::merge(Histogram const& other) {
+  if (other.m_num_bins  != m_num_bins  ||
+      other.m_min_value != m_min_value || other.m_max_value != m_max_value)
+    vw_throw(ArgumentErr() << "Histogram::merge: The histograms have different bins!");
+  for (int i=0; i<m_num_bins; ++i)
+    m_bin_values[i] += other.m_bin_values[i];
+  m_num_values += other.m_num_values;
+}
+inline
 size_t Histogram::get_percentile(double percentile) const {
 
   // Verify the input percentile is in the legal range
@@ -608,3 +497,92 @@ void Histogram::write_to_disk(std::string const& path) const {
   f.close();
 }
 
+
+//--------------------------------------------------------------------------
+// Class StatisticsAccumulator
+inline
+StatisticsAccumulator::StatisticsAccumulator(size_t num_quantiles, size_t cdf_buffer_size)
+  : m_count(0), m_min(std::numeric_limits<double>::max()),
+    m_max(-std::numeric_limits<double>::max()), m_mean(0), m_m2(0),
+    m_use_cdf(num_quantiles > 0), m_use_hist(false), m_cdf_pending(false),
+    m_cdf(m_use_cdf ? cdf_buffer_size : 1, m_use_cdf ? num_quantiles : 3) {}
+
+inline
+void StatisticsAccumulator::set_histogram(size_t num_bins, double min_value, double max_value) {
+  VW_ASSERT(m_count == 0, LogicErr() << "StatisticsAccumulator: Set the histogram before adding values.");
+  m_hist.initialize(num_bins, min_value, max_value);
+  m_use_hist = true;
+}
+
+inline
+void StatisticsAccumulator::operator()(double value) {
+  ++m_count;
+  if (value < m_min) m_min = value;
+  if (value > m_max) m_max = value;
+  // Welford's update, which does not lose precision on large counts
+  double delta = value - m_mean;
+  m_mean += delta / m_count;
+  m_m2   += delta * (value - m_mean);
+  if (m_use_cdf ) {
+    m_cdf(value);
+    m_cdf_pending = true;
+  }
+  if (m_use_hist) m_hist.add_value(value);
+}
+
+inline
+void StatisticsAccumulator::operator()(StatisticsAccumulator & other) {
+  VW_ASSERT(m_use_cdf == other.m_use_cdf && m_use_hist == other.m_use_hist,
+            ArgumentErr() << "StatisticsAccumulator: Cannot merge objects with different settings.");
+  if (other.m_count == 0)
+    return;
+  // Chan's formula for combining the partial moments
+  double n1 = m_count, n2 = other.m_count, n = n1 + n2;
+  double delta = other.m_mean - m_mean;
+  m_mean  += delta * n2 / n;
+  m_m2    += other.m_m2 + delta*delta * n1 * n2 / n;
+  m_count += other.m_count;
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+  if (m_use_cdf ) {
+    m_cdf(other.m_cdf); // Updates both CDFs first
+    m_cdf_pending = other.m_cdf_pending = false;
+  }
+  if (m_use_hist) m_hist.merge(other.m_hist);
+}
+
+inline
+double StatisticsAccumulator::minimum() const {
+  VW_ASSERT(m_count, ArgumentErr() << "StatisticsAccumulator: no valid samples");
+  return m_min;
+}
+inline
+double StatisticsAccumulator::maximum() const {
+  VW_ASSERT(m_count, ArgumentErr() << "StatisticsAccumulator: no valid samples");
+  return m_max;
+}
+inline
+double StatisticsAccumulator::mean() const {
+  VW_ASSERT(m_count, ArgumentErr() << "StatisticsAccumulator: no valid samples");
+  return m_mean;
+}
+inline
+double StatisticsAccumulator::stddev() const {
+  VW_ASSERT(m_count, ArgumentErr() << "StatisticsAccumulator: no valid samples");
+  return sqrt(m_m2 / m_count);
+}
+
+inline
+double StatisticsAccumulator::quantile(double p) const {
+  VW_ASSERT(m_use_cdf, LogicErr() << "StatisticsAccumulator: Quantiles were not requested.");
+  VW_ASSERT(m_count, ArgumentErr() << "StatisticsAccumulator: no valid samples");
+  VW_ASSERT(!m_cdf_pending, LogicErr() << "StatisticsAccumulator: Call update() before quantile().");
+  return m_cdf.quantile(p);
+}
+
+inline
+void StatisticsAccumulator::update() {
+  if (m_use_cdf)
+    m_cdf.update();
+  m_cdf_pending = false;
+}
@@ -0,0 +1,125 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <test/Helpers.h>
+#include <vw/Math/BlockSparseCholesky.h>
+#include <vw/Math/LinearAlgebra.h>
+
+using namespace vw;
+using namespace vw::math;
+
+namespace {
+
+  // A diagonally dominant matrix with the block pattern of a ring of
+  // cameras, each also tied to one camera across the ring.
+  BlockSparseMatrix make_ring( size_t num_blocks, size_t block_size ) {
+    std::vector<std::vector<size_t> > pattern( num_blocks );
+    for ( size_t i = 1; i < num_blocks; ++i )
+      pattern[i].push_back( i-1 );
+    pattern[num_blocks-1].push_back( 0 );
+    for ( size_t i = num_blocks/2; i < num_blocks; ++i )
+      pattern[i].push_back( i - num_blocks/2 );
+
+    BlockSparseMatrix A( block_size, pattern );
+    for ( size_t i = 0; i < num_blocks; ++i )
+      for ( size_t k = A.row_begin(i); k < A.row_end(i); ++k ) {
+        size_t j = A.col_index(k);
+        double* b = A.block_data(k);
+        for ( size_t r = 0; r < block_size; ++r )
+          for ( size_t c = 0; c < block_size; ++c ) {
+            if ( i == j )
+              b[r*block_size+c] = ( r == c ) ? 20.0 + r : 1.0 / ( 1 + r + c );
+            else
+              b[r*block_size+c] = 0.1 * ( ( r*7 + c*3 + i + j ) % 5 ) - 0.2;
+          }
+      }
+    return A;
+  }
+
+  Vector<double> make_rhs( size_t size ) {
+    Vector<double> b( size );
+    for ( size_t i = 0; i < size; ++i )
+      b[i] = std::sin( double(i) );
+    return b;
+  }
+
+}
+
+TEST( BlockSparseCholesky, Pattern ) {
+  BlockSparseMatrix A = make_ring( 6, 2 );
+  EXPECT_EQ( 12u, A.rows() );
+  EXPECT_TRUE( A.block( 3, 2 ) != 0 );
+  EXPECT_TRUE( A.block( 3, 0 ) != 0 );
+  EXPECT_TRUE( A.block( 2, 0 ) == 0 );
+
+  Matrix<double> D = A.dense();
+  EXPECT_MATRIX_NEAR( D, transpose(D), 1e-15 );
+  Vector<double> x = make_rhs( A.cols() );
+  EXPECT_VECTOR_NEAR( D * x, A.multiply( x ), 1e-12 );
+}
+
+TEST( BlockSparseCholesky, Ordering ) {
+  // A star: eliminating the hub first would fill in everything.
+  std::vector<std::vector<size_t> > pattern( 5 );
+  for ( size_t i = 1; i < 5; ++i )
+    pattern[i].push_back( 0 );
+  BlockSparseMatrix A( 1, pattern );
+  std::vector<size_t> order = minimum_degree_ordering( A );
+  ASSERT_EQ( 5u, order.size() );
+  EXPECT_EQ( 1u, order[0] );
+  EXPECT_EQ( 0u, order[3] );  // Once only one leaf is left, ties go to the lower index
+
+  BlockSparseCholesky chol;
+  chol.analyze( A );
+  EXPECT_EQ( 9u, chol.num_factor_blocks() );
+}
+
+TEST( BlockSparseCholesky, Solve ) {
+  BlockSparseMatrix A = make_ring( 9, 3 );
+  Vector<double> b = make_rhs( A.rows() );
+  Vector<double> expected = inverse( A.dense() ) * b;
+
+  BlockSparseCholesky chol;
+  ASSERT_TRUE( chol.factor( A ) );
+  EXPECT_VECTOR_NEAR( expected, chol.solve( b ), 1e-10 );
+
+  // Refactoring with new values reuses the analysis.
+  for ( size_t i = 0; i < A.num_blocks(); ++i )
+    for ( size_t r = 0; r < A.block_size(); ++r )
+      A.block( i, i )[ r*A.block_size()+r ] += 5;
+  EXPECT_TRUE( chol.analyzed_for( A ) );
+  ASSERT_TRUE( chol.factor( A ) );
+  expected = inverse( A.dense() ) * b;
+  EXPECT_VECTOR_NEAR( expected, chol.solve( b ), 1e-10 );
+
+  // Not positive definite
+  A.block( 4, 4 )[0] = -100;
+  EXPECT_FALSE( chol.factor( A ) );
+}
+
+TEST( BlockSparseCholesky, ConjugateGradient ) {
+  BlockSparseMatrix A = make_ring( 9, 3 );
+  Vector<double> b = make_rhs( A.rows() );
+  Vector<double> expected = inverse( A.dense() ) * b;
+
+  Vector<double> x;
+  size_t iterations = block_jacobi_pcg( A, b, x, 1e-12 );
+  EXPECT_GT( iterations, 0u );
+  EXPECT_LE( iterations, A.rows() );
+  EXPECT_VECTOR_NEAR( expected, x, 1e-9 );
+}
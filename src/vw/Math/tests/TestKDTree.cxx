@@ -16,6 +16,8 @@
 // __END_LICENSE__
 
 
+#include <algorithm>
+#include <cstdlib>
 #include <vector>
 #include <gtest/gtest_VW.h>
 #include <vw/Math/KDTree.h>
@@ -711,7 +713,7 @@ TEST(KDTree, searches_after_inserts) {
   int num_records;
 
 
-  KDTree<file_t> kd_A(2);
+  KDTree<file_t> kd_A(2, 1);  // One record per leaf
   KDTree<file_t> kd_B(2, file);
   KDTree<file_t> kd_C(2, file, VarianceDiscSelector(), MedianPartitioner());
   KDTree<file_t> kd_D(2, file, VarianceDiscSelector(), RandPartitioner());
@@ -998,3 +1000,62 @@ TEST(KDTree, constrained_search) {
   EXPECT_EQ( nearest_records[3][0], 8);
   EXPECT_EQ( nearest_records[3][1], 18);
 }
+
+namespace {
+  // The m nearest records to query by exhaustive search
+  vector< vector<double> > brute_force_nearest(vector< vector<double> > const& file,
+                                               vector<double> const& query, size_t m) {
+    vector< std::pair<double,size_t> > distances;
+    for (size_t i = 0; i < file.size(); ++i)
+      distances.push_back(std::make_pair(SafeEuclideanDistanceMetric()(query.begin(), query.end(),
+                                                                       file[i].begin()), i));
+    std::sort(distances.begin(), distances.end());
+    vector< vector<double> > result;
+    for (size_t i = 0; i < m && i < distances.size(); ++i)
+      result.push_back(file[distances[i].second]);
+    return result;
+  }
+}
+
+TEST(KDTree, random_search) {
+  typedef vector< vector<double> > file_t;
+  std::srand(4);
+  file_t file(40000, vector<double>(3));
+  for (size_t i = 0; i < file.size(); ++i)
+    for (size_t j = 0; j < 3; ++j)
+      file[i][j] = std::rand() % 2000 / 10.0;
+
+  // Large enough to be built in parallel
+  uint32 threads = vw_settings().default_num_threads();
+  vw_settings().set_default_num_threads(4);
+  KDTree<file_t> kd(3, file);
+  vw_settings().set_default_num_threads(threads);
+  EXPECT_EQ(file.size(), kd.size());
+  EXPECT_LE(kd.max_depth(), kd.min_depth() + 1);
+
+  // Insert some more, so that buckets split.
+  KDTree<file_t> kd_small(3, file_t(file.begin(), file.begin() + 100));
+  for (size_t i = 100; i < 2000; ++i)
+    kd_small.insert(file[i]);
+  file_t small_file(file.begin(), file.begin() + 2000);
+  EXPECT_EQ(small_file.size(), kd_small.size());
+
+  vector< vector<double> > nearest;
+  for (int q = 0; q < 50; ++q) {
+    vector<double> query(3);
+    for (size_t j = 0; j < 3; ++j)
+      query[j] = std::rand() % 2200 / 10.0 - 10;
+
+    file_t expected = brute_force_nearest(file, query, 7);
+    ASSERT_EQ(7u, kd.m_nearest_neighbors(query, nearest, 7));
+    for (size_t i = 0; i < 7; ++i)
+      EXPECT_NEAR(SafeEuclideanDistanceMetric()(query.begin(), query.end(), expected[i].begin()),
+                  SafeEuclideanDistanceMetric()(query.begin(), query.end(), nearest[i].begin()), 1e-12);
+
+    expected = brute_force_nearest(small_file, query, 3);
+    ASSERT_EQ(3u, kd_small.m_nearest_neighbors(query, nearest, 3));
+    for (size_t i = 0; i < 3; ++i)
+      EXPECT_NEAR(SafeEuclideanDistanceMetric()(query.begin(), query.end(), expected[i].begin()),
+                  SafeEuclideanDistanceMetric()(query.begin(), query.end(), nearest[i].begin()), 1e-12);
+  }
+}
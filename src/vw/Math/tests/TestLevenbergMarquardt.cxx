@@ -96,3 +96,93 @@ TEST(LevenbergMarquardt, levenberg_marquardt) {
   EXPECT_EQ(vw::math::optimization::eConvergedRelTolerance, status);
   EXPECT_VECTOR_NEAR( expected_best, best, 1e-5 );
 }
+
+// The model above with fixed sizes, and optionally its exact Jacobian.
+template <bool AnalyticT>
+struct FixedModel : public LeastSquaresModelBaseFixed<FixedModel<AnalyticT>, 4, 5> {
+  typedef Vector<double,5> result_type;
+  typedef Vector4          domain_type;
+  typedef Matrix<double,5,4> jacobian_type;
+
+  inline result_type operator()( domain_type const& x ) const {
+    result_type h;
+    h(0) = sin(x(0)+0.1);
+    h(1) = cos(x(1) * x(2));
+    h(2) = x(1) * cos(x(2));
+    h(3) = atan2(x(0),x(3));
+    h(4) = atan2(x(2),x(1));
+    return h;
+  }
+
+  inline jacobian_type jacobian( domain_type const& x ) const {
+    if (!AnalyticT)
+      return LeastSquaresModelBaseFixed<FixedModel<AnalyticT>, 4, 5>::jacobian(x);
+    jacobian_type J;
+    J(0,0) = cos(x(0)+0.1);
+    J(1,1) = -x(2)*sin(x(1)*x(2));
+    J(1,2) = -x(1)*sin(x(1)*x(2));
+    J(2,1) = cos(x(2));
+    J(2,2) = -x(1)*sin(x(2));
+    double r03 = x(0)*x(0) + x(3)*x(3), r21 = x(2)*x(2) + x(1)*x(1);
+    J(3,0) =  x(3)/r03;
+    J(3,3) = -x(0)/r03;
+    J(4,1) = -x(2)/r21;
+    J(4,2) =  x(1)/r21;
+    return J;
+  }
+};
+
+TEST(LevenbergMarquardt, cholesky_solve_fixed) {
+  Matrix3x3 A( 4, 2, 0.6,
+               2, 5, 1,
+               0.6, 1, 3 );
+  Vector3 b( 1, -2, 0.5 ), x;
+  ASSERT_TRUE( cholesky_solve_fixed( A, b, x ) );
+  EXPECT_VECTOR_NEAR( b, A*x, 1e-12 );
+
+  Matrix2x2 singular( 1, 1, 1, 1 );
+  Vector2 y( 7, 7 );
+  EXPECT_FALSE( cholesky_solve_fixed( singular, Vector2(1, 1), y ) );
+  EXPECT_VECTOR_DOUBLE_EQ( Vector2(7, 7), y );
+}
+
+TEST(LevenbergMarquardt, levenberg_marquardtFixed) {
+  Vector<double,5> target( 0.2, 0.3, 0.4, 0.5, 0.6 );
+  Vector4 seed( 1, 1, 1, 1 );
+  Vector4 expected_best( 0.101358, 1.15485, 1.12093, 0.185534 );
+
+  FixedModel<false> numerical;
+  FixedModel<true>  analytic;
+  EXPECT_MATRIX_NEAR( numerical.jacobian(seed), analytic.jacobian(seed), 1e-6 );
+
+  int status;
+  EXPECT_VECTOR_NEAR( expected_best, levenberg_marquardtFixed( numerical, seed, target, status ), 1e-5 );
+  EXPECT_GT( status, 0 );
+  EXPECT_VECTOR_NEAR( expected_best, levenberg_marquardtFixed( analytic, seed, target, status ), 1e-5 );
+  EXPECT_GT( status, 0 );
+}
+
+TEST(LevenbergMarquardt, levenberg_marquardtFixed_batch) {
+  int old_threads = vw_settings().default_num_threads();
+  vw_settings().set_default_num_threads( 4 );
+
+  // Recover many points from their exact observations.
+  std::vector<FixedModel<true> > models( 200 );
+  std::vector<Vector4> seeds, expected, solutions;
+  std::vector<Vector<double,5> > targets;
+  for ( size_t i = 0; i < models.size(); ++i ) {
+    Vector4 x( 0.2 + 0.001*i, 0.5, 0.4 + 0.0005*i, 0.6 );
+    expected.push_back( x );
+    targets.push_back( models[i]( x ) );
+    seeds.push_back( x + Vector4( 0.05, -0.05, 0.05, 0.05 ) );
+  }
+  std::vector<int> status;
+  levenberg_marquardtFixed_batch( models, seeds, targets, solutions, status );
+  ASSERT_EQ( models.size(), solutions.size() );
+  for ( size_t i = 0; i < models.size(); ++i ) {
+    EXPECT_GT( status[i], 0 );
+    EXPECT_VECTOR_NEAR( expected[i], solutions[i], 1e-6 );
+  }
+
+  vw_settings().set_default_num_threads( old_threads );
+}
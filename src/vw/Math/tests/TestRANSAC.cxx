@@ -0,0 +1,103 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <cstdlib>
+#include <vector>
+#include <gtest/gtest_VW.h>
+#include <vw/Math/RANSAC.h>
+#include <vw/Math/Geometry.h>
+#include <test/Helpers.h>
+
+using namespace vw;
+using namespace vw::math;
+
+typedef RandomSampleConsensus<AffineFittingFunctor, InterestPointErrorMetric> AffineRANSAC;
+
+class RANSACTest : public ::testing::Test {
+protected:
+  std::vector<Vector3> p1, p2;
+  Matrix3x3 A;
+
+  // 300 matches under an affine transform, the first 200 exact and
+  // the rest wrong.
+  virtual void SetUp() {
+    A = Matrix3x3( 1.1, -0.2, 30,
+                   0.3,  0.9, -5,
+                   0,    0,    1 );
+    std::srand(7);
+    for ( int i = 0; i < 300; i++ ) {
+      Vector3 p( std::rand() % 1000, std::rand() % 1000, 1 );
+      p1.push_back( p );
+      if ( i < 200 )
+        p2.push_back( A * p );
+      else
+        p2.push_back( Vector3( std::rand() % 1000, std::rand() % 1000, 1 ) );
+    }
+  }
+};
+
+TEST_F( RANSACTest, Affine ) {
+  AffineFittingFunctor fit;
+  InterestPointErrorMetric error;
+  AffineRANSAC ransac( fit, error, 1000, 1, 150 );
+  ransac.set_num_threads( 4 );
+  Matrix3x3 H = ransac( p1, p2 );
+  EXPECT_MATRIX_NEAR( A, H, 1e-6 );
+  EXPECT_EQ( 200u, ransac.inlier_indices( H, p1, p2 ).size() );
+}
+
+TEST_F( RANSACTest, Threads ) {
+  AffineFittingFunctor fit;
+  InterestPointErrorMetric error;
+  AffineRANSAC serial( fit, error, 100, 1, 50 ), threaded( fit, error, 100, 1, 50 );
+  EXPECT_EQ( 1, serial.num_threads() ); // Threads are opt-in
+  threaded.set_num_threads( 3 );
+  serial.set_num_pretest( 1 );
+  threaded.set_num_pretest( 1 );
+
+  std::srand(1);
+  Matrix3x3 H1 = serial( p1, p2 );
+  std::srand(1);
+  Matrix3x3 H2 = threaded( p1, p2 );
+  EXPECT_MATRIX_NEAR( H1, H2, 1e-12 );
+}
+
+TEST_F( RANSACTest, ReducedInliers ) {
+  // Too many inliers are asked for, so a fit with fewer is returned
+  // from the same run.
+  AffineFittingFunctor fit;
+  InterestPointErrorMetric error;
+  AffineRANSAC ransac( fit, error, 200, 1, 290, true );
+  Matrix3x3 H = ransac( p1, p2 );
+  EXPECT_MATRIX_NEAR( A, H, 1e-6 );
+
+  AffineRANSAC strict( fit, error, 200, 1, 290 );
+  EXPECT_THROW( strict( p1, p2 ), RANSACErr );
+}
+
+TEST_F( RANSACTest, Progressive ) {
+  // The wrong matches are at the back, as if sorted by match quality,
+  // so a few hypotheses are enough.
+  AffineFittingFunctor fit;
+  InterestPointErrorMetric error;
+  AffineRANSAC ransac( fit, error, 5, 1, 150 );
+  ransac.set_progressive_sampling( true );
+  ransac.set_confidence( 1 );
+  Matrix3x3 H = ransac( p1, p2 );
+  EXPECT_MATRIX_NEAR( A, H, 1e-6 );
+}
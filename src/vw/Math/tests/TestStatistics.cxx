@@ -165,3 +165,42 @@ TEST(Statistics, CDF_Merge ) {
   cdf0.duplicate(cdf2);
   EXPECT_NEAR( cdf2.median(), cdf0.median(), 0.01 );
 }
+
+TEST(Statistics, StatisticsAccumulator_Merge ) {
+  boost::mt19937 random_gen(42);
+  boost::normal_distribution<double> norm(10, 2);
+  boost::variate_generator<boost::mt19937&, boost::normal_distribution<double> > generator( random_gen, norm );
+
+  // Accumulate everything in one object, and the same values split
+  // across four objects which are then merged.
+  StatisticsAccumulator all(251), parts[4];
+  for ( int k = 0; k < 4; k++ ) {
+    parts[k] = StatisticsAccumulator(251);
+    parts[k].set_histogram(20, 0, 20);
+  }
+  all.set_histogram(20, 0, 20);
+  std::vector<double> values;
+  for ( size_t i = 0; i < 40000; i++ ) {
+    double v = generator();
+    values.push_back(v);
+    all(v);
+    parts[i % 4](v);
+  }
+  for ( int k = 1; k < 4; k++ )
+    parts[0](parts[k]);
+
+  EXPECT_EQ    ( all.num_samples(), parts[0].num_samples() );
+  EXPECT_EQ    ( *std::min_element(values.begin(), values.end()), parts[0].minimum() );
+  EXPECT_EQ    ( *std::max_element(values.begin(), values.end()), parts[0].maximum() );
+  EXPECT_NEAR  ( mean(values), parts[0].mean(), 1e-10 );
+  EXPECT_NEAR  ( standard_deviation(values, mean(values)), parts[0].stddev(), 1e-3 );
+  EXPECT_NEAR  ( all.mean  (), parts[0].mean  (), 1e-10 );
+  EXPECT_NEAR  ( all.stddev(), parts[0].stddev(), 1e-10 );
+  for ( int b = 0; b < 20; b++ )
+    EXPECT_EQ( all.histogram().get_bin_value(b), parts[0].histogram().get_bin_value(b) );
+  EXPECT_THROW( all.quantile(0.5), LogicErr );
+  all.update();
+  EXPECT_NEAR( 10.0,  parts[0].quantile(0.5), 0.05 );
+  EXPECT_NEAR( all.quantile(0.25), parts[0].quantile(0.25), 0.05 );
+  EXPECT_NEAR( all.quantile(0.75), parts[0].quantile(0.75), 0.05 );
+}
@@ -31,6 +31,7 @@
 #include <vw/Core/ProgressCallback.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageViewRef.h>
+#include <vw/Image/AntiAliasing.h>
 #include <vw/Cartography/GeoReferenceUtils.h>
 #include <vw/FileIO/DiskImageResource.h>
 #include <vw/FileIO/FileUtils.h>
@@ -306,11 +307,18 @@ namespace vw { namespace mosaic {
       int    tile_size   = 256;
       int    sub_threads = 1;
 
-      // Resample the image at the current pyramid level.
-      // TODO: resample_aa is a hacky thingy. Need to understand
-      // what is a good way of resampling.
+      // Resample the image at the current pyramid level, averaging
+      // only valid pixels. Halving, the default, uses the streaming box
+      // reduction; other factors go through resample_aa.
       // Note that below we cast the channels to double for resampling,
       // then cast back to current pixel type for saving.
+      typedef PixelMask<typename CompoundChannelCast<PixelT, double>::type> double_pixel_type;
+      ImageViewRef<double_pixel_type> resampled;
+      if (subsample == 2)
+        resampled = reduce_view(channel_cast<double>(masked), 1, BoxReduceFilter);
+      else
+        resampled = resample_aa(channel_cast<double>(masked), sub_scale);
+
       PixelT nodata_pixel;
       set_all(nodata_pixel, m_nodata_val);
       ImageViewRef<PixelT> unmasked
@@ -318,8 +326,7 @@ namespace vw { namespace mosaic {
         (cache_tile_aware_render
           (pixel_cast<PixelT>
           (apply_mask
-            (resample_aa
-            (channel_cast<double>(masked), sub_scale),
+            (resampled,
             nodata_pixel
             )),
           Vector2i(tile_size,tile_size) * sub_scale
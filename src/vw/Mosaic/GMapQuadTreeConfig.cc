@@ -23,7 +23,6 @@
 #include <boost/foreach.hpp>
 namespace fs = boost::filesystem;
 
-#include <vw/FileIO/DiskImageResource.h>
 
 namespace vw {
 namespace mosaic {
@@ -56,9 +55,8 @@ namespace mosaic {
     return path.string();
   }
 
-  boost::shared_ptr<DstImageResource> GMapQuadTreeConfig::tile_resource( QuadTreeGenerator const& /*qtree*/, QuadTreeGenerator::TileInfo const& info, ImageFormat const& format ) {
-    create_directories( fs::path( info.filepath ).parent_path() );
-    return boost::shared_ptr<DstImageResource>( DiskImageResource::create( info.filepath + info.filetype, format, info.filetype ) );
+  boost::shared_ptr<DstImageResource> GMapQuadTreeConfig::tile_resource( QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info, ImageFormat const& format ) {
+    return qtree.create_tile_resource( info, format );
   }
 
   void GMapQuadTreeConfig::configure( QuadTreeGenerator& qtree ) const {
@@ -111,6 +111,7 @@ namespace mosaic {
            << "  \"nlevels\": " << qtree.get_tree_levels()   << std::endl
            << "}" << std::endl;
 
+      create_directories( json_path.parent_path() ); // No tiles here if they are archived
       fs::ofstream jsonfs(json_path);
       jsonfs << json.str();
     }
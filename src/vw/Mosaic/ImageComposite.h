@@ -25,7 +25,7 @@
 
 #include <iostream>
 #include <vector>
-#include <list>
+#include <algorithm>
 
 #include <vw/Core/Cache.h>
 #include <vw/Core/ProgressCallback.h>
@@ -36,7 +36,9 @@
 #include <vw/Image/Algorithms.h>
 #include <vw/Image/Transform.h>
 #include <vw/Image/Filter.h>
+#include <vw/Image/AntiAliasing.h>
 #include <vw/Image/SparseImageCheck.h>
+#include <vw/Geometry/PackedRTree.h>
 #include <vw/FileIO/DiskImageResource.h>
 
 namespace vw {
@@ -61,29 +63,18 @@ namespace mosaic {
     PositionedImage( int cols, int rows, ImageT const& image, BBox2i const& bbox ) 
       : m_cols(cols), m_rows(rows), image(image), bbox(bbox) {}
 
-    /// ?
+    /// Reduce to the next pyramid level with the 5-tap Gaussian kernel,
+    /// treating everything outside the bounding box as zero.
     PositionedImage reduce() const {
-      const int border = 1;
-
-      int left   = std::min( border + (bbox.min().x()   +border)%2, bbox.min().x()                      );
-      int top    = std::min( border + (bbox.min().y()   +border)%2, bbox.min().y()                      );
-      int right  = std::min( border + (bbox.width()+left+border)%2, m_cols-bbox.min().x()-bbox.width()  );
-      int bottom = std::min( border + (bbox.height()+top+border)%2, m_rows-bbox.min().y()-bbox.height() );
-
-      std::vector<float> kernel(3); kernel[0]=0.25; kernel[1]=0.5; kernel[2]=0.25;
-      // I don't quite yet understand why (if?) this is the correct bounding box,
-      // but bad things happen without the final "+1"s:
-      BBox2i new_bbox( Vector2i( (bbox.min().x()-left)/2, 
-                                 (bbox.min().y()-top )/2 ),
-                       Vector2i( (bbox.min().x()-left)/2 + (bbox.width()+left+right +1)/2+1,
-                                 (bbox.min().y()-top )/2 + (bbox.height()+top+bottom+1)/2+1 ) );
-      // We use vw::rasterize() here rather than ordinary assignment because it is
-      // faster for this particular combination of filtering and subsampling.
+      const int32 new_cols = (m_cols+1)/2, new_rows = (m_rows+1)/2;
+      BBox2i new_bbox( Vector2i( std::max( 0, (bbox.min().x()-1)/2 ),
+                                 std::max( 0, (bbox.min().y()-1)/2 ) ),
+                       Vector2i( std::min( new_cols, (bbox.max().x()+1)/2+1 ),
+                                 std::min( new_rows, (bbox.max().y()+1)/2+1 ) ) );
       ImageView<PixelT> new_image( new_bbox.width(), new_bbox.height() );
-      vw::rasterize( edge_extend( subsample( separable_convolution_filter( edge_extend( image, -left, -top, image.cols()+left+right, image.rows()+top+bottom, ZeroEdgeExtension() ),
-                                                                           kernel, kernel, ZeroEdgeExtension() ), 2 ), 0, 0, new_bbox.width(), new_bbox.height(), vw::ConstantEdgeExtension() ),
-                     new_image );
-      return PositionedImage( (m_cols+1)/2, (m_rows+1)/2, new_image, new_bbox );
+      vw::detail::reduce_levels( edge_extend( image, -bbox.min().x(), -bbox.min().y(), m_cols, m_rows, ZeroEdgeExtension() ),
+                                 new_bbox, 1, GaussianReduceFilter, true, new_image );
+      return PositionedImage( new_cols, new_rows, new_image, new_bbox );
     }
 
     void unpremultiply() {
@@ -137,11 +128,57 @@ namespace mosaic {
   };
 
 
+  // *******************************************************************
+  // SourceIndex
+  // *******************************************************************
+
+  /// A packed R-tree over the bounding boxes of the sources.  Finding
+  /// the sources near a region then costs time proportional to the
+  /// number of nearby sources rather than the total number of sources.
+  class SourceIndex {
+    geometry::PackedRTree m_tree;
+    bool m_built;
+
+  public:
+    SourceIndex() : m_built(false) {}
+
+    /// Build the index.
+    void build( std::vector<BBox2i> const& bboxes ) {
+      m_tree.build( bboxes );
+      m_built = true;
+    }
+
+    /// Return, in insertion order, the sources whose bounding boxes
+    /// intersect the given region.  This only reads the index, so
+    /// several threads may call it at once.  Before build() is called
+    /// this falls back to checking every source.
+    void find( std::vector<BBox2i> const& bboxes, BBox2i const& bbox, std::vector<uint32>& result ) const {
+      if( m_built ) {
+        m_tree.intersects( bbox, result );
+        return;
+      }
+      result.clear();
+      for( size_t i=0; i<bboxes.size(); ++i )
+        if( bbox.intersects( bboxes[i] ) )
+          result.push_back( uint32(i) );
+    }
+  };
+
+
   // *******************************************************************
   // ImageComposite
   // *******************************************************************
 
-  /// ?
+  /// A mosaic of positioned source images, either overlaid in order
+  /// (draft mode) or merged with multi-band blending.
+  ///
+  /// Blending works one output patch at a time: only the sources
+  /// overlapping the patch are read, and for each of them a Laplacian
+  /// pyramid is built over just the region the patch depends on, then
+  /// discarded.  That region grows with the number of pyramid levels,
+  /// which follows the smallest source unless capped with
+  /// set_max_levels().  Patches share nothing but the read-only source
+  /// list and the system cache, so they can be generated in parallel.
   template <class PixelT>
   class ImageComposite : public ImageViewBase<ImageComposite<PixelT> > {
   public:
@@ -149,25 +186,6 @@ namespace mosaic {
     typedef typename PixelChannelType<PixelT>::type channel_type;
 
   private:
-    struct Pyramid {
-      std::vector<PositionedImage<pixel_type  > > images;
-      std::vector<PositionedImage<channel_type> > masks;
-    };
-
-    /// ?
-    class SourceGenerator {
-      ImageViewRef<pixel_type> m_source;
-    public:
-      typedef ImageView<pixel_type> value_type;
-      SourceGenerator( ImageViewRef<pixel_type> const& source ) : m_source(source) {}
-      size_t size() const {
-        return m_source.cols() * m_source.rows() * sizeof(pixel_type);
-      }
-      boost::shared_ptr<value_type> generate() const {
-        return boost::shared_ptr<value_type>( new value_type(m_source) );
-      }
-    };
-
     class GrassfireGenerator {
       ImageViewRef<pixel_type> m_source;
     public:
@@ -182,52 +200,19 @@ namespace mosaic {
       }
     };
 
-    class AlphaGenerator {
-    public:
-      ImageComposite& m_composite;
-      size_t m_index;
-    public:
-      typedef ImageView<channel_type> value_type;
-      AlphaGenerator( ImageComposite& composite, size_t index ) : m_composite(composite), m_index(index) {}
-      size_t size() const {
-        return m_composite.sources[m_index].size() / PixelNumChannels<pixel_type>::value;
-      }
-      boost::shared_ptr<value_type> generate() const {
-        ImageView<pixel_type> source = *m_composite.sources[m_index];
-        m_composite.sources[m_index].release();
-        m_composite.sources[m_index].deprioritize();
-        return boost::shared_ptr<value_type>( new value_type( select_alpha_channel( source ) ) );
-      }
-    };
-
-    class PyramidGenerator {
-    public:
-      ImageComposite& m_composite;
-      size_t m_index;
-    public:
-      typedef Pyramid value_type;
-      PyramidGenerator( ImageComposite& composite, size_t index ) : m_composite(composite), m_index(index) {}
-      size_t size() const {
-        return size_t( double(m_composite.sources[m_index].size()) * 1.66 ); // 1.66 = (5/4)*(4/3)
-      }
-      boost::shared_ptr<value_type> generate() const;
-    };
-
-    friend class PyramidGenerator;
-
     std::vector<BBox2i > bboxes;
     BBox2i view_bbox, data_bbox;
-    int    mindim, levels;
+    int    mindim, levels, m_max_levels;
     bool   m_draft_mode;
     bool   m_fill_holes;
-    bool   m_reuse_masks;
     Cache& m_cache;
-    std::vector<ImageViewRef<pixel_type> >        sourcerefs;
-    std::vector<Cache::Handle<SourceGenerator > > sources;
-    std::vector<Cache::Handle<AlphaGenerator  > > alphas;
-    std::vector<Cache::Handle<PyramidGenerator> > pyramids;
+    SourceIndex m_index;
+    std::vector<ImageViewRef<pixel_type> >          sourcerefs;
+    std::vector<Cache::Handle<GrassfireGenerator> > grassfires;
 
-    void generate_masks( ProgressCallback const& progress_callback ) const;
+    /// The blending weight of source p over the given region: full
+    /// where p is the source furthest from its own edge, else zero.
+    ImageView<channel_type> blend_mask( uint32 p, BBox2i const& region ) const;
 
     /// Generates a full-resolution patch of the mosaic corresponding
     /// to the given bounding box.
@@ -240,8 +225,8 @@ namespace mosaic {
   public:
     typedef pixel_type result_type;
 
-    ImageComposite() : m_draft_mode (false), m_fill_holes(false),
-                       m_reuse_masks(false), m_cache(vw_system_cache()) {}
+    ImageComposite() : m_max_levels(0), m_draft_mode (false), m_fill_holes(false),
+                       m_cache(vw_system_cache()) {}
 
     void insert( ImageViewRef<pixel_type> const& image, int x, int y );
 
@@ -259,7 +244,17 @@ namespace mosaic {
 
     void set_fill_holes (bool fill_holes ) { m_fill_holes = fill_holes; }
 
-    void set_reuse_masks(bool reuse_masks) { m_reuse_masks = reuse_masks; }
+    /// Blending masks are now computed in memory as needed, so there
+    /// is nothing to reuse.  Kept for source compatibility.
+    void set_reuse_masks(bool /*reuse_masks*/) {}
+
+    /// Limit the number of blending pyramid levels.  Each output patch
+    /// reads a margin of roughly 3*2^levels source pixels around
+    /// itself, so a cap bounds the work per patch for large sources
+    /// at the price of blending fewer low frequencies.  Zero, the
+    /// default, leaves the count set by the smallest source.  Takes
+    /// effect at the next call to prepare().
+    void set_max_levels(int max_levels) { m_max_levels = std::max( max_levels, 0 ); }
 
     int32 cols  () const { return view_bbox.width();  }
     int32 rows  () const { return view_bbox.height(); }
@@ -269,9 +264,9 @@ namespace mosaic {
     BBox2i const& source_data_bbox() const { return view_bbox; }
 
     pixel_type operator()( int x, int y, int p=0 ) const {
-      // FIXME: This is horribly slow, and totally untested for
-      // multi-band blending.  We should do something faster for draft
-      // mode, and possibly cache output blocks in multi-band mode?
+      // FIXME: This is horribly slow.  We should do something faster
+      // for draft mode, and possibly cache output blocks in multi-band
+      // mode?
       return generate_patch(BBox2i(x,y,1,1))(0,0,p);
     }
 
@@ -290,14 +285,14 @@ namespace mosaic {
     }
 
     bool sparse_check( BBox2i const& bbox ) const {
-      for (unsigned int i = 0; i < bboxes.size(); ++i) {
-        BBox2i src_bbox = bboxes[i];
+      std::vector<uint32> overlapping;
+      m_index.find( bboxes, bbox, overlapping );
+      for (size_t i = 0; i < overlapping.size(); ++i) {
+        uint32 p = overlapping[i];
+        BBox2i src_bbox = bboxes[p];
         src_bbox.crop(bbox);
-        if( ! src_bbox.empty() ) {
-          if( vw::sparse_check( sourcerefs[i], src_bbox-bboxes[i].min() ) ) {
-            return true;
-          }
-        }
+        if( vw::sparse_check( sourcerefs[p], src_bbox-bboxes[p].min() ) )
+          return true;
       }
       return false;
     }
@@ -324,93 +319,10 @@ namespace mosaic {
 } // namespace vw
 
 
-template <class PixelT>
-void vw::mosaic::ImageComposite<PixelT>::generate_masks( vw::ProgressCallback const& progress_callback ) const {
-  vw_out(DebugMessage, "mosaic") << "Generating masks..." << std::endl;
-  std::vector<Cache::Handle<GrassfireGenerator> > grassfires;
-  for( unsigned i=0; i<sources.size(); ++i )
-    grassfires.push_back( m_cache.insert( GrassfireGenerator( sourcerefs[i] ) ) );
-  for( unsigned p1=0; p1<sources.size(); ++p1 ) {
-    ImageView<float> mask = copy( *(grassfires[p1]) );
-    for( unsigned p2=0; p2<sources.size(); ++p2 ) {
-      if( p1 == p2 ) continue;
-      int ox = bboxes[p2].min().x() - bboxes[p1].min().x();
-      int oy = bboxes[p2].min().y() - bboxes[p1].min().y();
-      if( ! ( ox >= bboxes[p1].width() ||
-              oy >= bboxes[p1].height() ||
-              -ox >= bboxes[p2].width() ||
-              -oy >= bboxes[p2].height() ) )
-      {
-        ImageView<float> other = *grassfires[p2];
-        int left = std::max( ox, 0 );
-        int top = std::max( oy, 0 );
-        int right = std::min( bboxes[p2].width()+ox, bboxes[p1].width() );
-        int bottom = std::min( bboxes[p2].height()+oy, bboxes[p1].height() );
-        for( int j=top; j<bottom; ++j ) {
-          for( int i=left; i<right; ++i ) {
-            if( ( other(i-ox,j-oy) > mask(i,j) ) ||
-                ( other(i-ox,j-oy) == mask(i,j) && p2 > p1 ) )
-              mask(i,j) = 0;
-          }
-        }
-      }
-      progress_callback.report_fractional_progress( double(p1*(sources.size()+1)+p2+1), double((sources.size()+1)*sources.size()) );
-    }
-    mask = threshold( mask );
-    std::ostringstream filename;
-    filename << "mask." << p1 << ".png";
-    write_image( filename.str(), mask );
-    progress_callback.report_fractional_progress( double((p1+1)*(sources.size()+1)), double((sources.size()+1)*sources.size()) );
-  }
-  // report_finished() called by prepare(), so don't call it here
-}
-
-
-template <class PixelT>
-boost::shared_ptr<typename vw::mosaic::ImageComposite<PixelT>::Pyramid> vw::mosaic::ImageComposite<PixelT>::PyramidGenerator::generate() const {
-  vw_out(DebugMessage, "mosaic") << "ImageComposite generating pyramid " << m_index << std::endl;
-  boost::shared_ptr<Pyramid> ptr( new Pyramid );
-  ImageView<pixel_type> source = copy(*m_composite.sources[m_index]);
-  m_composite.sources[m_index].release();
-  m_composite.sources[m_index].deprioritize();
-
-  // This is sort of a kluge: the hole-filling algorithm currently
-  // doesn't cope well with partially-transparent source pixels.
-  if( m_composite.m_fill_holes ) source /= select_alpha_channel(source);
-
-  PositionedImage<pixel_type> image_high( m_composite.view_bbox.width(), m_composite.view_bbox.height(), source, m_composite.bboxes[m_index] );
-  PositionedImage<pixel_type> image_low = image_high.reduce();
-  ImageView<channel_type> mask_image;
-
-  std::ostringstream mask_filename;
-  mask_filename << "mask." << m_index << ".png";
-  read_image( mask_image, mask_filename.str() );
-  PositionedImage<channel_type> mask( m_composite.view_bbox.width(), m_composite.view_bbox.height(), mask_image, m_composite.bboxes[m_index] );
-
-  for( int l=0; l<m_composite.levels; ++l ) {
-    PositionedImage<pixel_type> diff = image_high;
-    if( l > 0 ) mask = mask.reduce();
-    if( l < m_composite.levels-1 ) {
-      PositionedImage<pixel_type> next_image_low = image_low.reduce();
-      image_low.unpremultiply();
-      diff.subtract_expanded( image_low );
-      image_high = image_low;
-      image_low = next_image_low;
-    }
-    diff *= mask;
-    ptr->images.push_back( diff );
-    ptr->masks.push_back( mask );
-  }
-  return ptr;
-}
-
-
 template <class PixelT>
 void vw::mosaic::ImageComposite<PixelT>::insert( ImageViewRef<pixel_type> const& image, int x, int y ) {
   sourcerefs.push_back( image );
-  sources.push_back( m_cache.insert( SourceGenerator( image ) ) );
-  alphas.push_back( m_cache.insert( AlphaGenerator( *this, pyramids.size() ) ) );
-  pyramids.push_back( m_cache.insert( PyramidGenerator( *this, pyramids.size() ) ) );
+  grassfires.push_back( m_cache.insert( GrassfireGenerator( image ) ) );
 
   int cols = image.cols(), rows = image.rows();
   BBox2i image_bbox( Vector2i(x, y), Vector2i(x+cols, y+rows) );
@@ -431,16 +343,15 @@ void vw::mosaic::ImageComposite<PixelT>::insert( ImageViewRef<pixel_type> const&
 template <class PixelT>
 void vw::mosaic::ImageComposite<PixelT>::prepare( vw::ProgressCallback const& progress_callback ) {
   // Translate bboxes to origin
-  for( unsigned i=0; i<sources.size(); ++i )
+  for( unsigned i=0; i<bboxes.size(); ++i )
     bboxes[i] -= view_bbox.min();
   data_bbox -= view_bbox.min();
 
   levels = (int) floorf( logf( float(mindim)/2.0f ) / logf(2.0f) ) - 1;
+  if( m_max_levels > 0 && levels > m_max_levels ) levels = m_max_levels;
   if( levels < 1 ) levels = 1;
 
-  if( !m_draft_mode && !m_reuse_masks ) {
-    generate_masks( progress_callback );
-  }
+  m_index.build( bboxes );
   progress_callback.report_finished();
 }
 
@@ -451,13 +362,49 @@ void vw::mosaic::ImageComposite<PixelT>::prepare( BBox2i const& total_bbox,
   prepare( progress_callback );
 }
 
-// Suppose a destination image patch at a given level of the pyramid
-// has a bounding box that begins at offset x and has width w.  It
-// is affected by a range of pixels at the next level of the pyramid
-// starting at x/2 with width (x+w)/2-x/2+1 = (w+x%2)/2+1.  This in
-// turn is affected by source image pixels at the current level in
-// the range starting at 2*(x/2)-1 = x-x%2-1 with width
-// (2*(x+w)/2+1)-(2*(x/2)-1)+1 = w-(x+w)%2+x%2+3.
+
+template <class PixelT>
+vw::ImageView<typename vw::mosaic::ImageComposite<PixelT>::channel_type>
+vw::mosaic::ImageComposite<PixelT>::blend_mask( uint32 p, BBox2i const& region ) const {
+  ImageView<float32> fire = crop( *grassfires[p], region - bboxes[p].min() );
+  grassfires[p].release();
+
+  // A source loses a pixel to any source further from its edge there,
+  // and ties go to the source inserted last.
+  std::vector<uint32> others;
+  m_index.find( bboxes, region, others );
+  for( size_t k=0; k<others.size(); ++k ) {
+    uint32 q = others[k];
+    if( q == p ) continue;
+    BBox2i overlap = region;
+    overlap.crop( bboxes[q] );
+    ImageView<float32> other = crop( *grassfires[q], overlap - bboxes[q].min() );
+    grassfires[q].release();
+    int ox = overlap.min().x() - region.min().x();
+    int oy = overlap.min().y() - region.min().y();
+    for( int j=0; j<overlap.height(); ++j ) {
+      for( int i=0; i<overlap.width(); ++i ) {
+        if( ( other(i,j) > fire(i+ox,j+oy) ) ||
+            ( other(i,j) == fire(i+ox,j+oy) && q > p ) )
+          fire(i+ox,j+oy) = 0;
+      }
+    }
+  }
+
+  ImageView<channel_type> mask( region.width(), region.height() );
+  for( int j=0; j<mask.rows(); ++j )
+    for( int i=0; i<mask.cols(); ++i )
+      mask(i,j) = fire(i,j) > 0 ? ChannelRange<channel_type>::max() : channel_type(0);
+  return mask;
+}
+
+
+// Each level of the blend pyramid covers the pixels that the
+// expansion of the level below it reads (bbox_pyr).  A source's
+// Laplacian pyramid is exact over that region if each of its levels
+// is computed over the blend region plus whatever the reduction to
+// the next level reads (source_pyr).  Everything outside the source
+// is zero, so only source_pyr[0] of the source is ever read.
 
 // Generates a full-resolution patch of the mosaic corresponding
 // to the given bounding box.
@@ -467,54 +414,81 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
   vw_out(DebugMessage, "mosaic") << "ImageComposite compositing patch " << patch_bbox << "..." << std::endl;
 #endif
   // Compute bboxes and allocate the pyramids
+  std::vector<Vector2i> level_size( 1, Vector2i( view_bbox.width(), view_bbox.height() ) );
   std::vector<BBox2i> bbox_pyr;
   std::vector<ImageView<pixel_type> > sum_pyr(levels);
   std::vector<ImageView<channel_type> > msum_pyr(levels);
   for( int l=0; l<levels; ++l ) {
     if( l==0 ) bbox_pyr.push_back( patch_bbox );
-    else bbox_pyr.push_back( BBox2i( Vector2i( bbox_pyr[l-1].min().x() / 2,
-                                               bbox_pyr[l-1].min().y() / 2 ),
-                                     Vector2i( bbox_pyr[l-1].min().x() / 2 + ( bbox_pyr[l-1].width() + bbox_pyr[l-1].min().x() % 2 ) / 2 + 1,
-                                               bbox_pyr[l-1].min().y() / 2 + ( bbox_pyr[l-1].height() + bbox_pyr[l-1].min().y() % 2 ) / 2 + 1) ) );
+    else {
+      bbox_pyr.push_back( BBox2i( Vector2i( bbox_pyr[l-1].min().x() / 2,
+                                            bbox_pyr[l-1].min().y() / 2 ),
+                                  Vector2i( bbox_pyr[l-1].min().x() / 2 + ( bbox_pyr[l-1].width() + bbox_pyr[l-1].min().x() % 2 ) / 2 + 1,
+                                            bbox_pyr[l-1].min().y() / 2 + ( bbox_pyr[l-1].height() + bbox_pyr[l-1].min().y() % 2 ) / 2 + 1) ) );
+      level_size.push_back( Vector2i( (level_size[l-1].x()+1)/2, (level_size[l-1].y()+1)/2 ) );
+    }
     sum_pyr [l] = ImageView<pixel_type  >( bbox_pyr[l].width(), bbox_pyr[l].height() );
     msum_pyr[l] = ImageView<channel_type>( bbox_pyr[l].width(), bbox_pyr[l].height() );
   }
-
-  // Compute the bounding box for source pixels that could
-  // impact the patch.
-  BBox2i padded_bbox = patch_bbox;
-  for( int l=0; l<levels-1; ++l ) {
-    padded_bbox.min().x() = padded_bbox.min().x()/2;
-    padded_bbox.min().y() = padded_bbox.min().y()/2;
-    padded_bbox.max().x() = padded_bbox.max().x()/2+1;
-    padded_bbox.max().y() = padded_bbox.max().y()/2+1;
-  }
-  for( int l=0; l<levels-1; ++l ) {
-    padded_bbox.min().x() = 2*padded_bbox.min().x()-1;
-    padded_bbox.min().y() = 2*padded_bbox.min().y()-1;
-    padded_bbox.max().x() = 2*padded_bbox.max().x();
-    padded_bbox.max().y() = 2*padded_bbox.max().y();
+  vw::detail::ReduceKernel kernel( GaussianReduceFilter );
+  std::vector<BBox2i> source_pyr( bbox_pyr );
+  for( int l=levels-2; l>=0; --l ) {
+    Vector2i xr = kernel.input_range( source_pyr[l+1].min().x(), source_pyr[l+1].max().x(), level_size[l].x() );
+    Vector2i yr = kernel.input_range( source_pyr[l+1].min().y(), source_pyr[l+1].max().y(), level_size[l].y() );
+    source_pyr[l].grow( BBox2i( Vector2i( xr[0], yr[0] ), Vector2i( xr[1], yr[1] ) ) );
   }
 
-  // Make a list of the images whose bounding boxes permit them to
-  // impact the patch, prioritizing ones that are already in memory.
-  std::list<unsigned> image_list;
-  for( unsigned p=0; p<sources.size(); ++p ) {
-    if( ! padded_bbox.intersects( bboxes[p] ) ) continue;
-    if( ! pyramids[p].valid() ) image_list.push_back( p );
-    else image_list.push_front( p );
-  }
+  // The maximal source alpha, for trimming the result.
+  ImageView<channel_type> alpha;
+  if( ! m_fill_holes ) alpha.set_size( patch_bbox.width(), patch_bbox.height() );
+
+  // Add the pyramid of each source that can impact the patch to the
+  // blend pyramid.
+  std::vector<uint32> image_list;
+  m_index.find( bboxes, source_pyr[0], image_list );
+  for( size_t k=0; k<image_list.size(); ++k ) {
+    uint32 p = image_list[k];
+    BBox2i region = source_pyr[0];
+    region.crop( bboxes[p] );
+    ImageView<pixel_type> source = crop( sourcerefs[p], region - bboxes[p].min() );
+
+    if( m_fill_holes ) {
+      // This is sort of a kluge: the hole-filling algorithm currently
+      // doesn't cope well with partially-transparent source pixels.
+      source /= select_alpha_channel(source);
+    }
+    else {
+      BBox2i overlap = patch_bbox;
+      overlap.crop( bboxes[p] );
+      ImageView<channel_type> source_alpha = select_alpha_channel( crop( source, overlap - region.min() ) );
+      int ox = overlap.min().x() - patch_bbox.min().x();
+      int oy = overlap.min().y() - patch_bbox.min().y();
+      for( int j=0; j<overlap.height(); ++j ) {
+        for( int i=0; i<overlap.width(); ++i ) {
+          if( source_alpha(i,j) > alpha(i+ox,j+oy) )
+            alpha(i+ox,j+oy) = source_alpha(i,j);
+        }
+      }
+    }
+
+    PositionedImage<pixel_type> image_high( level_size[0].x(), level_size[0].y(), source, region );
+    PositionedImage<pixel_type> image_low = image_high.reduce();
+    PositionedImage<channel_type> mask( level_size[0].x(), level_size[0].y(), blend_mask( p, region ), region );
 
-  // Add each source image pyramid to the blend pyramid.
-  std::list<unsigned>::iterator ili=image_list.begin(), ilend=image_list.end();
-  for( ; ili!=ilend; ++ili ) {
-    unsigned p = *ili;
-    boost::shared_ptr<Pyramid> pyr = pyramids[p];
     for( int l=0; l<levels; ++l ) {
-      pyr->images[l].addto( sum_pyr [l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
-      pyr->masks [l].addto( msum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
+      PositionedImage<pixel_type> diff = image_high;
+      if( l > 0 ) mask = mask.reduce();
+      if( l < levels-1 ) {
+        PositionedImage<pixel_type> next_image_low = image_low.reduce();
+        image_low.unpremultiply();
+        diff.subtract_expanded( image_low );
+        image_high = image_low;
+        image_low = next_image_low;
+      }
+      diff *= mask;
+      diff.addto( sum_pyr [l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
+      mask.addto( msum_pyr[l], bbox_pyr[l].min().x(), bbox_pyr[l].min().y() );
     }
-    pyramids[p].release();
   }
 
   // Collapse the pyramid
@@ -531,34 +505,10 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::blend_patch( BBox2i co
     msum_pyr.pop_back();
   }
 
-  if( m_fill_holes ) {
+  if( m_fill_holes )
     composite /= select_alpha_channel( composite );
-  }
-  else {
-
-    // Trim to the maximal source alpha, reloading images if needed
-    ImageView<channel_type> alpha( patch_bbox.width(), patch_bbox.height() );
-    for( unsigned p=0; p<sources.size(); ++p ) {
-      if( ! patch_bbox.intersects( bboxes[p] ) ) continue;
-
-      ImageView<channel_type> source_alpha = *alphas[p];
-      alphas[p].release();
-
-      BBox2i overlap = patch_bbox;
-      overlap.crop( bboxes[p] );
-      for( int j=0; j<overlap.height(); ++j ) {
-        for( int i=0; i<overlap.width(); ++i ) {
-          if( source_alpha( overlap.min().x()+i-bboxes[p].min().x(), overlap.min().y()+j-bboxes[p].min().y() ) >
-              alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) ) {
-            alpha( overlap.min().x()+i-patch_bbox.min().x(), overlap.min().y()+j-patch_bbox.min().y() ) =
-              source_alpha( overlap.min().x()+i-bboxes[p].min().x(), overlap.min().y()+j-bboxes[p].min().y() );
-          }
-        }
-      }
-    }
-
+  else
     composite *= alpha / select_alpha_channel( composite );
-  }
 
   return composite;
 }
@@ -573,9 +523,11 @@ vw::ImageView<PixelT> vw::mosaic::ImageComposite<PixelT>::draft_patch( BBox2i co
 #endif
   ImageView<pixel_type> composite(patch_bbox.width(),patch_bbox.height());
 
-  // Add each image to the composite.
-  for( unsigned p=0; p<sources.size(); ++p ) {
-    if( ! patch_bbox.intersects( bboxes[p] ) ) continue;
+  // Add each image to the composite, in the order they were inserted.
+  std::vector<uint32> image_list;
+  m_index.find( bboxes, patch_bbox, image_list );
+  for( size_t k=0; k<image_list.size(); ++k ) {
+    uint32 p = image_list[k];
     BBox2i bbox = patch_bbox;
     bbox.crop( bboxes[p] );
     PositionedImage<pixel_type> image( view_bbox.width(), view_bbox.height(),
@@ -19,7 +19,7 @@
 #include <vw/Mosaic/KMLQuadTreeConfig.h>
 
 #include <vw/Image/Transform.h>
-#include <vw/FileIO/DiskImageResourcePNG.h>
+#include <vw/Image/ImageResource.h>
 
 #include <iomanip>
 #include <sstream>
@@ -43,19 +43,27 @@ namespace vw {
   // rendering of semi-transparent GroundOverlays interpolates
   // alpha-masked (i.e. invalid) data, resulting in annoying (generally
   // black) fringes around semi-transparent images.
-  class DiskImageResourcePNGAlphaHack : public DiskImageResourcePNG {
+  //
+  // The PNG itself is written by the wrapped resource, which is a file
+  // or a tile in a tile archive.
+  class PNGAlphaHackResource : public DstImageResource {
+    boost::shared_ptr<DstImageResource> m_resource;
   public:
 
-    DiskImageResourcePNGAlphaHack( std::string const& filename, ImageFormat const& format ) : DiskImageResourcePNG(filename,format) {}
+    PNGAlphaHackResource( boost::shared_ptr<DstImageResource> const& resource ) : m_resource(resource) {}
+
+    virtual bool has_block_write () const { return false; }
+    virtual bool has_nodata_write() const { return false; }
+    virtual void flush() { m_resource->flush(); }
 
-    void write( ImageBuffer const& src, BBox2i const& bbox ) {
+    virtual void write( ImageBuffer const& src, BBox2i const& bbox ) {
       int levels = (int) floor(((std::min)(log((double)bbox.width()),log((double)bbox.height())))/log(2.));
       if( levels<2 || !src.format.premultiplied || !(src.format.pixel_format==VW_PIXEL_RGBA || src.format.pixel_format==VW_PIXEL_GRAYA) )
-        return DiskImageResourcePNG::write(src,bbox);
+        return m_resource->write(src,bbox);
 
       std::vector<ImageView<PixelRGBA<float> > > pyramid(levels);
       pyramid[0].set_size( bbox.width(), bbox.height() );
-      convert( pyramid[0].buffer(), src, m_rescale );
+      convert( pyramid[0].buffer(), src, true );
 
       std::vector<float> kernel(2);
       kernel[0] = kernel[1] = 0.5;
@@ -95,7 +103,7 @@ namespace vw {
 
       ImageBuffer buffer = pyramid[0].buffer();
       buffer.format.premultiplied = false;
-      DiskImageResourcePNG::write(buffer,bbox);
+      m_resource->write(buffer,bbox);
     }
   };
 
@@ -290,8 +298,10 @@ namespace mosaic {
     if( num_children == 0 ) max_lod = -1;
     int draw_order = m_draw_order_offset + int(info.name.size());
     BBox2i go_bbox = (qtree.get_crop_images() ? info.image_bbox : info.region_bbox);
-    if( exists( fs::path( info.filepath + info.filetype ) ) ) {
-      kml << kml_ground_overlay( file_path.filename().string() + info.filetype,
+    if( qtree.tile_exists( info ) ) {
+      // Archived tiles are referred to by their path in the archive.
+      std::string href = qtree.get_tile_archive() ? qtree.tile_path( info ) : file_path.filename().string() + info.filetype;
+      kml << kml_ground_overlay( href,
                                  pixels_to_longlat( info.region_bbox, qtree.get_dimensions() ),
                                  pixels_to_longlat( go_bbox, qtree.get_dimensions() ),
                                  draw_order, min_lod, max_lod );
@@ -307,6 +317,7 @@ namespace mosaic {
 
     // Skip this file if there aren't any real contents
     if( num_children != 0 ) {
+      create_directories( kml_path.parent_path() );
       fs::ofstream kmlfs( kml_path );
       kmlfs << kml.str();
     }
@@ -342,13 +353,13 @@ namespace mosaic {
     return children;
   }
 
-  boost::shared_ptr<DstImageResource> KMLQuadTreeConfigData::tile_resource_func( QuadTreeGenerator const&, QuadTreeGenerator::TileInfo const& info, ImageFormat const& format ) const {
-    create_directories( fs::path( info.filepath ).parent_path() );
+  boost::shared_ptr<DstImageResource> KMLQuadTreeConfigData::tile_resource_func( QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info, ImageFormat const& format ) const {
+    boost::shared_ptr<DstImageResource> resource = qtree.create_tile_resource( info, format );
     if( info.filetype == ".png" && (format.pixel_format==VW_PIXEL_RGBA || format.pixel_format==VW_PIXEL_GRAYA) ) {
-      return boost::shared_ptr<DstImageResource>( new DiskImageResourcePNGAlphaHack( info.filepath+info.filetype, format ) );
+      return boost::shared_ptr<DstImageResource>( new PNGAlphaHackResource( resource ) );
     }
     else {
-      return boost::shared_ptr<DstImageResource>( DiskImageResource::create( info.filepath+info.filetype, format ) );
+      return resource;
     }
   }
 
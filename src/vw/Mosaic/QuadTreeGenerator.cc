@@ -23,6 +23,9 @@
 namespace fs = boost::filesystem;
 
 #include <vw/FileIO/DiskImageResource.h>
+#include <vw/FileIO/MemoryImageResource.h>
+
+#include <boost/scoped_ptr.hpp>
 
 namespace vw {
 namespace mosaic {
@@ -79,11 +82,83 @@ namespace mosaic {
     return children;
   }
 
-  boost::shared_ptr<DstImageResource> QuadTreeGenerator::default_tile_resource_func::operator()( QuadTreeGenerator const&, TileInfo const& info, ImageFormat const& format ) {
+  boost::shared_ptr<DstImageResource> QuadTreeGenerator::default_tile_resource_func::operator()( QuadTreeGenerator const& qtree, TileInfo const& info, ImageFormat const& format ) {
+    return qtree.create_tile_resource( info, format );
+  }
+
+  namespace {
+    // Encodes a tile in memory, and adds it to a tile archive when it
+    // is flushed.
+    class ArchiveTileResource : public DstImageResource {
+      boost::shared_ptr<TileArchiveWriter>      m_archive;
+      boost::scoped_ptr<DstMemoryImageResource> m_resource;
+      int32 m_level;
+      Vector2i m_pos;
+      std::string m_filetype;
+      bool m_written;
+    public:
+      ArchiveTileResource( boost::shared_ptr<TileArchiveWriter> const& archive, int32 level, Vector2i const& pos,
+                           std::string const& filetype, ImageFormat const& format )
+        : m_archive( archive ), m_resource( DstMemoryImageResource::create( filetype, format ) ),
+          m_level( level ), m_pos( pos ), m_filetype( filetype ), m_written( false ) {}
+
+      virtual void write( ImageBuffer const& buf, BBox2i const& bbox ) {
+        m_resource->write( buf, bbox );
+        m_written = true;
+      }
+      virtual bool has_block_write () const { return false; }
+      virtual bool has_nodata_write() const { return false; }
+      virtual void flush() {
+        if( !m_written ) return;
+        m_resource->flush();
+        m_archive->add_tile( m_level, m_pos.x(), m_pos.y(), m_filetype, m_resource->data(), m_resource->size() );
+        m_written = false;
+      }
+    };
+  }
+
+  boost::shared_ptr<DstImageResource> QuadTreeGenerator::create_tile_resource( TileInfo const& info, ImageFormat const& format ) const {
+    if( m_tile_archive )
+      return boost::shared_ptr<DstImageResource>( new ArchiveTileResource( m_tile_archive, int32(info.name.size()),
+                                                                           tile_position( info.name ), info.filetype, format ) );
     create_directories( fs::path( info.filepath ).parent_path() );
     return boost::shared_ptr<DstImageResource>( DiskImageResource::create( info.filepath+info.filetype, format ) );
   }
 
+  bool QuadTreeGenerator::tile_exists( TileInfo const& info ) const {
+    if( m_tile_archive ) {
+      Vector2i pos = tile_position( info.name );
+      return m_tile_archive->has_tile( int32(info.name.size()), pos.x(), pos.y() );
+    }
+    return fs::exists( fs::path( info.filepath + info.filetype ) );
+  }
+
+  std::string QuadTreeGenerator::tile_path( TileInfo const& info ) const {
+    if( m_tile_archive ) {
+      Vector2i pos = tile_position( info.name );
+      fs::path path( m_tile_archive->filename() );
+      path /= tile_archive_path( int32(info.name.size()), pos.x(), pos.y(), info.filetype );
+      return path.string();
+    }
+    return info.filepath + info.filetype;
+  }
+
+  // Children 0-3 are the upper left, upper right, lower left and lower
+  // right quadrants, as made by default_branch_func.  KML's merged top
+  // and bottom halves, 4 and 5, take the places of 0 and 2.
+  Vector2i QuadTreeGenerator::tile_position( std::string const& name ) {
+    Vector2i pos(0,0);
+    for( size_t i=0; i<name.size(); ++i ) {
+      if( name[i] < '0' || name[i] > '5' )
+        vw_throw( LogicErr() << "QuadTreeGenerator: tile name \"" << name << "\" is not a standard quadtree name." );
+      int32 quadrant = name[i] - '0';
+      if( quadrant == 4 ) quadrant = 0;
+      if( quadrant == 5 ) quadrant = 2;
+      pos = 2*pos + Vector2i( quadrant & 1, quadrant >> 1 );
+    }
+    return pos;
+  }
+
   void QuadTreeGenerator::generate( const ProgressCallback &progress_callback ) {
     ScopedWatch sw("QuadTreeGenerator::generate");
     int32 tree_levels = get_tree_levels();
@@ -28,26 +28,40 @@
 #include <string>
 #include <fstream>
 
+#include <exception>
+
 #include <boost/function.hpp>
 
 #include <vw/Core/ProgressCallback.h>
 #include <vw/Core/Stopwatch.h>
+#include <vw/Core/ThreadPool.h>
 #include <vw/Image/EdgeExtension.h>
 #include <vw/Image/SparseImageCheck.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/Algorithms.h>
 #include <vw/Image/Filter.h>
+#include <vw/Image/AntiAliasing.h>
+#include <vw/Image/ImageIO.h>
+#include <vw/Mosaic/TileArchive.h>
 
 
 namespace vw {
 namespace mosaic {
 
-  // This feature, or something like it, should be implemented better and
-  // moved somewhere into the Image module.
-  /// ???
+  /// Average scale.x() by scale.y() blocks of an image.  Square
+  /// power-of-two scales, the usual case in a quadtree, go through the
+  /// streaming box reduction of reduce_view(), which also leaves invalid
+  /// pixels out of the average.
   template <class PixelT>
   ImageView<PixelT> box_subsample( ImageView<PixelT> const& image, Vector2i const& scale ) {
+    int32 levels = 0;
+    while( (1 << levels) < scale.x() )
+      ++levels;
+    if( levels > 0 && scale.x() == (1 << levels) && scale.y() == scale.x() &&
+        image.cols() % scale.x() == 0 && image.rows() % scale.y() == 0 && image.planes() == 1 )
+      return reduce_view( image, levels, BoxReduceFilter );
+
     std::vector<double> xkernel(scale.x()), ykernel(scale.y());
     for( int x=0; x<scale.x(); ++x ) 
       xkernel[x] = 1.0 / scale.x();
@@ -95,13 +109,16 @@ namespace mosaic {
         m_crop_bbox(),
         m_crop_images( false ),
         m_cull_images( false ),
+        m_num_threads( 0 ),
+        m_num_encoder_threads( 0 ),
         m_dimensions( image.impl().cols(), image.impl().rows() ),
         m_processor( new Processor<typename ImageT::pixel_type>( this, image.impl() ) ),
         m_image_path_func( simple_image_path() ),
         m_branch_func( default_branch_func() ),
         m_tile_resource_func( default_tile_resource_func() ),
         m_metadata_func(),
-        m_sparse_image_check( SparseImageCheck<ImageT>(image.impl()) )
+        m_sparse_image_check( SparseImageCheck<ImageT>(image.impl()) ),
+        m_tile_archive()
     {}
 
     virtual ~QuadTreeGenerator() {}
@@ -135,7 +152,10 @@ namespace mosaic {
     Vector2i    const& get_dimensions()  const { return m_dimensions;  }
     bool               get_crop_images() const { return m_crop_images; }
     bool               get_cull_images() const { return m_cull_images; }
+    int32              get_num_threads() const { return m_num_threads > 0 ? m_num_threads : vw_settings().default_num_threads(); }
+    int32      get_num_encoder_threads() const { return m_num_encoder_threads > 0 ? m_num_encoder_threads : vw_settings().default_num_threads(); }
     sparse_image_check_type const& sparse_image_check() const { return m_sparse_image_check; }
+    boost::shared_ptr<TileArchiveWriter> const& get_tile_archive() const { return m_tile_archive; }
 
 
     // Simple "set" functions
@@ -144,11 +164,21 @@ namespace mosaic {
     void set_tile_size         (int32                          size              ) {m_tile_size          = size;              }
     void set_crop_images       (bool                           crop              ) {m_crop_images        = crop;              }
     void set_cull_images       (bool                           cull              ) {m_cull_images        = cull;              }
+    /// Threads generating tiles, and threads compressing and writing
+    /// them.  Zero, the default, uses vw_settings().default_num_threads().
+    void set_num_threads       (int32                          threads           ) {m_num_threads        = threads;           }
+    void set_num_encoder_threads(int32                         threads           ) {m_num_encoder_threads = threads;          }
     void set_image_path_func   (image_path_func_type           image_path_func   ) {m_image_path_func    = image_path_func;   }
     void set_branch_func       (branch_func_type        const& branch_func       ) {m_branch_func        = branch_func;       }
     void set_tile_resource_func(tile_resource_func_type const& tile_resource_func) {m_tile_resource_func = tile_resource_func;}
     void set_metadata_func     (metadata_func_type             metadata_func     ) {m_metadata_func      = metadata_func;     }
     void set_sparse_image_check(sparse_image_check_type const& func              ) {m_sparse_image_check = func;              }
+    /// Write the tiles into a single archive file instead of one file
+    /// each.  Tile resource functions get their resources from
+    /// create_tile_resource(), which then encodes the tiles in memory
+    /// and adds them to the archive, and metadata functions refer to
+    /// the tiles by tile_path().
+    void set_tile_archive      (boost::shared_ptr<TileArchiveWriter> const& archive) {m_tile_archive = archive;           }
 
 
     std::string image_path( std::string const& name ) const {
@@ -163,6 +193,24 @@ namespace mosaic {
       return m_tile_resource_func( *this, info, format );
     }
 
+    /// Create the resource that a tile is written to: a new file at
+    /// info.filepath + info.filetype, or if there is a tile archive, a
+    /// memory resource which adds the tile to the archive when it is
+    /// flushed.  Custom tile resource functions should wrap this rather
+    /// than create files themselves.
+    boost::shared_ptr<DstImageResource> create_tile_resource( TileInfo const& info, ImageFormat const& format ) const;
+
+    /// Whether a tile has been written, either to its own file or to the tile archive.
+    bool tile_exists( TileInfo const& info ) const;
+
+    /// The path metadata should use to refer to a tile: its file, or
+    /// its path in the tile archive (see tile_archive_path()).
+    std::string tile_path( TileInfo const& info ) const;
+
+    /// The column and row of a tile within its level, from its name.
+    /// The level is the length of the name.
+    static Vector2i tile_position( std::string const& name );
+
     void make_tile_metadata( TileInfo const& info ) const {
       if( m_metadata_func ) {
         m_metadata_func( *this, info );
@@ -194,7 +242,7 @@ namespace mosaic {
       std::vector<std::pair<std::string,BBox2i> > operator()(QuadTreeGenerator const& qtree, std::string const& name, BBox2i const& region);
     };
 
-    /// The default resource function, creates standard disk image resources
+    /// The default resource function, returns create_tile_resource()
     struct default_tile_resource_func {
       boost::shared_ptr<DstImageResource> operator()( QuadTreeGenerator const& qtree, TileInfo const& info, ImageFormat const& format );
     };
@@ -202,57 +250,288 @@ namespace mosaic {
   protected:
   
     /// Secret class that contains all the high level tree generation logic
+    ///
+    /// The top of the tree is split into subtrees, which are generated
+    /// in parallel on a pool of threads; the few tiles above them are
+    /// then made on the calling thread.  Finished tiles are handed to a
+    /// second pool that compresses and writes them, so generating tiles
+    /// never waits on the encoders unless too many tiles are queued.
     template <class PixelT>
     class Processor : public ProcessorBase {
+
+      /// A generated tile, and the task that writes it (if any).
+      struct Branch {
+        ImageView<PixelT> image;
+        boost::shared_ptr<Task> written;
+      };
+
+      /// Writes one tile and then its metadata.  Metadata may look at
+      /// the children's files (KML does), so it first waits for the
+      /// children's tasks.  These were queued earlier, so in a FIFO
+      /// queue they have always been started by the time this runs.
+      class WriteTileTask : public Task {
+        Processor& m_processor;
+        TileInfo m_info;
+        ImageView<PixelT> m_image;
+        std::vector<boost::shared_ptr<Task> > m_children;
+      public:
+        WriteTileTask( Processor& processor, TileInfo const& info, ImageView<PixelT> const& image,
+                       std::vector<boost::shared_ptr<Task> > const& children )
+          : m_processor(processor), m_info(info), m_image(image), m_children(children) {}
+
+        virtual void operator()() {
+          try {
+            for( size_t i=0; i<m_children.size(); ++i )
+              m_children[i]->join();
+            QuadTreeGenerator* qtree = m_processor.qtree;
+            if( m_image.is_valid_image() ) {
+              ScopedWatch sw("QuadTreeGenerator::write_tile");
+              boost::shared_ptr<DstImageResource> r = qtree->m_tile_resource_func( *qtree, m_info, m_image.format() );
+              write_image( *r, m_image );
+              r->flush(); // Archived tiles are stored here
+            }
+            // Call function to take care of any extra tile metadata tasks
+            if( qtree->m_metadata_func )
+              qtree->m_metadata_func( *qtree, m_info );
+          }
+          catch( ... ) {
+            m_processor.record_error();
+          }
+          m_processor.finish_write();
+        }
+      };
+
+      /// Generates one subtree on a worker thread.
+      class SubtreeTask : public Task {
+        Processor& m_processor;
+        std::string m_name;
+        BBox2i m_region_bbox;
+      public:
+        Branch result;
+        double area;
+        SubtreeTask( Processor& processor, std::string const& name, BBox2i const& region_bbox, double area )
+          : m_processor(processor), m_name(name), m_region_bbox(region_bbox), area(area) {}
+
+        std::string const& name() const { return m_name; }
+
+        virtual void operator()() {
+          try {
+            result = m_processor.generate_branch( m_name, m_region_bbox, ProgressCallback::dummy_instance() );
+          }
+          catch( ... ) {
+            m_processor.record_error();
+          }
+        }
+      };
+
       ImageViewRef<PixelT> m_source;
+      FifoWorkQueue*       m_writer;         ///< The encoder pool, while generate() runs
+      Mutex                m_mutex;          ///< Guards the members below
+      Condition            m_write_done;
+      int32                m_pending_writes, m_max_pending_writes;
+      std::exception_ptr   m_error;
+      bool                 m_abort;
+      std::map<std::string, Branch> m_subtrees; ///< Subtrees generated by the worker pool
+
+      void record_error() {
+        Mutex::Lock lock(m_mutex);
+        if( ! m_error ) m_error = std::current_exception();
+        m_abort = true;
+      }
+
+      bool aborted() {
+        Mutex::Lock lock(m_mutex);
+        return m_abort;
+      }
+
+      void finish_write() {
+        Mutex::Lock lock(m_mutex);
+        --m_pending_writes;
+        m_write_done.notify_all();
+      }
+
+      /// Queue a tile to be written, waiting first if too many already are.
+      boost::shared_ptr<Task> queue_write( TileInfo const& info, ImageView<PixelT> const& image,
+                                           std::vector<boost::shared_ptr<Task> > const& children ) {
+        boost::shared_ptr<Task> task( new WriteTileTask( *this, info, image, children ) );
+        {
+          Mutex::Lock lock(m_mutex);
+          while( m_pending_writes >= m_max_pending_writes )
+            m_write_done.wait( lock );
+          ++m_pending_writes;
+        }
+        m_writer->add_task( task );
+        return task;
+      }
+
+      /// Whether a branch has any data to generate.
+      bool has_data( BBox2i const& region_bbox ) const {
+        BBox2i image_bbox = region_bbox;
+        image_bbox.crop( crop_bbox() );
+        if( image_bbox.empty() )
+          return ! (qtree->get_crop_images() || qtree->get_cull_images());
+        return ! qtree->m_sparse_image_check || qtree->m_sparse_image_check(region_bbox);
+      }
+
+      /// Whether a branch is small enough to rasterize its source at once.
+      bool prefetch_size( BBox2i const& region_bbox ) const {
+        return region_bbox.width () <= 4*qtree->m_tile_size &&
+               region_bbox.height() <= 4*qtree->m_tile_size;
+      }
+
+      BBox2i crop_bbox() const {
+        BBox2i crop_bbox(Vector2i(), qtree->get_dimensions());
+        if( ! qtree->get_crop_bbox().empty() )
+          crop_bbox.crop( qtree->get_crop_bbox() );
+        return crop_bbox;
+      }
 
     public:
       /// Construct the image with the qtree object and the full resolution source image
       template <class ImageT>
       Processor( QuadTreeGenerator *qtree, ImageT const& source )
-        : ProcessorBase( qtree ), m_source( source )
+        : ProcessorBase( qtree ), m_source( source ), m_writer( 0 ),
+          m_pending_writes( 0 ), m_max_pending_writes( 0 ), m_abort( false )
       {}
 
       /// Top level call to generate a qtree from a specified region of the input image.
       void generate( BBox2i const& region_bbox, const ProgressCallback &progress_callback ) {
-        // Just redirect to the branch function leaving the name blank.
-        generate_branch( "", region_bbox, progress_callback );
+        int32 num_threads = qtree->get_num_threads(), num_encoder_threads = qtree->get_num_encoder_threads();
+        FifoWorkQueue writer( num_encoder_threads );
+        m_writer = &writer;
+        m_max_pending_writes = 4 * (num_threads + num_encoder_threads);
+        m_pending_writes = 0;
+        m_error = std::exception_ptr();
+        m_abort = false;
+        m_subtrees.clear();
+
+        // Split the top of the tree breadth-first until there are enough
+        // subtrees to keep the workers busy, dropping empty branches.
+        // Branches small enough to be prefetched are not split, so each
+        // prefetch is made exactly as it would be on one thread.
+        std::vector<std::pair<std::string,BBox2i> > frontier( 1, std::make_pair( std::string(), region_bbox ) );
+        if( num_threads > 1 ) {
+          while( int32(frontier.size()) < 4*num_threads ) {
+            std::vector<std::pair<std::string,BBox2i> > next;
+            bool split = false;
+            for( size_t i=0; i<frontier.size(); ++i ) {
+              std::vector<std::pair<std::string,BBox2i> > children;
+              if( ! prefetch_size( frontier[i].second ) )
+                children = qtree->m_branch_func( *qtree, frontier[i].first, frontier[i].second );
+              if( children.empty() ) {
+                next.push_back( frontier[i] );
+                continue;
+              }
+              split = true;
+              for( size_t c=0; c<children.size(); ++c )
+                if( has_data( children[c].second ) )
+                  next.push_back( children[c] );
+            }
+            if( ! split ) break;
+            frontier.swap( next );
+          }
+        }
+
+        progress_callback.report_progress(0);
+        if( frontier.size() > 1 || ( ! frontier.empty() && ! frontier[0].first.empty() ) ) {
+          FifoWorkQueue workers( num_threads );
+          std::vector<boost::shared_ptr<SubtreeTask> > tasks;
+          double total_area = 0, done_area = 0;
+          for( size_t i=0; i<frontier.size(); ++i ) {
+            BBox2i image_bbox = frontier[i].second;
+            image_bbox.crop( crop_bbox() );
+            tasks.push_back( boost::shared_ptr<SubtreeTask>( new SubtreeTask( *this, frontier[i].first, frontier[i].second,
+                                                                              double(image_bbox.width()) * image_bbox.height() ) ) );
+            total_area += tasks.back()->area;
+            workers.add_task( tasks.back() );
+          }
+          for( size_t i=0; i<tasks.size(); ++i ) {
+            tasks[i]->join();
+            done_area += tasks[i]->area;
+            progress_callback.report_fractional_progress( done_area, total_area );
+            if( progress_callback.abort_requested() ) {
+              Mutex::Lock lock(m_mutex);
+              m_abort = true;
+            }
+          }
+          workers.join_all();
+          for( size_t i=0; i<tasks.size(); ++i )
+            m_subtrees[tasks[i]->name()] = tasks[i]->result;
+        }
+
+        // Make the top of the tree from the subtrees.
+        try {
+          if( ! aborted() )
+            generate_branch( "", region_bbox, ProgressCallback::dummy_instance() );
+        }
+        catch( ... ) {
+          record_error();
+        }
+        m_subtrees.clear();
+        writer.join_all();
+        m_writer = 0;
+
+        if( m_error )
+          std::rethrow_exception( m_error );
+        progress_callback.abort_if_requested();
+        progress_callback.report_progress(1);
       }
 
       /// Generate all images and metadata files (all the way down the tree) for a named region of the input image.
       /// - Note that region_bbox is always in the original source image, not the parent of this particular branch.
-      ImageView<PixelT> generate_branch( std::string const& name, BBox2i const& region_bbox, const ProgressCallback &progress_callback ) {
+      /// - If source is given it holds the source pixels of source_bbox, which covers this branch.
+      Branch generate_branch( std::string const& name, BBox2i const& region_bbox, const ProgressCallback &progress_callback,
+                              ImageView<PixelT> const* source = 0, BBox2i const& source_bbox = BBox2i() ) {
         progress_callback.report_progress(0);
         progress_callback.abort_if_requested();
+        if( aborted() )
+          vw_throw( Aborted() << "QuadTreeGenerator: tile generation stopped." );
 
-        ImageView<PixelT> image;
+        typename std::map<std::string, Branch>::const_iterator subtree = m_subtrees.find( name );
+        if( subtree != m_subtrees.end() )
+          return subtree->second;
+
+        Branch branch;
+        ImageView<PixelT>& image = branch.image;
         TileInfo info;
         info.name = name;
         info.region_bbox = region_bbox;
-
-        BBox2i crop_bbox(Vector2i(), qtree->get_dimensions());
-        if( ! qtree->get_crop_bbox().empty() ) 
-          crop_bbox.crop( qtree->get_crop_bbox() );
         info.image_bbox = info.region_bbox;
-        info.image_bbox.crop( crop_bbox );
+        info.image_bbox.crop( crop_bbox() );
 
         if( info.image_bbox.empty() ) {
           if( ! (qtree->get_crop_images() || qtree->get_cull_images()) )
             image.set_size( qtree->get_tile_size(), qtree->get_tile_size() );
-          return image;
+          return branch;
         }
 
         if( qtree->m_sparse_image_check && ! qtree->m_sparse_image_check(info.region_bbox) ) 
-            return image;
+            return branch;
 
         Vector2i scale = info.region_bbox.size() / qtree->m_tile_size;
 
         // Call function to compute which children belong to this tile.
         // - Each child contains a name and a bounding box.
         std::vector<std::pair<std::string, BBox2i> > children = qtree->m_branch_func(*qtree, info.name, info.region_bbox);
+
+        // Once a branch is small enough, rasterize its source pixels in
+        // one go rather than one leaf tile at a time.
+        ImageView<PixelT> prefetched;
+        if( ! source && ! children.empty() && prefetch_size( info.region_bbox ) ) {
+          prefetched = crop( m_source, info.image_bbox );
+          // Culled tiles are never written, so a transparent branch is done.
+          if( qtree->m_cull_images && PixelHasAlpha<PixelT>::value && is_transparent( prefetched ) )
+            return branch;
+          source = &prefetched;
+        }
+        BBox2i prefetched_bbox = prefetched.is_valid_image() ? info.image_bbox : source_bbox;
         
+        std::vector<boost::shared_ptr<Task> > child_writes;
         if( children.empty() ) { // This is the highest resolution level of tiles (bottom of tree)
-          image = crop( m_source, info.image_bbox ); // Extract portion of source image
+          if( source ) // Extract portion of source image
+            image = crop( *source, info.image_bbox - prefetched_bbox.min() );
+          else
+            image = crop( m_source, info.image_bbox );
           if( info.image_bbox != info.region_bbox ) { // Pad with zero pixels if needed
             image = edge_extend( image, info.region_bbox - info.image_bbox.min(), ZeroEdgeExtension() );
           }
@@ -276,12 +555,14 @@ namespace mosaic {
             double child_area = (double) image_bbox.width() * image_bbox.height();
             double progress   = progress_callback.progress();
             SubProgressCallback spc( progress_callback, progress, progress + child_area/total_area );
-            ImageView<PixelT> child = generate_branch(children[i].first, children[i].second, spc); // (name, BBox, callback)
-            if( ! child.is_valid_image() ) 
+            Branch child = generate_branch(children[i].first, children[i].second, spc, source, prefetched_bbox); // (name, BBox, callback)
+            if( child.written )
+              child_writes.push_back( child.written );
+            if( ! child.image.is_valid_image() ) 
               continue;
             
-            BBox2i dst_bbox = elem_quot( children[i].second - info.region_bbox.min(), scale );            // Compute this child's ROI in the current tile.
-            crop(image,dst_bbox) = box_subsample( child, elem_quot(qtree->m_tile_size,dst_bbox.size()) ); // Copy and resample the child image to the destination ROI
+            BBox2i dst_bbox = elem_quot( children[i].second - info.region_bbox.min(), scale );                  // Compute this child's ROI in the current tile.
+            crop(image,dst_bbox) = box_subsample( child.image, elem_quot(qtree->m_tile_size,dst_bbox.size()) ); // Copy and resample the child image to the destination ROI
           }
         }
 
@@ -315,19 +596,17 @@ namespace mosaic {
           info.filetype = "." + qtree->m_file_type;
         }
 
-        // Retrieve the output path for this tile and write it to disk
+        // Retrieve the output path for this tile and queue it to be
+        // written, along with its metadata.  Only metadata needs to wait
+        // for the children.
         info.filepath = qtree->m_image_path_func( *qtree, info.name );
-        if( cropped_image.is_valid_image() ) {
-          ScopedWatch sw("QuadTreeGenerator::write_tile");
-          boost::shared_ptr<DstImageResource> r = qtree->m_tile_resource_func( *qtree, info, cropped_image.format() );
-          write_image( *r, cropped_image );
-        }
-        // Call function to take care of any extra tile metadata tasks
-        if( qtree->m_metadata_func ) 
-          qtree->m_metadata_func( *qtree, info );
+        if( qtree->m_metadata_func )
+          branch.written = queue_write( info, cropped_image, child_writes );
+        else if( cropped_image.is_valid_image() )
+          branch.written = queue_write( info, cropped_image, std::vector<boost::shared_ptr<Task> >() );
 
         progress_callback.report_progress(1);
-        return image;
+        return branch;
       }
     }; // End class Processor
 
@@ -340,6 +619,8 @@ namespace mosaic {
     BBox2i      m_crop_bbox;
     bool        m_crop_images;
     bool        m_cull_images;
+    int32       m_num_threads;
+    int32       m_num_encoder_threads;
     Vector2i    m_dimensions;
     boost::shared_ptr<ProcessorBase> m_processor;
 
@@ -349,6 +630,8 @@ namespace mosaic {
     tile_resource_func_type m_tile_resource_func;
     metadata_func_type      m_metadata_func;
     sparse_image_check_type m_sparse_image_check;
+
+    boost::shared_ptr<TileArchiveWriter> m_tile_archive;
   };
 
 } // namespace mosaic
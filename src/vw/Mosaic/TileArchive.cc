@@ -0,0 +1,348 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <vw/Mosaic/TileArchive.h>
+#include <vw/Core/Exception.h>
+#include <vw/Core/Log.h>
+#include <vw/FileIO/MemoryImageResource.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include <boost/shared_array.hpp>
+
+namespace vw {
+namespace mosaic {
+
+namespace {
+
+  const char   archive_magic[4] = { 'V', 'W', 'T', 'A' };
+  const uint32 archive_version  = 1;
+  const uint64 header_size      = 8;
+  const uint64 footer_size      = 12;
+  const uint64 entry_size       = 32;
+
+  void put_u32( std::string& buf, uint32 v ) {
+    for( int i=0; i<4; ++i ) buf += char( (v >> (8*i)) & 0xff );
+  }
+
+  void put_u64( std::string& buf, uint64 v ) {
+    for( int i=0; i<8; ++i ) buf += char( (v >> (8*i)) & 0xff );
+  }
+
+  uint32 get_u32( uint8 const* p ) {
+    uint32 v = 0;
+    for( int i=3; i>=0; --i ) v = (v << 8) | p[i];
+    return v;
+  }
+
+  uint64 get_u64( uint8 const* p ) {
+    uint64 v = 0;
+    for( int i=7; i>=0; --i ) v = (v << 8) | p[i];
+    return v;
+  }
+
+  // 64-bit FNV-1a, used only to find candidate duplicates.
+  uint64 content_hash( uint8 const* data, size_t size ) {
+    uint64 h = 14695981039346656037ULL;
+    for( size_t i=0; i<size; ++i ) {
+      h ^= data[i];
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
+  struct SameTile {
+    bool operator()( TileArchiveEntry const& a, TileArchiveEntry const& b ) const {
+      return a.level == b.level && a.x == b.x && a.y == b.y;
+    }
+  };
+
+} // namespace
+
+  // ---------------------------------------------------------------------
+  // TileArchiveWriter
+  // ---------------------------------------------------------------------
+
+  TileArchiveWriter::TileArchiveWriter( std::string const& filename )
+    : m_filename( filename ), m_end( header_size ), m_unique( 0 ) {
+    m_file.open( filename.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc );
+    if( !m_file.is_open() )
+      vw_throw( IOErr() << "TileArchiveWriter: could not create \"" << filename << "\"." );
+    std::string header( archive_magic, 4 );
+    put_u32( header, archive_version );
+    m_file.write( header.data(), header.size() );
+    if( !m_file )
+      vw_throw( IOErr() << "TileArchiveWriter: could not write to \"" << filename << "\"." );
+  }
+
+  TileArchiveWriter::~TileArchiveWriter() {
+    try {
+      close();
+    } catch( const std::exception& e ) {
+      vw_out(ErrorMessage) << "TileArchiveWriter: " << e.what() << "\n";
+    }
+  }
+
+  std::string tile_archive_path( int32 level, int32 x, int32 y, std::string const& filetype ) {
+    std::ostringstream oss;
+    oss << level << "/" << x << "/" << y;
+    if( !filetype.empty() && filetype[0] != '.' ) oss << ".";
+    oss << filetype;
+    return oss.str();
+  }
+
+  uint32 TileArchiveWriter::type_index( std::string const& filetype ) {
+    std::string type = filetype;
+    if( !type.empty() && type[0] == '.' ) type.erase( 0, 1 );
+    std::vector<std::string>::iterator it = std::find( m_types.begin(), m_types.end(), type );
+    if( it != m_types.end() ) return uint32( it - m_types.begin() );
+    m_types.push_back( type );
+    return uint32( m_types.size() - 1 );
+  }
+
+  void TileArchiveWriter::add_tile( int32 level, int32 x, int32 y, std::string const& filetype,
+                                    uint8 const* data, size_t size ) {
+    uint64 hash = content_hash( data, size );
+
+    Mutex::Lock lock( m_mutex );
+    if( !m_file.is_open() )
+      vw_throw( LogicErr() << "TileArchiveWriter: \"" << m_filename << "\" has already been closed." );
+
+    TileArchiveEntry entry;
+    entry.level = level;
+    entry.x     = x;
+    entry.y     = y;
+    entry.type  = type_index( filetype );
+    entry.size  = size;
+
+    // Look for an identical tile that has already been stored.  The hash
+    // only nominates candidates; the bytes themselves are compared.
+    bool found = false;
+    typedef std::multimap<uint64, size_t>::const_iterator iter_type;
+    std::pair<iter_type, iter_type> range = m_blobs.equal_range( hash );
+    std::vector<char> stored;
+    for( iter_type it = range.first; it != range.second && !found; ++it ) {
+      TileArchiveEntry const& other = m_entries[it->second];
+      if( other.size != size || other.type != entry.type ) continue;
+      if( size == 0 ) {
+        entry.offset = other.offset;
+        found = true;
+        break;
+      }
+      stored.resize( size );
+      m_file.seekg( other.offset );
+      m_file.read( &stored[0], size );
+      if( !m_file )
+        vw_throw( IOErr() << "TileArchiveWriter: could not read back from \"" << m_filename << "\"." );
+      if( std::memcmp( &stored[0], data, size ) == 0 ) {
+        entry.offset = other.offset;
+        found = true;
+      }
+    }
+
+    if( !found ) {
+      entry.offset = m_end;
+      m_file.seekp( m_end );
+      m_file.write( reinterpret_cast<const char*>( data ), size );
+      if( !m_file )
+        vw_throw( IOErr() << "TileArchiveWriter: could not write to \"" << m_filename << "\"." );
+      m_end += size;
+      m_blobs.insert( std::make_pair( hash, m_entries.size() ) );
+      ++m_unique;
+    }
+    m_entries.push_back( entry );
+    m_keys.insert( entry );
+  }
+
+  bool TileArchiveWriter::has_tile( int32 level, int32 x, int32 y ) const {
+    TileArchiveEntry key;
+    key.level = level;
+    key.x     = x;
+    key.y     = y;
+    Mutex::Lock lock( m_mutex );
+    return m_keys.count( key ) != 0;
+  }
+
+  size_t TileArchiveWriter::num_tiles() const {
+    Mutex::Lock lock( m_mutex );
+    return m_keys.size();
+  }
+
+  size_t TileArchiveWriter::num_unique_tiles() const {
+    Mutex::Lock lock( m_mutex );
+    return m_unique;
+  }
+
+  void TileArchiveWriter::close() {
+    Mutex::Lock lock( m_mutex );
+    if( !m_file.is_open() ) return;
+
+    // Sort the index, keeping only the last tile written at each
+    // position.  The sort is stable, so reversing first puts the most
+    // recent duplicate at the front of each run for unique() to keep.
+    std::vector<TileArchiveEntry> entries( m_entries.rbegin(), m_entries.rend() );
+    std::stable_sort( entries.begin(), entries.end() );
+    entries.erase( std::unique( entries.begin(), entries.end(), SameTile() ), entries.end() );
+
+    std::string index;
+    put_u32( index, uint32( m_types.size() ) );
+    for( size_t i=0; i<m_types.size(); ++i ) {
+      put_u32( index, uint32( m_types[i].size() ) );
+      index += m_types[i];
+    }
+    put_u64( index, entries.size() );
+    for( size_t i=0; i<entries.size(); ++i ) {
+      put_u32( index, uint32( entries[i].level ) );
+      put_u32( index, uint32( entries[i].x ) );
+      put_u32( index, uint32( entries[i].y ) );
+      put_u32( index, entries[i].type );
+      put_u64( index, entries[i].offset );
+      put_u64( index, entries[i].size );
+    }
+    put_u64( index, m_end );
+    index.append( archive_magic, 4 );
+
+    m_file.seekp( m_end );
+    m_file.write( index.data(), index.size() );
+    m_file.close();
+    if( m_file.fail() )
+      vw_throw( IOErr() << "TileArchiveWriter: could not write the index of \"" << m_filename << "\"." );
+  }
+
+  // ---------------------------------------------------------------------
+  // TileArchiveReader
+  // ---------------------------------------------------------------------
+
+  TileArchiveReader::TileArchiveReader( std::string const& filename )
+    : m_filename( filename ) {
+    m_file.open( filename.c_str(), std::ios::in | std::ios::binary );
+    if( !m_file.is_open() )
+      vw_throw( IOErr() << "TileArchiveReader: could not open \"" << filename << "\"." );
+
+    m_file.seekg( 0, std::ios::end );
+    uint64 file_size = m_file.tellg();
+    if( file_size < header_size + footer_size )
+      vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" is too short to be a tile archive." );
+
+    uint8 header[header_size], footer[footer_size];
+    m_file.seekg( 0 );
+    m_file.read( reinterpret_cast<char*>( header ), header_size );
+    m_file.seekg( file_size - footer_size );
+    m_file.read( reinterpret_cast<char*>( footer ), footer_size );
+    if( !m_file || std::memcmp( header, archive_magic, 4 ) != 0
+                || std::memcmp( footer + 8, archive_magic, 4 ) != 0 )
+      vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" is not a tile archive." );
+    if( get_u32( header + 4 ) != archive_version )
+      vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has unsupported version "
+                << get_u32( header + 4 ) << "." );
+
+    uint64 index_offset = get_u64( footer );
+    if( index_offset < header_size || index_offset > file_size - footer_size )
+      vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has a corrupt index offset." );
+
+    std::vector<uint8> index( file_size - footer_size - index_offset );
+    m_file.seekg( index_offset );
+    if( !index.empty() )
+      m_file.read( reinterpret_cast<char*>( &index[0] ), index.size() );
+    if( !m_file )
+      vw_throw( IOErr() << "TileArchiveReader: could not read the index of \"" << filename << "\"." );
+
+    size_t pos = 0;
+    const size_t end = index.size();
+    if( end < 4 ) vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has a truncated index." );
+    uint32 num_types = get_u32( &index[pos] ); pos += 4;
+    for( uint32 i=0; i<num_types; ++i ) {
+      if( end - pos < 4 ) vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has a truncated index." );
+      uint32 len = get_u32( &index[pos] ); pos += 4;
+      if( end - pos < len ) vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has a truncated index." );
+      m_types.push_back( std::string( reinterpret_cast<const char*>( &index[pos] ), len ) );
+      pos += len;
+    }
+    if( end - pos < 8 ) vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has a truncated index." );
+    uint64 count = get_u64( &index[pos] ); pos += 8;
+    if( (end - pos) / entry_size < count )
+      vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has a truncated index." );
+
+    m_entries.resize( count );
+    for( uint64 i=0; i<count; ++i, pos += entry_size ) {
+      TileArchiveEntry& e = m_entries[i];
+      e.level  = int32( get_u32( &index[pos] ) );
+      e.x      = int32( get_u32( &index[pos+4] ) );
+      e.y      = int32( get_u32( &index[pos+8] ) );
+      e.type   = get_u32( &index[pos+12] );
+      e.offset = get_u64( &index[pos+16] );
+      e.size   = get_u64( &index[pos+24] );
+      if( e.type >= m_types.size() || e.offset > index_offset || e.size > index_offset - e.offset )
+        vw_throw( IOErr() << "TileArchiveReader: \"" << filename << "\" has a corrupt index entry." );
+    }
+  }
+
+  TileArchiveEntry const* TileArchiveReader::find( int32 level, int32 x, int32 y ) const {
+    TileArchiveEntry key;
+    key.level = level;
+    key.x     = x;
+    key.y     = y;
+    std::vector<TileArchiveEntry>::const_iterator it =
+      std::lower_bound( m_entries.begin(), m_entries.end(), key );
+    if( it == m_entries.end() || !SameTile()( *it, key ) ) return 0;
+    return &*it;
+  }
+
+  bool TileArchiveReader::read_tile( int32 level, int32 x, int32 y, std::vector<uint8>& data,
+                                     std::string* filetype ) const {
+    TileArchiveEntry const* entry = find( level, x, y );
+    if( !entry ) return false;
+    data.resize( entry->size );
+    if( filetype ) *filetype = m_types[entry->type];
+    if( entry->size == 0 ) return true;
+
+    Mutex::Lock lock( m_mutex );
+    m_file.clear();
+    m_file.seekg( entry->offset );
+    m_file.read( reinterpret_cast<char*>( &data[0] ), entry->size );
+    if( !m_file )
+      vw_throw( IOErr() << "TileArchiveReader: could not read a tile from \"" << m_filename << "\"." );
+    return true;
+  }
+
+  bool TileArchiveReader::read_tile( std::string const& path, std::vector<uint8>& data,
+                                     std::string* filetype ) const {
+    int32 level, x, y;
+    char slash1, slash2;
+    std::istringstream iss( path );
+    if( !( iss >> level >> slash1 >> x >> slash2 >> y ) || slash1 != '/' || slash2 != '/' )
+      return false;
+    return read_tile( level, x, y, data, filetype );
+  }
+
+  boost::shared_ptr<SrcImageResource> TileArchiveReader::open_tile( int32 level, int32 x, int32 y ) const {
+    std::vector<uint8> data;
+    std::string type;
+    if( !read_tile( level, x, y, data, &type ) )
+      vw_throw( ArgumentErr() << "TileArchiveReader: \"" << m_filename << "\" has no tile at level "
+                << level << " (" << x << "," << y << ")." );
+    boost::shared_array<uint8> buffer( new uint8[data.size()] );
+    std::copy( data.begin(), data.end(), buffer.get() );
+    return boost::shared_ptr<SrcImageResource>(
+      SrcMemoryImageResource::open( type, boost::shared_array<const uint8>( buffer ), data.size() ) );
+  }
+
+} // namespace mosaic
+} // namespace vw
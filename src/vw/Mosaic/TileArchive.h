@@ -0,0 +1,153 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+/// \file TileArchive.h
+///
+/// A single-file container for the tiles of a quadtree, so that a
+/// large tree does not need one file per tile.
+///
+/// The file holds a header, the encoded tiles in the order they were
+/// added, an index sorted by (level, y, x), and a footer locating the
+/// index.  All integers are little-endian.
+///
+///   header:  "VWTA", uint32 version
+///   tiles:   the encoded bytes of each distinct tile
+///   index:   uint32 number of file types, each as uint32 length + chars
+///            uint64 number of tiles, each as int32 level, int32 x,
+///            int32 y, uint32 file type, uint64 offset, uint64 size
+///   footer:  uint64 offset of the index, "VWTA"
+///
+/// Identical tiles (blank ones, for example) are stored once and share
+/// an offset.
+///
+#ifndef __VW_MOSAIC_TILEARCHIVE_H__
+#define __VW_MOSAIC_TILEARCHIVE_H__
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <map>
+#include <set>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <vw/Core/FundamentalTypes.h>
+#include <vw/Core/Thread.h>
+#include <vw/Image/ImageResource.h>
+
+namespace vw {
+namespace mosaic {
+
+  /// The location of one tile in a TileArchive.
+  struct TileArchiveEntry {
+    int32  level, x, y;
+    uint32 type;   ///< Index into the archive's list of file types
+    uint64 offset, size;
+
+    bool operator<( TileArchiveEntry const& other ) const {
+      if( level != other.level ) return level < other.level;
+      if( y     != other.y     ) return y     < other.y;
+      return x < other.x;
+    }
+  };
+
+  /// The path of a tile within an archive, "level/x/y.type".  Metadata
+  /// refers to archived tiles by this path, appended to the archive's
+  /// filename, and TileArchiveReader::read_tile() accepts it.
+  std::string tile_archive_path( int32 level, int32 x, int32 y, std::string const& filetype );
+
+  /// Appends tiles to a new archive file.  add_tile() may be called
+  /// from several threads at once.  The index is written by close(),
+  /// which the destructor calls if needed.
+  class TileArchiveWriter : private boost::noncopyable {
+    std::string    m_filename;
+    std::fstream   m_file;
+    uint64         m_end;
+    std::vector<TileArchiveEntry>   m_entries;
+    std::vector<std::string>        m_types;
+    std::set<TileArchiveEntry>      m_keys;   ///< Positions added so far
+    std::multimap<uint64, size_t>   m_blobs;  ///< Content hash -> an entry holding that content
+    size_t         m_unique;
+    mutable Mutex  m_mutex;
+
+    uint32 type_index( std::string const& filetype );
+
+  public:
+    /// Create the archive, replacing any existing file.
+    TileArchiveWriter( std::string const& filename );
+    ~TileArchiveWriter();
+
+    /// Add a tile in the given file type ("png", "jpg", ...).  A later
+    /// tile with the same level and position replaces an earlier one.
+    void add_tile( int32 level, int32 x, int32 y, std::string const& filetype,
+                   uint8 const* data, size_t size );
+
+    /// Whether a tile has been added at this level and position.
+    bool has_tile( int32 level, int32 x, int32 y ) const;
+
+    /// Write the index and close the file.
+    void close();
+
+    std::string const& filename() const { return m_filename; }
+
+    /// The number of tiles added, and how many of them were distinct.
+    size_t num_tiles() const;
+    size_t num_unique_tiles() const;
+  };
+
+  /// Reads tiles from an archive.  The index is loaded when the archive
+  /// is opened; tiles are read on demand, and reads may be made from
+  /// several threads at once.
+  class TileArchiveReader : private boost::noncopyable {
+    std::string   m_filename;
+    mutable std::ifstream m_file;
+    std::vector<TileArchiveEntry> m_entries;
+    std::vector<std::string>      m_types;
+    mutable Mutex m_mutex;
+
+    TileArchiveEntry const* find( int32 level, int32 x, int32 y ) const;
+
+  public:
+    TileArchiveReader( std::string const& filename );
+
+    /// All the tiles, sorted by level, then row, then column.
+    std::vector<TileArchiveEntry> const& entries() const { return m_entries; }
+    std::string const& filetype( TileArchiveEntry const& entry ) const { return m_types[entry.type]; }
+    size_t num_tiles() const { return m_entries.size(); }
+
+    bool has_tile( int32 level, int32 x, int32 y ) const { return find( level, x, y ) != 0; }
+
+    /// Read the encoded bytes of a tile.  Returns false if there is no
+    /// such tile.
+    bool read_tile( int32 level, int32 x, int32 y, std::vector<uint8>& data,
+                    std::string* filetype = 0 ) const;
+
+    /// Read a tile by its path in the archive, as made by
+    /// tile_archive_path().  Returns false if there is no such tile.
+    bool read_tile( std::string const& path, std::vector<uint8>& data,
+                    std::string* filetype = 0 ) const;
+
+    /// Open a tile as an image resource.  Throws if there is no such tile.
+    boost::shared_ptr<SrcImageResource> open_tile( int32 level, int32 x, int32 y ) const;
+  };
+
+} // namespace mosaic
+} // namespace vw
+
+#endif // __VW_MOSAIC_TILEARCHIVE_H__
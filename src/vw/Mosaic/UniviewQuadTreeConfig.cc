@@ -25,19 +25,22 @@
 #include <boost/filesystem/fstream.hpp>
 namespace fs = boost::filesystem;
 
-#include <vw/FileIO/DiskImageResourcePNG.h>
+#include <vw/Image/ImageResource.h>
 
 namespace vw {
 namespace mosaic {
 
-  // A special subclass of DiskImageResourcePNG that produces the bizarro
-  // 16-bit PNG files that Uniview uses for terrain data.  They're standard
-  // uint16 image files, except the data is interpreted as signed int16
-  // data instead.
-  class UniviewTerrainResource : public DiskImageResourcePNG {
+  // A wrapper resource that produces the bizarro 16-bit PNG files that
+  // Uniview uses for terrain data.  They're standard uint16 image files,
+  // except the data is interpreted as signed int16 data instead.  The
+  // PNG itself is written by the wrapped resource, which is a file or a
+  // tile in a tile archive.
+  class UniviewTerrainResource : public DstImageResource {
+    boost::shared_ptr<DstImageResource> m_resource;
 
-    // A convenience function to force the format hint that we
-    // pass to DiskImageResourcePNG to be single-channel uint16
+  public:
+    // A convenience function to force the format of the wrapped
+    // resource to be single-channel uint16
     static ImageFormat make_uint16( ImageFormat const& format ) {
       ImageFormat result = format;
       result.pixel_format = VW_PIXEL_GRAY;
@@ -45,20 +48,22 @@ namespace mosaic {
       return result;
     }
 
-  public:
-    // We only provide a constructor for image *creation*, at least for now.
-    UniviewTerrainResource( std::string const& filename, ImageFormat const& format )
-      : DiskImageResourcePNG( filename, make_uint16(format) )
+    UniviewTerrainResource( boost::shared_ptr<DstImageResource> const& resource )
+      : m_resource( resource )
     {}
 
+    virtual bool has_block_write () const { return false; }
+    virtual bool has_nodata_write() const { return false; }
+    virtual void flush() { m_resource->flush(); }
+
     // First we convert to single-channel signed int16, then we spoof that as
-    // uint16 data and pass it along to DiskImageResourcePNG to write.
-    void write( ImageBuffer const& src, BBox2i const& bbox ) {
+    // uint16 data and pass it along to the wrapped resource to write.
+    virtual void write( ImageBuffer const& src, BBox2i const& bbox ) {
       ImageView<PixelGray<int16> > im_buf( src.format.cols, src.format.rows );
       ImageBuffer buffer = im_buf.buffer();
       convert( buffer, src );
       buffer.format.channel_type = VW_CHANNEL_UINT16;
-      DiskImageResourcePNG::write( buffer, bbox );
+      m_resource->write( buffer, bbox );
     }
   };
 
@@ -90,15 +95,18 @@ namespace mosaic {
   }
 
 
-  boost::shared_ptr<DstImageResource> UniviewQuadTreeConfig::terrain_tile_resource( QuadTreeGenerator const& /*qtree*/,QuadTreeGenerator::TileInfo const& info, ImageFormat const& format ) {
-    create_directories( fs::path( info.filepath ).parent_path() );
-    return boost::shared_ptr<DstImageResource>( new UniviewTerrainResource( info.filepath+info.filetype, format ) );
+  boost::shared_ptr<DstImageResource> UniviewQuadTreeConfig::terrain_tile_resource( QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info, ImageFormat const& format ) {
+    boost::shared_ptr<DstImageResource> resource = qtree.create_tile_resource( info, UniviewTerrainResource::make_uint16( format ) );
+    return boost::shared_ptr<DstImageResource>( new UniviewTerrainResource( resource ) );
   }
 
 
   void UniviewQuadTreeConfig::configure( QuadTreeGenerator &qtree ) const {
     qtree.set_image_path_func( &image_path );
-    if( m_terrain ) qtree.set_tile_resource_func( &terrain_tile_resource );
+    if( m_terrain ) {
+      qtree.set_file_type( "png" );
+      qtree.set_tile_resource_func( &terrain_tile_resource );
+    }
     qtree.set_metadata_func( boost::bind(&UniviewQuadTreeConfig::metadata_func,this,_1,_2) );
   }
 
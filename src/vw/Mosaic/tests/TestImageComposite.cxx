@@ -50,3 +50,105 @@ TEST(TestImageComposite, Basic) {
       EXPECT_EQ(2, c(col, row)) << "at (" << col << "," << row << ")";
   }
 }
+
+static ImageView<PixelRGBA<float32> > make_rgba(int32 cols, int32 rows, float32 x) {
+  ImageView<PixelRGBA<float32> > img(cols,rows);
+  fill(img, PixelRGBA<float32>(x, x, x, 1));
+  return img;
+}
+
+TEST(TestImageComposite, Blend) {
+  typedef PixelRGBA<float32> PixelT;
+  ImageComposite<PixelT> c;
+  c.insert(make_rgba(90,70,0.2f),  0,  0);
+  c.insert(make_rgba(80,75,0.6f), 47, 33);
+  c.prepare();
+  ASSERT_EQ(127, c.cols());
+  ASSERT_EQ(108, c.rows());
+
+  ImageView<PixelT> full = c.generate_patch(BBox2i(0,0,c.cols(),c.rows()));
+  // Covered pixels stay within the source values, uncovered ones are clear.
+  for (int32 row = 0; row < full.rows(); ++row)
+    for (int32 col = 0; col < full.cols(); ++col) {
+      bool covered = (col < 90 && row < 70) || (col >= 47 && row >= 33);
+      if (!covered) {
+        EXPECT_EQ(0, full(col,row).a());
+        continue;
+      }
+      EXPECT_NEAR(1, full(col,row).a(), 1e-5);
+      EXPECT_GE(full(col,row).r(), 0.2f - 1e-5);
+      EXPECT_LE(full(col,row).r(), 0.6f + 1e-5);
+    }
+  EXPECT_NEAR(0.2, full(10,10).r(), 1e-5);
+  EXPECT_NEAR(0.6, full(120,100).r(), 1e-5);
+
+  // Each patch only builds the pyramids it needs, but the result does
+  // not depend on how the output is split up.
+  for (int32 y = 0; y < c.rows(); y += 32)
+    for (int32 x = 0; x < c.cols(); x += 32) {
+      BBox2i bbox(x, y, std::min(32, c.cols()-x), std::min(32, c.rows()-y));
+      ImageView<PixelT> patch = c.generate_patch(bbox);
+      for (int32 row = 0; row < patch.rows(); ++row)
+        for (int32 col = 0; col < patch.cols(); ++col)
+          for (int32 ch = 0; ch < 4; ++ch)
+            EXPECT_NEAR(full(x+col,y+row)[ch], patch(col,row)[ch], 1e-5);
+    }
+}
+
+TEST(TestImageComposite, BlendLargeSources) {
+  // The smallest source calls for seven pyramid levels.
+  typedef PixelRGBA<float32> PixelT;
+  ImageComposite<PixelT> c, capped;
+  c.insert(make_rgba(560,530,0.2f),    0,   0);
+  c.insert(make_rgba(560,530,0.6f),  300, 200);
+  capped.insert(make_rgba(560,530,0.2f),    0,   0);
+  capped.insert(make_rgba(560,530,0.6f),  300, 200);
+  capped.set_max_levels(6);
+  c.prepare();
+  capped.prepare();
+  ASSERT_EQ(860, c.cols());
+  ASSERT_EQ(730, c.rows());
+
+  BBox2i all(0,0,c.cols(),c.rows());
+  ImageView<PixelT> full = c.generate_patch(all);
+  ImageView<PixelT> full_capped = capped.generate_patch(all);
+
+  // Only an explicit cap drops the lowest band, which changes the
+  // blend across the seam.
+  double max_diff = 0;
+  for (int32 row = 0; row < full.rows(); ++row)
+    for (int32 col = 0; col < full.cols(); ++col)
+      max_diff = std::max(max_diff, double(fabs(full(col,row).r() - full_capped(col,row).r())));
+  EXPECT_GT(max_diff, 1e-3);
+
+  // Tiling stays exact with the full level count.
+  for (int32 y = 0; y < c.rows(); y += 256)
+    for (int32 x = 0; x < c.cols(); x += 256) {
+      BBox2i bbox(x, y, std::min(256, c.cols()-x), std::min(256, c.rows()-y));
+      ImageView<PixelT> patch = c.generate_patch(bbox);
+      for (int32 row = 0; row < patch.rows(); ++row)
+        for (int32 col = 0; col < patch.cols(); ++col)
+          for (int32 ch = 0; ch < 4; ++ch)
+            EXPECT_NEAR(full(x+col,y+row)[ch], patch(col,row)[ch], 1e-5);
+    }
+}
+
+TEST(TestImageComposite, SourceIndex) {
+  std::vector<BBox2i> bboxes;
+  for (int32 i = 0; i < 20; ++i)
+    for (int32 j = 0; j < 20; ++j)
+      bboxes.push_back(BBox2i(i*50, j*40, 60 + (i%3)*10, 45));
+  SourceIndex index;
+  index.build(bboxes);
+
+  BBox2i queries[] = { BBox2i(0,0,1,1), BBox2i(123,77,400,250),
+                       BBox2i(-50,-50,10,10), BBox2i(990,800,300,300) };
+  for (size_t q = 0; q < sizeof(queries)/sizeof(queries[0]); ++q) {
+    std::vector<uint32> expected, found;
+    for (size_t i = 0; i < bboxes.size(); ++i)
+      if (queries[q].intersects(bboxes[i]))
+        expected.push_back(uint32(i));
+    index.find(bboxes, queries[q], found);
+    EXPECT_EQ(expected, found);
+  }
+}
@@ -0,0 +1,78 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+#include <test/Helpers.h>
+#include <vw/Mosaic/QuadTreeGenerator.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/PixelTypes.h>
+
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+using namespace std;
+using namespace vw;
+using namespace vw::mosaic;
+using namespace vw::test;
+
+namespace fs = boost::filesystem;
+
+// The contents of every file in a directory, by file name.
+static map<string, string> read_tiles( string const& dir ) {
+  map<string, string> tiles;
+  for (fs::directory_iterator it(dir), end; it != end; ++it) {
+    ifstream in(it->path().string().c_str(), ios::binary);
+    tiles[it->path().filename().string()] = string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+  return tiles;
+}
+
+static void generate( ImageView<PixelRGBA<uint8> > const& image, string const& name, int32 threads ) {
+  QuadTreeGenerator qtree(image, name);
+  qtree.set_tile_size(16);
+  qtree.set_file_type("png");
+  qtree.set_crop_images(true);
+  qtree.set_num_threads(threads);
+  qtree.set_num_encoder_threads(threads);
+  qtree.generate();
+}
+
+TEST(QuadTreeGenerator, ThreadsMatchSerial) {
+  // Not a multiple of the tile size, with a transparent corner, so
+  // that some tiles are cropped and some are culled.
+  ImageView<PixelRGBA<uint8> > image(150, 90);
+  for (int32 y = 0; y < image.rows(); ++y)
+    for (int32 x = 0; x < image.cols(); ++x)
+      image(x, y) = PixelRGBA<uint8>((x*7 + y) % 256, (x*y) % 256, (x + 3*y) % 256,
+                                     (x < 40 && y < 40) ? 0 : 255);
+
+  UnlinkName serial("serial.qtree"), threaded("threaded.qtree");
+  generate(image, serial, 1);
+  generate(image, threaded, 4);
+
+  map<string, string> serial_tiles = read_tiles(serial), threaded_tiles = read_tiles(threaded);
+  EXPECT_FALSE(serial_tiles.empty());
+  EXPECT_TRUE(serial_tiles.count("r.png"));
+  ASSERT_EQ(serial_tiles.size(), threaded_tiles.size());
+  for (map<string, string>::const_iterator it = serial_tiles.begin(); it != serial_tiles.end(); ++it) {
+    ASSERT_TRUE(threaded_tiles.count(it->first)) << it->first;
+    EXPECT_TRUE(threaded_tiles[it->first] == it->second) << it->first;
+  }
+}
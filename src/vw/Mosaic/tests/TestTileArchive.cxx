@@ -0,0 +1,193 @@
+// __BEGIN_LICENSE__
+//  Copyright (c) 2006-2013, United States Government as represented by the
+//  Administrator of the National Aeronautics and Space Administration. All
+//  rights reserved.
+//
+//  The NASA Vision Workbench is licensed under the Apache License,
+//  Version 2.0 (the "License"); you may not use this file except in
+//  compliance with the License. You may obtain a copy of the License at
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed under the License is distributed on an "AS IS" BASIS,
+//  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//  See the License for the specific language governing permissions and
+//  limitations under the License.
+// __END_LICENSE__
+
+
+#include <gtest/gtest_VW.h>
+#include <test/Helpers.h>
+#include <vw/Mosaic/TileArchive.h>
+#include <vw/Mosaic/QuadTreeGenerator.h>
+#include <vw/Image/ImageView.h>
+#include <vw/Image/PixelTypes.h>
+#include <vw/Image/ImageIO.h>
+#include <vw/FileIO/MemoryImageResource.h>
+
+#include <boost/bind.hpp>
+
+using namespace std;
+using namespace vw;
+using namespace vw::mosaic;
+using namespace vw::test;
+
+TEST(TestTileArchive, RoundTrip) {
+  UnlinkName archive("test.vwta");
+  const uint8 a[] = { 1, 2, 3, 4, 5 };
+  const uint8 b[] = { 9, 8, 7 };
+  {
+    TileArchiveWriter writer(archive);
+    writer.add_tile(2, 3, 1, "png", a, sizeof(a));
+    writer.add_tile(0, 0, 0, ".jpg", b, sizeof(b));
+    writer.add_tile(2, 0, 1, "png", a, sizeof(a));  // Duplicate contents
+    writer.add_tile(1, 1, 0, "png", b, sizeof(b));  // Same bytes, other type
+    writer.add_tile(2, 3, 1, "png", b, sizeof(b));  // Replaces the first tile
+    EXPECT_TRUE (writer.has_tile(2, 0, 1));
+    EXPECT_FALSE(writer.has_tile(2, 1, 0));
+    EXPECT_EQ(4u, writer.num_tiles());
+    EXPECT_EQ(3u, writer.num_unique_tiles());
+  }
+
+  TileArchiveReader reader(archive);
+  ASSERT_EQ(4u, reader.num_tiles());
+  for (size_t i = 1; i < reader.num_tiles(); ++i)
+    EXPECT_TRUE(reader.entries()[i-1] < reader.entries()[i]);
+  EXPECT_EQ(0, reader.entries()[0].level);
+  EXPECT_EQ("jpg", reader.filetype(reader.entries()[0]));
+
+  vector<uint8> data;
+  string type;
+  ASSERT_TRUE(reader.read_tile(2, 0, 1, data, &type));
+  EXPECT_EQ("png", type);
+  EXPECT_VECTOR_EQ(vector<uint8>(a, a+sizeof(a)), data);
+  ASSERT_TRUE(reader.read_tile(2, 3, 1, data, &type));
+  EXPECT_EQ("png", type);
+  EXPECT_VECTOR_EQ(vector<uint8>(b, b+sizeof(b)), data);
+  ASSERT_TRUE(reader.read_tile(1, 1, 0, data));
+  EXPECT_VECTOR_EQ(vector<uint8>(b, b+sizeof(b)), data);
+  EXPECT_FALSE(reader.read_tile(2, 1, 1, data));
+  EXPECT_FALSE(reader.has_tile(3, 0, 0));
+}
+
+TEST(TestTileArchive, BadFile) {
+  UnlinkName name("test.notarchive");
+  {
+    std::ofstream out(name.c_str());
+    out << "this is not a tile archive";
+  }
+  EXPECT_THROW(TileArchiveReader reader(name), IOErr);
+}
+
+TEST(TestTileArchive, QuadTree) {
+  UnlinkName archive("test.qtree.vwta");
+  ImageView<PixelRGB<uint8> > image(64, 32);
+  for (int32 y = 0; y < image.rows(); ++y)
+    for (int32 x = 0; x < image.cols(); ++x)
+      image(x, y) = PixelRGB<uint8>(x < 32 ? 0 : 255, 0, 0);
+
+  {
+    boost::shared_ptr<TileArchiveWriter> writer(new TileArchiveWriter(archive));
+    QuadTreeGenerator qtree(image, "test.qtree");
+    qtree.set_tile_size(16);
+    qtree.set_file_type("png");
+    qtree.set_tile_archive(writer);
+    qtree.generate();
+    writer->close();
+  }
+
+  // A 64x32 image in 16 pixel tiles needs three levels.  Only the
+  // tiles over the image are made, and the left and right halves of
+  // the image are uniform, so only a few distinct tiles are stored.
+  TileArchiveReader reader(archive);
+  EXPECT_TRUE(reader.has_tile(0, 0, 0));
+  EXPECT_TRUE(reader.has_tile(2, 3, 1));
+  EXPECT_EQ(QuadTreeGenerator::tile_position("13"), Vector2i(3, 1));
+
+  boost::shared_ptr<SrcImageResource> tile = reader.open_tile(2, 3, 1);
+  ASSERT_EQ(16, tile->cols());
+  ASSERT_EQ(16, tile->rows());
+  ImageView<PixelRGB<uint8> > pixels(16, 16);
+  read_image(pixels, *tile);
+  EXPECT_EQ(255, pixels(5, 5).r());
+
+  pixels.set_size(16, 16);
+  read_image(pixels, *reader.open_tile(2, 0, 0));
+  EXPECT_EQ(0, pixels(5, 5).r());
+}
+
+namespace {
+
+  // Writes the tiles as single channel images, as Uniview terrain does.
+  class GrayResource : public DstImageResource {
+    boost::shared_ptr<DstImageResource> m_resource;
+  public:
+    GrayResource(boost::shared_ptr<DstImageResource> const& resource) : m_resource(resource) {}
+    virtual bool has_block_write () const { return false; }
+    virtual bool has_nodata_write() const { return false; }
+    virtual void flush() { m_resource->flush(); }
+    virtual void write(ImageBuffer const& src, BBox2i const& bbox) {
+      ImageView<PixelGray<uint8> > gray(src.format.cols, src.format.rows);
+      convert(gray.buffer(), src);
+      m_resource->write(gray.buffer(), bbox);
+    }
+  };
+
+  boost::shared_ptr<DstImageResource> gray_resource(QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info,
+                                                    ImageFormat const& format) {
+    ImageFormat gray_format = format;
+    gray_format.pixel_format = VW_PIXEL_GRAY;
+    gray_format.planes = 1;
+    return boost::shared_ptr<DstImageResource>(new GrayResource(qtree.create_tile_resource(info, gray_format)));
+  }
+
+  // Records the tiles each metadata call can see.
+  struct TileListing {
+    Mutex mutex;
+    std::vector<std::string> paths;
+    void operator()(QuadTreeGenerator const& qtree, QuadTreeGenerator::TileInfo const& info) {
+      Mutex::Lock lock(mutex);
+      if (qtree.tile_exists(info))
+        paths.push_back(qtree.tile_path(info));
+    }
+  };
+
+}
+
+TEST(TestTileArchive, FileConfigs) {
+  UnlinkName archive("test.configs.vwta");
+  ImageView<PixelRGB<uint8> > image(32, 32);
+  fill(image, PixelRGB<uint8>(200, 100, 50));
+
+  boost::shared_ptr<TileListing> listing(new TileListing);
+  {
+    boost::shared_ptr<TileArchiveWriter> writer(new TileArchiveWriter(archive));
+    QuadTreeGenerator qtree(image, "test.configs");
+    qtree.set_tile_size(16);
+    qtree.set_tile_archive(writer);
+    qtree.set_tile_resource_func(&gray_resource);
+    qtree.set_metadata_func(boost::bind(&TileListing::operator(), listing, _1, _2));
+    qtree.generate();
+    writer->close();
+  }
+
+  // Metadata is made after a tile is written, so it sees every tile,
+  // and refers to it by its path in the archive.
+  TileArchiveReader reader(archive);
+  ASSERT_EQ(reader.num_tiles(), listing->paths.size());
+  std::string prefix = archive + "/";
+  for (size_t i = 0; i < listing->paths.size(); ++i) {
+    ASSERT_EQ(0u, listing->paths[i].find(prefix));
+    vector<uint8> data;
+    EXPECT_TRUE(reader.read_tile(listing->paths[i].substr(prefix.size()), data));
+  }
+  EXPECT_EQ("1/1/0.png", tile_archive_path(1, 1, 0, ".png"));
+
+  // The tiles went through the custom resource.
+  boost::shared_ptr<SrcImageResource> tile = reader.open_tile(1, 1, 0);
+  EXPECT_EQ(VW_PIXEL_GRAY, tile->pixel_format());
+  ImageView<PixelGray<uint8> > pixels;
+  read_image(pixels, *tile);
+  EXPECT_EQ(16, pixels.cols());
+  EXPECT_NEAR(int(PixelGray<uint8>(PixelRGB<uint8>(200, 100, 50)).v()), int(pixels(3, 3).v()), 1);
+}
@@ -313,6 +313,8 @@ StereoModel::operator()(ImageView<PixelMask<Vector2f> > const& disparity_map,
     }
     for (int32 x = 0; x < disparity_map.cols(); x++) {
       if ( is_valid(disparity_map(x,y)) ) {
+        // Go through the virtual operator, so that subclasses which
+        // triangulate differently are honored.
         xyz(x,y) = (*this)(Vector2( x, y),
                            Vector2( x+disparity_map(x,y)[0],
                                     y+disparity_map(x,y)[1]),
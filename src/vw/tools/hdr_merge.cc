@@ -36,6 +36,7 @@
 
 #include <vw/Core/Exception.h>
 #include <vw/Core/Log.h>
+#include <vw/Core/Settings.h>
 #include <vw/Image/ImageView.h>
 #include <vw/Image/ImageViewRef.h>
 #include <vw/Image/PixelMath.h>
@@ -48,6 +49,8 @@
 #include <string>
 
 #include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 namespace po = boost::program_options;
 
 using std::cout;
@@ -58,6 +61,27 @@ using std::string;
 using namespace vw;
 using namespace vw::hdr;
 
+// Merges the exposures read with the channel type ChannelT.  8- and
+// 16-bit exposures are merged through the luminance tables of
+// HighDynamicRangeView.
+template <class ChannelT>
+void merge_exposures( vector<string> const& input_filenames, CameraCurveFn const& curves,
+                      vector<double> const& brightness_values, string const& output_filename ) {
+  vector<ImageViewRef<PixelRGB<ChannelT> > > images(input_filenames.size());
+  for ( unsigned i=0; i < input_filenames.size(); ++i )
+    images[i] = DiskImageView<PixelRGB<ChannelT> >(input_filenames[i]);
+
+  TerminalProgressCallback tpc( "tools.hdr_merge", "Processing");
+  // Create the HDR images and write the results to the file.  The
+  // blocks are merged in parallel.
+  HighDynamicRangeView<PixelRGB<ChannelT> > hdr_image(images, curves, brightness_values);
+  boost::scoped_ptr<DiskImageResource> r(DiskImageResource::create(output_filename, hdr_image.format()));
+  if ( r->has_block_write() )
+    r->set_block_write_size( Vector2i( vw_settings().default_tile_size(),
+                                       vw_settings().default_tile_size() ) );
+  block_write_image( *r, hdr_image, tpc );
+}
+
 int main( int argc, char *argv[] ) {
   try {
     vector<string> input_filenames;
@@ -126,9 +150,21 @@ int main( int argc, char *argv[] ) {
       }
     }
 
-    TerminalProgressCallback tpc( "tools.hdr_merge", "Processing");
-    // Create the HDR images and write the results to the file
-    write_image(output_filename, HighDynamicRangeView<PixelRGB<float> > (images, curves, brightness_values), tpc);
+    // The curves are estimated from pixel values in [0,1], but the
+    // exposures are merged in the channel type of the files, which
+    // all share the format of the first.
+    boost::shared_ptr<DiskImageResource> rsrc( DiskImageResourcePtr(input_filenames[0]) );
+    switch ( rsrc->channel_type() ) {
+    case VW_CHANNEL_UINT8:
+      merge_exposures<uint8>(input_filenames, curves, brightness_values, output_filename);
+      break;
+    case VW_CHANNEL_UINT16:
+      merge_exposures<uint16>(input_filenames, curves, brightness_values, output_filename);
+      break;
+    default:
+      merge_exposures<float>(input_filenames, curves, brightness_values, output_filename);
+      break;
+    }
 
   } catch (const vw::Exception& e) {
     vw_out() << argv[0] << ": a Vision Workbench error occurred: \n\t"
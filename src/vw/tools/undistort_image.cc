@@ -165,6 +165,10 @@ void do_work() {
   
   const int width_in  = dist_img.cols();
   const int height_in = dist_img.rows();
+
+  // Replace the per-pixel distortion solver with a lookup table
+  camera_model.build_lens_distortion_table(Vector2i(width_in, height_in));
+
   const LensDistortion* lens_ptr = camera_model.lens_distortion();
   const double pitch = camera_model.pixel_pitch();
 